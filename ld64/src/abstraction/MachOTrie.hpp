@@ -25,7 +25,10 @@
 #define __MACH_O_TRIE__
 
 #include <algorithm>
+#include <deque>
+#include <vector>
 #include <assert.h>
+#include <string.h>
 
 #include "MachOFileAbstraction.hpp"
 
@@ -33,220 +36,6 @@
 namespace mach_o {
 namespace trie {
 
-struct Edge
-{
-					Edge(const char* s, struct Node* n) : fSubString(s), fChild(n) { }
-					~Edge() {  }
-	const char*		fSubString;
-	struct Node*	fChild;
-	
-};
-
-struct Node
-{
-						Node(const char* s) : fCummulativeString(s), fAddress(0), fFlags(0), 
-											fOther(0), fImportedName(NULL), fOrdered(false), 
-											fHaveExportInfo(false), fTrieOffset(0) {}
-						~Node() { }
-	const char*			fCummulativeString;
-	std::vector<Edge>	fChildren;
-	uint64_t			fAddress;
-	uint64_t			fFlags;
-	uint64_t			fOther;
-	const char*			fImportedName;
-	bool				fOrdered;
-	bool				fHaveExportInfo;
-	uint32_t			fTrieOffset;
-	
-	void addSymbol(const char* fullStr, uint64_t address, uint64_t flags, uint64_t other, const char* importName) {
-		const char* partialStr = &fullStr[strlen(fCummulativeString)];
-		for (std::vector<Edge>::iterator it = fChildren.begin(); it != fChildren.end(); ++it) {
-			Edge& e = *it;
-			int subStringLen = strlen(e.fSubString);
-			if ( strncmp(e.fSubString, partialStr, subStringLen) == 0 ) {
-				// already have matching edge, go down that path
-				e.fChild->addSymbol(fullStr, address, flags, other, importName);
-				return;
-			}
-			else {
-				for (int i=subStringLen-1; i > 0; --i) {
-					if ( strncmp(e.fSubString, partialStr, i) == 0 ) {
-						// found a common substring, splice in new node
-						//  was A -> C,  now A -> B -> C
-						char* bNodeCummStr = strdup(e.fChild->fCummulativeString);
-						bNodeCummStr[strlen(bNodeCummStr)+i-subStringLen] = '\0';
-						//node* aNode = this;
-						Node* bNode = new Node(bNodeCummStr);
-						Node* cNode = e.fChild;
-						char* abEdgeStr = strdup(e.fSubString);
-						abEdgeStr[i] = '\0';
-						char* bcEdgeStr = strdup(&e.fSubString[i]);
-						Edge& abEdge = e;
-						abEdge.fSubString = abEdgeStr;
-						abEdge.fChild = bNode;
-						Edge bcEdge(bcEdgeStr, cNode);
-						bNode->fChildren.push_back(bcEdge);
-						bNode->addSymbol(fullStr, address, flags, other, importName);
-						return;
-					}
-				}
-			}
-		}
-		if ( flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
-			assert(importName != NULL);
-			assert(other != 0);
-		}
-		if ( flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER ) {
-			assert(other != 0);
-		}
-		// no commonality with any existing child, make a new edge that is this whole string
-		Node* newNode = new Node(strdup(fullStr));
-		Edge newEdge(strdup(partialStr), newNode);
-		fChildren.push_back(newEdge);
-		newNode->fAddress = address;
-		newNode->fFlags = flags;
-		newNode->fOther = other;
-		if ( (flags & EXPORT_SYMBOL_FLAGS_REEXPORT) && (importName != NULL) && (strcmp(fullStr,importName) != 0) )
-			newNode->fImportedName = importName;
-		else
-			newNode->fImportedName = NULL;
-		newNode->fHaveExportInfo = true;
-	}
-	
-	void addOrderedNodes(const char* name, std::vector<Node*>& orderedNodes) {
-		if ( !fOrdered ) {
-			orderedNodes.push_back(this);
-			//fprintf(stderr, "ordered %p %s\n", this, fCummulativeString);
-			fOrdered = true;
-		}
-		const char* partialStr = &name[strlen(fCummulativeString)];
-		for (std::vector<Edge>::iterator it = fChildren.begin(); it != fChildren.end(); ++it) {
-			Edge& e = *it;
-			int subStringLen = strlen(e.fSubString);
-			if ( strncmp(e.fSubString, partialStr, subStringLen) == 0 ) {
-				// already have matching edge, go down that path
-				e.fChild->addOrderedNodes(name, orderedNodes);
-				return;
-			}
-		}
-	}
-
-	// byte for terminal node size in bytes, or 0x00 if not terminal node
-	// teminal node (uleb128 flags, uleb128 addr [uleb128 other])
-	// byte for child node count
-	//  each child: zero terminated substring, uleb128 node offset
-	bool updateOffset(uint32_t& offset) {
-		uint32_t nodeSize = 1; // length of export info when no export info
-		if ( fHaveExportInfo ) {
-			if ( fFlags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
-				nodeSize = uleb128_size(fFlags) + uleb128_size(fOther); // ordinal
-				if ( fImportedName != NULL )
-					nodeSize += strlen(fImportedName);
-				++nodeSize; // trailing zero in imported name
-			}
-			else {
-				nodeSize = uleb128_size(fFlags) + uleb128_size(fAddress);
-				if ( fFlags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER )
-					nodeSize += uleb128_size(fOther);
-			}
-			// do have export info, overall node size so far is uleb128 of export info + export info
-			nodeSize += uleb128_size(nodeSize); 
-		}
-		// add children
-		++nodeSize; // byte for count of chidren
-		for (std::vector<Edge>::iterator it = fChildren.begin(); it != fChildren.end(); ++it) {
-			Edge& e = *it;
-			nodeSize += strlen(e.fSubString) + 1 + uleb128_size(e.fChild->fTrieOffset);
-		}
-		bool result = (fTrieOffset != offset);
-		fTrieOffset = offset;
-		//fprintf(stderr, "updateOffset %p %05d %s\n", this, fTrieOffset, fCummulativeString);
-		offset += nodeSize;
-		// return true if fTrieOffset was changed
-		return result;
-	}
-
-	void appendToStream(std::vector<uint8_t>& out) {
-		if ( fHaveExportInfo ) {
-			if ( fFlags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
-				if ( fImportedName != NULL ) {
-					// nodes with re-export info: size, flags, ordinal, string
-					uint32_t nodeSize = uleb128_size(fFlags) + uleb128_size(fOther) + strlen(fImportedName) + 1;
-					out.push_back(nodeSize);
-					append_uleb128(fFlags, out);
-					append_uleb128(fOther, out);
-					append_string(fImportedName, out);
-				}
-				else {
-					// nodes with re-export info: size, flags, ordinal, empty-string
-					uint32_t nodeSize = uleb128_size(fFlags) + uleb128_size(fOther) + 1;
-					out.push_back(nodeSize);
-					append_uleb128(fFlags, out);
-					append_uleb128(fOther, out);
-					out.push_back(0);
-				}
-			}
-			else if ( fFlags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER ) {
-				// nodes with export info: size, flags, address, other
-				uint32_t nodeSize = uleb128_size(fFlags) + uleb128_size(fAddress) + uleb128_size(fOther);
-				out.push_back(nodeSize);
-				append_uleb128(fFlags, out);
-				append_uleb128(fAddress, out);
-				append_uleb128(fOther, out);
-			}
-			else {
-				// nodes with export info: size, flags, address
-				uint32_t nodeSize = uleb128_size(fFlags) + uleb128_size(fAddress);
-				out.push_back(nodeSize);
-				append_uleb128(fFlags, out);
-				append_uleb128(fAddress, out);
-			}
-		}
-		else {
-			// no export info uleb128 of zero is one byte of zero
-			out.push_back(0);
-		}
-		// write number of children
-		out.push_back(fChildren.size());
-		// write each child
-		for (std::vector<Edge>::iterator it = fChildren.begin(); it != fChildren.end(); ++it) {
-			Edge& e = *it;
-			append_string(e.fSubString, out);
-			append_uleb128(e.fChild->fTrieOffset, out);
-		}
-	}
-	
-private:
-	static void append_uleb128(uint64_t value, std::vector<uint8_t>& out) {
-		uint8_t byte;
-		do {
-			byte = value & 0x7F;
-			value &= ~0x7F;
-			if ( value != 0 )
-				byte |= 0x80;
-			out.push_back(byte);
-			value = value >> 7;
-		} while( byte >= 0x80 );
-	}
-	
-	static void append_string(const char* str, std::vector<uint8_t>& out) {
-		for (const char* s = str; *s != '\0'; ++s)
-			out.push_back(*s);
-		out.push_back('\0');
-	}
-	
-	static unsigned int	uleb128_size(uint64_t value) {
-		uint32_t result = 0;
-		do {
-			value = value >> 7;
-			++result;
-		} while ( value != 0 );
-		return result;
-	}
-	
-
-};
-
 inline uint64_t read_uleb128(const uint8_t*& p, const uint8_t* end) {
 	uint64_t result = 0;
 	int		 bit = 0;
@@ -279,38 +68,314 @@ struct Entry
 };
 
 
+//
+// Builds the export trie for a list of symbols.
+//
+// Symbols are added to the trie one at a time in the order given, and which
+// edges get split and the order children are written in depend on that order.
+// Every trie ld64 has ever written depends on it, so the builder keeps exactly
+// that algorithm.  What it avoids is the cost: nodes and edges are carved out of
+// arenas instead of new'ed, edge strings are (pointer, length) slices of the
+// symbol names instead of strdup()ed copies, and children are matched on their
+// first character instead of strncmp()ing every prefix length.
+//
+class TrieBuilder
+{
+public:
+						TrieBuilder(const std::vector<Entry>& entries) : _entries(entries) { }
 
-inline void makeTrie(const std::vector<Entry>& entries, std::vector<uint8_t>& output)
+	void				build(std::vector<uint8_t>& output);
+
+private:
+	struct Node;
+	struct Edge
+	{
+		const char*		subString;			// points into a symbol name, not zero terminated
+		uint32_t		subStringLen;
+		Node*			child;
+		Edge*			next;
+	};
+
+	struct Node
+	{
+		uint32_t		cummulativeStringLen;
+		uint32_t		childCount;
+		Edge*			firstChild;
+		Edge*			lastChild;
+		uint64_t		address;
+		uint64_t		flags;
+		uint64_t		other;
+		const char*		importedName;
+		uint32_t		importedNameLen;
+		uint32_t		trieOffset;
+		bool			ordered;
+		bool			haveExportInfo;
+	};
+
+	// std::deque never moves its elements, so it serves as a simple arena
+	Node*				newNode(uint32_t cummulativeStringLen);
+	void				addChild(Node* parent, const char* subString, uint32_t subStringLen, Node* child);
+	void				addSymbol(Node* start, const Entry& entry, uint32_t nameLen);
+	void				addOrderedNodes(Node* start, const char* name, uint32_t nameLen, std::vector<Node*>& orderedNodes);
+	static bool			updateOffset(Node* node, uint32_t& offset);
+	static void			appendToStream(const Node* node, std::vector<uint8_t>& out);
+	static void			append_uleb128(uint64_t value, std::vector<uint8_t>& out);
+	static void			append_string(const char* str, uint32_t len, std::vector<uint8_t>& out);
+	static unsigned int	uleb128_size(uint64_t value);
+
+	const std::vector<Entry>&	_entries;
+	std::deque<Node>			_nodes;
+	std::deque<Edge>			_edges;
+};
+
+inline TrieBuilder::Node* TrieBuilder::newNode(uint32_t cummulativeStringLen)
 {
-	Node start(strdup(""));
-	
+	_nodes.emplace_back();
+	Node* node = &_nodes.back();
+	node->cummulativeStringLen = cummulativeStringLen;
+	node->childCount = 0;
+	node->firstChild = NULL;
+	node->lastChild = NULL;
+	node->address = 0;
+	node->flags = 0;
+	node->other = 0;
+	node->importedName = NULL;
+	node->importedNameLen = 0;
+	node->trieOffset = 0;
+	node->ordered = false;
+	node->haveExportInfo = false;
+	return node;
+}
+
+inline void TrieBuilder::addChild(Node* parent, const char* subString, uint32_t subStringLen, Node* child)
+{
+	_edges.emplace_back();
+	Edge* edge = &_edges.back();
+	edge->subString = subString;
+	edge->subStringLen = subStringLen;
+	edge->child = child;
+	edge->next = NULL;
+	if ( parent->lastChild != NULL )
+		parent->lastChild->next = edge;
+	else
+		parent->firstChild = edge;
+	parent->lastChild = edge;
+	++parent->childCount;
+}
+
+inline void TrieBuilder::addSymbol(Node* node, const Entry& entry, uint32_t nameLen)
+{
+	const char* fullStr = entry.name;
+	for (;;) {
+		const char* partialStr = &fullStr[node->cummulativeStringLen];
+		const uint32_t partialLen = nameLen - node->cummulativeStringLen;
+		// The first child whose edge shares a prefix with partialStr is taken.  Edges
+		// of a node never share a first character, except that an empty edge (made
+		// when a symbol is a prefix of an existing edge) matches everything.
+		Edge* e = node->firstChild;
+		while ( (e != NULL) && (e->subStringLen != 0) && ((partialLen == 0) || (e->subString[0] != partialStr[0])) )
+			e = e->next;
+		if ( e == NULL )
+			break;
+		if ( (e->subStringLen <= partialLen) && (memcmp(e->subString, partialStr, e->subStringLen) == 0) ) {
+			// already have matching edge, go down that path
+			node = e->child;
+			continue;
+		}
+		// found a common substring, splice in new node
+		//  was A -> C,  now A -> B -> C
+		uint32_t i = 1;
+		while ( (i < e->subStringLen) && (i < partialLen) && (e->subString[i] == partialStr[i]) )
+			++i;
+		Node* bNode = newNode(node->cummulativeStringLen + i);
+		addChild(bNode, &e->subString[i], e->subStringLen - i, e->child);
+		e->subStringLen = i;
+		e->child = bNode;
+		node = bNode;
+	}
+	if ( entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
+		assert(entry.importName != NULL);
+		assert(entry.other != 0);
+	}
+	if ( entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER ) {
+		assert(entry.other != 0);
+	}
+	// no commonality with any existing child, make a new edge that is this whole string
+	Node* newNode = this->newNode(nameLen);
+	addChild(node, &fullStr[node->cummulativeStringLen], nameLen - node->cummulativeStringLen, newNode);
+	newNode->address = entry.address;
+	newNode->flags = entry.flags;
+	newNode->other = entry.other;
+	if ( (entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT) && (entry.importName != NULL) && (strcmp(fullStr, entry.importName) != 0) ) {
+		newNode->importedName = entry.importName;
+		newNode->importedNameLen = (uint32_t)strlen(entry.importName);
+	}
+	newNode->haveExportInfo = true;
+}
+
+inline void TrieBuilder::addOrderedNodes(Node* node, const char* name, uint32_t nameLen, std::vector<Node*>& orderedNodes)
+{
+	while ( node != NULL ) {
+		if ( !node->ordered ) {
+			orderedNodes.push_back(node);
+			node->ordered = true;
+		}
+		const char* partialStr = &name[node->cummulativeStringLen];
+		const uint32_t partialLen = nameLen - node->cummulativeStringLen;
+		Node* next = NULL;
+		for (const Edge* e = node->firstChild; e != NULL; e = e->next) {
+			if ( (e->subStringLen <= partialLen) && (memcmp(e->subString, partialStr, e->subStringLen) == 0) ) {
+				// already have matching edge, go down that path
+				next = e->child;
+				break;
+			}
+		}
+		node = next;
+	}
+}
+
+// byte for terminal node size in bytes, or 0x00 if not terminal node
+// teminal node (uleb128 flags, uleb128 addr [uleb128 other])
+// byte for child node count
+//  each child: zero terminated substring, uleb128 node offset
+inline bool TrieBuilder::updateOffset(Node* node, uint32_t& offset)
+{
+	uint32_t nodeSize = 1; // length of export info when no export info
+	if ( node->haveExportInfo ) {
+		if ( node->flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
+			nodeSize = uleb128_size(node->flags) + uleb128_size(node->other); // ordinal
+			nodeSize += node->importedNameLen;
+			++nodeSize; // trailing zero in imported name
+		}
+		else {
+			nodeSize = uleb128_size(node->flags) + uleb128_size(node->address);
+			if ( node->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER )
+				nodeSize += uleb128_size(node->other);
+		}
+		// do have export info, overall node size so far is uleb128 of export info + export info
+		nodeSize += uleb128_size(nodeSize); 
+	}
+	// add children
+	++nodeSize; // byte for count of chidren
+	for (const Edge* e = node->firstChild; e != NULL; e = e->next)
+		nodeSize += e->subStringLen + 1 + uleb128_size(e->child->trieOffset);
+	bool result = (node->trieOffset != offset);
+	node->trieOffset = offset;
+	offset += nodeSize;
+	// return true if trieOffset was changed
+	return result;
+}
+
+inline void TrieBuilder::appendToStream(const Node* node, std::vector<uint8_t>& out)
+{
+	if ( node->haveExportInfo ) {
+		if ( node->flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
+			// nodes with re-export info: size, flags, ordinal, string (empty if same name)
+			uint32_t nodeSize = uleb128_size(node->flags) + uleb128_size(node->other) + node->importedNameLen + 1;
+			out.push_back(nodeSize);
+			append_uleb128(node->flags, out);
+			append_uleb128(node->other, out);
+			append_string(node->importedName, node->importedNameLen, out);
+		}
+		else if ( node->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER ) {
+			// nodes with export info: size, flags, address, other
+			uint32_t nodeSize = uleb128_size(node->flags) + uleb128_size(node->address) + uleb128_size(node->other);
+			out.push_back(nodeSize);
+			append_uleb128(node->flags, out);
+			append_uleb128(node->address, out);
+			append_uleb128(node->other, out);
+		}
+		else {
+			// nodes with export info: size, flags, address
+			uint32_t nodeSize = uleb128_size(node->flags) + uleb128_size(node->address);
+			out.push_back(nodeSize);
+			append_uleb128(node->flags, out);
+			append_uleb128(node->address, out);
+		}
+	}
+	else {
+		// no export info uleb128 of zero is one byte of zero
+		out.push_back(0);
+	}
+	// write number of children
+	out.push_back(node->childCount);
+	// write each child
+	for (const Edge* e = node->firstChild; e != NULL; e = e->next) {
+		append_string(e->subString, e->subStringLen, out);
+		append_uleb128(e->child->trieOffset, out);
+	}
+}
+
+inline void TrieBuilder::append_uleb128(uint64_t value, std::vector<uint8_t>& out)
+{
+	uint8_t byte;
+	do {
+		byte = value & 0x7F;
+		value &= ~0x7F;
+		if ( value != 0 )
+			byte |= 0x80;
+		out.push_back(byte);
+		value = value >> 7;
+	} while( byte >= 0x80 );
+}
+
+inline void TrieBuilder::append_string(const char* str, uint32_t len, std::vector<uint8_t>& out)
+{
+	out.insert(out.end(), (const uint8_t*)str, (const uint8_t*)str + len);
+	out.push_back('\0');
+}
+
+inline unsigned int TrieBuilder::uleb128_size(uint64_t value)
+{
+	uint32_t result = 0;
+	do {
+		value = value >> 7;
+		++result;
+	} while ( value != 0 );
+	return result;
+}
+
+inline void TrieBuilder::build(std::vector<uint8_t>& output)
+{
+	Node* start = newNode(0);
+
 	// make nodes for all exported symbols
-	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
-		start.addSymbol(it->name, it->address, it->flags, it->other, it->importName);
+	std::vector<uint32_t> nameLengths;
+	nameLengths.reserve(_entries.size());
+	for (std::vector<Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+		nameLengths.push_back((uint32_t)strlen(it->name));
+		addSymbol(start, *it, nameLengths.back());
 	}
 
 	// create vector of nodes
 	std::vector<Node*> orderedNodes;
-	orderedNodes.reserve(entries.size()*2);
-	for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
-		start.addOrderedNodes(it->name, orderedNodes);
-	}
+	orderedNodes.reserve(_nodes.size());
+	for (size_t i=0; i < _entries.size(); ++i)
+		addOrderedNodes(start, _entries[i].name, nameLengths[i], orderedNodes);
 	
 	// assign each node in the vector an offset in the trie stream, iterating until all uleb128 sizes have stabilized
 	bool more;
+	uint32_t offset;
 	do {
-		uint32_t offset = 0;
+		offset = 0;
 		more = false;
 		for (std::vector<Node*>::iterator it = orderedNodes.begin(); it != orderedNodes.end(); ++it) {
-			if ( (*it)->updateOffset(offset) )
+			if ( updateOffset(*it, offset) )
 				more = true;
 		}
 	} while ( more );
 	
 	// create trie stream
-	for (std::vector<Node*>::iterator it = orderedNodes.begin(); it != orderedNodes.end(); ++it) {
-		(*it)->appendToStream(output);
-	}
+	output.reserve(output.size() + offset);
+	for (std::vector<Node*>::iterator it = orderedNodes.begin(); it != orderedNodes.end(); ++it)
+		appendToStream(*it, output);
+}
+
+
+inline void makeTrie(const std::vector<Entry>& entries, std::vector<uint8_t>& output)
+{
+	TrieBuilder builder(entries);
+	builder.build(output);
 }
 
 struct EntryWithOffset
@@ -323,6 +388,24 @@ struct EntryWithOffset
 
 
 
+static inline void parseTerminal(const uint8_t* p, const uint8_t* const end, Entry& entry)
+{
+	entry.flags = read_uleb128(p, end);
+	if ( entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
+		entry.address = 0;
+		entry.other = read_uleb128(p, end); // dylib ordinal
+		entry.importName = (char*)p;
+	}
+	else {
+		entry.address = read_uleb128(p, end); 
+		if ( entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER )
+			entry.other = read_uleb128(p, end); 
+		else
+			entry.other = 0;
+		entry.importName = NULL;
+	}
+}
+
 static inline void processExportNode(const uint8_t* const start, const uint8_t* p, const uint8_t* const end, 
 									char* cummulativeString, int curStrOffset, 
 									std::vector<EntryWithOffset>& output) 
@@ -335,20 +418,7 @@ static inline void processExportNode(const uint8_t* const start, const uint8_t*
 		EntryWithOffset e;
 		e.nodeOffset = p-start;
 		e.entry.name = strdup(cummulativeString);
-		e.entry.flags = read_uleb128(p, end);
-		if ( e.entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT ) {
-			e.entry.address = 0;
-			e.entry.other = read_uleb128(p, end); // dylib ordinal
-			e.entry.importName = (char*)p;
-		}
-		else {
-			e.entry.address = read_uleb128(p, end); 
-			if ( e.entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER )
-				e.entry.other = read_uleb128(p, end); 
-			else
-				e.entry.other = 0;
-			e.entry.importName = NULL;
-		}
+		parseTerminal(p, end, e.entry);
 		output.push_back(e);
 	}
 	if ( children > end )
@@ -389,6 +459,143 @@ inline void parseTrie(const uint8_t* start, const uint8_t* end, std::vector<Entr
 }
 
 
+//
+// Lookups that walk the trie where it lies instead of parsing all of it.
+//
+
+// Follows the edges spelling out prefix from the root.  Returns the node
+// reached, or NULL if no exported name starts with prefix.  If path is not
+// NULL the edges followed are copied into it, and pathLength is set to their
+// total length, which is longer than prefix when prefix ends part way along
+// an edge.
+static inline const uint8_t* walkTrie(const uint8_t* start, const uint8_t* end, const char* prefix,
+									  char* path, uint32_t& pathLength)
+{
+	const uint8_t* p = start;
+	const char* s = prefix;
+	pathLength = 0;
+	while ( *s != '\0' ) {
+		if ( p >= end )
+			throw "malformed trie, node past end";
+		const uint64_t terminalSize = read_uleb128(p, end);
+		const uint8_t* children = p + terminalSize;
+		if ( children >= end )
+			throw "malformed trie, terminalSize extends beyond trie data";
+		const uint8_t childrenCount = *children++;
+		const uint8_t* e = children;
+		const uint8_t* next = NULL;
+		for (uint8_t i=0; (i < childrenCount) && (next == NULL); ++i) {
+			const char* edge = (char*)e;
+			const uint32_t edgeLen = strnlen(edge, end-e);
+			if ( edgeLen == (uint32_t)(end-e) )
+				throw "malformed trie, edge string extends beyond trie data";
+			e += edgeLen+1;
+			const uint64_t childNodeOffset = read_uleb128(e, end);
+			// edges leaving a node all start with different characters
+			if ( (edgeLen == 0) || (edge[0] != s[0]) )
+				continue;
+			uint32_t matched = 1;
+			while ( (matched < edgeLen) && (s[matched] != '\0') && (s[matched] == edge[matched]) )
+				++matched;
+			if ( (matched != edgeLen) && (s[matched] != '\0') )
+				return NULL;
+			if ( childNodeOffset == 0 )
+				throw "malformed trie, childNodeOffset==0";
+			if ( path != NULL )
+				memcpy(&path[pathLength], edge, edgeLen);
+			pathLength += edgeLen;
+			s += matched;
+			next = start + childNodeOffset;
+		}
+		if ( next == NULL )
+			return NULL;
+		p = next;
+	}
+	if ( path != NULL )
+		path[pathLength] = '\0';
+	return p;
+}
+
+// Looks up one exported name.  entry.name is left as is.
+inline bool findTrieEntry(const uint8_t* start, const uint8_t* end, const char* name, Entry& entry)
+{
+	if ( start == end )
+		return false;
+	uint32_t pathLength;
+	const uint8_t* p = walkTrie(start, end, name, NULL, pathLength);
+	// a longer path means name ends part way along an edge
+	if ( (p == NULL) || (pathLength != strlen(name)) )
+		return false;
+	if ( p >= end )
+		throw "malformed trie, node past end";
+	const uint64_t terminalSize = read_uleb128(p, end);
+	if ( terminalSize == 0 )
+		return false;
+	parseTerminal(p, end, entry);
+	return true;
+}
+
+// Like parseTrie(), but only for names starting with prefix.
+inline void parseTrieWithPrefix(const uint8_t* start, const uint8_t* end, const char* prefix, std::vector<Entry>& output)
+{
+	if ( start == end )
+		return;
+	char* cummulativeString = new char[end-start+strlen(prefix)+1];
+	uint32_t pathLength;
+	const uint8_t* node = walkTrie(start, end, prefix, cummulativeString, pathLength);
+	if ( node != NULL ) {
+		std::vector<EntryWithOffset> entries;
+		processExportNode(start, node, end, cummulativeString, pathLength, entries);
+		std::sort(entries.begin(), entries.end());
+		output.reserve(entries.size());
+		for (std::vector<EntryWithOffset>::iterator it=entries.begin(); it != entries.end(); ++it)
+			output.push_back(it->entry);
+	}
+	delete [] cummulativeString;
+}
+
+template <typename H>
+static inline void forEachNameInNode(const uint8_t* const start, const uint8_t* p, const uint8_t* const end,
+									 char* cummulativeString, int curStrOffset, H& handler)
+{
+	if ( p >= end )
+		throw "malformed trie, node past end";
+	const uint64_t terminalSize = read_uleb128(p, end);
+	const uint8_t* children = p + terminalSize;
+	if ( terminalSize != 0 )
+		handler(cummulativeString);
+	if ( children >= end )
+		throw "malformed trie, terminalSize extends beyond trie data";
+	const uint8_t childrenCount = *children++;
+	const uint8_t* s = children;
+	for (uint8_t i=0; i < childrenCount; ++i) {
+		int edgeStrLen = 0;
+		while (*s != '\0') {
+			cummulativeString[curStrOffset+edgeStrLen] = *s++;
+			++edgeStrLen;
+		}
+		cummulativeString[curStrOffset+edgeStrLen] = *s++;
+		uint32_t childNodeOffset = read_uleb128(s, end);
+		if (childNodeOffset == 0)
+			throw "malformed trie, childNodeOffset==0";
+		forEachNameInNode(start, start+childNodeOffset, end, cummulativeString, curStrOffset+edgeStrLen, handler);
+	}
+}
+
+// Calls handler(name) for every exported name, in no particular order.  The
+// name is only valid during the call.
+template <typename H>
+inline void forEachTrieName(const uint8_t* start, const uint8_t* end, H& handler)
+{
+	if ( start == end )
+		return;
+	char* cummulativeString = new char[end-start+1];
+	cummulativeString[0] = '\0';
+	forEachNameInNode(start, start, end, cummulativeString, 0, handler);
+	delete [] cummulativeString;
+}
+
+
 
 
 }; // namespace trie
@@ -0,0 +1,200 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+namespace ld {
+namespace arena {
+
+//
+// Bump allocator for what parsers create that lives until the link is done:
+// files, atoms, fixups, sections and their names.  Nothing allocated here is
+// ever freed or destroyed; the memory goes away with the process.
+//
+// Each thread bumps through its own chunk, so parser threads never contend.
+// Requests too big to share a chunk get a chunk of their own.  When a thread
+// exits its arena goes on a free list, and the next new thread carries on
+// bumping through the same chunk, so the short lived threads of each
+// parallel phase do not leave a mostly unused chunk behind.
+//
+struct ThreadArena {
+	uint8_t*		current;
+	uint8_t*		end;
+	uint64_t		allocated;		// bytes handed out
+	uint64_t		reserved;		// bytes in chunks
+	ThreadArena*	next;			// in list of all thread arenas
+	ThreadArena*	nextFree;		// in list of arenas no thread is using
+};
+
+enum { kChunkSize = 1024*1024, kLargeAllocation = kChunkSize/8 };
+
+inline pthread_mutex_t& arenasLock()
+{
+	static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+	return sLock;
+}
+
+inline ThreadArena*& allArenas()
+{
+	static ThreadArena* sArenas = NULL;
+	return sArenas;
+}
+
+inline ThreadArena*& freeArenas()
+{
+	static ThreadArena* sFreeArenas = NULL;
+	return sFreeArenas;
+}
+
+// called when a thread that used an arena exits
+inline void releaseArena(void* value)
+{
+	ThreadArena* arena = (ThreadArena*)value;
+	pthread_mutex_lock(&arenasLock());
+	arena->nextFree = freeArenas();
+	freeArenas() = arena;
+	pthread_mutex_unlock(&arenasLock());
+}
+
+inline pthread_key_t& arenaKey()
+{
+	static pthread_key_t sKey;
+	return sKey;
+}
+
+inline bool& haveArenaKey()
+{
+	static bool sHaveKey = false;
+	return sHaveKey;
+}
+
+inline void makeArenaKey()
+{
+	// without a key arenas are just not reused
+	haveArenaKey() = (pthread_key_create(&arenaKey(), &releaseArena) == 0);
+}
+
+inline ThreadArena* threadArena()
+{
+	static __thread ThreadArena* sArena = NULL;
+	if ( sArena == NULL ) {
+		static pthread_once_t sKeyOnce = PTHREAD_ONCE_INIT;
+		pthread_once(&sKeyOnce, &makeArenaKey);
+		pthread_mutex_lock(&arenasLock());
+		ThreadArena* arena = freeArenas();
+		if ( arena != NULL ) {
+			freeArenas() = arena->nextFree;
+		}
+		else {
+			arena = (ThreadArena*)calloc(1, sizeof(ThreadArena));
+			if ( arena == NULL ) {
+				pthread_mutex_unlock(&arenasLock());
+				throw "out of memory";
+			}
+			arena->next = allArenas();
+			allArenas() = arena;
+		}
+		pthread_mutex_unlock(&arenasLock());
+		// gives the arena back when this thread exits
+		if ( haveArenaKey() )
+			pthread_setspecific(arenaKey(), arena);
+		sArena = arena;
+	}
+	return sArena;
+}
+
+inline uint8_t* newChunk(ThreadArena* arena, size_t size)
+{
+	uint8_t* chunk = (uint8_t*)malloc(size);
+	if ( chunk == NULL )
+		throw "out of memory";
+	arena->reserved += size;
+	return chunk;
+}
+
+// Returns size bytes aligned to alignment (a power of two, at most 16).
+inline void* allocate(size_t size, size_t alignment=16)
+{
+	ThreadArena* arena = threadArena();
+	arena->allocated += size;
+	if ( size >= kLargeAllocation )
+		return newChunk(arena, size);
+	uint8_t* p = (uint8_t*)(((uintptr_t)arena->current + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	if ( (arena->current == NULL) || (p + size > arena->end) ) {
+		// rest of current chunk is abandoned
+		p = newChunk(arena, kChunkSize);
+		arena->end = p + kChunkSize;
+	}
+	arena->current = p + size;
+	return p;
+}
+
+// Returns uninitialized space for count objects of type T.
+template <typename T>
+inline T* allocateArray(size_t count)
+{
+	return (T*)allocate(count * sizeof(T), (__alignof__(T) < 16) ? __alignof__(T) : 16);
+}
+
+inline const char* copyString(const char* str)
+{
+	size_t size = strlen(str) + 1;
+	char* copy = (char*)allocate(size, 1);
+	memcpy(copy, str, size);
+	return copy;
+}
+
+inline const char* copyString(const char* str, size_t maxLength)
+{
+	size_t length = strnlen(str, maxLength);
+	char* copy = (char*)allocate(length + 1, 1);
+	memcpy(copy, str, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+// Totals over all threads.  Only exact when no parsing is going on.
+inline void statistics(uint64_t& allocated, uint64_t& reserved)
+{
+	allocated = 0;
+	reserved = 0;
+	pthread_mutex_lock(&arenasLock());
+	for (ThreadArena* arena = allArenas(); arena != NULL; arena = arena->next) {
+		allocated += arena->allocated;
+		reserved += arena->reserved;
+	}
+	pthread_mutex_unlock(&arenasLock());
+}
+
+
+} // namespace arena
+} // namespace ld
+
+#endif // __ARENA_HPP__
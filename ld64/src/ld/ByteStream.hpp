@@ -0,0 +1,193 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2009-2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __BYTE_STREAM_HPP__
+#define __BYTE_STREAM_HPP__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <vector>
+
+namespace ld {
+namespace tool {
+
+//
+// Growable buffer used to build LINKEDIT content.
+//
+// The malloc()ed buffer is kept larger than the logical size, so appending a
+// LEB128 value is one capacity check followed by a fixed-count store loop
+// into the slack (at most 10 bytes for a 64-bit value), rather than a
+// push_back() per byte.  Growing uses realloc(), which avoids copying large
+// streams on most systems.  Encoders that can cheaply compute their final size
+// should do so with the *_size() helpers and reserve_for_encoding() once up front.
+//
+class ByteStream {
+private:
+	enum { kMaxLEB128Size = 10 };
+
+	uint8_t*					_data;
+	size_t						_size;
+	size_t						_capacity;
+
+	// makes room for count more bytes and returns where they start
+	uint8_t* ensure(size_t count) {
+		if ( _size + count > _capacity )
+			grow(count);
+		return &_data[_size];
+	}
+
+	void grow(size_t count) {
+		size_t newCapacity = 2 * _capacity;
+		if ( newCapacity < _size + count )
+			newCapacity = _size + count;
+		if ( newCapacity < 256 )
+			newCapacity = 256;
+		setCapacity(newCapacity);
+	}
+
+	void setCapacity(size_t capacity) {
+		uint8_t* data = (uint8_t*)realloc(_data, capacity);
+		if ( data == NULL )
+			throw "out of memory encoding LINKEDIT";
+		_data = data;
+		_capacity = capacity;
+	}
+
+	// not copyable
+								ByteStream(const ByteStream&);
+	ByteStream&					operator=(const ByteStream&);
+
+	// Writes all 10 possible bytes with their continuation bit set, then
+	// clears it on the last real byte.  The caller must have made room for
+	// kMaxLEB128Size bytes; only the returned count become part of the stream.
+	static unsigned int encode_uleb128(uint64_t value, uint8_t* p) {
+		unsigned int size = uleb128_size(value);
+		for (unsigned int i=0; i < kMaxLEB128Size; ++i)
+			p[i] = (uint8_t)((value >> (7*i)) | 0x80);
+		p[size-1] &= 0x7F;
+		return size;
+	}
+
+public:
+								ByteStream() : _data(NULL), _size(0), _capacity(0) { }
+								~ByteStream() { free(_data); }
+
+	unsigned long size() const { return _size; }
+	void reserve(unsigned long l) { if ( l > _capacity ) setCapacity(l); }
+	// For encoders that computed their final size: also makes room for the
+	// scratch bytes appending a LEB128 value near the end of the stream needs.
+	void reserve_for_encoding(unsigned long l) { reserve(l + kMaxLEB128Size); }
+	const uint8_t* start() const { return _data; }
+
+	void append_uleb128(uint64_t value) {
+		uint8_t* p = ensure(kMaxLEB128Size);
+		if ( value < 0x80 ) {
+			*p = (uint8_t)value;
+			_size += 1;
+		}
+		else {
+			_size += encode_uleb128(value, p);
+		}
+	}
+
+	void append_sleb128(int64_t value) {
+		uint8_t* p = ensure(kMaxLEB128Size);
+		unsigned int size = sleb128_size(value);
+		for (unsigned int i=0; i < kMaxLEB128Size; ++i)
+			p[i] = (uint8_t)((value >> (7*i)) | 0x80);
+		p[size-1] &= 0x7F;
+		_size += size;
+	}
+
+	// Appends the uleb128 encoded deltas between successive (sorted) locations,
+	// starting from 'start'.  Makes room for the whole run with one check.
+	void append_delta_encoded_uleb128_run(uint64_t start, const std::vector<uint64_t>& locations) {
+		const uint64_t* const begin = locations.data();
+		const uint64_t* const end = begin + locations.size();
+		uint8_t* const runStart = ensure(locations.size() * kMaxLEB128Size);
+		uint8_t* p = runStart;
+		uint64_t lastAddr = start;
+		for (const uint64_t* it = begin; it != end; ++it) {
+			uint64_t delta = *it - lastAddr;
+			assert(delta != 0);
+			if ( delta < 0x80 )
+				*p++ = (uint8_t)delta;
+			else
+				p += encode_uleb128(delta, p);
+			lastAddr = *it;
+		}
+		_size += (p - runStart);
+	}
+
+	void append_string(const char* str) {
+		append_bytes((const uint8_t*)str, strlen(str) + 1);
+	}
+
+	void append_bytes(const uint8_t* bytes, size_t count) {
+		if ( count == 0 )
+			return;
+		memcpy(ensure(count), bytes, count);
+		_size += count;
+	}
+
+	void append_byte(uint8_t byte) {
+		*ensure(1) = byte;
+		_size += 1;
+	}
+
+	static unsigned int	uleb128_size(uint64_t value) {
+		// 7 bits per byte, at least one byte (for zero)
+		unsigned int bits = 64 - __builtin_clzll(value | 1);
+		return (bits + 6) / 7;
+	}
+
+	static unsigned int	sleb128_size(int64_t value) {
+		// 7 bits per byte, one of which must hold the sign
+		uint64_t magnitude = (uint64_t)(value ^ (value >> 63));
+		unsigned int bits = 64 - __builtin_clzll((magnitude << 1) | 1);
+		return (bits + 6) / 7;
+	}
+
+	static unsigned int	string_size(const char* str) {
+		return (unsigned int)strlen(str) + 1;
+	}
+
+	void pad_to_size(unsigned int alignment) {
+		size_t remainder = _size % alignment;
+		if ( remainder != 0 ) {
+			size_t count = alignment - remainder;
+			memset(ensure(count), 0, count);
+			_size += count;
+		}
+	}
+};
+
+
+} // namespace tool
+} // namespace ld
+
+#endif // __BYTE_STREAM_HPP__
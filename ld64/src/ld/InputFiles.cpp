@@ -66,6 +66,8 @@
 #include "opaque_section_file.h"
 #include "MachOFileAbstraction.hpp"
 #include "Snapshot.h"
+#include "Parallel.hpp"
+#include "StringHash.hpp"
 
 const bool _s_logPThreads = false;
 
@@ -309,6 +311,8 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 	objOpts.usingBitcode		= _options.bundleBitcode();
 	objOpts.maxDefaultCommonAlignment = _options.maxDefaultCommonAlign();
 	objOpts.osxMin              = _options.macosxVersionMin();
+	objOpts.objectCachePath		= _options.objectCachePath();
+	objOpts.parallelParseMinSize = _options.parallelParseMinSize();
 
 	ld::relocatable::File* objResult = mach_o::relocatable::parse(p, len, info.path, info.modTime, info.ordinal, objOpts);
 	if ( objResult != NULL ) {
@@ -371,6 +375,7 @@ ld::File* InputFiles::makeFile(const Options::FileInfo& info, bool indirectDylib
 	archOpts.objcABI2				= _options.objCABIVersion2POverride();
 	archOpts.verboseLoad			= _options.whyLoad();
 	archOpts.logAllFiles			= _options.logAllFiles();
+	archOpts.tocCachePath			= _options.archiveTOCCachePath();
 	// Set ObjSource Kind, libclang_rt is compiler static library
 	const char* libName = strrchr(info.path, '/');
 	if ( (libName != NULL) && (strncmp(libName, "/libclang_rt", 12) == 0) )
@@ -769,6 +774,8 @@ void InputFiles::createIndirectDylibs()
 		}
 	}
 	
+	// re-exports of already indexed dylibs may now be known
+	++_dylibGeneration;
 }
 
 void InputFiles::createOpaqueFileSections()
@@ -922,7 +929,8 @@ InputFiles::InputFiles(Options& opts, const char** archName)
 	_inferredArch(false),
 	_exception(NULL), 
 	_indirectDylibOrdinal(ld::File::Ordinal::indirectDylibBase()),
-	_linkerOptionOrdinal(ld::File::Ordinal::linkeOptionBase())
+	_linkerOptionOrdinal(ld::File::Ordinal::linkeOptionBase()),
+	_dylibGeneration(0), _indexedDylibGeneration(0), _indexedSearchLibraries(0), _indexedIndirectDylibs(0)
 {
 //	fStartCreateReadersTime = mach_absolute_time();
 	if ( opts.architecture() == 0 ) {
@@ -934,6 +942,9 @@ InputFiles::InputFiles(Options& opts, const char** archName)
 	pthread_cond_init(&_parseWorkReady, NULL);
 	pthread_cond_init(&_newFileAvailable, NULL);
 	_neededFileSlot = -1;
+	_startedWorkers = 0;
+	_pipelinedFilesCursor = 0;
+	_pipelinedFilesPending = 0;
 #endif
 	const std::vector<Options::FileInfo>& files = _options.getInputFiles();
 	if ( files.size() == 0 )
@@ -941,20 +952,34 @@ InputFiles::InputFiles(Options& opts, const char** archName)
 
 	_inputFiles.reserve(files.size());
 #if HAVE_PTHREADS
+	// The parse pool has a fixed number of workers, one per allowed thread
+	// besides the main thread, which runs the resolver and parses any file it
+	// needs before a worker got to it.  Files are dealt out round robin in
+	// command line order, so all workers stay close to where the resolver is
+	// consuming.  A worker that runs out of files steals from the front of the
+	// other workers' queues.  With -threads 1 there are no workers and files
+	// are parsed on the main thread as the resolver asks for them.
+	unsigned int workerCount = ld::parallel::workerCount() - 1;
+	if ( workerCount > files.size() )
+		workerCount = (unsigned int)files.size();
+	_parseQueues.resize(workerCount);
 	unsigned int inputFileSlot = 0;
-	_availableInputFiles = 0;
-	_parseCursor = 0;
+	unsigned int readyFileCount = 0;
 #endif
 	Options::FileInfo* entry;
 	for (std::vector<Options::FileInfo>::const_iterator it = files.begin(); it != files.end(); ++it) {
 		entry = (Options::FileInfo*)&(*it);
 #if HAVE_PTHREADS
-		// Assign input file slots to all the FileInfos.
-		// Also chain all FileInfos into one big list to set up for worker threads to do parsing.
+		// Assign input file slots to all the FileInfos and queue the ones
+		// that can be parsed now.  Files from a pipelined file list are
+		// queued when they are announced.
 		entry->inputFileSlot = inputFileSlot;
 		entry->readyToParse = !entry->fromFileList || !_options.pipelineEnabled();
-		if (entry->readyToParse)
-			_availableInputFiles++;
+		entry->parsed = false;
+		if ( !entry->readyToParse )
+			_pipelinedFilesPending++;
+		else if ( workerCount != 0 )
+			_parseQueues[readyFileCount++ % workerCount].slots.push_back(inputFileSlot);
 		_inputFiles.push_back(NULL);
 		inputFileSlot++;
 #else
@@ -964,28 +989,13 @@ InputFiles::InputFiles(Options& opts, const char** archName)
 	}
 	
 #if HAVE_PTHREADS
-	_remainingInputFiles = files.size();
-	
-	// initialize info for parsing input files on worker threads
-	unsigned int ncpus;
-	int mib[2];
-	size_t len = sizeof(ncpus);
-	mib[0] = CTL_HW;
-	mib[1] = HW_NCPU;
-	if (sysctl(mib, 2, &ncpus, &len, NULL, 0) != 0) {
-		ncpus = 1;
-	}
-	_availableWorkers = MIN(ncpus, files.size()); // max # workers we permit
-	_idleWorkers = 0;
-	
 	if (_options.pipelineEnabled()) {
 		// start up a thread to listen for available input files
 		startThread(InputFiles::waitForInputFiles);
 	}
 
-	// Start up one parser thread. More start on demand as parsed input files get consumed.
-	startThread(InputFiles::parseWorkerThread);
-	_availableWorkers--;
+	for (unsigned int i=0; i < workerCount; ++i)
+		startThread(InputFiles::parseWorkerThread);
 #else
 	if (_options.pipelineEnabled()) {
 		throwf("pipelined linking not supported on this platform");
@@ -1006,69 +1016,108 @@ void InputFiles::startThread(void (*threadFunc)(InputFiles *)) const {
 	pthread_attr_destroy(&attr);
 }
 
-// Work loop for input file parsing threads
-void InputFiles::parseWorkerThread() {
-	ld::File *file;
-	const char *exception = NULL;
+// Returns the slot of a queued file nobody has started parsing, or -1.  Claiming
+// a file is a single atomic increment, so neither the workers nor the resolver
+// ever wait on each other just to find work.
+int InputFiles::claimQueuedFile(unsigned int worker)
+{
+	// own queue first, then steal from the other workers, oldest file first
+	const size_t queueCount = _parseQueues.size();
+	for (size_t i=0; i < queueCount; ++i) {
+		ParseQueue& queue = _parseQueues[(worker + i) % queueCount];
+		if ( queue.next < queue.slots.size() ) {
+			size_t index = __sync_fetch_and_add(&queue.next, 1);
+			if ( index < queue.slots.size() )
+				return queue.slots[index];
+		}
+	}
+	return -1;
+}
+
+// Returns the slot of the next file for worker to parse, or -1 when there are
+// no files left.
+int InputFiles::nextFileToParse(unsigned int worker)
+{
+	int queued = claimQueuedFile(worker);
+	if ( queued != -1 )
+		return queued;
+
+	// only files from a pipelined file list can be left
+	int slot = -1;
 	pthread_mutex_lock(&_parseLock);
+	while ( (_pipelinedFilesCursor == _pipelinedFiles.size()) && (_pipelinedFilesPending != 0) && (_exception == NULL) )
+		pthread_cond_wait(&_parseWorkReady, &_parseLock);
+	if ( (_pipelinedFilesCursor < _pipelinedFiles.size()) && (_exception == NULL) )
+		slot = _pipelinedFiles[_pipelinedFilesCursor++];
+	pthread_mutex_unlock(&_parseLock);
+	return slot;
+}
+
+
+// Parses the file in slot and publishes the result to the resolver
+void InputFiles::parseFile(int slot)
+{
 	const std::vector<Options::FileInfo>& files = _options.getInputFiles();
-	if (_s_logPThreads) printf("worker starting\n");
-	do {
-		if (_availableInputFiles == 0) {
-			_idleWorkers++;
-			pthread_cond_wait(&_parseWorkReady, &_parseLock);
-			_idleWorkers--;
-		} else {
-			int slot = _parseCursor;
-			while (slot < (int)files.size() && (_inputFiles[slot] != NULL || !files[slot].readyToParse))
-				slot++;
-			assert(slot < (int)files.size());
-			Options::FileInfo& entry = (Options::FileInfo&)files[slot];
-			_parseCursor = slot+1;
-			_availableInputFiles--;
-			entry.readyToParse = false; // to avoid multiple threads finding this file
-			pthread_mutex_unlock(&_parseLock);
-			if (_s_logPThreads) printf("parsing index %u\n", slot);
-			try {
-				file = makeFile(entry, false);
-			}
-			catch (const char *msg) {
-				if ( (strstr(msg, "architecture") != NULL) && !_options.errorOnOtherArchFiles() ) {
-					if ( _options.ignoreOtherArchInputFiles() ) {
-						// ignore, because this is about an architecture not in use
-					}
-					else {
-						warning("ignoring file %s, %s", entry.path, msg);
-					}
-				} 
-				else if ( strstr(msg, "ignoring unexpected") != NULL ) {
-					warning("%s, %s", entry.path, msg);
-				}
-				else {
-					asprintf((char**)&exception, "%s file '%s'", msg, entry.path);
-				}
-				file = new IgnoredFile(entry.path, entry.modTime, entry.ordinal, ld::File::Other);
+	Options::FileInfo& entry = (Options::FileInfo&)files[slot];
+	ld::File* file;
+	const char* exception = NULL;
+	if (_s_logPThreads) printf("parsing index %u\n", slot);
+	try {
+		file = makeFile(entry, false);
+	}
+	catch (const char *msg) {
+		if ( (strstr(msg, "architecture") != NULL) && !_options.errorOnOtherArchFiles() ) {
+			if ( _options.ignoreOtherArchInputFiles() ) {
+				// ignore, because this is about an architecture not in use
 			}
-			pthread_mutex_lock(&_parseLock);
-			if (_remainingInputFiles > 0)
-				_remainingInputFiles--;
-			if (_s_logPThreads) printf("done with index %u, %d remaining\n", slot, _remainingInputFiles);
-			if (exception) {
-				// We are about to die, so set to zero to stop other threads from doing unneeded work.
-				_remainingInputFiles = 0;
-				_exception = exception;
-			} 
 			else {
-				_inputFiles[slot] = file;
-				if (_neededFileSlot == slot)
-					pthread_cond_signal(&_newFileAvailable);
+				warning("ignoring file %s, %s", entry.path, msg);
 			}
+		} 
+		else if ( strstr(msg, "ignoring unexpected") != NULL ) {
+			warning("%s, %s", entry.path, msg);
 		}
-	} while (_remainingInputFiles);
-	if (_s_logPThreads) printf("worker exiting\n");
-	pthread_cond_broadcast(&_parseWorkReady);
-	pthread_cond_signal(&_newFileAvailable);
-	pthread_mutex_unlock(&_parseLock);
+		else {
+			asprintf((char**)&exception, "%s file '%s'", msg, entry.path);
+		}
+		file = new IgnoredFile(entry.path, entry.modTime, entry.ordinal, ld::File::Other);
+	}
+	if ( exception != NULL ) {
+		// We are about to die, so stop the other threads from doing unneeded work.
+		pthread_mutex_lock(&_parseLock);
+		if ( _exception == NULL )
+			_exception = exception;
+		pthread_cond_broadcast(&_parseWorkReady);
+		pthread_cond_signal(&_newFileAvailable);
+		pthread_mutex_unlock(&_parseLock);
+		return;
+	}
+	if (_s_logPThreads) printf("done with index %u\n", slot);
+	_inputFiles[slot] = file;
+	__sync_synchronize();
+	entry.parsed = true;
+	// Only take the lock if the resolver is blocked on this very file.  It sets
+	// _neededFileSlot before checking parsed, so one of us sees the other's store.
+	__sync_synchronize();
+	if ( _neededFileSlot == slot ) {
+		pthread_mutex_lock(&_parseLock);
+		pthread_cond_signal(&_newFileAvailable);
+		pthread_mutex_unlock(&_parseLock);
+	}
+}
+
+
+// Work loop for input file parsing threads
+void InputFiles::parseWorkerThread() {
+	const unsigned int worker = __sync_fetch_and_add(&_startedWorkers, 1);
+	if (_s_logPThreads) printf("worker %u starting\n", worker);
+	while ( _exception == NULL ) {
+		int slot = nextFileToParse(worker);
+		if ( slot == -1 )
+			break;
+		parseFile(slot);
+	}
+	if (_s_logPThreads) printf("worker %u exiting\n", worker);
 }
 
 
@@ -1107,6 +1156,7 @@ ld::File* InputFiles::addDylib(ld::dylib::File* reader, const Options::FileInfo&
 		InstallNameToDylib::iterator pos = _installPathToDylibs.find(installPath);
 		if ( pos == _installPathToDylibs.end() ) {
 			_installPathToDylibs[strdup(installPath)] = reader;
+			_indirectDylibs.push_back(reader);
 		}
 		else {
 			bool dylibOnCommandLineTwice = ( strcmp(pos->second->path(), reader->path()) == 0 );
@@ -1178,19 +1228,23 @@ void InputFiles::waitForInputFiles()
 			if (!inputInfo->checkFileExists(_options))
 				throwf("pipelined linking error - file does not exist: %s\n", inputInfo->path);
 			pthread_mutex_lock(&_parseLock);
-			if (_idleWorkers)
-				pthread_cond_signal(&_parseWorkReady);
 			inputInfo->readyToParse = true;
-			if (_parseCursor > inputInfo->inputFileSlot)
-				_parseCursor = inputInfo->inputFileSlot;
-			_availableInputFiles++;
-			if (_s_logPThreads) printf("pipeline listener: %s slot=%d, _parseCursor=%d, _availableInputFiles = %d remaining = %ld\n", path_buf, inputInfo->inputFileSlot, _parseCursor, _availableInputFiles, fileMap.size()-1);
+			_pipelinedFiles.push_back(inputInfo->inputFileSlot);
+			if ( --_pipelinedFilesPending == 0 )
+				pthread_cond_broadcast(&_parseWorkReady);	// let idle workers exit
+			else
+				pthread_cond_signal(&_parseWorkReady);
+			if (_neededFileSlot == inputInfo->inputFileSlot)
+				pthread_cond_signal(&_newFileAvailable);
+			if (_s_logPThreads) printf("pipeline listener: %s slot=%d, remaining = %ld\n", path_buf, inputInfo->inputFileSlot, fileMap.size()-1);
 			pthread_mutex_unlock(&_parseLock);
 			fileMap.erase(it);
 		}
 	} catch (const char *msg) {
 		pthread_mutex_lock(&_parseLock);
-		_exception = msg;
+		if ( _exception == NULL )
+			_exception = msg;
+		pthread_cond_broadcast(&_parseWorkReady);
 		pthread_cond_signal(&_newFileAvailable);
 		pthread_mutex_unlock(&_parseLock);
 	}
@@ -1211,20 +1265,35 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 	for (fileIndex=0; fileIndex<_inputFiles.size(); fileIndex++) {
 		ld::File *file;
 #if HAVE_PTHREADS
-		pthread_mutex_lock(&_parseLock);
-		
-		// this loop waits for the needed file to be ready (parsed by worker thread)
-		while (_inputFiles[fileIndex] == NULL && _exception == NULL) {
-			// We are starved for input. If there are still files to parse and we have
-			// not maxed out the worker thread count start a new worker thread.
-			if (_availableInputFiles > 0 && _availableWorkers > 0) {
-				if (_s_logPThreads) printf("starting worker\n");
-				startThread(InputFiles::parseWorkerThread);
-				_availableWorkers--;
+		if ( !files[fileIndex].parsed && _parseQueues.empty() && files[fileIndex].readyToParse ) {
+			// no parse workers (-threads 1), so parse on demand
+			parseFile((int)fileIndex);
+		}
+		while ( !files[fileIndex].parsed && (_exception == NULL) ) {
+			// the main thread is one of the -threads, so parse queued files instead of just waiting
+			int slot = claimQueuedFile(0);
+			if ( slot == -1 )
+				break;
+			parseFile(slot);
+		}
+		if ( !files[fileIndex].parsed ) {
+			// wait for just this file, the workers only take the lock to wake us
+			pthread_mutex_lock(&_parseLock);
+			_neededFileSlot = (int)fileIndex;
+			__sync_synchronize();
+			while ( !files[fileIndex].parsed && (_exception == NULL) ) {
+				if ( _parseQueues.empty() && files[fileIndex].readyToParse ) {
+					// pipelined file arrived and there is nobody else to parse it
+					pthread_mutex_unlock(&_parseLock);
+					parseFile((int)fileIndex);
+					pthread_mutex_lock(&_parseLock);
+					continue;
+				}
+				if (_s_logPThreads) printf("consumer blocking for %lu: %s\n", fileIndex, files[fileIndex].path);
+				pthread_cond_wait(&_newFileAvailable, &_parseLock);
 			}
-			_neededFileSlot = fileIndex;
-			if (_s_logPThreads) printf("consumer blocking for %lu: %s\n", fileIndex, files[fileIndex].path);
-			pthread_cond_wait(&_newFileAvailable, &_parseLock);
+			_neededFileSlot = -1;
+			pthread_mutex_unlock(&_parseLock);
 		}
 
 		if (_exception)
@@ -1232,8 +1301,8 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 
 		// The input file is parsed. Assimilate it and call its atom iterator.
 		if (_s_logPThreads) printf("consuming slot %lu\n", fileIndex);
+		__sync_synchronize();
 		file = _inputFiles[fileIndex];
-		pthread_mutex_unlock(&_parseLock);
 #else
 		file = _inputFiles[fileIndex];
 #endif
@@ -1330,11 +1399,240 @@ void InputFiles::forEachInitialAtom(ld::File::AtomHandler& handler, ld::Internal
 }
 
 
+void InputFiles::LibraryNameIndex::doName(const char* name)
+{
+	Entry entry = { _currentLibrary, kNone };
+	Chain chain = { (uint32_t)_entries.size(), (uint32_t)_entries.size() };
+	std::pair<NameToChain::iterator, bool> pos = _names.insert(std::make_pair(name, chain));
+	if ( pos.second ) {
+		_entries.push_back(entry);
+		return;
+	}
+	Chain& existing = pos.first->second;
+	if ( _entries[existing.tail].library < _currentLibrary ) {
+		// libraries are normally indexed in search order, so appending keeps the chain sorted
+		_entries[existing.tail].next = (uint32_t)_entries.size();
+		existing.tail = (uint32_t)_entries.size();
+		_entries.push_back(entry);
+		return;
+	}
+
+	// a library can report the same name more than once (e.g. through two re-exports),
+	// and a dylib is indexed again when it starts re-exporting other dylibs
+	uint32_t* link = &existing.head;
+	while ( _entries[*link].library < _currentLibrary )
+		link = &_entries[*link].next;
+	if ( _entries[*link].library == _currentLibrary )
+		return;
+	entry.next = *link;
+	*link = (uint32_t)_entries.size();
+	_entries.push_back(entry);
+}
+
+InputFiles::LibraryNameIndex::Iterator InputFiles::LibraryNameIndex::find(const char* name) const
+{
+	// the hash is only needed for the filters, don't compute it if there are none
+	uint64_t hash = _alwaysSearched.empty() ? 0 : ld::strings::hash(name);
+	NameToChain::const_iterator pos = _names.find(name);
+	if ( pos == _names.end() )
+		return Iterator(*this, kNone, hash);
+	return Iterator(*this, pos->second.head, hash);
+}
+
+InputFiles::LibraryNameIndex::Iterator::Iterator(const LibraryNameIndex& index, uint32_t entry, uint64_t hash)
+	: _index(index), _entry(entry), _always(0), _hash(hash)
+{
+	skipFilteredOut();
+}
+
+void InputFiles::LibraryNameIndex::Iterator::skipFilteredOut()
+{
+	while ( (_always < _index._alwaysSearched.size()) && !_index._alwaysSearched[_always].filter.mayContain(_hash) )
+		++_always;
+}
+
+uint32_t InputFiles::LibraryNameIndex::Iterator::library() const
+{
+	uint32_t library = kNone;
+	if ( _entry != kNone )
+		library = _index._entries[_entry].library;
+	if ( (_always < _index._alwaysSearched.size()) && (_index._alwaysSearched[_always].library < library) )
+		library = _index._alwaysSearched[_always].library;
+	return library;
+}
+
+void InputFiles::LibraryNameIndex::Iterator::next()
+{
+	// a library can be both indexed for the name and always asked, only visit it once
+	uint32_t current = library();
+	if ( (_entry != kNone) && (_index._entries[_entry].library == current) )
+		_entry = _index._entries[_entry].next;
+	if ( (_always < _index._alwaysSearched.size()) && (_index._alwaysSearched[_always].library == current) ) {
+		++_always;
+		skipFilteredOut();
+	}
+}
+
+// about 1% false positives or fewer, for 12 to 24 bits per name
+enum { kExportFilterBitsPerName = 12, kExportFilterProbes = 3 };
+
+void InputFiles::LibraryNameIndex::ExportFilter::doName(const char* name)
+{
+	_hashes.push_back(ld::strings::hash(name));
+}
+
+void InputFiles::LibraryNameIndex::ExportFilter::build(const ld::dylib::File* dylib)
+{
+	// the names are only hashed, so this does not copy the names of lazily looked up exports
+	_hashes.clear();
+	dylib->forEachExportedName(*this);
+	uint64_t bitCount = 64;
+	while ( bitCount < _hashes.size() * kExportFilterBitsPerName )
+		bitCount *= 2;
+	_mask = bitCount - 1;
+	_bits.assign(bitCount/64, 0);
+	for (std::vector<uint64_t>::const_iterator it=_hashes.begin(); it != _hashes.end(); ++it) {
+		const uint64_t step = (*it >> 32) | 1;
+		for (int i=0; i < kExportFilterProbes; ++i) {
+			const uint64_t bit = (*it + i*step) & _mask;
+			_bits[bit/64] |= (1ULL << (bit%64));
+		}
+	}
+	std::vector<uint64_t>().swap(_hashes);
+}
+
+bool InputFiles::LibraryNameIndex::ExportFilter::mayContain(uint64_t hash) const
+{
+	// not built yet, so it can't rule anything out
+	if ( _bits.empty() )
+		return true;
+	const uint64_t step = (hash >> 32) | 1;
+	for (int i=0; i < kExportFilterProbes; ++i) {
+		const uint64_t bit = (hash + i*step) & _mask;
+		if ( (_bits[bit/64] & (1ULL << (bit%64))) == 0 )
+			return false;
+	}
+	return true;
+}
+
+void InputFiles::LibraryNameIndex::addArchive(uint32_t library, const ld::archive::File* archive)
+{
+	_currentLibrary = library;
+	archive->forEachTableOfContentsName(*this);
+}
+
+void InputFiles::LibraryNameIndex::addDylib(uint32_t library, const ld::dylib::File* dylib)
+{
+	// the names a dylib may provide only change when dylibs it re-exports are found,
+	// and the index is a superset filter, so names never have to be removed
+	uint32_t reExports = dylib->reExportedDylibCount();
+	if ( library >= _dylibReExportCounts.size() )
+		_dylibReExportCounts.resize(library+1, kNone);
+	else if ( _dylibReExportCounts[library] == reExports )
+		return;
+	_dylibReExportCounts[library] = reExports;
+	_currentLibrary = library;
+	dylib->forEachLoadedExportName(*this);
+
+	// don't put all the names of dylibs that look their exports up lazily in the index,
+	// just ask them about the names that pass their filter, which buildFilters() (re)builds
+	if ( dylib->hasUnloadedExports() ) {
+		std::vector<AlwaysSearched>::iterator pos = _alwaysSearched.begin();
+		while ( (pos != _alwaysSearched.end()) && (pos->library < library) )
+			++pos;
+		if ( (pos == _alwaysSearched.end()) || (pos->library != library) ) {
+			AlwaysSearched always;
+			always.library = library;
+			always.dylib = dylib;
+			pos = _alwaysSearched.insert(pos, always);
+		}
+		pos->filterBuilt = false;
+		_filtersOutOfDate = true;
+	}
+}
+
+void InputFiles::LibraryNameIndex::buildFilters()
+{
+	if ( !_filtersOutOfDate )
+		return;
+	_filtersOutOfDate = false;
+	std::vector<AlwaysSearched*> unbuilt;
+	for (std::vector<AlwaysSearched>::iterator it=_alwaysSearched.begin(); it != _alwaysSearched.end(); ++it) {
+		if ( !it->filterBuilt )
+			unbuilt.push_back(&*it);
+	}
+	// each one walks a whole export trie, so build them on all cpus
+	ld::parallel::forEach(unbuilt.size(), [&](size_t i) {
+		unbuilt[i]->filter.build(unbuilt[i]->dylib);
+		unbuilt[i]->filterBuilt = true;
+	});
+}
+
+void InputFiles::updateLibraryIndexes() const
+{
+	// dylibs re-exported by already indexed dylibs are only known after createIndirectDylibs(),
+	// addDylib() only walks the names again for dylibs that found new re-exports
+	if ( _indexedDylibGeneration != _dylibGeneration ) {
+		for (size_t i=0; i < _indexedSearchLibraries; ++i) {
+			const LibraryInfo& lib = _searchLibraries[i];
+			if ( lib.isDylib() )
+				_searchLibraryIndex.addDylib((uint32_t)i, lib.dylib());
+		}
+		for (size_t i=0; i < _indexedIndirectDylibs; ++i)
+			_indirectDylibIndex.addDylib((uint32_t)i, _indirectDylibs[i]);
+		_indexedDylibGeneration = _dylibGeneration;
+	}
+
+	// libraries are only ever appended to the search list, so just index the new ones
+	for ( ; _indexedSearchLibraries < _searchLibraries.size(); ++_indexedSearchLibraries) {
+		const LibraryInfo& lib = _searchLibraries[_indexedSearchLibraries];
+		if ( lib.isDylib() )
+			_searchLibraryIndex.addDylib((uint32_t)_indexedSearchLibraries, lib.dylib());
+		else
+			_searchLibraryIndex.addArchive((uint32_t)_indexedSearchLibraries, lib.archive());
+	}
+
+	// likewise for dylibs added to _installPathToDylibs
+	for ( ; _indexedIndirectDylibs < _indirectDylibs.size(); ++_indexedIndirectDylibs)
+		_indirectDylibIndex.addDylib((uint32_t)_indexedIndirectDylibs, _indirectDylibs[_indexedIndirectDylibs]);
+
+	_searchLibraryIndex.buildFilters();
+	_indirectDylibIndex.buildFilters();
+}
+
+void InputFiles::parseAheadArchiveMembers(const std::vector<const char*>& names) const
+{
+	if ( ld::parallel::workerCount() <= 1 )
+		return;
+	updateLibraryIndexes();
+
+	// Only the first library that may define a name is considered, which is
+	// where searchLibraries() will find it unless an earlier load defines it.
+	std::map<uint32_t, std::vector<const char*> > namesByArchive;
+	for (std::vector<const char*>::const_iterator it = names.begin(); it != names.end(); ++it) {
+		// skip the dylibs that are asked about every name, parsing ahead is only a hint
+		LibraryNameIndex::Iterator candidate = _searchLibraryIndex.find(*it);
+		while ( !candidate.done() && !candidate.indexed() )
+			candidate.next();
+		if ( candidate.done() )
+			continue;
+		uint32_t library = candidate.library();
+		if ( !_searchLibraries[library].isDylib() )
+			namesByArchive[library].push_back(*it);
+	}
+	for (std::map<uint32_t, std::vector<const char*> >::const_iterator it = namesByArchive.begin(); it != namesByArchive.end(); ++it)
+		_searchLibraries[it->first].archive()->parseAhead(it->second);
+}
+
 bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searchArchives, bool dataSymbolOnly, ld::File::AtomHandler& handler) const
 {
+	// Only the libraries that may define name are checked, in the same order as
+	// walking every library would, so first definition found still wins.
+	updateLibraryIndexes();
+
 	// Check each input library.
-    for (std::vector<LibraryInfo>::const_iterator it=_searchLibraries.begin(); it != _searchLibraries.end(); ++it) {
-        LibraryInfo lib = *it;
+	for (LibraryNameIndex::Iterator candidate=_searchLibraryIndex.find(name); !candidate.done(); candidate.next()) {
+        LibraryInfo lib = _searchLibraries[candidate.library()];
         if (lib.isDylib()) {
             if (searchDylibs) {
                 ld::dylib::File *dylibFile = lib.dylib();
@@ -1377,8 +1675,8 @@ bool InputFiles::searchLibraries(const char* name, bool searchDylibs, bool searc
 
 	// search indirect dylibs
 	if ( searchDylibs ) {
-		for (InstallNameToDylib::const_iterator it=_installPathToDylibs.begin(); it != _installPathToDylibs.end(); ++it) {
-			ld::dylib::File* dylibFile = it->second;
+		for (LibraryNameIndex::Iterator candidate=_indirectDylibIndex.find(name); !candidate.done(); candidate.next()) {
+			ld::dylib::File* dylibFile = _indirectDylibs[candidate.library()];
 			bool searchThisDylib = false;
 			if ( _options.nameSpace() == Options::kTwoLevelNameSpace ) {
 				// for two level namesapce, just check all implicitly linked dylibs
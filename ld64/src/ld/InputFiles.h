@@ -67,6 +67,10 @@ public:
 	// searches libraries for name
 	bool						searchLibraries(const char* name, bool searchDylibs, bool searchArchives,  
 																  bool dataSymbolOnly, ld::File::AtomHandler&) const;
+	// parses, in parallel, archive members that searchLibraries() is likely to load for names
+	void						parseAheadArchiveMembers(const std::vector<const char*>& names) const;
+	// changes whenever searchLibraries() may find names it could not find before
+	uint64_t					searchLibrariesGeneration() const { return _searchLibraries.size() + _installPathToDylibs.size() + _dylibGeneration; }
 	// see if any linked dylibs export a weak def of symbol
 	bool						searchWeakDefInDylib(const char* name) const;
 	// copy dylibs to link with in command line order
@@ -108,6 +112,9 @@ private:
 	// for threaded input file processing
 	void						parseWorkerThread();
 	static void					parseWorkerThread(InputFiles *inputFiles);
+	int							nextFileToParse(unsigned int worker);
+	int							claimQueuedFile(unsigned int worker);
+	void						parseFile(int slot);
 	void						startThread(void (*threadFunc)(InputFiles *)) const;
 
 	typedef std::unordered_map<const char*, ld::dylib::File*, CStringHash, CStringEquals>	InstallNameToDylib;
@@ -126,17 +133,24 @@ private:
 
 	// for threaded input file processing
 #if HAVE_PTHREADS
-	pthread_mutex_t				_parseLock;
-	pthread_cond_t				_parseWorkReady;		// used by parse threads to block for work
+	// Input file slots dealt to one parse worker, in command line order.  Any
+	// worker claims the next entry by atomically incrementing next.
+	struct ParseQueue {
+								ParseQueue() : next(0) { }
+		std::vector<int>		slots;
+		volatile size_t			next;
+	};
+	std::vector<ParseQueue>		_parseQueues;			// one per parse worker thread
+	volatile unsigned int		_startedWorkers;		// hands out worker (and own queue) numbers
+	pthread_mutex_t				_parseLock;				// only taken to block, never to find or publish work
+	pthread_cond_t				_parseWorkReady;		// used by parse threads to block for pipelined input files
 	pthread_cond_t				_newFileAvailable;		// used by main thread to block for parsed input files
-	int							_availableWorkers;		// number of remaining unstarted parse threads
-	int							_idleWorkers;			// number of running parse threads that are idle
-	int							_neededFileSlot;		// input file the resolver is currently blocked waiting for
-	int							_parseCursor;			// slot to begin searching for a file to parse
-	int							_availableInputFiles;	// number of input fileinfos with readyToParse==true
+	volatile int				_neededFileSlot;		// input file the resolver is currently blocked waiting for
+	std::vector<int>			_pipelinedFiles;		// slots of file list entries announced by the pipeline
+	size_t						_pipelinedFilesCursor;	// next entry of _pipelinedFiles to parse
+	size_t						_pipelinedFilesPending;	// file list entries not yet announced
 #endif
-	const char *				_exception;				// passes an exception message from parse thread to main thread
-	int							_remainingInputFiles;	// number of input files still to parse
+	const char * volatile		_exception;				// passes an exception message from parse thread to main thread
 	
 	ld::File::Ordinal			_indirectDylibOrdinal;
 	ld::File::Ordinal			_linkerOptionOrdinal;
@@ -153,6 +167,87 @@ private:
         ld::archive::File *archive() const { return (ld::archive::File*)_lib; }
     };
     std::vector<LibraryInfo>  _searchLibraries;
+
+	// Maps a symbol name to the libraries that may define it, in search order, so
+	// searchLibraries() only has to ask those libraries.  Libraries are identified
+	// by their index in the list the index was built from.  Dylibs that look their
+	// exports up lazily are only indexed by the names they have loaded so far, and
+	// are asked about every name that passes a bloom filter of all their exports.
+	class LibraryNameIndex : public ld::File::NameHandler
+	{
+	public:
+		static const uint32_t	kNone = 0xFFFFFFFF;
+
+		// walks the libraries a name is indexed for merged with the ones always asked
+		// whose filter passes the name, in search order
+		class Iterator
+		{
+		public:
+			bool				done() const		{ return (_entry == kNone) && (_always == _index._alwaysSearched.size()); }
+			uint32_t			library() const;
+			bool				indexed() const		{ return (_entry != kNone) && (_index._entries[_entry].library == library()); }
+			void				next();
+		private:
+			friend class LibraryNameIndex;
+								Iterator(const LibraryNameIndex& index, uint32_t entry, uint64_t hash);
+			void				skipFilteredOut();
+			const LibraryNameIndex&	_index;
+			uint32_t				_entry;
+			size_t					_always;
+			uint64_t				_hash;
+		};
+
+								LibraryNameIndex() : _currentLibrary(0), _filtersOutOfDate(false) {}
+		void					addArchive(uint32_t library, const ld::archive::File* archive);
+		void					addDylib(uint32_t library, const ld::dylib::File* dylib);
+		void					buildFilters();
+		virtual void			doName(const char* name);
+		Iterator				find(const char* name) const;
+
+	private:
+		struct Entry { uint32_t library; uint32_t next; };
+		struct Chain { uint32_t head; uint32_t tail; };
+		typedef std::unordered_map<const char*, Chain, CStringHash, CStringEquals> NameToChain;
+
+		// Bloom filter of the names a dylib may provide, a few bits per name.  A name
+		// that fails it is certainly not exported, one that passes probably is.
+		class ExportFilter : public ld::File::NameHandler
+		{
+		public:
+								ExportFilter() : _mask(0) {}
+			void				build(const ld::dylib::File* dylib);
+			bool				mayContain(uint64_t hash) const;
+			virtual void		doName(const char* name);
+			virtual bool		keepsNames() const		{ return false; }
+		private:
+			std::vector<uint64_t>	_hashes;			// only while building
+			std::vector<uint64_t>	_bits;
+			uint64_t				_mask;
+		};
+		struct AlwaysSearched {
+			uint32_t				library;
+			const ld::dylib::File*	dylib;
+			bool					filterBuilt;
+			ExportFilter			filter;
+		};
+
+		NameToChain					_names;
+		std::vector<Entry>			_entries;
+		std::vector<AlwaysSearched>	_alwaysSearched;		// sorted by library
+		std::vector<uint32_t>		_dylibReExportCounts;	// by library, kNone if not an indexed dylib
+		uint32_t					_currentLibrary;
+		bool						_filtersOutOfDate;
+	};
+
+	void						updateLibraryIndexes() const;
+
+	uint32_t							_dylibGeneration;			// bumped when dylib re-exports may have changed
+	mutable uint32_t					_indexedDylibGeneration;
+	mutable LibraryNameIndex			_searchLibraryIndex;		// indexes into _searchLibraries
+	mutable size_t						_indexedSearchLibraries;
+	mutable LibraryNameIndex			_indirectDylibIndex;		// indexes into _indirectDylibs
+	mutable size_t						_indexedIndirectDylibs;
+	std::vector<ld::dylib::File*>		_indirectDylibs;			// _installPathToDylibs values in the order they were added
 };
 
 } // namespace tool 
@@ -39,86 +39,11 @@
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
 #include "code-sign-blobs/superblob.h"
+#include "ByteStream.hpp"
 
 namespace ld {
 namespace tool {
 
-class ByteStream {
-private:
-	std::vector<uint8_t>		_data;
-public:
-	std::vector<uint8_t>& bytes() { return _data; }
-	unsigned long size() const { return _data.size(); }
-	void reserve(unsigned long l) { _data.reserve(l); }
-	const uint8_t* start() const { return &_data[0]; }
-
-	void append_uleb128(uint64_t value) {
-		uint8_t byte;
-		do {
-			byte = value & 0x7F;
-			value &= ~0x7F;
-			if ( value != 0 )
-				byte |= 0x80;
-			_data.push_back(byte);
-			value = value >> 7;
-		} while( byte >= 0x80 );
-	}
-	
-	void append_sleb128(int64_t value) {
-		bool isNeg = ( value < 0 );
-		uint8_t byte;
-		bool more;
-		do {
-			byte = value & 0x7F;
-			value = value >> 7;
-			if ( isNeg ) 
-				more = ( (value != -1) || ((byte & 0x40) == 0) );
-			else
-				more = ( (value != 0) || ((byte & 0x40) != 0) );
-			if ( more )
-				byte |= 0x80;
-			_data.push_back(byte);
-		} 
-		while( more );
-	}
-	
-	void append_delta_encoded_uleb128_run(uint64_t start, const std::vector<uint64_t>& locations) {
-		uint64_t lastAddr = start;
-		for(std::vector<uint64_t>::const_iterator it = locations.begin(); it != locations.end(); ++it) {
-			uint64_t nextAddr = *it;
-			uint64_t delta = nextAddr - lastAddr;
-			assert(delta != 0);
-			append_uleb128(delta);
-			lastAddr = nextAddr;
-		}
-	}
-
-	void append_string(const char* str) {
-		for (const char* s = str; *s != '\0'; ++s)
-			_data.push_back(*s);
-		_data.push_back('\0');
-	}
-	
-	void append_byte(uint8_t byte) {
-		_data.push_back(byte);
-	}
-	
-	static unsigned int	uleb128_size(uint64_t value) {
-		uint32_t result = 0;
-		do {
-			value = value >> 7;
-			++result;
-		} while ( value != 0 );
-		return result;
-	}
-	
-	void pad_to_size(unsigned int alignment) {
-		while ( (_data.size() % alignment) != 0 )
-			_data.push_back(0);
-	}
-};
-
-
 class LinkEditAtom : public ld::Atom
 {
 public:
@@ -161,6 +86,70 @@ void LinkEditAtom::copyRawContent(uint8_t buffer[]) const
 }
 
 
+//
+// Size pre-passes over the intermediate opcode lists, so the rebase and
+// binding encoders can size their ByteStream once instead of growing it.
+// The result is exact except that a trailing DONE opcode is always counted.
+//
+template <typename T>
+unsigned long rebaseOpcodesSize(const std::vector<T>& ops)
+{
+	unsigned long size = 0;
+	for (typename std::vector<T>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+		++size;
+		switch ( it->opcode ) {
+			case REBASE_OPCODE_DONE:
+				return size;
+			case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+				size += ByteStream::uleb128_size(it->operand2);
+				break;
+			case REBASE_OPCODE_ADD_ADDR_ULEB:
+			case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
+			case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
+				size += ByteStream::uleb128_size(it->operand1);
+				break;
+			case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
+				size += ByteStream::uleb128_size(it->operand1);
+				size += ByteStream::uleb128_size(it->operand2);
+				break;
+		}
+	}
+	return size;
+}
+
+template <typename T>
+unsigned long bindOpcodesSize(const std::vector<T>& ops)
+{
+	unsigned long size = 0;
+	for (typename std::vector<T>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+		++size;
+		switch ( it->opcode ) {
+			case BIND_OPCODE_DONE:
+				return size;
+			case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+				size += ByteStream::string_size(it->name);
+				break;
+			case BIND_OPCODE_SET_ADDEND_SLEB:
+				size += ByteStream::sleb128_size(it->operand1);
+				break;
+			case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+				size += ByteStream::uleb128_size(it->operand2);
+				break;
+			case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+			case BIND_OPCODE_ADD_ADDR_ULEB:
+			case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+				size += ByteStream::uleb128_size(it->operand1);
+				break;
+			case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+				size += ByteStream::uleb128_size(it->operand1);
+				size += ByteStream::uleb128_size(it->operand2);
+				break;
+		}
+	}
+	return size;
+}
+
+
 
 
 template <typename A>
@@ -315,7 +304,7 @@ void RebaseInfoAtom<A>::encode() const
 
 	// convert to compressed encoding
 	const static bool log = false;
-	this->_encodedData.reserve(info.size()*2);
+	this->_encodedData.reserve_for_encoding(rebaseOpcodesSize(mid) + sizeof(pint_t));
 	bool done = false;
 	for (typename std::vector<rebase_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
 		switch ( it->opcode ) {
@@ -525,7 +514,7 @@ void BindingInfoAtom<A>::encode() const
 
 	// convert to compressed encoding
 	const static bool log = false;
-	this->_encodedData.reserve(info.size()*2);
+	this->_encodedData.reserve_for_encoding(bindOpcodesSize(mid) + sizeof(pint_t));
 	bool done = false;
 	for (typename std::vector<binding_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
 		switch ( it->opcode ) {
@@ -762,7 +751,7 @@ void WeakBindingInfoAtom<A>::encode() const
 
 	// convert to compressed encoding
 	const static bool log = false;
-	this->_encodedData.reserve(info.size()*2);
+	this->_encodedData.reserve_for_encoding(bindOpcodesSize(mid) + sizeof(pint_t));
 	bool done = false;
 	for (typename std::vector<binding_tmp>::iterator it = mid.begin(); !done && it != mid.end() ; ++it) {
 		switch ( it->opcode ) {
@@ -1063,7 +1052,9 @@ void ExportInfoAtom<A>::encode() const
 	std::sort(entries.begin(), entries.end(), TrieEntriesSorter(_options));
 	
 	// create trie
-	mach_o::trie::makeTrie(entries, this->_encodedData.bytes());
+	std::vector<uint8_t> trie;
+	mach_o::trie::makeTrie(entries, trie);
+	this->_encodedData.append_bytes(trie.data(), trie.size());
 
 	//Add additional data padding for the unoptimized shared cache
 	for (unsigned int i = 0; i < padding; ++i)
@@ -1248,26 +1239,14 @@ template <typename A>
 void SplitSegInfoV1Atom<A>::uleb128EncodeAddresses(const std::vector<uint64_t>& locations) const
 {
 	pint_t addr = this->_options.baseAddress();
+	// locations are sorted, so a repeated address shows up as a zero delta
 	for(typename std::vector<uint64_t>::const_iterator it = locations.begin(); it != locations.end(); ++it) {
 		pint_t nextAddr = *it;
-		//fprintf(stderr, "nextAddr=0x%0llX\n", (uint64_t)nextAddr);
-		uint64_t delta = nextAddr - addr;
-		//fprintf(stderr, "delta=0x%0llX\n", delta);
-		if ( delta == 0 ) 
+		if ( nextAddr == addr )
 			throw "double split seg info for same address";
-		// uleb128 encode
-		uint8_t byte;
-		do {
-			byte = delta & 0x7F;
-			delta &= ~0x7F;
-			if ( delta != 0 )
-				byte |= 0x80;
-			this->_encodedData.append_byte(byte);
-			delta = delta >> 7;
-		} 
-		while( byte >= 0x80 );
 		addr = nextAddr;
 	}
+	this->_encodedData.append_delta_encoded_uleb128_run(this->_options.baseAddress(), locations);
 }
 
 
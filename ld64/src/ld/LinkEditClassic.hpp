@@ -32,12 +32,16 @@
 #include <unistd.h>
 
 #include <vector>
+#include <deque>
+#include <string>
 #include <unordered_map>
+#include <algorithm>
 
 #include "Options.h"
 #include "ld.hpp"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
+#include "Parallel.hpp"
 
 namespace ld {
 namespace tool {
@@ -90,15 +94,34 @@ public:
 	const char*									stringForIndex(int32_t) const;
 	uint32_t									currentOffset();
 
+	// Strings added with addTailMerged() only get their offset when
+	// layoutTailMerged() places them all at once, sharing storage with any
+	// string they are a suffix of.  Until then the returned ticket stands in
+	// for the offset.  name must stay valid until layoutTailMerged().
+	uint32_t									addTailMerged(const char* name);
+	void										layoutTailMerged();
+	int32_t										offsetForTicket(uint32_t ticket) const { return _tailMergedOffsets[ticket]; }
+
 private:
 	enum { kBufferSize = 0x01000000 };
 	typedef std::unordered_map<const char*, int32_t, CStringHash, CStringEquals> StringToOffset;
 
+	struct TailMergedString {
+		const char*		str;
+		uint32_t		length;
+		uint32_t		host;		// ticket of string whose storage this one uses, or self
+	};
+
+	static uint32_t		tailBucket(const TailMergedString& s);
+	static bool			reversedGreater(const TailMergedString* left, const TailMergedString* right);
+
 	const uint32_t							_pointerSize;
 	std::vector<char*>						_fullBuffers;
 	char*									_currentBuffer;
 	uint32_t								_currentBufferUsed;
 	StringToOffset							_uniqueStrings;
+	std::vector<TailMergedString>			_tailMerged;
+	std::vector<int32_t>					_tailMergedOffsets;
 
 	static ld::Section			_s_section;
 };
@@ -178,6 +201,101 @@ int32_t StringPoolAtom::addUnique(const char* str)
 }
 
 
+uint32_t StringPoolAtom::addTailMerged(const char* str)
+{
+	TailMergedString entry;
+	entry.str = str;
+	entry.length = (uint32_t)strlen(str);
+	entry.host = (uint32_t)_tailMerged.size();
+	_tailMerged.push_back(entry);
+	return entry.host;
+}
+
+// A string can only be the tail of a string ending in the same two characters,
+// so each bucket is merged on its own.  One character strings get buckets of
+// their own and are never merged, which costs next to nothing.
+uint32_t StringPoolAtom::tailBucket(const TailMergedString& s)
+{
+	const uint8_t* end = (uint8_t*)&s.str[s.length];
+	if ( s.length >= 2 )
+		return (end[-2] << 8) | end[-1];
+	return end[-1];
+}
+
+// Orders by the reversed strings, largest first, so each string directly
+// follows the strings it is a tail of.
+bool StringPoolAtom::reversedGreater(const TailMergedString* left, const TailMergedString* right)
+{
+	const uint8_t* l = (uint8_t*)&left->str[left->length];
+	const uint8_t* r = (uint8_t*)&right->str[right->length];
+	const uint8_t* const lStop = l - std::min(left->length, right->length);
+	while ( l != lStop ) {
+		--l;
+		--r;
+		if ( *l != *r )
+			return (*l > *r);
+	}
+	return (left->length > right->length);
+}
+
+void StringPoolAtom::layoutTailMerged()
+{
+	// distribute strings into buckets by their last two characters
+	std::vector<uint32_t> bucketStarts(0x10001, 0);
+	for (const TailMergedString& s : _tailMerged) {
+		if ( s.length != 0 )
+			++bucketStarts[tailBucket(s) + 1];
+	}
+	std::vector<uint32_t> nonEmptyBuckets;
+	for (uint32_t i=0; i < 0x10000; ++i) {
+		if ( bucketStarts[i+1] != 0 )
+			nonEmptyBuckets.push_back(i);
+		bucketStarts[i+1] += bucketStarts[i];
+	}
+	std::vector<TailMergedString*> sorted(bucketStarts[0x10000]);
+	std::vector<uint32_t> bucketFill(bucketStarts.begin(), bucketStarts.end()-1);
+	for (TailMergedString& s : _tailMerged) {
+		if ( s.length != 0 )
+			sorted[bucketFill[tailBucket(s)]++] = &s;
+	}
+
+	// sort each bucket and find which strings are tails of an earlier one
+	ld::parallel::forEach(nonEmptyBuckets.size(), [&](size_t index) {
+		const uint32_t bucket = nonEmptyBuckets[index];
+		TailMergedString** const begin = &sorted[bucketStarts[bucket]];
+		TailMergedString** const end = &sorted[bucketStarts[bucket+1]];
+		std::sort(begin, end, &reversedGreater);
+		const TailMergedString* host = NULL;
+		for (TailMergedString** it = begin; it != end; ++it) {
+			TailMergedString* s = *it;
+			if ( (host != NULL) && (host->length >= s->length)
+					&& (memcmp(&host->str[host->length - s->length], s->str, s->length) == 0) )
+				s->host = host->host;
+			else
+				host = s;
+		}
+	});
+
+	// copy strings in bucket order, so the layout does not depend on threads
+	_tailMergedOffsets.resize(_tailMerged.size());
+	for (const TailMergedString* s : sorted) {
+		const uint32_t ticket = (uint32_t)(s - &_tailMerged[0]);
+		if ( s->host == ticket ) {
+			_tailMergedOffsets[ticket] = this->add(s->str);
+		}
+		else {
+			const TailMergedString& host = _tailMerged[s->host];
+			_tailMergedOffsets[ticket] = _tailMergedOffsets[s->host] + (host.length - s->length);
+		}
+	}
+	for (uint32_t ticket=0; ticket < _tailMerged.size(); ++ticket) {
+		if ( _tailMerged[ticket].length == 0 )
+			_tailMergedOffsets[ticket] = this->emptyString();
+	}
+	_tailMerged.clear();
+}
+
+
 const char* StringPoolAtom::stringForIndex(int32_t index) const
 {
 	int32_t currentBufferStartIndex = kBufferSize * _fullBuffers.size();
@@ -225,7 +343,10 @@ private:
 	uint64_t						valueForStab(const ld::relocatable::File::Stab& stab);
 	uint8_t							sectionIndexForStab(const ld::relocatable::File::Stab& stab);
 	bool							isAltEntry(const ld::Atom* atom);
+	const char*						synthesizedName(const char* name);
+	void							setStringOffsets(std::vector<macho_nlist<P> >& entries, StringPoolAtom* pool);
 
+	std::deque<std::string>					_synthesizedNames;
 	mutable std::vector<macho_nlist<P> >	_globals;
 	mutable std::vector<macho_nlist<P> >	_locals;
 	mutable std::vector<macho_nlist<P> >	_imports;
@@ -270,6 +391,26 @@ bool SymbolTableAtom<A>::isAltEntry(const ld::Atom* atom)
 	return false;
 }
 
+// names made up here must outlive the string pool's tail merging
+template <typename A>
+const char* SymbolTableAtom<A>::synthesizedName(const char* name)
+{
+	_synthesizedNames.push_back(name);
+	return _synthesizedNames.back().c_str();
+}
+
+// replaces the string pool tickets in entries with string offsets
+template <typename A>
+void SymbolTableAtom<A>::setStringOffsets(std::vector<macho_nlist<P> >& entries, StringPoolAtom* pool)
+{
+	for (macho_nlist<P>& entry : entries) {
+		entry.set_n_strx(pool->offsetForTicket(entry.n_strx()));
+		// indirect symbols have the name they stand for in n_value
+		if ( (entry.n_type() & N_TYPE) == N_INDR )
+			entry.set_n_value(pool->offsetForTicket((uint32_t)entry.n_value()));
+	}
+}
+
 template <typename A>
 bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool) 
 {
@@ -285,7 +426,7 @@ bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool)
 				// don't use 'l' labels for x86_64 strings
 				// <rdar://problem/6605499> x86_64 obj-c runtime confused when static lib is stripped
 				sprintf(anonName, "LC%u", _s_anonNameIndex++);
-				symbolName = anonName;
+				symbolName = synthesizedName(anonName);
 			}
 		}
 		else if ( atom->contentType() == ld::Atom::typeCFI ) {
@@ -300,10 +441,10 @@ bool SymbolTableAtom<A>::addLocal(const ld::Atom* atom, StringPoolAtom* pool)
 		else if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel ) {
 			// make auto-strip anonymous name for symbol 
 			sprintf(anonName, "l%03u", _s_anonNameIndex++);
-			symbolName = anonName;
+			symbolName = synthesizedName(anonName);
 		}
 	}
-	entry.set_n_strx(pool->add(symbolName));
+	entry.set_n_strx(pool->addTailMerged(symbolName));
 
 	// set n_type
 	uint8_t type = N_SECT;
@@ -363,10 +504,10 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 		if ( atom->symbolTableInclusion() == ld::Atom::symbolTableInWithRandomAutoStripLabel ) {
 			// make auto-strip anonymous name for symbol 
 			sprintf(anonName, "l%03u", _s_anonNameIndex++);
-			symbolName = anonName;
+			symbolName = synthesizedName(anonName);
 		}
 	}
-	entry.set_n_strx(pool->add(symbolName));
+	entry.set_n_strx(pool->addTailMerged(symbolName));
 
 	// set n_type
 	if ( atom->definition() == ld::Atom::definitionAbsolute ) {
@@ -431,7 +572,7 @@ void SymbolTableAtom<A>::addGlobal(const ld::Atom* atom, StringPoolAtom* pool)
 			for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
 				if ( fit->kind == ld::Fixup::kindNoneFollowOn ) {
 					assert(fit->binding == ld::Fixup::bindingDirectlyBound);
-					entry.set_n_value(pool->add(fit->u.target->name()));
+					entry.set_n_value(pool->addTailMerged(fit->u.target->name()));
 				}
 			}
 		}
@@ -474,7 +615,7 @@ void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool)
 	macho_nlist<P> entry;
 
 	// set n_strx
-	entry.set_n_strx(pool->add(atom->name()));
+	entry.set_n_strx(pool->addTailMerged(atom->name()));
 
 	// set n_type
 	if ( this->_options.outputKind() == Options::kObjectFile ) {
@@ -541,10 +682,10 @@ void SymbolTableAtom<A>::addImport(const ld::Atom* atom, StringPoolAtom* pool)
 			assert(fit->kind == ld::Fixup::kindNoneFollowOn);
 			switch ( fit->binding ) {
 				case ld::Fixup::bindingByNameUnbound:
-					entry.set_n_value(pool->add(fit->u.name));
+					entry.set_n_value(pool->addTailMerged(fit->u.name));
 					break;
 				case ld::Fixup::bindingsIndirectlyBound:
-					entry.set_n_value(pool->add((_state.indirectBindingTable[fit->u.bindingIndex])->name()));
+					entry.set_n_value(pool->addTailMerged((_state.indirectBindingTable[fit->u.bindingIndex])->name()));
 					break;
 				default:
 					assert(0 && "internal error: unexpected alias binding");
@@ -698,10 +839,26 @@ void SymbolTableAtom<A>::encode()
 	}
 	this->_writer._importSymbolsCount = symbolIndex - this->_writer._importSymbolsStartIndex;
 
-	// go back to start and make nlist entries for all local symbols
+	// make nlist entries for all local symbols, they go after the stabs
 	std::vector<const ld::Atom*>& localAtoms = this->_writer._localAtoms;
 	_locals.reserve(localsCount);
-	symbolIndex = 0;
+	symbolIndex = _state.stabs.size();
+	for (const ld::Atom* atom : localAtoms) {
+		if ( this->addLocal(atom, this->_writer._stringPoolAtom) )
+			this->_writer._atomToSymbolIndex[atom] = symbolIndex++;
+	}
+	this->_writer._localSymbolsCount = symbolIndex;
+
+	// all symbol names are now known, lay them out sharing common tails
+	this->_writer._stringPoolAtom->layoutTailMerged();
+	_synthesizedNames.clear();
+	setStringOffsets(_globals, this->_writer._stringPoolAtom);
+	setStringOffsets(_imports, this->_writer._stringPoolAtom);
+	setStringOffsets(_locals, this->_writer._stringPoolAtom);
+
+	// make nlist entries for stabs, their strings go last in the string pool
+	std::vector<macho_nlist<P> > stabEntries;
+	stabEntries.reserve(_state.stabs.size());
 	this->_writer._localSymbolsStartIndex = 0;
 	_stabsIndexStart = 0;
 	_stabsStringsOffsetStart = this->_writer._stringPoolAtom->currentOffset();
@@ -712,16 +869,11 @@ void SymbolTableAtom<A>::encode()
 		entry.set_n_desc(stab.desc);
 		entry.set_n_value(valueForStab(stab));
 		entry.set_n_strx(stringOffsetForStab(stab, this->_writer._stringPoolAtom));
-		_locals.push_back(entry);
-		++symbolIndex;
+		stabEntries.push_back(entry);
 	}
-	_stabsIndexEnd = symbolIndex;
+	_stabsIndexEnd = stabEntries.size();
 	_stabsStringsOffsetEnd = this->_writer._stringPoolAtom->currentOffset();
-	for (const ld::Atom* atom : localAtoms) {
-		if ( this->addLocal(atom, this->_writer._stringPoolAtom) )
-			this->_writer._atomToSymbolIndex[atom] = symbolIndex++;
-	}
-	this->_writer._localSymbolsCount = symbolIndex;
+	_locals.insert(_locals.begin(), stabEntries.begin(), stabEntries.end());
 }
 
 template <typename A>
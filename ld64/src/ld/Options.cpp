@@ -38,6 +38,7 @@
 #include <Availability.h>
 #include <tapi/tapi.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include <vector>
 #include <map>
@@ -88,9 +89,12 @@ static bool			sFatalWarnings = false;
 static const char*	sWarningsSideFilePath = NULL;
 static FILE*		sWarningsSideFile = NULL;
 static int			sWarningsCount = 0;
+static pthread_mutex_t	sWarningsLock = PTHREAD_MUTEX_INITIALIZER;
 
 void warning(const char* format, ...)
 {
+	// warnings can come from parallel phases, keep each one on its own lines
+	pthread_mutex_lock(&sWarningsLock);
 	++sWarningsCount;
 	if ( sEmitWarnings ) {
 		va_list	list;
@@ -110,6 +114,7 @@ void warning(const char* format, ...)
 		}
 		va_end(list);
 	}
+	pthread_mutex_unlock(&sWarningsLock);
 }
 
 void throwf(const char* format, ...)
@@ -157,13 +162,13 @@ Options::Options(int argc, const char* argv[])
 	  fClientName(NULL),
 	  fUmbrellaName(NULL), fInitFunctionName(NULL), fDotOutputFile(NULL), fExecutablePath(NULL),
 	  fBundleLoader(NULL), fDtraceScriptName(NULL), fSegAddrTablePath(NULL), fMapPath(NULL), 
-	  fDyldInstallPath("/usr/lib/dyld"), fTempLtoObjectPath(NULL), fOverridePathlibLTO(NULL), fLtoCpu(NULL),
+	  fDyldInstallPath("/usr/lib/dyld"), fTempLtoObjectPath(NULL), fObjectCachePath(NULL), fArchiveTOCCachePath(NULL), fParallelParseMinSize(32*1024*1024), fOverridePathlibLTO(NULL), fLtoCpu(NULL),
 	  fZeroPageSize(ULLONG_MAX), fStackSize(0), fStackAddr(0), fSourceVersion(0), fSDKVersion(0), fExecutableStack(false), 
 	  fNonExecutableHeap(false), fDisableNonExecutableHeap(false),
 	  fMinimumHeaderPad(32), fSegmentAlignment(4096), 
-	  fCommonsMode(kCommonsIgnoreDylibs),  fUUIDMode(kUUIDContent), fLocalSymbolHandling(kLocalSymbolsAll), fWarnCommons(false), 
+	  fCommonsMode(kCommonsIgnoreDylibs),  fUUIDMode(kUUIDContent), fUUIDTreeHash(false), fStreamOutput(false), fThreadCount(0), fLocalSymbolHandling(kLocalSymbolsAll), fWarnCommons(false), 
 	  fVerbose(false), fKeepRelocations(false), fWarnStabs(false),
-	  fTraceDylibSearching(false), fPause(false), fStatistics(false), fPrintOptions(false),
+	  fTraceDylibSearching(false), fPause(false), fStatistics(false), fStatisticsTraceFile(NULL), fPrintOptions(false),
 	  fSharedRegionEligible(false), fSharedRegionEligibleForceOff(false), fPrintOrderFileStatistics(false),
 	  fReadOnlyx86Stubs(false), fPositionIndependentExecutable(false), fPIEOnCommandLine(false),
 	  fDisablePositionIndependentExecutable(false), fMaxMinimumHeaderPad(false),
@@ -201,7 +206,7 @@ Options::Options(int argc, const char* argv[])
 	  fSharedRegionEncodingV2(false), fUseDataConstSegment(false),
 	  fUseDataConstSegmentForceOn(false), fUseDataConstSegmentForceOff(false), fUseTextExecSegment(false),
 	  fBundleBitcode(false), fHideSymbols(false), fVerifyBitcode(false),
-	  fReverseMapUUIDRename(false), fDeDupe(true), fVerboseDeDupe(false),
+	  fReverseMapUUIDRename(false), fDeDupe(true), fVerboseDeDupe(false), fDeDupeReadOnlyData(false),
 	  fReverseMapPath(NULL), fLTOCodegenOnly(false),
 	  fIgnoreAutoLink(false), fAllowDeadDups(false), fAllowWeakImports(true), fBitcodeKind(kBitcodeProcess),
 	  fPlatform(kPlatformUnknown), fDebugInfoStripping(kDebugInfoMinimal), fTraceOutputFile(NULL),
@@ -1165,18 +1170,18 @@ void Options::SetWithWildcards::remove(const NameSet& toBeRemoved)
 	}
 }
 
-bool Options::SetWithWildcards::hasWildCards(const char* symbol) 
-{
-	// an exported symbol name containing *, ?, or [ requires wildcard matching
-	return ( strpbrk(symbol, "*?[") != NULL );
-}
-
 void Options::SetWithWildcards::insert(const char* symbol)
 {
-	if ( hasWildCards(symbol) )
+	if ( strchr(symbol, ':') != NULL )
+		fHasFilePrefixes = true;
+	// an exported symbol name containing *, ?, or [ requires wildcard matching
+	if ( ld::tool::WildcardMatcher::hasWildCards(symbol) ) {
 		fWildCard.push_back(symbol);
-	else
+		fWildCardMatcher.insert(symbol);
+	}
+	else {
 		fRegular.insert(symbol);
+	}
 }
 
 bool Options::SetWithWildcards::contains(const char* symbol, bool* matchBecauseOfWildcard) const
@@ -1186,13 +1191,11 @@ bool Options::SetWithWildcards::contains(const char* symbol, bool* matchBecauseO
 	// first look at hash table on non-wildcard symbols
 	if ( fRegular.find(symbol) != fRegular.end() )
 		return true;
-	// next walk list of wild card symbols looking for a match
-	for(std::vector<const char*>::const_iterator it = fWildCard.begin(); it != fWildCard.end(); ++it) {
-		if ( wildCardMatch(*it, symbol) ) {
-			if ( matchBecauseOfWildcard != NULL )
-				*matchBecauseOfWildcard = true;
-			return true;
-		}
+	// next match against all wild card symbols at once
+	if ( fWildCardMatcher.matches(symbol) ) {
+		if ( matchBecauseOfWildcard != NULL )
+			*matchBecauseOfWildcard = true;
+		return true;
 	}
 	return false;
 }
@@ -1203,13 +1206,18 @@ bool Options::SetWithWildcards::containsWithPrefix(const char* symbol, const cha
 	wildCardMatch = false;
 	if ( contains(symbol, &wildCardMatch) )
 		return true;
-	if ( file == NULL )
+	// only build "file:symbol" if some entry could be one
+	if ( (file == NULL) || !fHasFilePrefixes )
 		return false;
 	const char* s = strrchr(file, '/');
 	if ( s != NULL )
 		file = s+1;
-	char buff[strlen(file)+strlen(symbol)+2];
-	sprintf(buff, "%s:%s", file, symbol);
+	size_t fileLen = strlen(file);
+	size_t symbolLen = strlen(symbol);
+	char buff[fileLen+symbolLen+2];
+	memcpy(buff, file, fileLen);
+	buff[fileLen] = ':';
+	memcpy(&buff[fileLen+1], symbol, symbolLen+1);
 	return contains(buff, &wildCardMatch);
 }
 
@@ -1238,67 +1246,6 @@ std::vector<const char*> Options::SetWithWildcards::data() const
 	return data;
 }
 
-bool Options::SetWithWildcards::inCharRange(const char*& p, unsigned char c) const
-{
-	++p; // find end
-	const char* b = p;
-	while ( *p != '\0' ) {
-		if ( *p == ']') {
-			const char* e = p;
-			// found beginining [ and ending ]
-			unsigned char last = '\0';
-			for ( const char* s = b; s < e; ++s ) {
-				if ( *s == '-' ) {
-					unsigned char next = *(++s);
-					if ( (last <= c) && (c <= next) )
-						return true;
-					++s;
-				}
-				else {
-					if ( *s == c )
-						return true;
-					last = *s;
-				}
-			}
-			return false;
-		}
-		++p;
-	}
-	return false;
-}
-
-bool Options::SetWithWildcards::wildCardMatch(const char* pattern, const char* symbol) const
-{
-	const char* s = symbol;
-	for (const char* p = pattern; *p != '\0'; ++p) {
-		switch ( *p ) {
-			case '*':
-				if ( p[1] == '\0' )
-					return true;
-				for (const char* t = s; *t != '\0'; ++t) {
-					if ( wildCardMatch(&p[1], t) )
-						return true;
-				}
-				return false;
-			case '?':
-				if ( *s == '\0' )
-					return false;
-				++s;
-				break;
-			case '[':
-				if ( ! inCharRange(p, *s) )
-					return false;
-				++s;
-				break;
-			default:
-				if ( *s != *p )
-					return false;
-				++s;
-		}
-	}
-	return (*s == '\0');
-}
-
 
 void Options::loadExportFile(const char* fileOfExports, const char* option, SetWithWildcards& set)
 {
@@ -1928,6 +1875,64 @@ void Options::parseOrderFile(const char* path, bool cstring)
 	// Note: we do not free() the malloc buffer, because the strings are used by the fOrderedSymbols
 }
 
+void Options::parseCallGraphOrderFile(const char* path)
+{
+	// read in whole file
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		throwf("can't open call graph order file: %s", path);
+	struct stat stat_buf;
+	::fstat(fd, &stat_buf);
+	char* p = (char*)malloc(stat_buf.st_size+1);
+	if ( p == NULL )
+		throwf("can't process call graph order file: %s", path);
+	if ( read(fd, p, stat_buf.st_size) != stat_buf.st_size )
+		throwf("can't read call graph order file: %s", path);
+	::close(fd);
+	p[stat_buf.st_size] = '\0';
+	if ( this->dumpDependencyInfo() )
+		this->dumpDependency(Options::depMisc, path);
+
+	// each line is "caller callee weight" or "function weight", '#' starts a comment
+	unsigned int lineNumber = 0;
+	for (char* line = p; line != NULL; ) {
+		++lineNumber;
+		char* nextLine = strchr(line, '\n');
+		if ( nextLine != NULL )
+			*nextLine++ = '\0';
+		char* comment = strchr(line, '#');
+		if ( comment != NULL )
+			*comment = '\0';
+		char* fields[3];
+		unsigned int fieldCount = 0;
+		for (char* s = line; *s != '\0'; ) {
+			while ( isspace(*s) )
+				*s++ = '\0';
+			if ( *s == '\0' )
+				break;
+			if ( fieldCount == 3 )
+				throwf("malformed line %u in call graph order file: %s", lineNumber, path);
+			fields[fieldCount++] = s;
+			while ( (*s != '\0') && !isspace(*s) )
+				++s;
+		}
+		if ( fieldCount != 0 ) {
+			if ( fieldCount == 1 )
+				throwf("malformed line %u in call graph order file: %s", lineNumber, path);
+			char* endptr;
+			CallGraphEdge edge;
+			edge.caller = fields[0];
+			edge.callee = (fieldCount == 3) ? fields[1] : NULL;
+			edge.weight = strtoull(fields[fieldCount-1], &endptr, 10);
+			if ( *endptr != '\0' )
+				throwf("malformed weight on line %u in call graph order file: %s", lineNumber, path);
+			fCallGraphEdges.push_back(edge);
+		}
+		line = nextLine;
+	}
+	// Note: we do not free() the malloc buffer, because the strings are used by fCallGraphEdges
+}
+
 void Options::parseSectionOrderFile(const char* segment, const char* section, const char* path)
 {
 	if ( (strcmp(section, "__cstring") == 0) && (strcmp(segment, "__TEXT") == 0) ) {
@@ -2452,6 +2457,16 @@ void Options::parse(int argc, const char* argv[])
 				if ( fLtoCachePath == NULL )
 					throw "missing argument to -cache_path_lto";
 			}
+			else if ( strcmp(arg, "-object_cache_path") == 0 ) {
+				fObjectCachePath = argv[++i];
+				if ( fObjectCachePath == NULL )
+					throw "missing argument to -object_cache_path";
+			}
+			else if ( strcmp(arg, "-archive_toc_cache_path") == 0 ) {
+				fArchiveTOCCachePath = argv[++i];
+				if ( fArchiveTOCCachePath == NULL )
+					throw "missing argument to -archive_toc_cache_path";
+			}
 			else if ( strcmp(arg, "-prune_interval_lto") == 0 ) {
 				const char* value = argv[++i];
 				if ( value == NULL )
@@ -2561,6 +2576,14 @@ void Options::parse(int argc, const char* argv[])
                 snapshotFileArgIndex = 1;
 				parseOrderFile(argv[++i], false);
 			}
+			else if ( strcmp(arg, "-call_graph_order_file") == 0 ) {
+				snapshotFileArgIndex = 1;
+				const char* path = argv[++i];
+				if ( path == NULL )
+					throw "missing argument to -call_graph_order_file";
+				parseCallGraphOrderFile(path);
+				cannotBeUsedWithBitcode(arg);
+			}
 			else if ( strcmp(arg, "-order_file_statistics") == 0 ) {
 				fPrintOrderFileStatistics = true;
 				cannotBeUsedWithBitcode(arg);
@@ -3217,6 +3240,11 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-print_statistics") == 0 ) {
 				fStatistics = true;
 			}
+			else if ( strcmp(arg, "-trace_statistics_file") == 0 ) {
+				fStatisticsTraceFile = argv[++i];
+				if ( fStatisticsTraceFile == NULL )
+					throw "missing argument to -trace_statistics_file";
+			}
 			else if ( strcmp(arg, "-d") == 0 ) {
 				fMakeTentativeDefinitionsReal = true;
 			}
@@ -3243,6 +3271,21 @@ void Options::parse(int argc, const char* argv[])
 				fUUIDMode = kUUIDRandom;
 				cannotBeUsedWithBitcode(arg);
 			}
+			else if ( strcmp(arg, "-uuid_tree_hash") == 0 ) {
+				fUUIDTreeHash = true;
+			}
+			else if ( strcmp(arg, "-stream_output") == 0 ) {
+				fStreamOutput = true;
+			}
+			else if ( strcmp(arg, "-threads") == 0 ) {
+				const char* value = argv[++i];
+				if ( value == NULL )
+					throw "missing argument to -threads";
+				char* endptr;
+				fThreadCount = strtoul(value, &endptr, 10);
+				if ( (*endptr != '\0') || (fThreadCount == 0) )
+					throw "invalid argument for -threads";
+			}
 			else if ( strcmp(arg, "-dtrace") == 0 ) {
                 snapshotFileArgIndex = 1;
 				const char* name = argv[++i];
@@ -3865,6 +3908,9 @@ void Options::parse(int argc, const char* argv[])
 			else if ( strcmp(arg, "-verbose_deduplicate") == 0 ) {
 				fVerboseDeDupe = true;
 			}
+			else if ( strcmp(arg, "-deduplicate_read_only_data") == 0 ) {
+				fDeDupeReadOnlyData = true;
+			}
 			else if ( strcmp(arg, "-max_default_common_align") == 0 ) {
 				const char* alignStr = argv[++i];
 				if ( alignStr == NULL )
@@ -4250,6 +4296,11 @@ void Options::parsePreCommandLineEnvironmentSettings()
 	
 	if (getenv("LD_DYLIB_CPU_SUBTYPES_MUST_MATCH") != NULL)
 		fEnforceDylibSubtypesMatch = true;
+
+	// object files at least this many bytes are parsed on several threads
+	const char* parallelParseMinSize = getenv("LD_PARALLEL_PARSE_MIN_SIZE");
+	if ( parallelParseMinSize != NULL )
+		fParallelParseMinSize = strtoull(parallelParseMinSize, NULL, 0);
 	
 	sWarningsSideFilePath = getenv("LD_WARN_FILE");
 	
@@ -36,6 +36,7 @@
 #include "ld.hpp"
 #include "Snapshot.h"
 #include "MachOFileAbstraction.hpp"
+#include "WildcardMatcher.hpp"
 
 extern void throwf (const char* format, ...) __attribute__ ((noreturn,format(printf, 1, 2)));
 extern void warning(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -143,6 +144,7 @@ public:
 		// These are used by the threaded input file parsing engine.
 		mutable int				inputFileSlot;	// The input file "slot" assigned to this particular file
 		bool					readyToParse;
+		volatile bool			parsed;			// set once the parsed file is in its slot
 
         // The use pattern for FileInfo is to create one on the stack in a leaf function and return
         // it to the calling frame by copy. Therefore the copy constructor steals the path string from
@@ -158,6 +160,7 @@ public:
 			std::swap(fromFileList, other.fromFileList);
 			std::swap(inputFileSlot, other.inputFileSlot);
 			std::swap(readyToParse, other.readyToParse);
+			std::swap(parsed, other.parsed);
 			return *this;
 		}
 
@@ -207,6 +210,14 @@ public:
 	};
 	typedef const OrderedSymbol*	OrderedSymbolsIterator;
 
+	// A line of a -call_graph_order_file: caller calls callee weight times, or
+	// with no callee, function was seen weight times in samples.
+	struct CallGraphEdge {
+		const char*				caller;
+		const char*				callee;		// NULL for a sample count
+		uint64_t				weight;
+	};
+
 	struct SegmentStart {
 		const char*				name;
 		uint64_t				address;
@@ -321,6 +332,7 @@ public:
 	UndefinesIterator			initialUndefinesEnd() const { return &fInitialUndefines[fInitialUndefines.size()]; }
 	const std::vector<const char*>&	initialUndefines() const { return fInitialUndefines; }
 	bool						printWhyLive(const char* name) const;
+	bool						whyLiveRequested() const { return !fWhyLive.empty(); }
 	uint32_t					minimumHeaderPad() const { return fMinimumHeaderPad; }
 	bool						maxMminimumHeaderPad() const { return fMaxMinimumHeaderPad; }
 	ExtraSection::const_iterator	extraSectionsBegin() const { return &fExtraSections[0]; }
@@ -331,9 +343,13 @@ public:
 	FileInfo					findFile(const std::string &path, const ld::dylib::File* fromDylib=nullptr) const;
 	bool						findFile(const std::string &path, const std::vector<std::string> &tbdExtensions, FileInfo& result) const;
 	UUIDMode					UUIDMode() const { return fUUIDMode; }
+	bool						UUIDTreeHash() const { return fUUIDTreeHash; }
+	bool						streamOutput() const { return fStreamOutput; }
+	unsigned int				threadCount() const { return fThreadCount; }
 	bool						warnStabs();
 	bool						pauseAtEnd() { return fPause; }
 	bool						printStatistics() const { return fStatistics; }
+	const char*					statisticsTraceFile() const { return fStatisticsTraceFile; }
 	bool						printArchPrefix() const { return fMessagesPrefixedWithArchitecture; }
 	void						gotoClassicLinker(int argc, const char* argv[]);
 	bool						sharedRegionEligible() const { return fSharedRegionEligible; }
@@ -343,6 +359,7 @@ public:
 	unsigned long				orderedSymbolsCount() const { return fOrderedSymbols.size(); }
 	OrderedSymbolsIterator		orderedSymbolsBegin() const { return &fOrderedSymbols[0]; }
 	OrderedSymbolsIterator		orderedSymbolsEnd() const { return &fOrderedSymbols[fOrderedSymbols.size()]; }
+	const std::vector<CallGraphEdge>& callGraphEdges() const { return fCallGraphEdges; }
 	bool						splitSeg() const { return fSplitSegs; }
 	uint64_t					baseWritableAddress() { return fBaseWritableAddress; }
 	uint64_t					segmentAlignment() const { return fSegmentAlignment; }
@@ -415,6 +432,9 @@ public:
 	bool						addDataInCodeInfo() const { return fDataInCodeInfoLoadCommand; }
 	bool						canReExportSymbols() const { return fCanReExportSymbols; }
 	const char*					ltoCachePath() const { return fLtoCachePath; }
+	const char*					objectCachePath() const { return fObjectCachePath; }
+	const char*					archiveTOCCachePath() const { return fArchiveTOCCachePath; }
+	uint64_t					parallelParseMinSize() const { return fParallelParseMinSize; }
 	int							ltoPruneInterval() const { return fLtoPruneInterval; }
 	int							ltoPruneAfter() const { return fLtoPruneAfter; }
 	unsigned					ltoMaxCacheSize() const { return fLtoMaxCacheSize; }
@@ -438,6 +458,7 @@ public:
 	bool						renameReverseSymbolMap() const { return fReverseMapUUIDRename; }
 	bool						deduplicateFunctions() const { return fDeDupe; }
 	bool						verboseDeduplicate() const { return fVerboseDeDupe; }
+	bool						deduplicateReadOnlyData() const { return fDeDupeReadOnlyData; }
 	const char*					reverseSymbolMapPath() const { return fReverseMapPath; }
 	std::string					reverseMapTempPath() const { return fReverseMapTempPath; }
 	bool						ltoCodegenOnly() const { return fLTOCodegenOnly; }
@@ -502,6 +523,7 @@ private:
 		bool					contains(const char*, bool* wildCardMatch=NULL) const;
 		bool					containsWithPrefix(const char* symbol, const char* file, bool& wildCardMatch) const;
 		bool					containsNonWildcard(const char*) const;
+							SetWithWildcards() : fHasFilePrefixes(false) { }
 		bool					empty() const			{ return fRegular.empty() && fWildCard.empty(); }
 		bool					hasWildCards() const	{ return !fWildCard.empty(); }
 		NameSet::const_iterator		regularBegin() const	{ return fRegular.begin(); }
@@ -509,12 +531,10 @@ private:
 		void					remove(const NameSet&); 
 		std::vector<const char*>		data() const;
 	private:
-		static bool				hasWildCards(const char*);
-		bool					wildCardMatch(const char* pattern, const char* candidate) const;
-		bool					inCharRange(const char*& range, unsigned char c) const;
-
 		NameSet							fRegular;
 		std::vector<const char*>		fWildCard;
+		ld::tool::WildcardMatcher		fWildCardMatcher;
+		bool							fHasFilePrefixes;	// some entry is "file:symbol"
 	};
 
 	struct SymbolsMove {
@@ -535,6 +555,7 @@ private:
 	bool						parsePackedVersion32(const std::string& versionStr, uint32_t &result);
 	void						parseSectionOrderFile(const char* segment, const char* section, const char* path);
 	void						parseOrderFile(const char* path, bool cstring);
+	void						parseCallGraphOrderFile(const char* path);
 	void						addSection(const char* segment, const char* section, const char* path);
 	void						addSubLibrary(const char* name);
 	void						loadFileList(const char* fileOfPaths, ld::File::Ordinal baseOrdinal);
@@ -622,6 +643,9 @@ private:
 	const char*							fMapPath;
 	const char*							fDyldInstallPath;
 	const char*							fLtoCachePath;
+	const char*							fObjectCachePath;
+	const char*							fArchiveTOCCachePath;
+	uint64_t							fParallelParseMinSize;
 	int									fLtoPruneInterval;
 	int									fLtoPruneAfter;
 	unsigned							fLtoMaxCacheSize;
@@ -640,6 +664,9 @@ private:
 	uint64_t							fSegmentAlignment;
 	CommonsMode							fCommonsMode;
 	enum UUIDMode						fUUIDMode;
+	bool								fUUIDTreeHash;
+	bool								fStreamOutput;
+	unsigned int						fThreadCount;
 	SetWithWildcards					fLocalSymbolsIncluded;
 	SetWithWildcards					fLocalSymbolsExcluded;
 	LocalSymbolHandling					fLocalSymbolHandling;
@@ -650,6 +677,7 @@ private:
 	bool								fTraceDylibSearching;
 	bool								fPause;
 	bool								fStatistics;
+	const char*							fStatisticsTraceFile;
 	bool								fPrintOptions;
 	bool								fSharedRegionEligible;
 	bool								fSharedRegionEligibleForceOff;
@@ -754,6 +782,7 @@ private:
 	bool								fReverseMapUUIDRename;
 	bool								fDeDupe;
 	bool								fVerboseDeDupe;
+	bool								fDeDupeReadOnlyData;
 	const char*							fReverseMapPath;
 	std::string							fReverseMapTempPath;
 	bool								fLTOCodegenOnly;
@@ -774,6 +803,7 @@ private:
 	std::vector<ExtraSection>			fExtraSections;
 	std::vector<SectionAlignment>		fSectionAlignments;
 	std::vector<OrderedSymbol>			fOrderedSymbols;
+	std::vector<CallGraphEdge>			fCallGraphEdges;
 	std::vector<SegmentStart>			fCustomSegmentAddresses;
 	std::vector<SegmentSize>			fCustomSegmentSizes;
 	std::vector<SegmentProtect>			fCustomSegmentProtections;
@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <limits.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <mach/mach_time.h>
 #include <mach/vm_statistics.h>
 #include <mach/mach_init.h>
@@ -62,6 +63,8 @@
 #include <AvailabilityMacros.h>
 
 #include "MachOTrie.hpp"
+#include "Parallel.hpp"
+#include "Timing.hpp"
 
 #include "Options.h"
 
@@ -105,6 +108,8 @@ OutputFile::OutputFile(const Options& opts)
 		_hasOptimizationHints(opts.outputKind() == Options::kObjectFile),
 		_encryptedTEXTstartOffset(0),
 		_encryptedTEXTendOffset(0),
+		_writingAtomsInParallel(false),
+		_sectionLayoutWanted(false),
 		_localSymbolsStartIndex(0),
 		_localSymbolsCount(0),
 		_globalSymbolsStartIndex(0),
@@ -149,25 +154,52 @@ void OutputFile::dumpAtomsBySection(ld::Internal& state, bool printAtoms)
 
 void OutputFile::write(ld::Internal& state)
 {
-	this->buildDylibOrdinalMapping(state);
-	this->addLoadCommands(state);
-	this->addLinkEdit(state);
-	state.setSectionSizesAndAlignments();
-	this->setLoadCommandsPadding(state);
-	_fileSize = state.assignFileOffsets();
-	this->assignAtomAddresses(state);
-	this->synthesizeDebugNotes(state);
-	this->buildSymbolTable(state);
-	this->generateLinkEditInfo(state);
-	if ( _options.sharedRegionEncodingV2() )
-		this->makeSplitSegInfoV2(state);
-	else
-		this->makeSplitSegInfo(state);
-	this->updateLINKEDITAddresses(state);
+	{
+		ld::timing::Scope timer("add load commands and LINKEDIT");
+		this->buildDylibOrdinalMapping(state);
+		this->addLoadCommands(state);
+		this->addLinkEdit(state);
+	}
+	{
+		ld::timing::Scope timer("assign addresses");
+		state.setSectionSizesAndAlignments();
+		this->setLoadCommandsPadding(state);
+		_fileSize = state.assignFileOffsets();
+		this->assignAtomAddresses(state);
+	}
+	{
+		ld::timing::Scope timer("synthesizeDebugNotes");
+		this->synthesizeDebugNotes(state);
+	}
+	{
+		ld::timing::Scope timer("buildSymbolTable");
+		this->buildSymbolTable(state);
+	}
+	{
+		ld::timing::Scope timer("generateLinkEditInfo");
+		this->generateLinkEditInfo(state);
+	}
+	{
+		ld::timing::Scope timer("makeSplitSegInfo");
+		if ( _options.sharedRegionEncodingV2() )
+			this->makeSplitSegInfoV2(state);
+		else
+			this->makeSplitSegInfo(state);
+	}
+	{
+		ld::timing::Scope timer("updateLINKEDITAddresses");
+		this->updateLINKEDITAddresses(state);
+	}
 	//this->dumpAtomsBySection(state, false);
-	this->writeOutputFile(state);
-	this->writeMapFile(state);
-	this->writeJSONEntry(state);
+	{
+		ld::timing::Scope timer("writeOutputFile");
+		this->writeOutputFile(state);
+	}
+	{
+		ld::timing::Scope timer("writeMapFile");
+		this->writeMapFile(state);
+		this->writeJSONEntry(state);
+	}
 }
 
 bool OutputFile::findSegment(ld::Internal& state, uint64_t addr, uint64_t* start, uint64_t* end, uint32_t* index)
@@ -228,72 +260,87 @@ void OutputFile::assignAtomAddresses(ld::Internal& state)
 
 void OutputFile::updateLINKEDITAddresses(ld::Internal& state)
 {
+	// The dyld info, split seg, function starts, data-in-code and optimization hint
+	// encoders each fill their own ByteStream from final addresses and their own
+	// inputs, so they can run concurrently.
+	std::vector<LinkEditAtom*> encoders;
 	if ( _options.makeCompressedDyldInfo() ) {
 		// build dylb rebasing info  
 		assert(_rebasingInfoAtom != NULL);
-		_rebasingInfoAtom->encode();
+		encoders.push_back(_rebasingInfoAtom);
 		
 		// build dyld binding info  
 		assert(_bindingInfoAtom != NULL);
-		_bindingInfoAtom->encode();
+		encoders.push_back(_bindingInfoAtom);
 		
 		// build dyld lazy binding info  
 		assert(_lazyBindingInfoAtom != NULL);
-		_lazyBindingInfoAtom->encode();
+		encoders.push_back(_lazyBindingInfoAtom);
 		
 		// build dyld weak binding info  
 		assert(_weakBindingInfoAtom != NULL);
-		_weakBindingInfoAtom->encode();
+		encoders.push_back(_weakBindingInfoAtom);
 		
 		// build dyld export info  
 		assert(_exportInfoAtom != NULL);
-		_exportInfoAtom->encode();
+		encoders.push_back(_exportInfoAtom);
 	}
 	
 	if ( _options.sharedRegionEligible() ) {
 		// build split seg info  
 		assert(_splitSegInfoAtom != NULL);
-		_splitSegInfoAtom->encode();
+		encoders.push_back(_splitSegInfoAtom);
 	}
 
 	if ( _options.addFunctionStarts() ) {
 		// build function starts info  
 		assert(_functionStartsAtom != NULL);
-		_functionStartsAtom->encode();
+		encoders.push_back(_functionStartsAtom);
 	}
 
 	if ( _options.addDataInCodeInfo() ) {
 		// build data-in-code info  
 		assert(_dataInCodeAtom != NULL);
-		_dataInCodeAtom->encode();
+		encoders.push_back(_dataInCodeAtom);
 	}
 	
 	if ( _hasOptimizationHints ) {
 		// build linker-optimization-hint info  
 		assert(_optimizationHintsAtom != NULL);
-		_optimizationHintsAtom->encode();
+		encoders.push_back(_optimizationHintsAtom);
 	}
 	
-	// build classic symbol table
-	assert(_symbolTableAtom != NULL);
-	_symbolTableAtom->encode();
-	assert(_indirectSymbolTableAtom != NULL);
-	_indirectSymbolTableAtom->encode();
+	// The classic symbol table, indirect symbol table and relocations use each
+	// other's symbol indexes, so they are encoded in order as one extra job.
+	ld::parallel::forEach(encoders.size()+1, [&](size_t index) {
+		if ( index < encoders.size() ) {
+			ld::timing::Scope timer(encoders[index]->name());
+			encoders[index]->encode();
+			return;
+		}
 
-	// add relocations to .o files
-	if ( _options.outputKind() == Options::kObjectFile ) {
-		assert(_sectionsRelocationsAtom != NULL);
-		_sectionsRelocationsAtom->encode();
-	}
+		ld::timing::Scope timer("classic symbol table and relocations");
+		// build classic symbol table
+		assert(_symbolTableAtom != NULL);
+		_symbolTableAtom->encode();
+		assert(_indirectSymbolTableAtom != NULL);
+		_indirectSymbolTableAtom->encode();
+
+		// add relocations to .o files
+		if ( _options.outputKind() == Options::kObjectFile ) {
+			assert(_sectionsRelocationsAtom != NULL);
+			_sectionsRelocationsAtom->encode();
+		}
 
-	if ( ! _options.makeCompressedDyldInfo() ) {
-		// build external relocations 
-		assert(_externalRelocsAtom != NULL);
-		_externalRelocsAtom->encode();
-		// build local relocations 
-		assert(_localRelocsAtom != NULL);
-		_localRelocsAtom->encode();
-	}
+		if ( ! _options.makeCompressedDyldInfo() ) {
+			// build external relocations 
+			assert(_externalRelocsAtom != NULL);
+			_externalRelocsAtom->encode();
+			// build local relocations 
+			assert(_localRelocsAtom != NULL);
+			_localRelocsAtom->encode();
+		}
+	});
 
 	// update address and file offsets now that linkedit content has been generated
 	uint64_t curLinkEditAddress = 0;
@@ -431,17 +478,18 @@ uint64_t OutputFile::pageAlign(uint64_t addr, uint64_t pageSize)
 
 static const char* makeName(const ld::Atom& atom)
 {
-	static char buffer[4096];
+	// only used for error messages, which may be built on several writeAtoms() threads at once
+	char* buffer = NULL;
 	switch ( atom.symbolTableInclusion() ) {
 		case ld::Atom::symbolTableNotIn:
 		case ld::Atom::symbolTableNotInFinalLinkedImages:
-			sprintf(buffer, "%s@0x%08llX", atom.name(), atom.objectAddress());
+			asprintf(&buffer, "%s@0x%08llX", atom.name(), atom.objectAddress());
 			break;
 		case ld::Atom::symbolTableIn:
 		case ld::Atom::symbolTableInAndNeverStrip:
 		case ld::Atom::symbolTableInAsAbsolute:
 		case ld::Atom::symbolTableInWithRandomAutoStripLabel:
-			strlcpy(buffer, atom.name(), 4096);
+			buffer = strdup(atom.name());
 			break;
 	}
 	return buffer;
@@ -594,6 +642,11 @@ uint64_t OutputFile::tlvTemplateOffsetOf(const ld::Internal& state, const ld::Fi
 
 void OutputFile::printSectionLayout(ld::Internal& state)
 {
+	// range check failures on writeAtoms() worker threads leave the dump to writeAtoms()
+	if ( _writingAtomsInParallel ) {
+		_sectionLayoutWanted = true;
+		return;
+	}
 	// show layout of final image
 	fprintf(stderr, "final section layout:\n");
 	for (std::vector<ld::Internal::FinalSection*>::iterator it = state.sections.begin(); it != state.sections.end(); ++it) {
@@ -2643,21 +2696,21 @@ if (printStuff) fprintf(stderr, "\n");
 					if ( (infoA.instruction & 0x9F000000) != 0x90000000 ) {
 						if ( _options.verboseOptimizationHints() )
 							fprintf(stderr, "may-reused-adrp at 0x%08llX no longer an ADRP, now 0x%08X\n", infoA.instructionAddress, infoA.instruction);
-						sAdrpNA++;
+						__sync_fetch_and_add(&sAdrpNA, 1);
 						break;
 					}
 					if ( (infoB.instruction & 0x9F000000) != 0x90000000 ) {
 						if ( _options.verboseOptimizationHints() )
 							fprintf(stderr, "may-reused-adrp at 0x%08llX no longer an ADRP, now 0x%08X\n", infoB.instructionAddress, infoA.instruction);
-						sAdrpNA++;
+						__sync_fetch_and_add(&sAdrpNA, 1);
 						break;
 					}
 					if ( (infoA.targetAddress & (-4096)) == (infoB.targetAddress & (-4096)) ) {
 						set32LE(infoB.instructionContent, 0xD503201F);
-						sAdrpNoped++;
+						__sync_fetch_and_add(&sAdrpNoped, 1);
 					}
 					else {
-						sAdrpNotNoped++;
+						__sync_fetch_and_add(&sAdrpNotNoped, 1);
 					}
 					break;
 			}				
@@ -2729,9 +2782,49 @@ bool OutputFile::hasZeroForFileOffset(const ld::Section* sect)
 	return false;
 }
 
-void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
+void OutputFile::writeAtomRange(ld::Internal& state, uint8_t* buffer, uint64_t bufferFileOffset, const AtomWriteRange& range)
+{
+	ld::Internal::FinalSection* sect = range.sect;
+	const bool sectionUsesNops = (sect->type() == ld::Section::typeCode);
+	uint64_t fileOffsetOfEndOfLastAtom = range.fileOffsetOfEndOfLastAtom;
+	bool lastAtomUsesNoOps = range.lastAtomUsesNoOps;
+	bool lastAtomWasThumb = range.lastAtomWasThumb;
+	for (size_t i=range.begin; i < range.end; ++i) {
+		const ld::Atom* atom = sect->atoms[i];
+		if ( atom->definition() == ld::Atom::definitionProxy )
+			continue;
+		try {
+			uint64_t fileOffset = atom->finalAddress() - sect->address + sect->fileOffset;
+			// check for alignment padding between atoms
+			if ( (fileOffset != fileOffsetOfEndOfLastAtom) && lastAtomUsesNoOps ) {
+				this->copyNoOps(&buffer[fileOffsetOfEndOfLastAtom - bufferFileOffset], &buffer[fileOffset - bufferFileOffset], lastAtomWasThumb);
+			}
+			// copy atom content
+			atom->copyRawContent(&buffer[fileOffset - bufferFileOffset]);
+			// apply fix ups
+			this->applyFixUps(state, range.mhAddress, atom, &buffer[fileOffset - bufferFileOffset]);
+			fileOffsetOfEndOfLastAtom = fileOffset+atom->size();
+			lastAtomUsesNoOps = sectionUsesNops;
+			lastAtomWasThumb = atom->isThumb();
+		}
+		catch (const char* msg) {
+			if ( atom->file() != NULL )
+				throwf("%s in '%s' from %s", msg, atom->name(), atom->file()->path());
+			else
+				throwf("%s in '%s'", msg, atom->name());
+		}
+	}
+}
+
+void OutputFile::buildAtomWriteRanges(ld::Internal& state, std::vector<AtomWriteRange>& ranges)
 {
-	// have each atom write itself
+	// Atoms write disjoint parts of the buffer, so split each section into ranges
+	// of atoms that can be written independently.  Each range records the padding
+	// state the serial walk would have when reaching its first atom, so nop fill
+	// between atoms comes out the same regardless of which thread writes it.
+	// A range is only ended where nothing written so far extends past the next atom.
+	const uint64_t kRangeMaxBytes = 256*1024;
+	const size_t   kRangeMaxAtoms = 4096;
 	uint64_t fileOffsetOfEndOfLastAtom = 0;
 	uint64_t mhAddress = 0;
 	bool lastAtomUsesNoOps = false;
@@ -2742,35 +2835,82 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 		if ( takesNoDiskSpace(sect) )
 			continue;
 		const bool sectionUsesNops = (sect->type() == ld::Section::typeCode);
-		//fprintf(stderr, "file offset=0x%08llX, section %s\n", sect->fileOffset, sect->sectionName());
 		std::vector<const ld::Atom*>& atoms = sect->atoms;
 		bool lastAtomWasThumb = false;
-		for (std::vector<const ld::Atom*>::iterator ait = atoms.begin(); ait != atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
+		AtomWriteRange range = { sect, mhAddress, 0, 0, fileOffsetOfEndOfLastAtom, lastAtomUsesNoOps, lastAtomWasThumb, 0, 0 };
+		uint64_t rangeBytes = 0;
+		size_t rangeAtoms = 0;
+		uint64_t maxEnd = fileOffsetOfEndOfLastAtom;
+		for (size_t i=0; i < atoms.size(); ++i) {
+			const ld::Atom* atom = atoms[i];
 			if ( atom->definition() == ld::Atom::definitionProxy )
 				continue;
-			try {
-				uint64_t fileOffset = atom->finalAddress() - sect->address + sect->fileOffset;
-				// check for alignment padding between atoms
-				if ( (fileOffset != fileOffsetOfEndOfLastAtom) && lastAtomUsesNoOps ) {
-					this->copyNoOps(&wholeBuffer[fileOffsetOfEndOfLastAtom], &wholeBuffer[fileOffset], lastAtomWasThumb);
-				}
-				// copy atom content
-				atom->copyRawContent(&wholeBuffer[fileOffset]);
-				// apply fix ups
-				this->applyFixUps(state, mhAddress, atom, &wholeBuffer[fileOffset]);
-				fileOffsetOfEndOfLastAtom = fileOffset+atom->size();
-				lastAtomUsesNoOps = sectionUsesNops;
-				lastAtomWasThumb = atom->isThumb();
-			}
-			catch (const char* msg) {
-				if ( atom->file() != NULL )
-					throwf("%s in '%s' from %s", msg, atom->name(), atom->file()->path());
-				else
-					throwf("%s in '%s'", msg, atom->name());
+			uint64_t fileOffset = atom->finalAddress() - sect->address + sect->fileOffset;
+			if ( ((rangeBytes >= kRangeMaxBytes) || (rangeAtoms >= kRangeMaxAtoms))
+					&& (fileOffset >= maxEnd) && (fileOffsetOfEndOfLastAtom >= maxEnd) ) {
+				range.end = i;
+				ranges.push_back(range);
+				AtomWriteRange next = { sect, mhAddress, i, 0, fileOffsetOfEndOfLastAtom, lastAtomUsesNoOps, lastAtomWasThumb, 0, 0 };
+				range = next;
+				rangeBytes = 0;
+				rangeAtoms = 0;
+			}
+			// track the extent of the file this range writes, including nop padding before the atom
+			uint64_t atomStart = fileOffset;
+			if ( lastAtomUsesNoOps && (fileOffsetOfEndOfLastAtom < fileOffset) )
+				atomStart = fileOffsetOfEndOfLastAtom;
+			fileOffsetOfEndOfLastAtom = fileOffset+atom->size();
+			if ( rangeAtoms == 0 ) {
+				range.fileStart = atomStart;
+				range.fileEnd = fileOffsetOfEndOfLastAtom;
 			}
+			else {
+				range.fileStart = std::min(range.fileStart, atomStart);
+				range.fileEnd = std::max(range.fileEnd, fileOffsetOfEndOfLastAtom);
+			}
+			if ( fileOffsetOfEndOfLastAtom > maxEnd )
+				maxEnd = fileOffsetOfEndOfLastAtom;
+			lastAtomUsesNoOps = sectionUsesNops;
+			lastAtomWasThumb = atom->isThumb();
+			rangeBytes += atom->size();
+			++rangeAtoms;
+		}
+		range.end = atoms.size();
+		ranges.push_back(range);
+	}
+}
+
+void OutputFile::writeAtomRanges(ld::Internal& state, uint8_t* buffer, uint64_t bufferFileOffset,
+								 const AtomWriteRange* ranges, size_t rangeCount)
+{
+	// verbose optimization hint logging is only readable in serial order
+	if ( _options.verboseOptimizationHints() || (rangeCount < 2) ) {
+		for (size_t i=0; i < rangeCount; ++i)
+			this->writeAtomRange(state, buffer, bufferFileOffset, ranges[i]);
+	}
+	else {
+		_writingAtomsInParallel = true;
+		try {
+			ld::parallel::forEach(rangeCount, [&](size_t index) {
+				this->writeAtomRange(state, buffer, bufferFileOffset, ranges[index]);
+			});
 		}
+		catch (const char*) {
+			_writingAtomsInParallel = false;
+			if ( _sectionLayoutWanted )
+				printSectionLayout(state);
+			throw;
+		}
+		_writingAtomsInParallel = false;
 	}
+}
+
+void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
+{
+	std::vector<AtomWriteRange> ranges;
+	buildAtomWriteRanges(state, ranges);
+	if ( !ranges.empty() )
+		writeAtomRanges(state, wholeBuffer, 0, &ranges[0], ranges.size());
 	
 	if ( _options.verboseOptimizationHints() ) {
 		//fprintf(stderr, "ADRP optimized away:   %d\n", sAdrpNA);
@@ -2779,79 +2919,259 @@ void OutputFile::writeAtoms(ld::Internal& state, uint8_t* wholeBuffer)
 	}
 }
 
+static const uint64_t kUUIDTreeHashChunkSize = 1024*1024;
+
+//
+// Hashes the file in fixed size chunks on worker threads, then hashes the list of
+// chunk digests.  Chunk boundaries are file offsets, so the result does not depend
+// on how many threads did the work.  excludeRegions must be sorted.
+//
+static void treeHashMD5(const uint8_t* buffer, uint64_t size, const char* prefix,
+						const std::vector<std::pair<uint64_t, uint64_t>>& excludeRegions, uint8_t digest[])
+{
+	const uint64_t kChunkSize = kUUIDTreeHashChunkSize;
+	const size_t chunkCount = (size + kChunkSize - 1) / kChunkSize;
+	std::vector<uint8_t> chunkDigests(chunkCount * CC_MD5_DIGEST_LENGTH);
+	ld::parallel::forEach(chunkCount, [&](size_t index) {
+		const uint64_t chunkStart = index * kChunkSize;
+		const uint64_t chunkEnd = std::min(chunkStart + kChunkSize, size);
+		CC_MD5_CTX md5state;
+		CC_MD5_Init(&md5state);
+		uint64_t checksumStart = chunkStart;
+		for (const auto& region : excludeRegions) {
+			if ( region.second <= checksumStart )
+				continue;
+			if ( region.first >= chunkEnd )
+				break;
+			if ( region.first > checksumStart )
+				CC_MD5_Update(&md5state, &buffer[checksumStart], region.first - checksumStart);
+			checksumStart = region.second;
+		}
+		if ( checksumStart < chunkEnd )
+			CC_MD5_Update(&md5state, &buffer[checksumStart], chunkEnd - checksumStart);
+		CC_MD5_Final(&chunkDigests[index * CC_MD5_DIGEST_LENGTH], &md5state);
+	});
+
+	CC_MD5_CTX md5state;
+	CC_MD5_Init(&md5state);
+	if ( prefix != NULL )
+		CC_MD5_Update(&md5state, prefix, strlen(prefix));
+	if ( chunkCount != 0 )
+		CC_MD5_Update(&md5state, &chunkDigests[0], chunkDigests.size());
+	CC_MD5_Final(digest, &md5state);
+}
+
+//
+// Produces the same digest as computeContentUUID() from file content handed over
+// in file order, a window at a time, so the whole file never has to be in memory.
+//
+class StreamingContentHash
+{
+public:
+					StreamingContentHash() : _treeHash(false), _prefix(NULL), _nextRegion(0), _offset(0) { }
+
+	void			init(bool treeHash, const char* prefix, const std::vector<std::pair<uint64_t, uint64_t>>& sortedExcludeRegions);
+	uint64_t		offset() const { return _offset; }
+	void			update(const uint8_t* bytes, uint64_t size);	// NULL bytes means zero fill
+	void			final(uint8_t digest[]);
+
+private:
+	void			hash(const uint8_t* bytes, uint64_t size);
+
+	bool										_treeHash;
+	const char*									_prefix;
+	std::vector<std::pair<uint64_t, uint64_t>>	_excludeRegions;
+	size_t										_nextRegion;
+	uint64_t									_offset;
+	CC_MD5_CTX									_md5state;		// whole file, or current chunk when tree hashing
+	std::vector<uint8_t>						_chunkDigests;
+};
+
+void StreamingContentHash::init(bool treeHash, const char* prefix, const std::vector<std::pair<uint64_t, uint64_t>>& sortedExcludeRegions)
+{
+	_treeHash = treeHash;
+	_prefix = prefix;
+	_excludeRegions = sortedExcludeRegions;
+	CC_MD5_Init(&_md5state);
+	if ( !_treeHash && (_prefix != NULL) )
+		CC_MD5_Update(&_md5state, _prefix, strlen(_prefix));
+}
+
+void StreamingContentHash::hash(const uint8_t* bytes, uint64_t size)
+{
+	if ( bytes != NULL ) {
+		CC_MD5_Update(&_md5state, bytes, size);
+		return;
+	}
+	static const uint8_t zeros[64*1024] = { 0 };
+	while ( size != 0 ) {
+		uint64_t len = std::min(size, (uint64_t)sizeof(zeros));
+		CC_MD5_Update(&_md5state, zeros, len);
+		size -= len;
+	}
+}
+
+void StreamingContentHash::update(const uint8_t* bytes, uint64_t size)
+{
+	while ( size != 0 ) {
+		while ( (_nextRegion < _excludeRegions.size()) && (_excludeRegions[_nextRegion].second <= _offset) )
+			++_nextRegion;
+		// hash up to the next exclude region or chunk boundary
+		uint64_t runEnd = _offset + size;
+		bool excluded = false;
+		if ( _nextRegion < _excludeRegions.size() ) {
+			const std::pair<uint64_t, uint64_t>& region = _excludeRegions[_nextRegion];
+			if ( region.first <= _offset ) {
+				excluded = true;
+				runEnd = std::min(runEnd, region.second);
+			}
+			else {
+				runEnd = std::min(runEnd, region.first);
+			}
+		}
+		if ( _treeHash )
+			runEnd = std::min(runEnd, (_offset / kUUIDTreeHashChunkSize + 1) * kUUIDTreeHashChunkSize);
+		const uint64_t runSize = runEnd - _offset;
+		if ( !excluded )
+			this->hash(bytes, runSize);
+		_offset = runEnd;
+		size -= runSize;
+		if ( bytes != NULL )
+			bytes += runSize;
+		if ( _treeHash && ((_offset % kUUIDTreeHashChunkSize) == 0) ) {
+			_chunkDigests.resize(_chunkDigests.size() + CC_MD5_DIGEST_LENGTH);
+			CC_MD5_Final(&_chunkDigests[_chunkDigests.size() - CC_MD5_DIGEST_LENGTH], &_md5state);
+			CC_MD5_Init(&_md5state);
+		}
+	}
+}
+
+void StreamingContentHash::final(uint8_t digest[])
+{
+	if ( !_treeHash ) {
+		CC_MD5_Final(digest, &_md5state);
+		return;
+	}
+	// finish partial last chunk
+	if ( (_offset % kUUIDTreeHashChunkSize) != 0 ) {
+		_chunkDigests.resize(_chunkDigests.size() + CC_MD5_DIGEST_LENGTH);
+		CC_MD5_Final(&_chunkDigests[_chunkDigests.size() - CC_MD5_DIGEST_LENGTH], &_md5state);
+	}
+	CC_MD5_CTX md5state;
+	CC_MD5_Init(&md5state);
+	if ( _prefix != NULL )
+		CC_MD5_Update(&md5state, _prefix, strlen(_prefix));
+	if ( !_chunkDigests.empty() )
+		CC_MD5_Update(&md5state, &_chunkDigests[0], _chunkDigests.size());
+	CC_MD5_Final(digest, &md5state);
+}
+
+bool OutputFile::contentUUIDWanted(ld::Internal& state)
+{
+	return ( (_options.outputKind() != Options::kObjectFile) || state.someObjectFileHasDwarf );
+}
+
+//
+// Returns the parts of the file that must not contribute to the content UUID, sorted,
+// and the string to hash ahead of the content (NULL if none).  Must be called after
+// the load commands have been written.
+//
+const char* OutputFile::contentUUIDExcludeRegions(ld::Internal& state, std::vector<std::pair<uint64_t, uint64_t>>& excludeRegions)
+{
+	const bool log = false;
+	uint64_t bitcodeCmdOffset;
+	uint64_t bitcodeCmdEnd;
+	uint64_t bitcodeSectOffset;
+	uint64_t bitcodePaddingEnd;
+	if ( _headersAndLoadCommandAtom->bitcodeBundleCommand(bitcodeCmdOffset, bitcodeCmdEnd,
+														  bitcodeSectOffset, bitcodePaddingEnd) ) {
+		// Exclude embedded bitcode bundle section which contains timestamps in XAR header
+		// Note the timestamp is in the compressed XML header which means it might change the size of
+		// bitcode section. The load command which include the size of the section and the padding after
+		// the bitcode section should also be excluded in the UUID computation.
+		// Bitcode section should appears before LINKEDIT
+		// Exclude section cmd
+		if ( log ) fprintf(stderr, "bundle cmd start=0x%08llX, bundle cmd end=0x%08llX\n",
+						   bitcodeCmdOffset, bitcodeCmdEnd);
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(bitcodeCmdOffset, bitcodeCmdEnd));
+		// Exclude section content
+		if ( log ) fprintf(stderr, "bundle start=0x%08llX, bundle end=0x%08llX\n",
+						   bitcodeSectOffset, bitcodePaddingEnd);
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(bitcodeSectOffset, bitcodePaddingEnd));
+	}
+	uint32_t	stabsStringsOffsetStart;
+	uint32_t	tabsStringsOffsetEnd;
+	uint32_t	stabsOffsetStart;
+	uint32_t	stabsOffsetEnd;
+	if ( _symbolTableAtom->hasStabs(stabsStringsOffsetStart, tabsStringsOffsetEnd, stabsOffsetStart, stabsOffsetEnd) ) {
+		// find two areas of file that are stabs info and should not contribute to checksum
+		uint64_t stringPoolFileOffset = 0;
+		uint64_t symbolTableFileOffset = 0;
+		for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
+			ld::Internal::FinalSection* sect = *sit;
+			if ( sect->type() == ld::Section::typeLinkEdit ) {
+				if ( strcmp(sect->sectionName(), "__string_pool") == 0 )
+					stringPoolFileOffset = sect->fileOffset;
+				else if ( strcmp(sect->sectionName(), "__symbol_table") == 0 )
+					symbolTableFileOffset = sect->fileOffset;
+			}
+		}
+		uint64_t firstStabNlistFileOffset  = symbolTableFileOffset + stabsOffsetStart;
+		uint64_t lastStabNlistFileOffset   = symbolTableFileOffset + stabsOffsetEnd;
+		uint64_t firstStabStringFileOffset = stringPoolFileOffset  + stabsStringsOffsetStart;
+		uint64_t lastStabStringFileOffset  = stringPoolFileOffset  + tabsStringsOffsetEnd;
+		if ( log ) fprintf(stderr, "stabNlist offset=0x%08llX, size=0x%08llX\n", firstStabNlistFileOffset, lastStabNlistFileOffset-firstStabNlistFileOffset);
+		if ( log ) fprintf(stderr, "stabString offset=0x%08llX, size=0x%08llX\n", firstStabStringFileOffset, lastStabStringFileOffset-firstStabStringFileOffset);
+		assert(firstStabNlistFileOffset <= firstStabStringFileOffset);
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(firstStabNlistFileOffset, lastStabNlistFileOffset));
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(firstStabStringFileOffset, lastStabStringFileOffset));
+		// exclude LINKEDIT LC_SEGMENT (size field depends on stabs size)
+		uint64_t linkeditSegCmdOffset;
+		uint64_t linkeditSegCmdSize;
+		_headersAndLoadCommandAtom->linkeditCmdInfo(linkeditSegCmdOffset, linkeditSegCmdSize);
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(linkeditSegCmdOffset, linkeditSegCmdOffset+linkeditSegCmdSize));
+		if ( log ) fprintf(stderr, "linkedit SegCmdOffset=0x%08llX, size=0x%08llX\n", linkeditSegCmdOffset, linkeditSegCmdSize);
+		uint64_t symbolTableCmdOffset;
+		uint64_t symbolTableCmdSize;
+		_headersAndLoadCommandAtom->symbolTableCmdInfo(symbolTableCmdOffset, symbolTableCmdSize);
+		excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(symbolTableCmdOffset, symbolTableCmdOffset+symbolTableCmdSize));
+		if ( log ) fprintf(stderr, "linkedit SegCmdOffset=0x%08llX, size=0x%08llX\n", symbolTableCmdOffset, symbolTableCmdSize);
+	}
+	std::sort(excludeRegions.begin(), excludeRegions.end());
+	if ( excludeRegions.empty() )
+		return NULL;
+	// rdar://problem/19487042 include the output leaf file name in the hash
+	return strrchr(_options.outputFilePath(), '/');
+}
+
+void OutputFile::setContentUUID(uint8_t digest[])
+{
+	// <rdar://problem/6723729> LC_UUID uuids should conform to RFC 4122 UUID version 4 & UUID version 5 formats
+	digest[6] = ( digest[6] & 0x0F ) | ( 3 << 4 );
+	digest[8] = ( digest[8] & 0x3F ) | 0x80;
+	// update buffer with new UUID
+	_headersAndLoadCommandAtom->setUUID(digest);
+	_headersAndLoadCommandAtom->recopyUUIDCommand();
+}
+
 void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
 {
 	const bool log = false;
-	if ( (_options.outputKind() != Options::kObjectFile) || state.someObjectFileHasDwarf ) {
+	if ( contentUUIDWanted(state) ) {
 		uint8_t digest[CC_MD5_DIGEST_LENGTH];
 		std::vector<std::pair<uint64_t, uint64_t>> excludeRegions;
-		uint64_t bitcodeCmdOffset;
-		uint64_t bitcodeCmdEnd;
-		uint64_t bitcodeSectOffset;
-		uint64_t bitcodePaddingEnd;
-		if ( _headersAndLoadCommandAtom->bitcodeBundleCommand(bitcodeCmdOffset, bitcodeCmdEnd,
-															  bitcodeSectOffset, bitcodePaddingEnd) ) {
-			// Exclude embedded bitcode bundle section which contains timestamps in XAR header
-			// Note the timestamp is in the compressed XML header which means it might change the size of
-			// bitcode section. The load command which include the size of the section and the padding after
-			// the bitcode section should also be excluded in the UUID computation.
-			// Bitcode section should appears before LINKEDIT
-			// Exclude section cmd
-			if ( log ) fprintf(stderr, "bundle cmd start=0x%08llX, bundle cmd end=0x%08llX\n",
-							   bitcodeCmdOffset, bitcodeCmdEnd);
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(bitcodeCmdOffset, bitcodeCmdEnd));
-			// Exclude section content
-			if ( log ) fprintf(stderr, "bundle start=0x%08llX, bundle end=0x%08llX\n",
-							   bitcodeSectOffset, bitcodePaddingEnd);
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(bitcodeSectOffset, bitcodePaddingEnd));
-		}
-		uint32_t	stabsStringsOffsetStart;
-		uint32_t	tabsStringsOffsetEnd;
-		uint32_t	stabsOffsetStart;
-		uint32_t	stabsOffsetEnd;
-		if ( _symbolTableAtom->hasStabs(stabsStringsOffsetStart, tabsStringsOffsetEnd, stabsOffsetStart, stabsOffsetEnd) ) {
-			// find two areas of file that are stabs info and should not contribute to checksum
-			uint64_t stringPoolFileOffset = 0;
-			uint64_t symbolTableFileOffset = 0;
-			for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
-				ld::Internal::FinalSection* sect = *sit;
-				if ( sect->type() == ld::Section::typeLinkEdit ) {
-					if ( strcmp(sect->sectionName(), "__string_pool") == 0 )
-						stringPoolFileOffset = sect->fileOffset;
-					else if ( strcmp(sect->sectionName(), "__symbol_table") == 0 )
-						symbolTableFileOffset = sect->fileOffset;
-				}
-			}
-			uint64_t firstStabNlistFileOffset  = symbolTableFileOffset + stabsOffsetStart;
-			uint64_t lastStabNlistFileOffset   = symbolTableFileOffset + stabsOffsetEnd;
-			uint64_t firstStabStringFileOffset = stringPoolFileOffset  + stabsStringsOffsetStart;
-			uint64_t lastStabStringFileOffset  = stringPoolFileOffset  + tabsStringsOffsetEnd;
-			if ( log ) fprintf(stderr, "stabNlist offset=0x%08llX, size=0x%08llX\n", firstStabNlistFileOffset, lastStabNlistFileOffset-firstStabNlistFileOffset);
-			if ( log ) fprintf(stderr, "stabString offset=0x%08llX, size=0x%08llX\n", firstStabStringFileOffset, lastStabStringFileOffset-firstStabStringFileOffset);
-			assert(firstStabNlistFileOffset <= firstStabStringFileOffset);
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(firstStabNlistFileOffset, lastStabNlistFileOffset));
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(firstStabStringFileOffset, lastStabStringFileOffset));
-			// exclude LINKEDIT LC_SEGMENT (size field depends on stabs size)
-			uint64_t linkeditSegCmdOffset;
-			uint64_t linkeditSegCmdSize;
-			_headersAndLoadCommandAtom->linkeditCmdInfo(linkeditSegCmdOffset, linkeditSegCmdSize);
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(linkeditSegCmdOffset, linkeditSegCmdOffset+linkeditSegCmdSize));
-			if ( log ) fprintf(stderr, "linkedit SegCmdOffset=0x%08llX, size=0x%08llX\n", linkeditSegCmdOffset, linkeditSegCmdSize);
-			uint64_t symbolTableCmdOffset;
-			uint64_t symbolTableCmdSize;
-			_headersAndLoadCommandAtom->symbolTableCmdInfo(symbolTableCmdOffset, symbolTableCmdSize);
-			excludeRegions.emplace_back(std::pair<uint64_t, uint64_t>(symbolTableCmdOffset, symbolTableCmdOffset+symbolTableCmdSize));
-			if ( log ) fprintf(stderr, "linkedit SegCmdOffset=0x%08llX, size=0x%08llX\n", symbolTableCmdOffset, symbolTableCmdSize);
+		const char* prefix = contentUUIDExcludeRegions(state, excludeRegions);
+		if ( _options.UUIDTreeHash() ) {
+			treeHashMD5(wholeBuffer, _fileSize, prefix, excludeRegions, digest);
+			if ( log ) fprintf(stderr, "tree uuid=%02X, %02X, %02X, %02X, %02X, %02X, %02X, %02X\n", digest[0], digest[1], digest[2],
+							   digest[3], digest[4], digest[5], digest[6],  digest[7]);
 		}
-		if ( !excludeRegions.empty() ) {
+		else if ( !excludeRegions.empty() ) {
 			CC_MD5_CTX md5state;
 			CC_MD5_Init(&md5state);
-			// rdar://problem/19487042 include the output leaf file name in the hash
-			const char* lastSlash = strrchr(_options.outputFilePath(), '/');
-			if ( lastSlash !=  NULL ) {
-				CC_MD5_Update(&md5state, lastSlash, strlen(lastSlash));
+			if ( prefix !=  NULL ) {
+				CC_MD5_Update(&md5state, prefix, strlen(prefix));
 			}
-			std::sort(excludeRegions.begin(), excludeRegions.end());
 			uint64_t checksumStart = 0;
 			for ( auto& region : excludeRegions ) {
 				uint64_t regionStart = region.first;
@@ -2870,12 +3190,167 @@ void OutputFile::computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer)
 		else {
 			CC_MD5(wholeBuffer, _fileSize, digest);
 		}
-		// <rdar://problem/6723729> LC_UUID uuids should conform to RFC 4122 UUID version 4 & UUID version 5 formats
-		digest[6] = ( digest[6] & 0x0F ) | ( 3 << 4 );
-		digest[8] = ( digest[8] & 0x3F ) | 0x80;
-		// update buffer with new UUID
-		_headersAndLoadCommandAtom->setUUID(digest);
-		_headersAndLoadCommandAtom->recopyUUIDCommand();
+		setContentUUID(digest);
+	}
+}
+
+//
+// Groups atom ranges into windows of the output file that are built in memory and
+// written out one at a time.  Windows never overlap, so each one can be written with
+// a single pwrite().  The mach header gets a window of its own, because the LC_UUID
+// in it is rewritten once the content hash of the whole file is known.  Returns false
+// if the layout is not suitable for streaming.
+//
+bool OutputFile::buildOutputWindows(const std::vector<AtomWriteRange>& ranges, std::vector<OutputWindow>& windows)
+{
+	const uint64_t kWindowMaxBytes = 32*1024*1024;
+	if ( ranges.empty() || (ranges[0].sect->type() != ld::Section::typeMachHeader) )
+		return false;
+	OutputWindow window = { 0, 0, 0, 0 };
+	for (size_t i=0; i < ranges.size(); ++i) {
+		const AtomWriteRange& range = ranges[i];
+		if ( range.fileStart == range.fileEnd ) {
+			// range writes nothing, it can go in any window
+			++window.rangeCount;
+			continue;
+		}
+		const bool headerDone = (window.firstRange == 0) && (range.sect->type() != ld::Section::typeMachHeader);
+		if ( (range.fileStart >= window.fileEnd) && (headerDone || (window.fileEnd - window.fileStart >= kWindowMaxBytes)) ) {
+			windows.push_back(window);
+			OutputWindow next = { range.fileStart, range.fileEnd, i, 0 };
+			window = next;
+		}
+		if ( range.fileStart < window.fileStart )
+			return false;
+		if ( range.fileEnd > window.fileEnd )
+			window.fileEnd = range.fileEnd;
+		++window.rangeCount;
+	}
+	windows.push_back(window);
+	return true;
+}
+
+static int pwriteAll(int fd, const uint8_t* buffer, uint64_t size, uint64_t fileOffset)
+{
+	while ( size != 0 ) {
+		ssize_t amount = ::pwrite(fd, buffer, size, fileOffset);
+		if ( amount == -1 ) {
+			if ( errno == EINTR )
+				continue;
+			return errno;
+		}
+		buffer += amount;
+		size -= amount;
+		fileOffset += amount;
+	}
+	return 0;
+}
+
+struct WindowFlush
+{
+	int						fd;
+	const uint8_t*			buffer;
+	uint64_t				fileOffset;
+	uint64_t				size;
+	StreamingContentHash*	hash;
+	int						error;
+};
+
+static void* flushWindow(void* arg)
+{
+	WindowFlush* flush = (WindowFlush*)arg;
+	if ( flush->hash != NULL ) {
+		// bytes between windows are zero fill from ftruncate(), but still part of the content hash
+		flush->hash->update(NULL, flush->fileOffset - flush->hash->offset());
+		flush->hash->update(flush->buffer, flush->size);
+	}
+	flush->error = pwriteAll(flush->fd, flush->buffer, flush->size, flush->fileOffset);
+	return NULL;
+}
+
+//
+// Builds the output file one window at a time instead of in one buffer the size of
+// the file.  While the atoms of one window are being written, the previous window is
+// hashed (for the content UUID) and written to the file on a second thread.
+//
+void OutputFile::writeOutputFileStreaming(ld::Internal& state, int fd, const std::vector<AtomWriteRange>& ranges,
+										  const std::vector<OutputWindow>& windows)
+{
+	const bool hashContent = (_options.UUIDMode() == Options::kUUIDContent) && contentUUIDWanted(state);
+	StreamingContentHash hash;
+	uint8_t* headerBuffer = NULL;
+	WindowFlush flush;
+	pthread_t flushThread;
+	bool flushPending = false;
+	uint8_t* flushBuffer = NULL;
+	try {
+		for (std::vector<OutputWindow>::const_iterator it = windows.begin(); it != windows.end(); ++it) {
+			const uint64_t windowSize = it->fileEnd - it->fileStart;
+			uint8_t* buffer = (uint8_t*)calloc(windowSize, 1);
+			if ( buffer == NULL )
+				throwf("can't create buffer of %llu bytes for output", windowSize);
+			writeAtomRanges(state, buffer, it->fileStart, &ranges[it->firstRange], it->rangeCount);
+			if ( it == windows.begin() && hashContent ) {
+				// the load commands are written now, so the exclude regions are known
+				std::vector<std::pair<uint64_t, uint64_t>> excludeRegions;
+				const char* prefix = contentUUIDExcludeRegions(state, excludeRegions);
+				hash.init(_options.UUIDTreeHash(), prefix, excludeRegions);
+				headerBuffer = buffer;
+			}
+			// wait for previous window to be on disk
+			if ( flushPending ) {
+				pthread_join(flushThread, NULL);
+				flushPending = false;
+				if ( flushBuffer != headerBuffer )
+					free(flushBuffer);
+				if ( flush.error != 0 )
+					throwf("can't write to output file: %s, errno=%d", _options.outputFilePath(), flush.error);
+			}
+			flush.fd = fd;
+			flush.buffer = buffer;
+			flush.fileOffset = it->fileStart;
+			flush.size = windowSize;
+			flush.hash = (hashContent ? &hash : NULL);
+			flush.error = 0;
+			flushBuffer = buffer;
+			if ( pthread_create(&flushThread, NULL, &flushWindow, &flush) == 0 ) {
+				flushPending = true;
+			}
+			else {
+				flushWindow(&flush);
+				if ( flushBuffer != headerBuffer )
+					free(flushBuffer);
+				if ( flush.error != 0 )
+					throwf("can't write to output file: %s, errno=%d", _options.outputFilePath(), flush.error);
+			}
+		}
+		if ( flushPending ) {
+			pthread_join(flushThread, NULL);
+			flushPending = false;
+			if ( flushBuffer != headerBuffer )
+				free(flushBuffer);
+			if ( flush.error != 0 )
+				throwf("can't write to output file: %s, errno=%d", _options.outputFilePath(), flush.error);
+		}
+	}
+	catch (const char*) {
+		if ( flushPending )
+			pthread_join(flushThread, NULL);
+		throw;
+	}
+
+	if ( hashContent ) {
+		// zero fill at end of file
+		hash.update(NULL, _fileSize - hash.offset());
+		uint8_t digest[CC_MD5_DIGEST_LENGTH];
+		hash.final(digest);
+		// rewrites LC_UUID in the header window, which was kept for this
+		setContentUUID(digest);
+		const OutputWindow& headerWindow = windows.front();
+		int err = pwriteAll(fd, headerBuffer, headerWindow.fileEnd - headerWindow.fileStart, headerWindow.fileStart);
+		free(headerBuffer);
+		if ( err != 0 )
+			throwf("can't write to output file: %s, errno=%d", _options.outputFilePath(), err);
 	}
 }
 
@@ -2949,12 +3424,21 @@ void OutputFile::writeOutputFile(ld::Internal& state)
 	
 	//fprintf(stderr, "outputIsMappableFile=%d, outputIsRegularFile=%d, path=%s\n", outputIsMappableFile, outputIsRegularFile, _options.outputFilePath());
 	
+	// instead of building the whole file in one malloced buffer, build it a window at a time
+	bool outputIsStreamed = false;
+	std::vector<AtomWriteRange> ranges;
+	std::vector<OutputWindow> windows;
+	if ( _options.streamOutput() && outputIsRegularFile && !outputIsMappableFile ) {
+		buildAtomWriteRanges(state, ranges);
+		outputIsStreamed = buildOutputWindows(ranges, windows);
+	}
+
 	int fd;
 	// Construct a temporary path of the form {outputFilePath}.ld_XXXXXX
 	const char filenameTemplate[] = ".ld_XXXXXX";
 	char tmpOutput[PATH_MAX];
-	uint8_t *wholeBuffer;
-	if ( outputIsRegularFile && outputIsMappableFile ) {
+	uint8_t *wholeBuffer = NULL;
+	if ( outputIsRegularFile && (outputIsMappableFile || outputIsStreamed) ) {
 		// <rdar://problem/20959031> ld64 should clean up temporary files on SIGINT
 		::signal(SIGINT, removePathAndExit);
 
@@ -2980,9 +3464,11 @@ void OutputFile::writeOutputFile(ld::Internal& state)
 				throwf("can't grow file for writing '%s', errno=%d", _options.outputFilePath(), err);
 		}
 		
-		wholeBuffer = (uint8_t *)mmap(NULL, _fileSize, PROT_WRITE|PROT_READ, MAP_SHARED, fd, 0);
-		if ( wholeBuffer == MAP_FAILED )
-			throwf("can't create buffer of %llu bytes for output", _fileSize);
+		if ( outputIsMappableFile ) {
+			wholeBuffer = (uint8_t *)mmap(NULL, _fileSize, PROT_WRITE|PROT_READ, MAP_SHARED, fd, 0);
+			if ( wholeBuffer == MAP_FAILED )
+				throwf("can't create buffer of %llu bytes for output", _fileSize);
+		}
 	} 
 	else {
 		if ( outputIsRegularFile )
@@ -3003,13 +3489,34 @@ void OutputFile::writeOutputFile(ld::Internal& state)
 		_headersAndLoadCommandAtom->setUUID(bits);
 	}
 
-	writeAtoms(state, wholeBuffer);
+	if ( outputIsStreamed ) {
+		try {
+			ld::timing::Scope timer("writeOutputFileStreaming");
+			writeOutputFileStreaming(state, fd, ranges, windows);
+		}
+		catch (const char*) {
+			unlink(tmpOutput);
+			throw;
+		}
+		// <rdar://problem/13118223> NFS: iOS incremental builds in Xcode 4.6 fail with codesign error
+		::ftruncate(fd, _fileSize);
+		sDescriptorOfPathToRemove = -1;
+		::close(fd);
+	}
+	else {
+		{
+			ld::timing::Scope timer("writeAtoms");
+			writeAtoms(state, wholeBuffer);
+		}
 	
-	// compute UUID 
-	if ( _options.UUIDMode() == Options::kUUIDContent )
-		computeContentUUID(state, wholeBuffer);
+		// compute UUID 
+		if ( _options.UUIDMode() == Options::kUUIDContent ) {
+			ld::timing::Scope timer("computeContentUUID");
+			computeContentUUID(state, wholeBuffer);
+		}
+	}
 
-	if ( outputIsRegularFile && outputIsMappableFile ) {
+	if ( outputIsRegularFile && (outputIsMappableFile || outputIsStreamed) ) {
 		if ( ::chmod(tmpOutput, permissions) == -1 ) {
 			unlink(tmpOutput);
 			throwf("can't set permissions on output file: %s, errno=%d", tmpOutput, errno);
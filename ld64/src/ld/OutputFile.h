@@ -150,7 +150,35 @@ public:
 	static void					dumpAtomsBySection(ld::Internal& state, bool);
 
 private:
+	struct AtomWriteRange {
+		ld::Internal::FinalSection*	sect;
+		uint64_t					mhAddress;
+		size_t						begin;
+		size_t						end;
+		uint64_t					fileOffsetOfEndOfLastAtom;
+		bool						lastAtomUsesNoOps;
+		bool						lastAtomWasThumb;
+		uint64_t					fileStart;		// first byte written, including leading nop padding
+		uint64_t					fileEnd;
+	};
+	struct OutputWindow {
+		uint64_t					fileStart;
+		uint64_t					fileEnd;
+		size_t						firstRange;
+		size_t						rangeCount;
+	};
+
 	void						writeAtoms(ld::Internal& state, uint8_t* wholeBuffer);
+	void						buildAtomWriteRanges(ld::Internal& state, std::vector<AtomWriteRange>& ranges);
+	bool						buildOutputWindows(const std::vector<AtomWriteRange>& ranges, std::vector<OutputWindow>& windows);
+	void						writeAtomRanges(ld::Internal& state, uint8_t* buffer, uint64_t bufferFileOffset,
+												const AtomWriteRange* ranges, size_t rangeCount);
+	void						writeAtomRange(ld::Internal& state, uint8_t* buffer, uint64_t bufferFileOffset, const AtomWriteRange& range);
+	void						writeOutputFileStreaming(ld::Internal& state, int fd, const std::vector<AtomWriteRange>& ranges,
+												const std::vector<OutputWindow>& windows);
+	bool						contentUUIDWanted(ld::Internal& state);
+	const char*					contentUUIDExcludeRegions(ld::Internal& state, std::vector<std::pair<uint64_t, uint64_t>>& excludeRegions);
+	void						setContentUUID(uint8_t digest[]);
 	void						computeContentUUID(ld::Internal& state, uint8_t* wholeBuffer);
 	void						buildDylibOrdinalMapping(ld::Internal&);
 	bool						hasOrdinalForInstallPath(const char* path, int* ordinal);
@@ -297,6 +325,8 @@ private:
 	std::map<uint64_t, uint32_t>			_lazyPointerAddressToInfoOffset;
 	uint32_t								_encryptedTEXTstartOffset;
 	uint32_t								_encryptedTEXTendOffset;
+	volatile bool							_writingAtomsInParallel;
+	volatile bool							_sectionLayoutWanted;
 public:
 	std::vector<const ld::Atom*>			_localAtoms;
 	std::vector<const ld::Atom*>			_exportedAtoms;
@@ -0,0 +1,168 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <pthread.h>
+
+#include <vector>
+
+namespace ld {
+namespace parallel {
+
+//
+// Number of threads (including the calling thread) that forEach() may use.
+// Defaults to the number of cpus.  A count of 1 makes every parallel phase
+// run serially on the calling thread.
+//
+inline unsigned int& workerCountStorage()
+{
+	static unsigned int sWorkerCount = 0;
+	return sWorkerCount;
+}
+
+inline unsigned int workerCount()
+{
+	unsigned int& count = workerCountStorage();
+	if ( count == 0 ) {
+		unsigned int ncpus;
+		int mib[2];
+		size_t len = sizeof(ncpus);
+		mib[0] = CTL_HW;
+		mib[1] = HW_NCPU;
+		if ( (sysctl(mib, 2, &ncpus, &len, NULL, 0) != 0) || (ncpus == 0) )
+			ncpus = 1;
+		count = ncpus;
+	}
+	return count;
+}
+
+inline void setWorkerCount(unsigned int count)
+{
+	workerCountStorage() = count;
+}
+
+
+//
+// Calls body(i) for every i in [0, count), spreading the calls over up to
+// workerCount() threads.  The calling thread takes part and forEach() only
+// returns once every call has finished.
+//
+// Errors are reported the same way the serial code does: by throwing a
+// const char*.  If several calls throw, the message from the lowest index is
+// rethrown, so diagnostics do not depend on thread scheduling.  Once a call
+// has failed, calls with a higher index are skipped.
+//
+template <typename B>
+class ForEach
+{
+public:
+						ForEach(const B& body, size_t count)
+							: _body(body), _count(count), _next(0), _failedIndex(count), _failure(NULL) {
+								pthread_mutex_init(&_lock, NULL);
+							}
+						~ForEach() { pthread_mutex_destroy(&_lock); }
+
+	void				run();
+
+private:
+	static void*		worker(void* job) { ((ForEach<B>*)job)->work(); return NULL; }
+	void				work();
+
+	const B&			_body;
+	const size_t		_count;
+	volatile size_t		_next;
+	pthread_mutex_t		_lock;
+	volatile size_t		_failedIndex;
+	const char*			_failure;
+};
+
+template <typename B>
+void ForEach<B>::work()
+{
+	for (;;) {
+		size_t index = __sync_fetch_and_add(&_next, 1);
+		if ( index >= _count )
+			break;
+		if ( index > _failedIndex )
+			continue;
+		try {
+			_body(index);
+		}
+		catch (const char* msg) {
+			pthread_mutex_lock(&_lock);
+			if ( index < _failedIndex ) {
+				_failedIndex = index;
+				_failure = msg;
+			}
+			pthread_mutex_unlock(&_lock);
+		}
+	}
+}
+
+template <typename B>
+void ForEach<B>::run()
+{
+	unsigned int threadCount = workerCount();
+	if ( threadCount > _count )
+		threadCount = (unsigned int)_count;
+	std::vector<pthread_t> threads;
+	for (unsigned int i=1; i < threadCount; ++i) {
+		pthread_t thread;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		// same stack size as the main thread, some code uses large stack buffers
+		pthread_attr_setstacksize(&attr, 8 * 1024 * 1024);
+		if ( pthread_create(&thread, &attr, &ForEach<B>::worker, this) == 0 )
+			threads.push_back(thread);
+		pthread_attr_destroy(&attr);
+	}
+	this->work();
+	for (std::vector<pthread_t>::iterator it=threads.begin(); it != threads.end(); ++it)
+		pthread_join(*it, NULL);
+	if ( _failure != NULL )
+		throw _failure;
+}
+
+template <typename B>
+inline void forEach(size_t count, const B& body)
+{
+	if ( (count <= 1) || (workerCount() <= 1) ) {
+		for (size_t i=0; i < count; ++i)
+			body(i);
+		return;
+	}
+	ForEach<B> job(body, count);
+	job.run();
+}
+
+
+} // namespace parallel
+} // namespace ld
+
+#endif // __PARALLEL_HPP__
@@ -57,6 +57,7 @@
 #include "InputFiles.h"
 #include "SymbolTable.h"
 #include "Resolver.h"
+#include "Parallel.hpp"
 
 #ifdef LTO_SUPPORT
 #include "parsers/lto_file.h"
@@ -928,12 +929,20 @@ void Resolver::addInitialUndefines()
 
 void Resolver::resolveUndefines()
 {
-	// keep looping until no more undefines were added in last loop
-	unsigned int undefineGenCount = 0xFFFFFFFF;
-	while ( undefineGenCount != _symbolTable.updateCount() ) {
-		undefineGenCount = _symbolTable.updateCount();
+	// Each round searches for the names that became undefined since the last
+	// round, in the order they were first referenced, so a name no library
+	// defines is not searched for over and over.  Only if loading something
+	// added libraries to search (auto-linking) are all remaining names
+	// searched for again.
+	size_t worklistPosition = 0;
+	uint64_t libraryGeneration = _inputFiles.searchLibrariesGeneration();
+	for (;;) {
 		std::vector<const char*> undefineNames;
-		_symbolTable.undefines(undefineNames);
+		worklistPosition = _symbolTable.undefinesAfter(worklistPosition, undefineNames);
+		++_undefinesRounds;
+		_undefinesVisited += undefineNames.size();
+		// parse the archive members these names will pull in on all cpus, then load them one by one
+		_inputFiles.parseAheadArchiveMembers(undefineNames);
 		for(std::vector<const char*>::iterator it = undefineNames.begin(); it != undefineNames.end(); ++it) {
 			const char* undef = *it;
 			// load for previous undefine may also have loaded this undefine, so check again
@@ -975,7 +984,16 @@ void Resolver::resolveUndefines()
 				}
 			}
 		}
+		// names referenced by what was just loaded come next
+		if ( !undefineNames.empty() )
+			continue;
+		if ( libraryGeneration != _inputFiles.searchLibrariesGeneration() ) {
+			libraryGeneration = _inputFiles.searchLibrariesGeneration();
+			worklistPosition = 0;
+			continue;
+		}
 		// <rdar://problem/5894163> need to search archives for overrides of common symbols 
+		unsigned int undefineGenCount = _symbolTable.updateCount();
 		if ( _symbolTable.hasExternalTentativeDefinitions() ) {
 			bool searchDylibs = (_options.commonsMode() == Options::kCommonsOverriddenByDylibs);
 			std::vector<const char*> tents;
@@ -989,6 +1007,9 @@ void Resolver::resolveUndefines()
 				}
 			}
 		}
+		// done unless overriding tentative definitions added more undefines
+		if ( (undefineGenCount == _symbolTable.updateCount()) && (libraryGeneration == _inputFiles.searchLibrariesGeneration()) )
+			break;
 	}
 	
 	// Use linker options to resolve any remaining undefined symbols
@@ -1040,6 +1061,112 @@ void Resolver::resolveUndefines()
 }
 
 
+// fixups of these kinds make their target live when the atom with the fixup is live
+static bool fixupKeepsTargetLive(ld::Fixup::Kind kind)
+{
+	switch ( kind ) {
+		case ld::Fixup::kindNone:
+		case ld::Fixup::kindNoneFollowOn:
+		case ld::Fixup::kindNoneGroupSubordinate:
+		case ld::Fixup::kindNoneGroupSubordinateFDE:
+		case ld::Fixup::kindNoneGroupSubordinateLSDA:
+		case ld::Fixup::kindNoneGroupSubordinatePersonality:
+		case ld::Fixup::kindSetTargetAddress:
+		case ld::Fixup::kindSubtractTargetAddress:
+		case ld::Fixup::kindStoreTargetAddressLittleEndian32:
+		case ld::Fixup::kindStoreTargetAddressLittleEndian64:
+		case ld::Fixup::kindStoreTargetAddressBigEndian32:
+		case ld::Fixup::kindStoreTargetAddressBigEndian64:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32:
+		case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
+		case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoadNowLEA:
+		case ld::Fixup::kindStoreTargetAddressARMBranch24:
+		case ld::Fixup::kindStoreTargetAddressThumbBranch22:
+#if SUPPORT_ARCH_arm64
+		case ld::Fixup::kindStoreTargetAddressARM64Branch26:
+		case ld::Fixup::kindStoreTargetAddressARM64Page21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
+		case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadNowLeaPage21:
+#endif
+		case ld::Fixup::kindStoreTargetAddressPPCBranch24:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Returns the atom the fixup keeps live, or NULL if there is none (yet).  Binds
+// the fixup and loads from libraries as needed, so it must not run concurrently
+// with anything else using the symbol table.
+const ld::Atom* Resolver::liveTarget(const ld::Atom& atom, ld::Fixup* fit)
+{
+	const ld::Atom* target = NULL;
+	if ( fit->binding == ld::Fixup::bindingByContentBound ) {
+		// normally this was done in convertReferencesToIndirect()
+		// but a archive loaded .o file may have a forward reference
+		SymbolTable::IndirectBindingSlot slot;
+		const ld::Atom* dummy;
+		switch ( fit->u.target->combine() ) {
+			case ld::Atom::combineNever:
+			case ld::Atom::combineByName:
+				assert(0 && "wrong combine type for bind by content");
+				break;
+			case ld::Atom::combineByNameAndContent:
+				slot = _symbolTable.findSlotForContent(fit->u.target, &dummy);
+				fit->binding = ld::Fixup::bindingsIndirectlyBound;
+				fit->u.bindingIndex = slot;
+				break;
+			case ld::Atom::combineByNameAndReferences:
+				slot = _symbolTable.findSlotForReferences(fit->u.target, &dummy);
+				fit->binding = ld::Fixup::bindingsIndirectlyBound;
+				fit->u.bindingIndex = slot;
+				break;
+		}
+	}
+	switch ( fit->binding ) {
+		case ld::Fixup::bindingDirectlyBound:
+			target = fit->u.target;
+			break;
+		case ld::Fixup::bindingByNameUnbound:
+			// doAtom() did not convert to indirect in dead-strip mode, so that now
+			fit->u.bindingIndex = _symbolTable.findSlotForName(fit->u.name);
+			fit->binding = ld::Fixup::bindingsIndirectlyBound;
+			// fall into next case
+		case ld::Fixup::bindingsIndirectlyBound:
+			target = _internal.indirectBindingTable[fit->u.bindingIndex];
+			if ( target == NULL ) {
+				const char* targetName = _symbolTable.indirectName(fit->u.bindingIndex);
+				_inputFiles.searchLibraries(targetName, true, true, false, *this);
+				target = _internal.indirectBindingTable[fit->u.bindingIndex];
+			}
+			if ( target != NULL ) {
+				if ( target->definition() == ld::Atom::definitionTentative ) {
+					// <rdar://problem/5894163> need to search archives for overrides of common symbols 
+					bool searchDylibs = (_options.commonsMode() == Options::kCommonsOverriddenByDylibs);
+					_inputFiles.searchLibraries(target->name(), searchDylibs, true, true, *this);
+					// recompute target since it may have been overridden by searchLibraries()
+					target = _internal.indirectBindingTable[fit->u.bindingIndex];
+				}
+			}
+			else {
+				_atomsWithUnresolvedReferences.push_back(&atom);
+			}
+			break;
+		default:
+			assert(0 && "bad binding during dead stripping");
+	}
+	return target;
+}
+
+// Recursive marking, which is only used for -why_live because it has the
+// chain of references that made each atom live at hand.
 void Resolver::markLive(const ld::Atom& atom, WhyLiveBackChain* previous)
 {
 	//fprintf(stderr, "markLive(%p) %s\n", &atom, atom.name());
@@ -1066,100 +1193,106 @@ void Resolver::markLive(const ld::Atom& atom, WhyLiveBackChain* previous)
 	thisChain.previous = previous;
 	thisChain.referer = &atom;
 	for (ld::Fixup::iterator fit = atom.fixupsBegin(), end=atom.fixupsEnd(); fit != end; ++fit) {
-		const ld::Atom* target;
-		switch ( fit->kind ) {
-			case ld::Fixup::kindNone:
-			case ld::Fixup::kindNoneFollowOn:
-			case ld::Fixup::kindNoneGroupSubordinate:
-			case ld::Fixup::kindNoneGroupSubordinateFDE:
-			case ld::Fixup::kindNoneGroupSubordinateLSDA:
-			case ld::Fixup::kindNoneGroupSubordinatePersonality:
-			case ld::Fixup::kindSetTargetAddress:
-			case ld::Fixup::kindSubtractTargetAddress:
-			case ld::Fixup::kindStoreTargetAddressLittleEndian32:
-			case ld::Fixup::kindStoreTargetAddressLittleEndian64:
-			case ld::Fixup::kindStoreTargetAddressBigEndian32:
-			case ld::Fixup::kindStoreTargetAddressBigEndian64:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32:
-			case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoad:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32GOTLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoad:
-			case ld::Fixup::kindStoreTargetAddressX86PCRel32TLVLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoad:
-			case ld::Fixup::kindStoreTargetAddressX86Abs32TLVLoadNowLEA:
-			case ld::Fixup::kindStoreTargetAddressARMBranch24:
-			case ld::Fixup::kindStoreTargetAddressThumbBranch22:
-#if SUPPORT_ARCH_arm64
-			case ld::Fixup::kindStoreTargetAddressARM64Branch26:
-			case ld::Fixup::kindStoreTargetAddressARM64Page21:
-			case ld::Fixup::kindStoreTargetAddressARM64GOTLoadPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64GOTLeaPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadPage21:
-			case ld::Fixup::kindStoreTargetAddressARM64TLVPLoadNowLeaPage21:
-#endif
-			case ld::Fixup::kindStoreTargetAddressPPCBranch24:
-				if ( fit->binding == ld::Fixup::bindingByContentBound ) {
-					// normally this was done in convertReferencesToIndirect()
-					// but a archive loaded .o file may have a forward reference
-					SymbolTable::IndirectBindingSlot slot;
-					const ld::Atom* dummy;
-					switch ( fit->u.target->combine() ) {
-						case ld::Atom::combineNever:
-						case ld::Atom::combineByName:
-							assert(0 && "wrong combine type for bind by content");
+		if ( fixupKeepsTargetLive(fit->kind) ) {
+			const ld::Atom* target = this->liveTarget(atom, fit);
+			if ( target != NULL )
+				this->markLive(*target, &thisChain);
+		}
+	}
+}
+
+
+// A fixup the parallel marker could not follow without the symbol table
+struct DeferredLiveFixup {
+	const ld::Atom*		atom;
+	ld::Fixup*			fixup;
+	const char*			name;		// what is looked up, to process these in a stable order
+};
+
+struct DeferredLiveFixupSorter {
+	bool operator()(const DeferredLiveFixup& left, const DeferredLiveFixup& right) const {
+		return (strcmp(left.name, right.name) < 0);
+	}
+};
+
+//
+// Marks the roots and everything reachable from them live, one breadth first
+// wave at a time.  Each wave follows the fixups of the atoms made live by the
+// previous wave on all worker threads, claiming atoms with the atomic
+// trySetLive().  Fixups that need the symbol table (not yet bound, bound to an
+// undefined or tentative symbol) are set aside and followed serially after the
+// wave, sorted by name so library loads do not depend on thread timing.
+//
+void Resolver::markLiveFrom(const std::vector<const ld::Atom*>& roots)
+{
+	enum { kAtomsPerChunk = 256 };
+	struct Chunk {
+		std::vector<const ld::Atom*>	newlyLive;
+		std::vector<DeferredLiveFixup>	deferred;
+	};
+
+	std::vector<const ld::Atom*> wave;
+	for (std::vector<const ld::Atom*>::const_iterator it=roots.begin(); it != roots.end(); ++it) {
+		if ( (const_cast<ld::Atom*>(*it))->trySetLive() )
+			wave.push_back(*it);
+	}
+	const std::vector<const ld::Atom*>& indirectBindingTable = _internal.indirectBindingTable;
+	while ( !wave.empty() ) {
+		std::vector<Chunk> chunks((wave.size() + kAtomsPerChunk - 1) / kAtomsPerChunk);
+		ld::parallel::forEach(chunks.size(), [&](size_t chunkIndex) {
+			Chunk& chunk = chunks[chunkIndex];
+			const size_t end = std::min(wave.size(), (chunkIndex + 1) * kAtomsPerChunk);
+			for (size_t i = chunkIndex * kAtomsPerChunk; i < end; ++i) {
+				const ld::Atom* atom = wave[i];
+				for (ld::Fixup::iterator fit = atom->fixupsBegin(), fend=atom->fixupsEnd(); fit != fend; ++fit) {
+					if ( !fixupKeepsTargetLive(fit->kind) )
+						continue;
+					const ld::Atom* target = NULL;
+					const char* name = NULL;
+					switch ( fit->binding ) {
+						case ld::Fixup::bindingDirectlyBound:
+							target = fit->u.target;
 							break;
-						case ld::Atom::combineByNameAndContent:
-							slot = _symbolTable.findSlotForContent(fit->u.target, &dummy);
-							fit->binding = ld::Fixup::bindingsIndirectlyBound;
-							fit->u.bindingIndex = slot;
+						case ld::Fixup::bindingsIndirectlyBound:
+							target = indirectBindingTable[fit->u.bindingIndex];
+							if ( (target == NULL) || (target->definition() == ld::Atom::definitionTentative) ) {
+								name = _symbolTable.indirectName(fit->u.bindingIndex);
+								target = NULL;
+							}
 							break;
-						case ld::Atom::combineByNameAndReferences:
-							slot = _symbolTable.findSlotForReferences(fit->u.target, &dummy);
-							fit->binding = ld::Fixup::bindingsIndirectlyBound;
-							fit->u.bindingIndex = slot;
+						case ld::Fixup::bindingByNameUnbound:
+							name = fit->u.name;
 							break;
+						case ld::Fixup::bindingByContentBound:
+							name = fit->u.target->name();
+							break;
+						default:
+							assert(0 && "bad binding during dead stripping");
+					}
+					if ( name != NULL ) {
+						DeferredLiveFixup deferred = { atom, fit, name };
+						chunk.deferred.push_back(deferred);
+					}
+					else if ( (target != NULL) && (const_cast<ld::Atom*>(target))->trySetLive() ) {
+						chunk.newlyLive.push_back(target);
 					}
 				}
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingDirectlyBound:
-						markLive(*(fit->u.target), &thisChain);
-						break;
-					case ld::Fixup::bindingByNameUnbound:
-						// doAtom() did not convert to indirect in dead-strip mode, so that now
-						fit->u.bindingIndex = _symbolTable.findSlotForName(fit->u.name);
-						fit->binding = ld::Fixup::bindingsIndirectlyBound;
-						// fall into next case
-					case ld::Fixup::bindingsIndirectlyBound:
-						target = _internal.indirectBindingTable[fit->u.bindingIndex];
-						if ( target == NULL ) {
-							const char* targetName = _symbolTable.indirectName(fit->u.bindingIndex);
-							_inputFiles.searchLibraries(targetName, true, true, false, *this);
-							target = _internal.indirectBindingTable[fit->u.bindingIndex];
-						}
-						if ( target != NULL ) {
-							if ( target->definition() == ld::Atom::definitionTentative ) {
-								// <rdar://problem/5894163> need to search archives for overrides of common symbols 
-								bool searchDylibs = (_options.commonsMode() == Options::kCommonsOverriddenByDylibs);
-								_inputFiles.searchLibraries(target->name(), searchDylibs, true, true, *this);
-								// recompute target since it may have been overridden by searchLibraries()
-								target = _internal.indirectBindingTable[fit->u.bindingIndex];
-							}
-							this->markLive(*target, &thisChain);
-						}
-						else {
-							_atomsWithUnresolvedReferences.push_back(&atom);
-						}
-						break;
-					default:
-						assert(0 && "bad binding during dead stripping");
-				}
-				break;
-            default:
-                break;    
+			}
+		});
+
+		wave.clear();
+		std::vector<DeferredLiveFixup> deferred;
+		for (std::vector<Chunk>::iterator it=chunks.begin(); it != chunks.end(); ++it) {
+			wave.insert(wave.end(), it->newlyLive.begin(), it->newlyLive.end());
+			deferred.insert(deferred.end(), it->deferred.begin(), it->deferred.end());
+		}
+		std::stable_sort(deferred.begin(), deferred.end(), DeferredLiveFixupSorter());
+		for (std::vector<DeferredLiveFixup>::iterator it=deferred.begin(); it != deferred.end(); ++it) {
+			const ld::Atom* target = this->liveTarget(*it->atom, it->fixup);
+			if ( (target != NULL) && (const_cast<ld::Atom*>(target))->trySetLive() )
+				wave.push_back(target);
 		}
 	}
-
 }
 
 class NotLiveLTO {
@@ -1222,18 +1355,38 @@ void Resolver::deadStripOptimize(bool force)
 		}
 	}
 	
-	// mark all roots as live, and all atoms they reference
-	for (std::set<const ld::Atom*>::iterator it=_deadStripRoots.begin(); it != _deadStripRoots.end(); ++it) {
-		WhyLiveBackChain rootChain;
-		rootChain.previous = NULL;
-		rootChain.referer = *it;
-		this->markLive(**it, &rootChain);
-	}
+	// mark all roots as live, and all atoms they reference.  Following a
+	// reference can load an archive member, whose dont-dead-strip atoms doAtom()
+	// adds to _deadStripRoots, so keep marking until no new roots show up.
+	const bool whyLive = _options.whyLiveRequested();
+	std::set<const ld::Atom*> markedRoots;
+	auto markNewRoots = [&]() {
+		while ( markedRoots.size() != _deadStripRoots.size() ) {
+			std::vector<const ld::Atom*> roots;
+			for (std::set<const ld::Atom*>::iterator it=_deadStripRoots.begin(); it != _deadStripRoots.end(); ++it) {
+				if ( markedRoots.insert(*it).second )
+					roots.push_back(*it);
+			}
+			if ( whyLive ) {
+				for (std::vector<const ld::Atom*>::iterator it=roots.begin(); it != roots.end(); ++it) {
+					WhyLiveBackChain rootChain;
+					rootChain.previous = NULL;
+					rootChain.referer = *it;
+					this->markLive(**it, &rootChain);
+				}
+			}
+			else {
+				this->markLiveFrom(roots);
+			}
+		}
+	};
+	markNewRoots();
 	
 	// special case atoms that need to be live if they reference something live
 	if ( ! _dontDeadStripIfReferencesLive.empty() ) {
-		for (std::vector<const ld::Atom*>::iterator it=_dontDeadStripIfReferencesLive.begin(); it != _dontDeadStripIfReferencesLive.end(); ++it) {
-			const Atom* liveIfRefLiveAtom = *it;
+		// indexed, because marking can load more members and grow the vector
+		for (size_t i=0; i < _dontDeadStripIfReferencesLive.size(); ++i) {
+			const Atom* liveIfRefLiveAtom = _dontDeadStripIfReferencesLive[i];
 			//fprintf(stderr, "live-if-live atom: %s\n", liveIfRefLiveAtom->name());
 			if ( liveIfRefLiveAtom->live() )
 				continue;
@@ -1254,10 +1407,17 @@ void Resolver::deadStripOptimize(bool force)
 					hasLiveRef = true;
 			}
 			if ( hasLiveRef ) {
-				WhyLiveBackChain rootChain;
-				rootChain.previous = NULL;
-				rootChain.referer = liveIfRefLiveAtom;
-				this->markLive(*liveIfRefLiveAtom, &rootChain);
+				if ( whyLive ) {
+					WhyLiveBackChain rootChain;
+					rootChain.previous = NULL;
+					rootChain.referer = liveIfRefLiveAtom;
+					this->markLive(*liveIfRefLiveAtom, &rootChain);
+				}
+				else {
+					std::vector<const ld::Atom*> roots(1, liveIfRefLiveAtom);
+					this->markLiveFrom(roots);
+				}
+				markNewRoots();
 			}
 		}
 	}
@@ -1807,6 +1967,7 @@ void Resolver::linkTimeOptimize()
 	optOpt.ignoreMismatchPlatform		= ((_options.outputKind() == Options::kPreload) || (_options.outputKind() == Options::kStaticExecutable));
 	optOpt.bitcodeBundle				= _options.bundleBitcode();
 	optOpt.maxDefaultCommonAlignment	= _options.maxDefaultCommonAlign();
+	optOpt.parallelParseMinSize			= _options.parallelParseMinSize();
 	optOpt.arch							= _options.architecture();
 	optOpt.mcpu							= _options.mcpuLTO();
 	optOpt.platform						= _options.platform();
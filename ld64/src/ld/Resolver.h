@@ -64,7 +64,8 @@ public:
 								  _haveLLVMObjs(false),
 								  _completedInitialObjectFiles(false),
 								  _ltoCodeGenFinished(false),
-								  _haveAliases(false) {}
+								  _haveAliases(false),
+								  _undefinesRounds(0), _undefinesVisited(0) {}
 								
 
 		virtual void		doAtom(const ld::Atom&);
@@ -99,6 +100,8 @@ private:
 	void					convertReferencesToIndirect(const ld::Atom& atom);
 	const ld::Atom*			entryPoint(bool searchArchives);
 	void					markLive(const ld::Atom& atom, WhyLiveBackChain* previous);
+	void					markLiveFrom(const std::vector<const ld::Atom*>& roots);
+	const ld::Atom*			liveTarget(const ld::Atom& atom, ld::Fixup* fit);
 	bool					isDtraceProbe(ld::Fixup::Kind kind);
 	void					liveUndefines(std::vector<const char*>&);
 	void					remainingUndefines(std::vector<const char*>&);
@@ -138,6 +141,11 @@ private:
 	bool							_completedInitialObjectFiles;
 	bool							_ltoCodeGenFinished;
 	bool							_haveAliases;
+
+public:
+	// for -print_statistics
+	uint32_t						_undefinesRounds;		// batches of undefined names searched for
+	uint64_t						_undefinesVisited;		// undefined names searched for, over all rounds
 };
 
 
@@ -0,0 +1,93 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __STRING_HASH_HPP__
+#define __STRING_HASH_HPP__
+
+#include <stdint.h>
+#include <string.h>
+
+namespace ld {
+namespace strings {
+
+//
+// Helpers for the hot loops over string literals and symbol names.
+//
+// hash() eats eight bytes per step instead of one, so hashing the tens of
+// megabytes of __cstring content in a large link is no longer dominated by
+// the hash loop.  It is not a stable format: values must only be compared
+// with values from the same process.
+//
+
+inline uint64_t mix(uint64_t h)
+{
+	// finalizer from MurmurHash3, every input bit affects every output bit
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+inline uint64_t hash(const void* data, size_t length)
+{
+	const uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+	const uint8_t* p = (const uint8_t*)data;
+	uint64_t h = length * kMultiplier;
+	for ( ; length >= 8; p += 8, length -= 8) {
+		uint64_t word;
+		memcpy(&word, p, 8);
+		h = (h ^ mix(word)) * kMultiplier;
+	}
+	if ( length != 0 ) {
+		uint64_t word = 0;
+		memcpy(&word, p, length);
+		h = (h ^ mix(word)) * kMultiplier;
+	}
+	return mix(h);
+}
+
+inline uint64_t hash(const char* str)
+{
+	return hash(str, strlen(str));
+}
+
+// Returns the length of the string at str, not looking at or past end.  If
+// there is no terminating zero before end, that is end - str.  memchr() is
+// vectorized by libc, so this is much faster than a byte loop on long
+// literal pools.
+inline size_t length(const char* str, const char* end)
+{
+	const char* zero = (const char*)memchr(str, '\0', end - str);
+	if ( zero == NULL )
+		return (end - str);
+	return (zero - str);
+}
+
+
+} // namespace strings
+} // namespace ld
+
+#endif // __STRING_HASH_HPP__
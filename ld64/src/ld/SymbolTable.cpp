@@ -47,6 +47,7 @@
 #include "ld.hpp"
 #include "InputFiles.h"
 #include "SymbolTable.h"
+#include "StringHash.hpp"
 
 
 
@@ -60,7 +61,7 @@ static ld::IndirectBindingTable*	_s_indirectBindingTable = NULL;
 
 
 SymbolTable::SymbolTable(const Options& opts, std::vector<const ld::Atom*>& ibt) 
-	: _options(opts), _cstringTable(6151), _indirectBindingTable(ibt), _hasExternalTentativeDefinitions(false)
+	: _options(opts), _indirectBindingTable(ibt), _hasExternalTentativeDefinitions(false)
 {  
 	_s_indirectBindingTable = this;
 }
@@ -78,14 +79,116 @@ bool SymbolTable::ContentFuncs::operator()(const ld::Atom* left, const ld::Atom*
 
 
 
-size_t SymbolTable::CStringHashFuncs::operator()(const ld::Atom* atom) const
+const SymbolTable::IndirectBindingSlot* SymbolTable::NameToSlot::find(const char* name, uint64_t hash) const
 {
-	return atom->contentHash(*_s_indirectBindingTable);
+	if ( _entries.empty() )
+		return NULL;
+	const size_t mask = _entries.size() - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		const Entry& entry = _entries[i];
+		if ( entry.name == NULL )
+			return NULL;
+		if ( (entry.hash == hash) && (strcmp(entry.name, name) == 0) )
+			return &entry.slot;
+	}
+}
+
+void SymbolTable::NameToSlot::add(const char* name, uint64_t hash, IndirectBindingSlot slot)
+{
+	// keep table at most 3/4 full
+	if ( (_count+1)*4 > _entries.size()*3 )
+		resize(std::max(_entries.size()*2, (size_t)16384));
+	const size_t mask = _entries.size() - 1;
+	size_t i = hash & mask;
+	while ( _entries[i].name != NULL )
+		i = (i + 1) & mask;
+	Entry entry = { name, hash, slot };
+	_entries[i] = entry;
+	++_count;
+}
+
+void SymbolTable::NameToSlot::resize(size_t entryCount)
+{
+	std::vector<Entry> oldEntries;
+	oldEntries.swap(_entries);
+	Entry empty = { NULL, 0, 0 };
+	_entries.resize(entryCount, empty);
+	const size_t mask = entryCount - 1;
+	for (std::vector<Entry>::const_iterator it=oldEntries.begin(); it != oldEntries.end(); ++it) {
+		if ( it->name == NULL )
+			continue;
+		size_t i = it->hash & mask;
+		while ( _entries[i].name != NULL )
+			i = (i + 1) & mask;
+		_entries[i] = *it;
+	}
+}
+
+
+SymbolTable::IndirectBindingSlot* SymbolTable::CStringToSlot::findOrAdd(const ld::Atom* atom, bool* added)
+{
+	// keep table at most 3/4 full
+	if ( (_count+1)*4 > _entries.size()*3 )
+		resize(std::max(_entries.size()*2, (size_t)8192));
+	const uint64_t hash = atom->contentHash(*_s_indirectBindingTable);
+	const char* content = (char*)atom->rawContentPointer();
+	const size_t mask = _entries.size() - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+		Entry& entry = _entries[i];
+		if ( entry.atom == NULL ) {
+			entry.atom = atom;
+			entry.hash = hash;
+			entry.slot = 0;
+			++_count;
+			*added = true;
+			return &entry.slot;
+		}
+		if ( (entry.hash == hash) && (strcmp((char*)entry.atom->rawContentPointer(), content) == 0) ) {
+			*added = false;
+			return &entry.slot;
+		}
+	}
+}
+
+void SymbolTable::CStringToSlot::resize(size_t entryCount)
+{
+	std::vector<Entry> oldEntries;
+	oldEntries.swap(_entries);
+	Entry empty = { NULL, 0, 0 };
+	_entries.resize(entryCount, empty);
+	const size_t mask = entryCount - 1;
+	for (std::vector<Entry>::const_iterator it=oldEntries.begin(); it != oldEntries.end(); ++it) {
+		if ( it->atom == NULL )
+			continue;
+		size_t i = it->hash & mask;
+		while ( _entries[i].atom != NULL )
+			i = (i + 1) & mask;
+		_entries[i] = *it;
+	}
+}
+
+void SymbolTable::CStringToSlot::removeDeadAtoms()
+{
+	// linear probing cannot simply empty an entry, so rebuild with the live atoms
+	for (std::vector<Entry>::iterator it=_entries.begin(); it != _entries.end(); ++it) {
+		if ( (it->atom != NULL) && !it->atom->live() && !it->atom->dontDeadStrip() ) {
+			it->atom = NULL;
+			--_count;
+		}
+	}
+	resize(_entries.size());
 }
 
-bool SymbolTable::CStringHashFuncs::operator()(const ld::Atom* left, const ld::Atom* right) const
+// counts how far each atom is from where its hash put it, the last count is for 10 or more
+void SymbolTable::CStringToSlot::probeLengths(unsigned int counts[11]) const
 {
-	return (strcmp((char*)left->rawContentPointer(), (char*)right->rawContentPointer()) == 0);
+	const size_t mask = _entries.size() - 1;
+	for (size_t i=0; i < _entries.size(); ++i) {
+		if ( _entries[i].atom == NULL )
+			continue;
+		size_t distance = (i - _entries[i].hash) & mask;
+		counts[std::min(distance, (size_t)10)] += 1;
+	}
 }
 
 
@@ -420,10 +523,11 @@ bool SymbolTable::addByName(const ld::Atom& newAtom, bool ignoreDuplicates)
 		if ( existingAtom != NULL ) {
 			markCoalescedAway(existingAtom);
 		}
-		if ( newAtom.scope() == ld::Atom::scopeGlobal ) {
-			if ( newAtom.definition() == ld::Atom::definitionTentative ) {
+		if ( newAtom.definition() == ld::Atom::definitionTentative ) {
+			NameAndSlot entry = { name, slot };
+			_tentativeNames.push_back(entry);
+			if ( newAtom.scope() == ld::Atom::scopeGlobal )
 				_hasExternalTentativeDefinitions = true;
-			}
 		}
 	}
 	else {
@@ -539,39 +643,74 @@ struct StrcmpSorter {
 			return strcmp(i, j)<0;}
 };
 
+void SymbolTable::compactUndefines()
+{
+	std::vector<NameAndSlot>::iterator end = _undefinedNames.begin();
+	for (std::vector<NameAndSlot>::iterator it=_undefinedNames.begin(); it != _undefinedNames.end(); ++it) {
+		if ( _indirectBindingTable[it->slot] == NULL )
+			*end++ = *it;
+	}
+	_undefinedNames.erase(end, _undefinedNames.end());
+}
+
+
 void SymbolTable::undefines(std::vector<const char*>& undefs)
 {
 	// return all names in _byNameTable that have no associated atom
-	for (NameToSlot::iterator it=_byNameTable.begin(); it != _byNameTable.end(); ++it) {
-		//fprintf(stderr, "  _byNameTable[%s] = slot %d which has atom %p\n", it->first, it->second, _indirectBindingTable[it->second]);
-		if ( _indirectBindingTable[it->second] == NULL )
-			undefs.push_back(it->first);
-	}
+	compactUndefines();
+	for (std::vector<NameAndSlot>::iterator it=_undefinedNames.begin(); it != _undefinedNames.end(); ++it)
+		undefs.push_back(it->name);
 	// sort so that undefines are in a stable order (not dependent on hashing functions)
 	struct StrcmpSorter strcmpSorter;
 	std::sort(undefs.begin(), undefs.end(), strcmpSorter);
 }
 
 
+//
+// Appends the names still undefined whose slots were made after the one at
+// position (as returned by an earlier call), in the order they were first
+// referenced.  Pass zero to get all undefined names.  Returns the position
+// to pass next time to only get names referenced since this call.
+//
+size_t SymbolTable::undefinesAfter(size_t position, std::vector<const char*>& undefs)
+{
+	// earlier positions are only invalidated by a compaction, so only compact on full sweeps
+	if ( position == 0 )
+		compactUndefines();
+	for (size_t i=position; i < _undefinedNames.size(); ++i) {
+		if ( _indirectBindingTable[_undefinedNames[i].slot] == NULL )
+			undefs.push_back(_undefinedNames[i].name);
+	}
+	return _undefinedNames.size();
+}
+
+
 void SymbolTable::tentativeDefs(std::vector<const char*>& tents)
 {
-	// return all names in _byNameTable that have no associated atom
-	for (NameToSlot::iterator it=_byNameTable.begin(); it != _byNameTable.end(); ++it) {
-		const char* name = it->first;
-		const ld::Atom* atom = _indirectBindingTable[it->second];
-		if ( (atom != NULL) && (atom->definition() == ld::Atom::definitionTentative) )
-			tents.push_back(name);
+	// return all names in _byNameTable that have a tentative definition
+	std::vector<NameAndSlot>::iterator end = _tentativeNames.begin();
+	for (std::vector<NameAndSlot>::iterator it=_tentativeNames.begin(); it != _tentativeNames.end(); ++it) {
+		const ld::Atom* atom = _indirectBindingTable[it->slot];
+		if ( (atom != NULL) && (atom->definition() == ld::Atom::definitionTentative) ) {
+			*end++ = *it;
+			tents.push_back(it->name);
+		}
 	}
+	_tentativeNames.erase(end, _tentativeNames.end());
+	// a slot is listed again each time a tentative definition replaces another
 	std::sort(tents.begin(), tents.end());
+	tents.erase(std::unique(tents.begin(), tents.end()), tents.end());
 }
 
 
 void SymbolTable::mustPreserveForBitcode(std::unordered_set<const char*>& syms)
 {
 	// return all names in _byNameTable that have no associated atom
-	for (const auto &entry: _byNameTable) {
-		const char* name = entry.first;
-		const ld::Atom* atom = _indirectBindingTable[entry.second];
+	for (IndirectBindingSlot slot=0; slot < _byNameReverseTable.size(); ++slot) {
+		const char* name = _byNameReverseTable[slot];
+		if ( name == NULL )
+			continue;
+		const ld::Atom* atom = _indirectBindingTable[slot];
 		if ( (atom == NULL) || (atom->definition() == ld::Atom::definitionProxy) )
 			syms.insert(name);
 	}
@@ -580,47 +719,47 @@ void SymbolTable::mustPreserveForBitcode(std::unordered_set<const char*>& syms)
 
 bool SymbolTable::hasName(const char* name)			
 { 
-	NameToSlot::iterator pos = _byNameTable.find(name);
-	if ( pos == _byNameTable.end() ) 
+	const IndirectBindingSlot* slot = _byNameTable.find(name, ld::strings::hash(name));
+	if ( slot == NULL ) 
 		return false;
-	return (_indirectBindingTable[pos->second] != NULL); 
+	return (_indirectBindingTable[*slot] != NULL); 
 }
 
 // find existing or create new slot
 SymbolTable::IndirectBindingSlot SymbolTable::findSlotForName(const char* name)
 {
-	NameToSlot::iterator pos = _byNameTable.find(name);
-	if ( pos != _byNameTable.end() ) 
-		return pos->second;
+	const uint64_t hash = ld::strings::hash(name);
+	const IndirectBindingSlot* pos = _byNameTable.find(name, hash);
+	if ( pos != NULL ) 
+		return *pos;
 	// create new slot for this name
 	SymbolTable::IndirectBindingSlot slot = _indirectBindingTable.size();
 	_indirectBindingTable.push_back(NULL);
-	_byNameTable[name] = slot;
+	_byNameTable.add(name, hash, slot);
+	if ( _byNameReverseTable.size() <= slot )
+		_byNameReverseTable.resize(slot+1, NULL);
 	_byNameReverseTable[slot] = name;
+	NameAndSlot entry = { name, slot };
+	_undefinedNames.push_back(entry);
 	return slot;
 }
 
 void SymbolTable::removeDeadAtoms()
 {
+	// dead atoms are defined, so dropping all defined names keeps them out of _undefinedNames
+	compactUndefines();
+
 	// remove dead atoms from: _byNameTable, _byNameReverseTable, and _indirectBindingTable
-	std::vector<const char*> namesToRemove;
-	for (NameToSlot::iterator it=_byNameTable.begin(); it != _byNameTable.end(); ++it) {
-		IndirectBindingSlot slot = it->second;
+	_byNameTable.removeIf([&](const char* name, IndirectBindingSlot slot) {
 		const ld::Atom* atom = _indirectBindingTable[slot];
-		if ( atom != NULL ) {
-			if ( !atom->live() && !atom->dontDeadStrip() ) {
-				//fprintf(stderr, "removing from symbolTable[%u] %s\n", slot, atom->name());
-				_indirectBindingTable[slot] = NULL;
-				// <rdar://problem/16025786> need to completely remove dead atoms from symbol table
-				_byNameReverseTable.erase(slot);
-				// can't remove while iterating, do it after iteration
-				namesToRemove.push_back(it->first);
-			}
-		}
-	}
-	for (std::vector<const char*>::iterator it = namesToRemove.begin(); it != namesToRemove.end(); ++it) {
-		_byNameTable.erase(*it);
-	}
+		if ( (atom == NULL) || atom->live() || atom->dontDeadStrip() )
+			return false;
+		//fprintf(stderr, "removing from symbolTable[%u] %s\n", slot, atom->name());
+		_indirectBindingTable[slot] = NULL;
+		// <rdar://problem/16025786> need to completely remove dead atoms from symbol table
+		_byNameReverseTable[slot] = NULL;
+		return true;
+	});
 
 	// remove dead atoms from _nonLazyPointerTable
 	for (ReferencesToSlot::iterator it=_nonLazyPointerTable.begin(); it != _nonLazyPointerTable.end(); ) {
@@ -633,14 +772,7 @@ void SymbolTable::removeDeadAtoms()
 	}
 
 	// remove dead atoms from _cstringTable
-	for (CStringToSlot::iterator it=_cstringTable.begin(); it != _cstringTable.end(); ) {
-		const ld::Atom* atom = it->first;
-		assert(atom != NULL);
-		if ( !atom->live() && !atom->dontDeadStrip() )
-			it = _cstringTable.erase(it);
-		else
-			++it;
-	}
+	_cstringTable.removeDeadAtoms();
 
 	// remove dead atoms from _utf16Table
 	for (UTF16StringToSlot::iterator it=_utf16Table.begin(); it != _utf16Table.end(); ) {
@@ -700,17 +832,18 @@ SymbolTable::IndirectBindingSlot SymbolTable::findSlotForContent(const ld::Atom*
 	//fprintf(stderr, "findSlotForContent(%p)\n", atom);
 	SymbolTable::IndirectBindingSlot slot = 0;
 	UTF16StringToSlot::iterator upos;
-	CStringToSlot::iterator cspos;
+	IndirectBindingSlot* csslot;
+	bool csadded;
 	ContentToSlot::iterator pos;
 	switch ( atom->section().type() ) {
 		case ld::Section::typeCString:
-			cspos = _cstringTable.find(atom);
-			if ( cspos != _cstringTable.end() ) {
-				*existingAtom = _indirectBindingTable[cspos->second];
-				return cspos->second;
+			csslot = _cstringTable.findOrAdd(atom, &csadded);
+			if ( !csadded ) {
+				*existingAtom = _indirectBindingTable[*csslot];
+				return *csslot;
 			}
 			slot = _indirectBindingTable.size();
-			_cstringTable[atom] = slot;
+			*csslot = slot;
 			break;
 		case ld::Section::typeNonStdCString:
 			{
@@ -726,13 +859,13 @@ SymbolTable::IndirectBindingSlot SymbolTable::findSlotForContent(const ld::Atom*
 				else {
 					map = mpos->second;
 				}
-				cspos = map->find(atom);
-				if ( cspos != map->end() ) {
-					*existingAtom = _indirectBindingTable[cspos->second];
-					return cspos->second;
+				csslot = map->findOrAdd(atom, &csadded);
+				if ( !csadded ) {
+					*existingAtom = _indirectBindingTable[*csslot];
+					return *csslot;
 				}
 				slot = _indirectBindingTable.size();
-				map->operator[](atom) = slot;
+				*csslot = slot;
 			}
 			break;
 		case ld::Section::typeUTF16Strings:
@@ -851,9 +984,8 @@ const char*	SymbolTable::indirectName(IndirectBindingSlot slot) const
 		return target->name();
 	}
 	// handle case when by-name reference is indirected and no atom yet in _byNameTable
-	SlotToName::const_iterator pos = _byNameReverseTable.find(slot);
-	if ( pos != _byNameReverseTable.end() )
-		return pos->second;
+	if ( (slot < _byNameReverseTable.size()) && (_byNameReverseTable[slot] != NULL) )
+		return _byNameReverseTable[slot];
 	assert(0);
 	return NULL;
 }
@@ -868,20 +1000,15 @@ void SymbolTable::printStatistics()
 {
 //	fprintf(stderr, "cstring table size: %lu, bucket count: %lu, hash func called %u times\n", 
 //				_cstringTable.size(), _cstringTable.bucket_count(), cstringHashCount);
-	int count[11];
+	unsigned int count[11];
 	for(unsigned int b=0; b < 11; ++b) {
 		count[b] = 0;
 	}
-	for(unsigned int i=0; i < _cstringTable.bucket_count(); ++i) {
-		unsigned int n = _cstringTable.bucket_size(i);
-		if ( n < 10 ) 
-			count[n] += 1;
-		else
-			count[10] += 1;
-	}
-	fprintf(stderr, "cstring table distribution\n");
+	_cstringTable.probeLengths(count);
+	fprintf(stderr, "cstring table size: %lu\n", _cstringTable.size());
+	fprintf(stderr, "cstring table probe distribution\n");
 	for(unsigned int b=0; b < 11; ++b) {
-		fprintf(stderr, "%u buckets have %u elements\n", count[b], b);
+		fprintf(stderr, "%u strings are %u entries past their hash\n", count[b], b);
 	}
 	fprintf(stderr, "indirect table size: %lu\n", _indirectBindingTable.size());
 	fprintf(stderr, "by-name table size: %lu\n", _byNameTable.size());
@@ -57,7 +57,43 @@ public:
 	typedef uint32_t IndirectBindingSlot;
 
 private:
-	typedef std::unordered_map<const char*, IndirectBindingSlot, CStringHash, CStringEquals> NameToSlot;
+	// Open addressing table from symbol name to slot.  Each entry keeps the
+	// name's hash, so a lookup hashes its name once, only compares names on
+	// a full hash match, and growing never rehashes names.
+	class NameToSlot {
+	public:
+							NameToSlot() : _count(0) { }
+
+		// Returns the slot for name, or NULL if name is not in the table.
+		const IndirectBindingSlot*	find(const char* name, uint64_t hash) const;
+		// Adds name, which must not be in the table yet.
+		void				add(const char* name, uint64_t hash, IndirectBindingSlot slot);
+		size_t				size() const { return _count; }
+
+		// Removes every name for which predicate(name, slot) is true.
+		template <typename P>
+		void				removeIf(const P& predicate) {
+								for (typename std::vector<Entry>::iterator it=_entries.begin(); it != _entries.end(); ++it) {
+									if ( (it->name != NULL) && predicate(it->name, it->slot) ) {
+										it->name = NULL;
+										--_count;
+									}
+								}
+								// linear probing cannot simply empty an entry, so rebuild with what is left
+								resize(_entries.size());
+							}
+
+	private:
+		struct Entry {
+			const char*			name;		// NULL if entry is empty
+			uint64_t			hash;
+			IndirectBindingSlot	slot;
+		};
+		void				resize(size_t entryCount);
+
+		std::vector<Entry>	_entries;		// count is zero or a power of two
+		size_t				_count;
+	};
 
 	class ContentFuncs {
 	public:
@@ -73,12 +109,32 @@ private:
 	};
 	typedef std::unordered_map<const ld::Atom*, IndirectBindingSlot, ReferencesHashFuncs, ReferencesHashFuncs> ReferencesToSlot;
 
-	class CStringHashFuncs {
+	// Open addressing table of cstring literal atoms, keyed by their content.
+	// Each entry keeps the atom's content hash, so probing only compares
+	// string bytes on a full hash match, and growing never rehashes strings.
+	class CStringToSlot {
 	public:
-		size_t	operator()(const ld::Atom*) const;
-		bool	operator()(const ld::Atom* left, const ld::Atom* right) const;
+							CStringToSlot() : _count(0) { }
+
+		// Returns the slot of the atom with the same content, or, if there is
+		// none, adds atom and returns its slot for the caller to fill in.
+		// The pointer is only good until the next call.
+		IndirectBindingSlot*	findOrAdd(const ld::Atom* atom, bool* added);
+		void				removeDeadAtoms();
+		size_t				size() const { return _count; }
+		void				probeLengths(unsigned int counts[11]) const;
+
+	private:
+		struct Entry {
+			const ld::Atom*		atom;		// NULL if entry is empty
+			uint64_t			hash;
+			IndirectBindingSlot	slot;
+		};
+		void				resize(size_t entryCount);
+
+		std::vector<Entry>	_entries;		// count is zero or a power of two
+		size_t				_count;
 	};
-	typedef std::unordered_map<const ld::Atom*, IndirectBindingSlot, CStringHashFuncs, CStringHashFuncs> CStringToSlot;
 
 	class UTF16StringHashFuncs {
 	public:
@@ -87,7 +143,7 @@ private:
 	};
 	typedef std::unordered_map<const ld::Atom*, IndirectBindingSlot, UTF16StringHashFuncs, UTF16StringHashFuncs> UTF16StringToSlot;
 
-	typedef std::map<IndirectBindingSlot, const char*> SlotToName;
+	typedef std::vector<const char*> SlotToName;		// indexed by slot, NULL if slot has no name
 	typedef std::unordered_map<const char*, CStringToSlot*, CStringHash, CStringEquals> NameToMap;
     
     typedef std::vector<const ld::Atom *> DuplicatedSymbolAtomList;
@@ -95,18 +151,21 @@ private:
 	
 public:
 
+	// visits the atom (or NULL) of every name in slot order
 	class byNameIterator {
 	public:
-		byNameIterator&			operator++(int) { ++_nameTableIterator; return *this; }
-		const ld::Atom*			operator*() { return _slotTable[_nameTableIterator->second]; }
-		bool					operator!=(const byNameIterator& lhs) { return _nameTableIterator != lhs._nameTableIterator; }
+		byNameIterator&			operator++(int) { ++_slot; skipUnnamed(); return *this; }
+		const ld::Atom*			operator*() { return _slotTable[_slot]; }
+		bool					operator!=(const byNameIterator& lhs) { return _slot != lhs._slot; }
 
 	private:
 		friend class SymbolTable;
-								byNameIterator(NameToSlot::iterator it, std::vector<const ld::Atom*>& indirectTable)
-									: _nameTableIterator(it), _slotTable(indirectTable) {} 
+								byNameIterator(IndirectBindingSlot slot, const SlotToName& names, std::vector<const ld::Atom*>& indirectTable)
+									: _slot(slot), _names(names), _slotTable(indirectTable) { skipUnnamed(); }
+		void					skipUnnamed() { while ( (_slot < _names.size()) && (_names[_slot] == NULL) ) ++_slot; }
 		
-		NameToSlot::iterator			_nameTableIterator;
+		IndirectBindingSlot				_slot;
+		const SlotToName&				_names;
 		std::vector<const ld::Atom*>&	_slotTable;
 	};
 	
@@ -119,13 +178,14 @@ public:
 	const ld::Atom*		atomForSlot(IndirectBindingSlot s)	{ return _indirectBindingTable[s]; }
 	unsigned int		updateCount()						{ return _indirectBindingTable.size(); }
 	void				undefines(std::vector<const char*>& undefines);
+	size_t				undefinesAfter(size_t position, std::vector<const char*>& undefines);
 	void				tentativeDefs(std::vector<const char*>& undefines);
 	void				mustPreserveForBitcode(std::unordered_set<const char*>& syms);
 	void				removeDeadAtoms();
 	bool				hasName(const char* name);
 	bool				hasExternalTentativeDefinitions()	{ return _hasExternalTentativeDefinitions; }
-	byNameIterator		begin()								{ return byNameIterator(_byNameTable.begin(),_indirectBindingTable); }
-	byNameIterator		end()								{ return byNameIterator(_byNameTable.end(),_indirectBindingTable); }
+	byNameIterator		begin()								{ return byNameIterator(0, _byNameReverseTable, _indirectBindingTable); }
+	byNameIterator		end()								{ return byNameIterator(_byNameReverseTable.size(), _byNameReverseTable, _indirectBindingTable); }
 	void				printStatistics();
 	
 	// from ld::IndirectBindingTable
@@ -141,6 +201,7 @@ private:
 	bool					addByContent(const ld::Atom& atom);
 	bool					addByReferences(const ld::Atom& atom);
 	void					markCoalescedAway(const ld::Atom* atom);
+	void					compactUndefines();
     
     // Tracks duplicated symbols. Each call adds file to the list of files defining symbol.
     // The file list is uniqued per symbol, so calling multiple times for the same symbol/file pair is permitted.
@@ -162,6 +223,14 @@ private:
 	ReferencesToSlot				_pointerToCStringTable;
 	std::vector<const ld::Atom*>&	_indirectBindingTable;
 	bool							_hasExternalTentativeDefinitions;
+
+	// Every name that was undefined when its slot was made, in slot order.
+	// Slots only go from undefined to defined (until removeDeadAtoms()), so
+	// the undefined names are found without scanning all of _byNameTable.
+	// Entries that have since been defined are dropped by compactUndefines().
+	struct NameAndSlot { const char* name; IndirectBindingSlot slot; };
+	std::vector<NameAndSlot>		_undefinedNames;
+	std::vector<NameAndSlot>		_tentativeNames;		// names that got a tentative definition
 	
     DuplicateSymbols                _duplicateSymbols;
 
@@ -0,0 +1,251 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __TIMING_HPP__
+#define __TIMING_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <mach/mach_time.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace ld {
+namespace timing {
+
+//
+// Records how long each phase of the link takes, and a few counters, for
+// -print_statistics and -trace_statistics_file.
+//
+// A Scope times the block it lives in.  Scopes may nest and may be used on
+// any thread; nesting is worked out afterwards from the recorded intervals,
+// so nothing has to be passed down.  Names must outlive the link (string
+// literals or atom names).  When timing is off a Scope costs one test.
+//
+struct Phase {
+	const char*		name;
+	uint64_t		start;		// mach_absolute_time() units
+	uint64_t		end;
+	uint32_t		thread;		// 1 is the thread that enabled timing
+};
+
+struct Counter {
+	const char*		name;
+	uint64_t		value;
+};
+
+struct Recorder {
+	pthread_mutex_t			lock;
+	bool					enabled;
+	uint32_t				threadCount;
+	std::vector<Phase>		phases;
+	std::vector<Counter>	counters;
+};
+
+inline Recorder& recorder()
+{
+	static Recorder sRecorder = { PTHREAD_MUTEX_INITIALIZER, false, 0, std::vector<Phase>(), std::vector<Counter>() };
+	return sRecorder;
+}
+
+inline bool enabled()
+{
+	return recorder().enabled;
+}
+
+inline uint32_t threadIndex()
+{
+	static __thread uint32_t sThread = 0;
+	if ( sThread == 0 )
+		sThread = __sync_add_and_fetch(&recorder().threadCount, 1);
+	return sThread;
+}
+
+inline void enable()
+{
+	threadIndex();
+	recorder().enabled = true;
+}
+
+inline void addPhase(const char* name, uint64_t start, uint64_t end)
+{
+	Recorder& r = recorder();
+	if ( !r.enabled )
+		return;
+	Phase phase = { name, start, end, threadIndex() };
+	pthread_mutex_lock(&r.lock);
+	r.phases.push_back(phase);
+	pthread_mutex_unlock(&r.lock);
+}
+
+// Adds amount to the counter called name, creating it if needed.
+inline void count(const char* name, uint64_t amount)
+{
+	Recorder& r = recorder();
+	if ( !r.enabled )
+		return;
+	pthread_mutex_lock(&r.lock);
+	std::vector<Counter>::iterator it = r.counters.begin();
+	while ( (it != r.counters.end()) && (strcmp(it->name, name) != 0) )
+		++it;
+	if ( it == r.counters.end() ) {
+		Counter counter = { name, amount };
+		r.counters.push_back(counter);
+	}
+	else {
+		it->value += amount;
+	}
+	pthread_mutex_unlock(&r.lock);
+}
+
+class Scope {
+public:
+					Scope(const char* name) : _name(name), _start(enabled() ? mach_absolute_time() : 0) { }
+					~Scope() { if ( _start != 0 ) addPhase(_name, _start, mach_absolute_time()); }
+private:
+					Scope(const Scope&);
+	Scope&			operator=(const Scope&);
+
+	const char*		_name;
+	uint64_t		_start;
+};
+
+
+inline uint64_t nanoseconds(uint64_t machTime)
+{
+	static mach_timebase_info_data_t sTimeBase = { 0, 0 };
+	if ( sTimeBase.denom == 0 ) {
+		if ( mach_timebase_info(&sTimeBase) != KERN_SUCCESS ) {
+			sTimeBase.numer = 1;
+			sTimeBase.denom = 1;
+		}
+	}
+	return machTime * sTimeBase.numer / sTimeBase.denom;
+}
+
+// parents before children, otherwise in start order
+inline bool phaseBefore(const Phase& a, const Phase& b)
+{
+	if ( a.start != b.start )
+		return (a.start < b.start);
+	return (a.end > b.end);
+}
+
+inline bool phaseContains(const Phase& outer, const Phase& inner)
+{
+	return (outer.start <= inner.start) && (inner.end <= outer.end);
+}
+
+// Phases on other threads are shown under the innermost phase of the first
+// thread that was running when they were.
+inline unsigned int phaseDepth(const std::vector<Phase>& phases, size_t index)
+{
+	const Phase& phase = phases[index];
+	unsigned int depth = 0;
+	for (size_t i=0; i < index; ++i) {
+		const Phase& other = phases[i];
+		if ( ((other.thread == phase.thread) || (other.thread == 1)) && phaseContains(other, phase) )
+			++depth;
+	}
+	return depth;
+}
+
+// Prints every phase, indented by nesting, and then the counters.
+inline void printStatistics(FILE* out, uint64_t totalTime)
+{
+	Recorder& r = recorder();
+	std::vector<Phase> phases = r.phases;
+	std::stable_sort(phases.begin(), phases.end(), phaseBefore);
+	if ( totalTime == 0 )
+		totalTime = 1;
+	fprintf(out, "ld phases:\n");
+	for (size_t i=0; i < phases.size(); ++i) {
+		const Phase& phase = phases[i];
+		unsigned int indent = 2 * (phaseDepth(phases, i) + 1);
+		uint64_t duration = phase.end - phase.start;
+		int width = (indent < 40) ? (40 - indent) : 0;
+		fprintf(out, "%*s%-*s %10.3f ms %5.1f%%", indent, "", width, phase.name,
+				nanoseconds(duration) / 1000000.0, (duration * 100.0) / totalTime);
+		if ( phase.thread != 1 )
+			fprintf(out, "  (thread %u)", phase.thread);
+		fprintf(out, "\n");
+	}
+	for (std::vector<Counter>::const_iterator it=r.counters.begin(); it != r.counters.end(); ++it)
+		fprintf(out, "%24s: %llu\n", it->name, it->value);
+}
+
+inline void writeJSONString(FILE* out, const char* str)
+{
+	fputc('"', out);
+	for (const char* s = str; *s != '\0'; ++s) {
+		if ( (*s == '"') || (*s == '\\') )
+			fprintf(out, "\\%c", *s);
+		else if ( (unsigned char)*s < 0x20 )
+			fprintf(out, "\\u%04x", *s);
+		else
+			fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+// Writes phases and counters in the Chrome trace event format, with times in
+// microseconds from origin.  Counters are sampled at end.  Returns false if
+// path could not be written.
+inline bool writeTraceFile(const char* path, uint64_t origin, uint64_t end)
+{
+	FILE* out = fopen(path, "w");
+	if ( out == NULL )
+		return false;
+	Recorder& r = recorder();
+	const int pid = getpid();
+	fprintf(out, "{\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"ld\"}}", pid);
+	for (std::vector<Phase>::const_iterator it=r.phases.begin(); it != r.phases.end(); ++it) {
+		fprintf(out, ",\n{\"name\":");
+		writeJSONString(out, it->name);
+		fprintf(out, ",\"cat\":\"ld\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				pid, it->thread, nanoseconds(it->start - origin) / 1000.0, nanoseconds(it->end - it->start) / 1000.0);
+	}
+	for (std::vector<Counter>::const_iterator it=r.counters.begin(); it != r.counters.end(); ++it) {
+		fprintf(out, ",\n{\"name\":");
+		writeJSONString(out, it->name);
+		fprintf(out, ",\"cat\":\"ld\",\"ph\":\"C\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+				pid, nanoseconds(end - origin) / 1000.0, it->value);
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	bool ok = (ferror(out) == 0);
+	if ( fclose(out) != 0 )
+		ok = false;
+	return ok;
+}
+
+
+} // namespace timing
+} // namespace ld
+
+#endif // __TIMING_HPP__
@@ -0,0 +1,335 @@
+/* -*- mode: C++; c-basic-offset: 4; tab-width: 4 -*-
+ *
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#ifndef __WILDCARD_MATCHER_HPP__
+#define __WILDCARD_MATCHER_HPP__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace ld {
+namespace tool {
+
+//
+// Matches names against a whole set of patterns using '*', '?' and '[...]'
+// at once.
+//
+// Patterns are kept in a trie keyed by their literal prefix (everything before
+// the first wildcard character), so a name walks the trie once and is then
+// only checked against the patterns whose prefix it starts with.  A pattern
+// that is its prefix followed by '*', the common case in export lists, needs
+// no further check.  Patterns that are a prefix, '*' and a literal suffix go
+// into a second trie of reversed suffixes hanging off the prefix's node, so
+// "*_block_invoke" style patterns cost one backwards walk of the name, not
+// one comparison each.  Whatever is left is compiled into a list of elements,
+// rejected early by length and trailing literals, and otherwise matched
+// without recursion, so patterns with several '*' cannot take exponential time.
+//
+// Patterns are added while options are parsed.  After that matches() only
+// reads, so it may be called from several threads.
+//
+class WildcardMatcher {
+public:
+							WildcardMatcher() : _nodes(1), _suffixNodes(1), _patternCount(0) { }
+
+	static bool				hasWildCards(const char* pattern) { return (strpbrk(pattern, "*?[") != NULL); }
+
+	void					insert(const char* pattern);
+	bool					matches(const char* name) const;
+	bool					empty() const { return (_patternCount == 0); }
+
+private:
+	enum ElementKind { kLiteral, kAnyChar, kCharSet, kAnyString };
+
+	struct Element {
+		uint8_t				kind;
+		uint8_t				literal;
+		uint32_t			charSet;		// index into _charSets
+	};
+
+	struct CharSet {
+		uint32_t			bits[8];
+
+		bool				contains(uint8_t c) const { return (bits[c >> 5] & (1U << (c & 31))) != 0; }
+	};
+
+	struct Tail {
+		uint32_t			start;			// index of first Element
+		uint32_t			count;
+		uint32_t			minLength;		// characters needed to match all non-'*' elements
+		uint32_t			suffixLength;	// trailing literal elements, compared before matching
+	};
+
+	// Node of either trie.  Index 0 of each node vector is the root (prefix
+	// trie) or unused (suffix tries), so a child of 0 means none.
+	struct Node {
+							Node() : matchesAnyRest(false), suffixes(0) { }
+
+		std::vector<std::pair<uint8_t, uint32_t> >	children;	// sorted by character
+		std::vector<uint32_t>						tails;		// indexes into _tails
+		bool										matchesAnyRest;	// in a suffix trie: a suffix ends here
+		uint32_t									suffixes;	// root in _suffixNodes, or 0
+	};
+
+	static uint32_t			child(const std::vector<Node>& nodes, uint32_t node, uint8_t c);
+	static uint32_t			addChild(std::vector<Node>& nodes, uint32_t node, uint8_t c);
+	uint32_t				compileCharSet(const char*& p);
+	bool					elementMatches(const Element& element, uint8_t c) const;
+	bool					tailMatches(const Tail& tail, const char* name, const char* end) const;
+	bool					suffixMatches(uint32_t root, const char* name, const char* end) const;
+
+	std::vector<Node>		_nodes;
+	std::vector<Node>		_suffixNodes;
+	std::vector<Element>	_elements;
+	std::vector<CharSet>	_charSets;
+	std::vector<Tail>		_tails;
+	size_t					_patternCount;
+};
+
+
+inline uint32_t WildcardMatcher::child(const std::vector<Node>& nodes, uint32_t node, uint8_t c)
+{
+	const std::vector<std::pair<uint8_t, uint32_t> >& children = nodes[node].children;
+	std::vector<std::pair<uint8_t, uint32_t> >::const_iterator pos = std::lower_bound(children.begin(), children.end(), std::make_pair(c, (uint32_t)0));
+	if ( (pos == children.end()) || (pos->first != c) )
+		return 0;
+	return pos->second;
+}
+
+inline uint32_t WildcardMatcher::addChild(std::vector<Node>& nodes, uint32_t node, uint8_t c)
+{
+	uint32_t existing = child(nodes, node, c);
+	if ( existing != 0 )
+		return existing;
+	uint32_t newNode = (uint32_t)nodes.size();
+	nodes.push_back(Node());
+	std::vector<std::pair<uint8_t, uint32_t> >& children = nodes[node].children;
+	children.insert(std::lower_bound(children.begin(), children.end(), std::make_pair(c, (uint32_t)0)), std::make_pair(c, newNode));
+	return newNode;
+}
+
+// Compiles the "[...]" starting at p, leaving p on the closing ']'.  Which
+// characters are in the set is decided exactly the way ld always has, by
+// running its range parser for every character.  An unterminated '[' matches
+// nothing and leaves p on the terminating zero.
+inline uint32_t WildcardMatcher::compileCharSet(const char*& p)
+{
+	CharSet set;
+	memset(set.bits, 0, sizeof(set.bits));
+	const char* b = ++p;
+	while ( (*p != '\0') && (*p != ']') )
+		++p;
+	if ( *p == ']' ) {
+		const char* e = p;
+		for (unsigned int c=1; c < 256; ++c) {
+			unsigned char last = '\0';
+			bool found = false;
+			for (const char* s = b; (s < e) && !found; ++s) {
+				if ( *s == '-' ) {
+					unsigned char next = *(++s);
+					if ( (last <= c) && (c <= next) )
+						found = true;
+					++s;
+				}
+				else {
+					if ( (unsigned char)*s == c )
+						found = true;
+					last = *s;
+				}
+			}
+			if ( found )
+				set.bits[c >> 5] |= (1U << (c & 31));
+		}
+	}
+	_charSets.push_back(set);
+	return (uint32_t)(_charSets.size() - 1);
+}
+
+inline void WildcardMatcher::insert(const char* pattern)
+{
+	// walk literal prefix down trie
+	uint32_t node = 0;
+	const char* p = pattern;
+	for ( ; (*p != '\0') && (strchr("*?[", *p) == NULL); ++p)
+		node = addChild(_nodes, node, (uint8_t)*p);
+	++_patternCount;
+	if ( _nodes[node].matchesAnyRest )
+		return;
+	const char* suffix = p;
+	while ( *suffix == '*' )
+		++suffix;
+	if ( (suffix != p) && (*suffix == '\0') ) {
+		_nodes[node].matchesAnyRest = true;
+		return;
+	}
+
+	// prefix, '*' and a literal suffix: add reversed suffix to node's suffix trie
+	if ( (suffix != p) && (strpbrk(suffix, "*?[") == NULL) ) {
+		if ( _nodes[node].suffixes == 0 ) {
+			_nodes[node].suffixes = (uint32_t)_suffixNodes.size();
+			_suffixNodes.push_back(Node());
+		}
+		uint32_t suffixNode = _nodes[node].suffixes;
+		for (const char* s = &suffix[strlen(suffix)]; s != suffix; )
+			suffixNode = addChild(_suffixNodes, suffixNode, (uint8_t)*--s);
+		_suffixNodes[suffixNode].matchesAnyRest = true;
+		return;
+	}
+
+	// compile the rest
+	Tail tail;
+	tail.start = (uint32_t)_elements.size();
+	tail.minLength = 0;
+	tail.suffixLength = 0;
+	for ( ; *p != '\0'; ++p) {
+		Element element = { kLiteral, (uint8_t)*p, 0 };
+		switch ( *p ) {
+			case '*':
+				if ( (_elements.size() > tail.start) && (_elements.back().kind == kAnyString) )
+					continue;
+				element.kind = kAnyString;
+				break;
+			case '?':
+				element.kind = kAnyChar;
+				break;
+			case '[':
+				element.kind = kCharSet;
+				element.charSet = compileCharSet(p);
+				break;
+		}
+		_elements.push_back(element);
+		if ( element.kind != kAnyString )
+			++tail.minLength;
+		if ( element.kind == kLiteral )
+			++tail.suffixLength;
+		else
+			tail.suffixLength = 0;
+		if ( *p == '\0' )
+			break;
+	}
+	tail.count = (uint32_t)(_elements.size() - tail.start);
+	_nodes[node].tails.push_back((uint32_t)_tails.size());
+	_tails.push_back(tail);
+}
+
+inline bool WildcardMatcher::elementMatches(const Element& element, uint8_t c) const
+{
+	switch ( element.kind ) {
+		case kLiteral:
+			return (element.literal == c);
+		case kAnyChar:
+			return true;
+		case kCharSet:
+			return _charSets[element.charSet].contains(c);
+	}
+	return false;
+}
+
+// Classic single backtrack point glob match: when an element fails, retry
+// from the most recent '*' with it covering one more character.
+inline bool WildcardMatcher::tailMatches(const Tail& tail, const char* name, const char* end) const
+{
+	if ( (uint32_t)(end - name) < tail.minLength )
+		return false;
+	// trailing literals can only line up with the end of the name
+	const Element* const elements = &_elements[tail.start];
+	const uint32_t count = tail.count - tail.suffixLength;
+	const char* suffix = end - tail.suffixLength;
+	for (uint32_t i=0; i < tail.suffixLength; ++i) {
+		if ( elements[count + i].literal != (uint8_t)suffix[i] )
+			return false;
+	}
+	end = suffix;
+
+	uint32_t e = 0;
+	const char* s = name;
+	uint32_t starElement = 0;
+	const char* starName = NULL;
+	while ( s != end ) {
+		if ( (e < count) && (elements[e].kind == kAnyString) ) {
+			starElement = ++e;
+			starName = s;
+		}
+		else if ( (e < count) && elementMatches(elements[e], (uint8_t)*s) ) {
+			++e;
+			++s;
+		}
+		else if ( starName != NULL ) {
+			e = starElement;
+			s = ++starName;
+		}
+		else {
+			return false;
+		}
+	}
+	while ( (e < count) && (elements[e].kind == kAnyString) )
+		++e;
+	return (e == count);
+}
+
+// walks name backwards from end (but not before name) down the suffix trie
+inline bool WildcardMatcher::suffixMatches(uint32_t root, const char* name, const char* end) const
+{
+	uint32_t node = root;
+	for (const char* s = end; s != name; ) {
+		node = child(_suffixNodes, node, (uint8_t)*--s);
+		if ( node == 0 )
+			return false;
+		if ( _suffixNodes[node].matchesAnyRest )
+			return true;
+	}
+	return false;
+}
+
+inline bool WildcardMatcher::matches(const char* name) const
+{
+	const char* end = &name[strlen(name)];
+	uint32_t node = 0;
+	for (const char* s = name; ; ++s) {
+		const Node& n = _nodes[node];
+		if ( n.matchesAnyRest )
+			return true;
+		if ( (n.suffixes != 0) && suffixMatches(n.suffixes, s, end) )
+			return true;
+		for (std::vector<uint32_t>::const_iterator it=n.tails.begin(); it != n.tails.end(); ++it) {
+			if ( tailMatches(_tails[*it], s, end) )
+				return true;
+		}
+		if ( s == end )
+			return false;
+		node = child(_nodes, node, (uint8_t)*s);
+		if ( node == 0 )
+			return false;
+	}
+}
+
+
+} // namespace tool
+} // namespace ld
+
+#endif // __WILDCARD_MATCHER_HPP__
@@ -67,6 +67,9 @@ extern "C" double log2 ( double );
 #include "Resolver.h"
 #include "OutputFile.h"
 #include "Snapshot.h"
+#include "Parallel.hpp"
+#include "Arena.hpp"
+#include "Timing.hpp"
 
 #include "passes/stubs/make_stubs.h"
 #include "passes/dtrace_dof.h"
@@ -1267,6 +1270,31 @@ static void printTime(const char* msg, uint64_t partTime, uint64_t totalTime)
 }
 
 
+static void runPass(const char* name, void (*pass)(const Options&, ld::Internal&), const Options& options, ld::Internal& state)
+{
+	ld::timing::Scope timer(name);
+	pass(options, state);
+}
+
+
+static void countAtomsAndFixups(const ld::Internal& state)
+{
+	uint64_t atomCount = 0;
+	uint64_t fixupCount = 0;
+	for (std::vector<ld::Internal::FinalSection*>::const_iterator sit = state.sections.begin(); sit != state.sections.end(); ++sit) {
+		const ld::Internal::FinalSection* sect = *sit;
+		atomCount += sect->atoms.size();
+		for (std::vector<const ld::Atom*>::const_iterator ait = sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
+			const ld::Atom* atom = *ait;
+			for (ld::Fixup::iterator fit = atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit)
+				++fixupCount;
+		}
+	}
+	ld::timing::count("output atoms", atomCount);
+	ld::timing::count("output fixups", fixupCount);
+}
+
+
 static void getVMInfo(vm_statistics_data_t& info)
 {
 	mach_msg_type_number_t count = sizeof(vm_statistics_data_t) / sizeof(natural_t);
@@ -1312,9 +1340,15 @@ int main(int argc, const char* argv[])
 		// allow libLTO to be overridden by command line -lto_library
 		sOverridePathlibLTO = options.overridePathlibLTO();
 		
+		// -threads limits every parallel phase, including input file parsing
+		if ( options.threadCount() != 0 )
+			ld::parallel::setWorkerCount(options.threadCount());
+		
 		// gather vm stats
 		if ( options.printStatistics() )
 			getVMInfo(statistics.vmStart);
+		if ( options.printStatistics() || (options.statisticsTraceFile() != NULL) )
+			ld::timing::enable();
 
 		// update strings for error messages
 		showArch = options.printArchPrefix();
@@ -1339,30 +1373,36 @@ int main(int argc, const char* argv[])
 
 		// run passes
 		statistics.startPasses = mach_absolute_time();
-		ld::passes::objc::doPass(options, state);
-		ld::passes::stubs::doPass(options, state);
-		ld::passes::huge::doPass(options, state);
-		ld::passes::got::doPass(options, state);
-		ld::passes::tlvp::doPass(options, state);
-		ld::passes::dylibs::doPass(options, state);	// must be after stubs and GOT passes
-		ld::passes::order::doPass(options, state);
+		runPass("objc", &ld::passes::objc::doPass, options, state);
+		runPass("stubs", &ld::passes::stubs::doPass, options, state);
+		runPass("huge", &ld::passes::huge::doPass, options, state);
+		runPass("got", &ld::passes::got::doPass, options, state);
+		runPass("tlvp", &ld::passes::tlvp::doPass, options, state);
+		runPass("dylibs", &ld::passes::dylibs::doPass, options, state);	// must be after stubs and GOT passes
+		runPass("order", &ld::passes::order::doPass, options, state);
 		state.markAtomsOrdered();
-		ld::passes::dedup::doPass(options, state);
-		ld::passes::branch_shim::doPass(options, state);	// must be after stubs
+		runPass("dedup", &ld::passes::dedup::doPass, options, state);
+		runPass("branch_shim", &ld::passes::branch_shim::doPass, options, state);	// must be after stubs
 		// We have multiple code sections and these might require intermediate branch
 		// islands, we need to ensure that the layout of the __TEXT segment is known
 		// before we do this.
-		state.sortSections(/* useQuick */true);
-		ld::passes::branch_island::doPass(options, state);	// must be after stubs and order pass
-		ld::passes::dtrace::doPass(options, state);
-		ld::passes::compact_unwind::doPass(options, state);  // must be after order pass
+		{
+			ld::timing::Scope timer("sort sections");
+			state.sortSections(/* useQuick */true);
+		}
+		runPass("branch_island", &ld::passes::branch_island::doPass, options, state);	// must be after stubs and order pass
+		runPass("dtrace", &ld::passes::dtrace::doPass, options, state);
+		runPass("compact_unwind", &ld::passes::compact_unwind::doPass, options, state);  // must be after order pass
 #ifdef LTO_SUPPORT
-		ld::passes::bitcode_bundle::doPass(options, state);  // must be after dylib
+		runPass("bitcode_bundle", &ld::passes::bitcode_bundle::doPass, options, state);  // must be after dylib
 #endif
 		// sort final sections
 		// Use a stable sort so that assumptions made in branch islanding don't get
 		// broken.
-		state.sortSections(/* useQuick */false);
+		{
+			ld::timing::Scope timer("sort sections");
+			state.sortSections(/* useQuick */false);
+		}
 
 		// write output file
 		statistics.startOutput = mach_absolute_time();
@@ -1370,6 +1410,20 @@ int main(int argc, const char* argv[])
 		out.write(state);
 		statistics.startDone = mach_absolute_time();
 		
+		if ( ld::timing::enabled() ) {
+			ld::timing::addPhase("option parsing", statistics.startTool, statistics.startInputFileProcessing);
+			ld::timing::addPhase("object file processing", statistics.startInputFileProcessing, statistics.startResolver);
+			ld::timing::addPhase("resolve symbols", statistics.startResolver, statistics.startDylibs);
+			ld::timing::addPhase("build atom list", statistics.startDylibs, statistics.startPasses);
+			ld::timing::addPhase("passes", statistics.startPasses, statistics.startOutput);
+			ld::timing::addPhase("write output", statistics.startOutput, statistics.startDone);
+			countAtomsAndFixups(state);
+			if ( options.statisticsTraceFile() != NULL ) {
+				if ( !ld::timing::writeTraceFile(options.statisticsTraceFile(), statistics.startTool, statistics.startDone) )
+					warning("could not write statistics trace file %s, errno=%d", options.statisticsTraceFile(), errno);
+			}
+		}
+
 		// print statistics
 		//mach_o::relocatable::printCounts();
 		if ( options.printStatistics() ) {
@@ -1387,10 +1441,17 @@ int main(int argc, const char* argv[])
 								statistics.vmEnd.pageouts-statistics.vmStart.pageouts, 
 								statistics.vmEnd.faults-statistics.vmStart.faults);
 			char temp[40];
+			char temp2[40];
+			uint64_t arenaAllocated;
+			uint64_t arenaReserved;
+			ld::arena::statistics(arenaAllocated, arenaReserved);
+			fprintf(stderr, "parser arena allocated %15s bytes, in chunks totaling %15s bytes\n", commatize(arenaAllocated, temp), commatize(arenaReserved, temp2));
 			fprintf(stderr, "processed %3u object files,  totaling %15s bytes\n", inputFiles._totalObjectLoaded, commatize(inputFiles._totalObjectSize, temp));
 			fprintf(stderr, "processed %3u archive files, totaling %15s bytes\n", inputFiles._totalArchivesLoaded, commatize(inputFiles._totalArchiveSize, temp));
 			fprintf(stderr, "processed %3u dylib files\n", inputFiles._totalDylibsLoaded);
+			fprintf(stderr, "searched for undefines in %u rounds, %15s names\n", resolver._undefinesRounds, commatize(resolver._undefinesVisited, temp));
 			fprintf(stderr, "wrote output file            totaling %15s bytes\n", commatize(out.fileSize(), temp));
+			ld::timing::printStatistics(stderr, totalTime);
 		}
 		// <rdar://problem/6780050> Would like linker warning to be build error.
 		if ( options.errorBecauseOfWarnings() ) {
@@ -70,6 +70,14 @@ public:
 		virtual void		doFile(const class File&) = 0;
 	};
 
+	class NameHandler {
+	public:
+		virtual				~NameHandler() {}
+		virtual void		doName(const char* name) = 0;
+		// false if name is only looked at during doName(), so it can be a scratch buffer
+		virtual bool		keepsNames() const		{ return true; }
+	};
+
 	//
 	// ld::File::Ordinal 
 	//
@@ -115,6 +123,9 @@ public:
 		
 		const bool validOrdinal() const { return _ordinal != 0; }
 		
+		// orders the same way as the Ordinal, for packing into sort keys
+		const uint64_t value() const { return _ordinal; }
+		
 		bool operator ==(const Ordinal& rhs) const { return _ordinal == rhs._ordinal; }
 		bool operator !=(const Ordinal& rhs) const {	return _ordinal != rhs._ordinal; }
 		bool operator < (const Ordinal& rhs) const { return _ordinal < rhs._ordinal; }
@@ -286,6 +297,15 @@ namespace dylib {
 		virtual bool						hasWeakExternals() const = 0;
 		virtual bool						deadStrippable() const = 0;
 		virtual bool						hasWeakDefinition(const char* name) const = 0;
+		// names this dylib or the dylibs it re-exports may provide, can include names justInTimeforEachAtom() rejects
+		virtual void						forEachExportedName(NameHandler&) const = 0;
+		// like forEachExportedName(), but only the names already loaded, which is cheap for
+		// dylibs that look their exports up lazily.  Those dylibs return true from
+		// hasUnloadedExports(), and the names they may provide are a superset of what is reported.
+		virtual void						forEachLoadedExportName(NameHandler&) const = 0;
+		virtual bool						hasUnloadedExports() const = 0;
+		// number of dylibs found so far that this dylib re-exports, directly or through other dylibs
+		virtual uint32_t					reExportedDylibCount() const = 0;
 		virtual bool						hasPublicInstallName() const = 0;
 		virtual bool						allSymbolsAreWeakImported() const = 0;
 		virtual bool						installPathVersionSpecific() const { return false; }
@@ -322,6 +342,10 @@ namespace archive {
 												: ld::File(pth, modTime, ord, Archive) { }
 		virtual								~File() {}
 		virtual bool						justInTimeDataOnlyforEachAtom(const char* name, AtomHandler&) const = 0;
+		// names in the table of contents that justInTimeforEachAtom() may load a member for
+		virtual void						forEachTableOfContentsName(NameHandler&) const = 0;
+		// hint that justInTimeforEachAtom() is about to be called for these names
+		virtual void						parseAhead(const std::vector<const char*>& names) const { }
 	};
 } // namespace archive 
 
@@ -699,12 +723,12 @@ public:
 											Atom(const Section& sect, Definition d, Combine c, Scope s, ContentType ct, 
 												SymbolTableInclusion i, bool dds, bool thumb, bool al, Alignment a) :  
 													_section(&sect), _address(0), _alignmentModulus(a.modulus), 
-													_alignmentPowerOf2(a.powerOf2), _definition(d), _combine(c),   
+													_alignmentPowerOf2(a.powerOf2), _live(false), _definition(d), _combine(c),   
 													_dontDeadStrip(dds), _thumb(thumb), _alias(al), _autoHide(false), 
 													_contentType(ct), _symbolTableInclusion(i),
 													_scope(s), _mode(modeSectionOffset), 
 													_overridesADylibsWeakDef(false), _coalescedAway(false),
-													_live(false), _dontDeadStripIfRefLive(false),
+													_dontDeadStripIfRefLive(false),
 													_machoSection(0), _weakImportState(weakImportUnset)
 													 {
 													#ifndef NDEBUG
@@ -752,6 +776,7 @@ public:
 	void									setDontDeadStripIfReferencesLive() { _dontDeadStripIfRefLive = true; }
 	void									setLive()					{ _live = true; }
 	void									setLive(bool value)			{ _live = value; }
+	bool									trySetLive()				{ return __sync_bool_compare_and_swap(&_live, 0, 1); }
 	void									setMachoSection(unsigned x) { assert(x != 0); assert(x < 256); _machoSection = x; }
 	void									setSectionOffset(uint64_t o){ assert(_mode == modeSectionOffset); _address = o; _mode = modeSectionOffset; }
 	void									setSectionStartAddress(uint64_t a) { assert(_mode == modeSectionOffset); _address += a; _mode = modeFinalAddress; }
@@ -812,6 +837,7 @@ protected:
 	uint64_t							_address;
 	uint16_t							_alignmentModulus;
 	uint8_t								_alignmentPowerOf2;
+	volatile uint8_t					_live;		// not a bit field so dead stripping can set it atomically
 	Definition							_definition : 2;
 	Combine								_combine : 2;
 	bool								_dontDeadStrip : 1;
@@ -821,10 +847,9 @@ protected:
 	ContentType							_contentType : 5;
 	SymbolTableInclusion				_symbolTableInclusion : 3;
 	Scope								_scope : 2;
-	AddressMode							_mode: 2;
+	AddressMode							_mode: 1;
 	bool								_overridesADylibsWeakDef : 1;
 	bool								_coalescedAway : 1;
-	bool								_live : 1;
 	bool								_dontDeadStripIfRefLive : 1;
 	unsigned							_machoSection : 8;
 	WeakImportState						_weakImportState : 2;
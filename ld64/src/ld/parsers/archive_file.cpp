@@ -25,9 +25,14 @@
 #include <stdint.h>
 #include <math.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <mach-o/ranlib.h>
 #include <ar.h>
+#include <CommonCrypto/CommonDigest.h>
 
 #include <vector>
 #include <set>
@@ -37,6 +42,8 @@
 
 #include "MachOFileAbstraction.hpp"
 #include "Architectures.hpp"
+#include "Parallel.hpp"
+#include "Arena.hpp"
 
 #include "macho_relocatable_file.h"
 #ifdef LTO_SUPPORT
@@ -52,6 +59,42 @@ namespace archive {
 template <typename A> class File;
 
 
+//
+// The table of contents is looked up through an open addressing hash table
+// with a power of two number of slots.  Each used slot has the hash of a name
+// and the index of the first ranlib entry with that name.  Nothing in it points
+// into memory, so with -archive_toc_cache_path it is saved next to nothing but
+// a small header and later links map it instead of hashing every name again.
+//
+struct TOCSlot {
+	uint32_t	hash;
+	uint32_t	tocIndex;
+};
+
+struct TOCCacheHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	tocCount;
+	uint64_t	archiveLength;
+	int64_t		modTime;
+	uint32_t	slotCount;
+	uint32_t	pad;
+};
+
+enum { kTOCCacheVersion = 1 };
+static const char		kTOCCacheMagic[8] = { 'l', 'd', 't', 'o', 'c', 'c', 'h', '1' };
+static const uint32_t	kEmptyTOCSlot = 0xFFFFFFFF;
+
+// FNV-1a, which unlike std::hash is the same in every process that reads the cache
+static uint32_t tocHash(const char* name)
+{
+	uint32_t hash = 2166136261U;
+	for (const uint8_t* p = (uint8_t*)name; *p != '\0'; ++p)
+		hash = (hash ^ *p) * 16777619U;
+	return hash;
+}
+
+
 template <typename A>
 class Parser 
 {
@@ -64,7 +107,7 @@ public:
 	static File<A>*									parse(const uint8_t* fileContent, uint64_t fileLength, 
 															const char* path, time_t mTime, 
 															ld::File::Ordinal ordinal, const ParserOptions& opts) {
-															 return new File<A>(fileContent, fileLength, path, mTime,
+															 return new (ld::arena::allocate(sizeof(File<A>))) File<A>(fileContent, fileLength, path, mTime,
 																			ordinal, opts);
 														}
 
@@ -88,6 +131,8 @@ public:
 	
 	// overrides of ld::archive::File
 	virtual bool										justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHandler& handler) const;
+	virtual void										forEachTableOfContentsName(ld::File::NameHandler& handler) const;
+	virtual void										parseAhead(const std::vector<const char*>& names) const;
 
 private:
 	static bool										validMachOFile(const uint8_t* fileContent, uint64_t fileLength, 
@@ -115,20 +160,24 @@ private:
 	struct MemberState { ld::relocatable::File* file; const Entry *entry; bool logged; bool loaded; uint32_t index;};
 	bool											loadMember(MemberState& state, ld::File::AtomHandler& handler, const char *format, ...) const;
 
-	typedef std::unordered_map<const char*, uint64_t, ld::CStringHash, ld::CStringEquals> NameToOffsetMap;
-
 	typedef typename A::P							P;
 	typedef typename A::P::E						E;
 
 	typedef std::map<const class Entry*, MemberState> MemberToStateMap;
 
+	static mach_o::relocatable::ParserOptions		memberParserOptions(const mach_o::relocatable::ParserOptions& opts);
+	MemberState&									memberState(const Entry* member) const;
 	MemberState&									makeObjectFileForMember(const Entry* member) const;
+	ld::relocatable::File*							parseMember(const Entry* member, uint32_t memberIndex) const;
+	void											parseMembers(std::vector<const Entry*>& members) const;
 	bool											memberHasObjCCategories(const Entry* member) const;
 	void											dumpTableOfContents();
-	void											buildHashTable();
-#ifdef SYMDEF_64
-	void											buildHashTable64();
-#endif
+	const char*										tocEntryName(uint32_t tocIndex) const;
+	uint64_t										tocEntryOffset(uint32_t tocIndex) const;
+	const Entry*									memberForName(const char* name) const;
+	void											buildHashTable(const char* tocCachePath);
+	bool											mapHashTable(const char* cacheFilePath);
+	void											saveHashTable(const char* cacheFilePath) const;
 	const uint8_t*									_archiveFileContent;
 	uint64_t										_archiveFilelength;
 	const struct ranlib*							_tableOfContents;
@@ -138,7 +187,9 @@ private:
 	uint32_t										_tableOfContentCount;
 	const char*										_tableOfContentStrings;
 	mutable MemberToStateMap						_instantiatedEntries;
-	NameToOffsetMap									_hashTable;
+	const TOCSlot*									_tocSlots;
+	uint32_t										_tocSlotCount;
+	std::vector<TOCSlot>							_tocSlotStorage;
 	const bool										_forceLoadAll;
 	const bool										_forceLoadObjC;
 	const bool										_forceLoadThis;
@@ -290,9 +341,10 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 	_tableOfContents64(NULL),
 #endif
 	_tableOfContentCount(0), _tableOfContentStrings(NULL),
+	_tocSlots(NULL), _tocSlotCount(0),
 	_forceLoadAll(opts.forceLoadAll), _forceLoadObjC(opts.forceLoadObjC), 
 	_forceLoadThis(opts.forceLoadThisArchive), _objc2ABI(opts.objcABI2), _verboseLoad(opts.verboseLoad), 
-	_logAllFiles(opts.logAllFiles), _objOpts(opts.objOpts)
+	_logAllFiles(opts.logAllFiles), _objOpts(memberParserOptions(opts.objOpts))
 {
 	if ( strncmp((const char*)fileContent, "!<arch>\n", 8) != 0 )
 		throw "not an archive";
@@ -310,7 +362,7 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 			if ( ((uint8_t*)(&_tableOfContents[_tableOfContentCount]) > &fileContent[fileLength])
 				|| ((uint8_t*)_tableOfContentStrings > &fileContent[fileLength]) )
 				throw "malformed archive, perhaps wrong architecture";
-			this->buildHashTable();
+			this->buildHashTable(opts.tocCachePath);
 		}
 #ifdef SYMDEF_64
 		else if ( (strcmp(memberName, SYMDEF_64_SORTED) == 0) || (strcmp(memberName, SYMDEF_64) == 0) ) {
@@ -322,7 +374,7 @@ File<A>::File(const uint8_t fileContent[], uint64_t fileLength, const char* pth,
 			if ( ((uint8_t*)(&_tableOfContents[_tableOfContentCount]) > &fileContent[fileLength])
 				|| ((uint8_t*)_tableOfContentStrings > &fileContent[fileLength]) )
 				throw "malformed archive, perhaps wrong architecture";
-			this->buildHashTable64();
+			this->buildHashTable(opts.tocCachePath);
 		}
 #endif
 		else
@@ -361,36 +413,57 @@ bool File<A>::memberHasObjCCategories(const Entry* member) const
 
 
 template <typename A>
-typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+typename File<A>::MemberState& File<A>::memberState(const Entry* member) const
 {
-	uint32_t memberIndex = 0;
 	// in case member was instantiated earlier but not needed yet
 	typename MemberToStateMap::iterator pos = _instantiatedEntries.find(member);
-	if ( pos == _instantiatedEntries.end() ) {
-		// Have to find the index of this member
-		const Entry* start;
-		uint32_t index;
-		if (_instantiatedEntries.size() == 0) {
-			start = (Entry*)&_archiveFileContent[8];
-			index = 1;
-		} else {
-			MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
-			start = lastKnown.entry->next();
-			index = lastKnown.index+1;
-		}
-		for (const Entry* p=start; p <= member; p = p->next(), index++) {
-			MemberState state = {NULL, p, false, false, index};
-			_instantiatedEntries[p] = state;
-			if (member == p) {
-				memberIndex = index;
-			}
-		}
+	if ( pos != _instantiatedEntries.end() )
+		return pos->second;
+
+	// Have to find the index of this member
+	const Entry* start;
+	uint32_t index;
+	if (_instantiatedEntries.size() == 0) {
+		start = (Entry*)&_archiveFileContent[8];
+		index = 1;
 	} else {
-		MemberState& state = pos->second;
-		if (state.file)
-			return state;
-		memberIndex = state.index;
+		MemberState &lastKnown = _instantiatedEntries.rbegin()->second;
+		start = lastKnown.entry->next();
+		index = lastKnown.index+1;
+	}
+	for (const Entry* p=start; p <= member; p = p->next(), index++) {
+		MemberState state = {NULL, p, false, false, index};
+		_instantiatedEntries[p] = state;
 	}
+	return _instantiatedEntries[member];
+}
+
+
+// Members may be parsed ahead on other threads and never loaded, so -t
+// logs them in loadMember() instead of when they are parsed.
+template <typename A>
+mach_o::relocatable::ParserOptions File<A>::memberParserOptions(const mach_o::relocatable::ParserOptions& opts)
+{
+	mach_o::relocatable::ParserOptions memberOpts = opts;
+	memberOpts.logAllFiles = false;
+	return memberOpts;
+}
+
+
+template <typename A>
+typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* member) const
+{
+	MemberState& state = this->memberState(member);
+	if ( state.file == NULL )
+		state.file = this->parseMember(member, state.index);
+	return state;
+}
+
+
+// Does not touch _instantiatedEntries, so it can be called on several members at once
+template <typename A>
+ld::relocatable::File* File<A>::parseMember(const Entry* member, uint32_t memberIndex) const
+{
 	assert(memberIndex != 0);
 	char memberName[256];
 	member->getName(memberName, sizeof(memberName));
@@ -406,27 +479,21 @@ typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* mem
 			throwf("corrupt archive, member starts past end of file");										
 		if ( (member->content() + member->contentSize()) > (_archiveFileContent+_archiveFilelength) )
 			throwf("corrupt archive, member contents extends past end of file");										
-		const char* mPath = strdup(memberPath);
+		const char* mPath = ld::arena::copyString(memberPath);
 		// see if member is mach-o file
 		ld::File::Ordinal ordinal = this->ordinal().archiveOrdinalWithMemberIndex(memberIndex);
 		ld::relocatable::File* result = mach_o::relocatable::parse(member->content(), member->contentSize(), 
 																	mPath, member->modificationTime(), 
 																	ordinal, _objOpts);
-		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
-			_instantiatedEntries[member] = state;
-			return _instantiatedEntries[member];
-		}
+		if ( result != NULL )
+			return result;
 #ifdef LTO_SUPPORT
 		// see if member is llvm bitcode file
 		result = lto::parse(member->content(), member->contentSize(), 
 								mPath, member->modificationTime(), ordinal, 
-								_objOpts.architecture, _objOpts.subType, _logAllFiles, _objOpts.verboseOptimizationHints);
-		if ( result != NULL ) {
-			MemberState state = {result, member, false, false, memberIndex};
-			_instantiatedEntries[member] = state;
-			return _instantiatedEntries[member];
-		}
+								_objOpts.architecture, _objOpts.subType, false, _objOpts.verboseOptimizationHints);
+		if ( result != NULL )
+			return result;
 		throwf("archive member '%s' with length %d is not mach-o or llvm bitcode", memberName, member->contentSize());
 #else
 		throwf("archive member '%s' with length %d is not mach-o", memberName, member->contentSize());
@@ -438,6 +505,59 @@ typename File<A>::MemberState& File<A>::makeObjectFileForMember(const Entry* mem
 }
 
 
+//
+// Parses the mach-o members in the list that are not parsed yet, spread over
+// the parallel workers.  This is speculative: a member that fails to parse is
+// left alone, and the error is reported if and when the member is loaded.
+// Bitcode members are always left to makeObjectFileForMember().
+//
+template <typename A>
+void File<A>::parseMembers(std::vector<const Entry*>& members) const
+{
+	std::sort(members.begin(), members.end());
+	members.erase(std::unique(members.begin(), members.end()), members.end());
+
+	// _instantiatedEntries is not thread safe, so look up states first
+	std::vector<MemberState*> states;
+	const uint8_t* const fileEnd = _archiveFileContent + _archiveFilelength;
+	for (const Entry* member : members) {
+		if ( ((uint8_t*)member + sizeof(ar_hdr) > fileEnd) || (member->content() + member->contentSize() > fileEnd) )
+			continue;
+		MemberState& state = this->memberState(member);
+		if ( (state.file == NULL) && validMachOFile(member->content(), member->contentSize(), _objOpts) )
+			states.push_back(&state);
+	}
+	if ( states.size() < 2 )
+		return;
+
+	ld::parallel::forEach(states.size(), [&](size_t i) {
+		try {
+			states[i]->file = this->parseMember(states[i]->entry, states[i]->index);
+		}
+		catch (const char* msg) {
+			// leave it for makeObjectFileForMember() to report if the member is needed
+		}
+	});
+}
+
+
+template <typename A>
+void File<A>::parseAhead(const std::vector<const char*>& names) const
+{
+	// in force load case, all members already loaded
+	if ( _forceLoadAll || _forceLoadThis ) 
+		return;
+
+	std::vector<const Entry*> members;
+	for (const char* name : names) {
+		const Entry* member = this->memberForName(name);
+		if ( member != NULL )
+			members.push_back(member);
+	}
+	this->parseMembers(members);
+}
+
+
 template <typename A>
 bool File<A>::loadMember(MemberState& state, ld::File::AtomHandler& handler, const char *format, ...) const
 {
@@ -451,6 +571,9 @@ bool File<A>::loadMember(MemberState& state, ld::File::AtomHandler& handler, con
 			state.logged = true;
 		}
 		state.loaded = true;
+		// respond to -t option
+		if ( _logAllFiles )
+			printf("%s\n", state.file->path());
 		didSomething = state.file->forEachAtom(handler);
 	}
 	return didSomething;
@@ -465,6 +588,12 @@ bool File<A>::forEachAtom(ld::File::AtomHandler& handler) const
 		// call handler on all .o files in this archive
 		const Entry* const start = (Entry*)&_archiveFileContent[8];
 		const Entry* const end = (Entry*)&_archiveFileContent[_archiveFilelength];
+		std::vector<const Entry*> members;
+		for (const Entry* p=start; p < end; p = p->next()) {
+			if ( p != start )
+				members.push_back(p);
+		}
+		this->parseMembers(members);
 		for (const Entry* p=start; p < end; p = p->next()) {
 			char memberName[256];
 			p->getName(memberName, sizeof(memberName));
@@ -480,9 +609,12 @@ bool File<A>::forEachAtom(ld::File::AtomHandler& handler) const
 	}
 	else if ( _forceLoadObjC ) {
 		// call handler on all .o files in this archive containing objc classes
-		for (const auto& entry : _hashTable) {
-			if ( (strncmp(entry.first, ".objc_c", 7) == 0) || (strncmp(entry.first, "_OBJC_CLASS_$_", 14) == 0) ) {
-				const Entry* member = (Entry*)&_archiveFileContent[entry.second];
+		for (uint32_t i=0; i < _tocSlotCount; ++i) {
+			if ( _tocSlots[i].tocIndex == kEmptyTOCSlot )
+				continue;
+			const char* name = this->tocEntryName(_tocSlots[i].tocIndex);
+			if ( (strncmp(name, ".objc_c", 7) == 0) || (strncmp(name, "_OBJC_CLASS_$_", 14) == 0) ) {
+				const Entry* member = (Entry*)&_archiveFileContent[this->tocEntryOffset(_tocSlots[i].tocIndex)];
 				MemberState& state = this->makeObjectFileForMember(member);
 				char memberName[256];
 				member->getName(memberName, sizeof(memberName));
@@ -538,18 +670,29 @@ bool File<A>::justInTimeforEachAtom(const char* name, ld::File::AtomHandler& han
 		return false;
 	
 	// do a hash search of table of contents looking for requested symbol
-	const auto& pos = _hashTable.find(name);
-	if ( pos == _hashTable.end() )
+	const Entry* member = this->memberForName(name);
+	if ( member == NULL )
 		return false;
 
-	// do a hash search of table of contents looking for requested symbol
-	const Entry* member = (Entry*)&_archiveFileContent[pos->second];
 	MemberState& state = this->makeObjectFileForMember(member);
 	char memberName[256];
 	member->getName(memberName, sizeof(memberName));
 	return loadMember(state, handler, "%s forced load of %s(%s)\n", name, this->path(), memberName);
 }
 
+template <typename A>
+void File<A>::forEachTableOfContentsName(ld::File::NameHandler& handler) const
+{
+	// in force load case, all members already loaded
+	if ( _forceLoadAll || _forceLoadThis ) 
+		return;
+
+	for (uint32_t i=0; i < _tocSlotCount; ++i) {
+		if ( _tocSlots[i].tocIndex != kEmptyTOCSlot )
+			handler.doName(this->tocEntryName(_tocSlots[i].tocIndex));
+	}
+}
+
 class CheckIsDataSymbolHandler : public ld::File::AtomHandler
 {
 public:
@@ -577,11 +720,10 @@ bool File<A>::justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHand
 		return false;
 	
 	// do a hash search of table of contents looking for requested symbol
-	const auto& pos = _hashTable.find(name);
-	if ( pos == _hashTable.end() )
+	const Entry* member = this->memberForName(name);
+	if ( member == NULL )
 		return false;
 
-	const Entry* member = (Entry*)&_archiveFileContent[pos->second];
 	MemberState& state = this->makeObjectFileForMember(member);
 	// only call handler for each member once
 	if ( ! state.loaded ) {
@@ -599,45 +741,177 @@ bool File<A>::justInTimeDataOnlyforEachAtom(const char* name, ld::File::AtomHand
 }
 
 template <typename A>
-void File<A>::buildHashTable()
+const char* File<A>::tocEntryName(uint32_t tocIndex) const
 {
-	// walk through list backwards, adding/overwriting entries
-	// this assures that with duplicates those earliest in the list will be found
-	for (int i = _tableOfContentCount-1; i >= 0; --i) {
-		const struct ranlib* entry = &_tableOfContents[i];
-		const char* entryName = &_tableOfContentStrings[E::get32(entry->ran_un.ran_strx)];
-		uint64_t offset = E::get32(entry->ran_off);
-		if ( offset > _archiveFilelength ) {
-			throwf("malformed archive TOC entry for %s, offset %d is beyond end of file %lld\n",
-				entryName, entry->ran_off, _archiveFilelength);
-		}
-		
-		//const Entry* member = (Entry*)&_archiveFileContent[E::get32(entry->ran_off)];
-		//fprintf(stderr, "adding hash %d, %s -> %p\n", i, entryName, entry);
-		_hashTable[entryName] = offset;
-	}
+#ifdef SYMDEF_64
+	if ( _tableOfContents64 != NULL )
+		return &_tableOfContentStrings[E::get64(_tableOfContents64[tocIndex].ran_un.ran_strx)];
+#endif
+	return &_tableOfContentStrings[E::get32(_tableOfContents[tocIndex].ran_un.ran_strx)];
 }
 
+template <typename A>
+uint64_t File<A>::tocEntryOffset(uint32_t tocIndex) const
+{
 #ifdef SYMDEF_64
+	if ( _tableOfContents64 != NULL )
+		return E::get64(_tableOfContents64[tocIndex].ran_off);
+#endif
+	return E::get32(_tableOfContents[tocIndex].ran_off);
+}
+
 template <typename A>
-void File<A>::buildHashTable64()
+const typename File<A>::Entry* File<A>::memberForName(const char* name) const
 {
-	// walk through list backwards, adding/overwriting entries
-	// this assures that with duplicates those earliest in the list will be found
-	for (int i = _tableOfContentCount-1; i >= 0; --i) {
-		const struct ranlib_64* entry = &_tableOfContents64[i];
-		const char* entryName = &_tableOfContentStrings[E::get64(entry->ran_un.ran_strx)];
-		uint64_t offset = E::get64(entry->ran_off);
+	if ( _tocSlotCount == 0 )
+		return NULL;
+	const uint32_t hash = tocHash(name);
+	const uint32_t mask = _tocSlotCount - 1;
+	for (uint32_t probe=0, i=(hash & mask); probe < _tocSlotCount; ++probe, i=((i+1) & mask)) {
+		const TOCSlot& slot = _tocSlots[i];
+		if ( slot.tocIndex == kEmptyTOCSlot )
+			break;
+		if ( (slot.hash == hash) && (slot.tocIndex < _tableOfContentCount) && (strcmp(this->tocEntryName(slot.tocIndex), name) == 0) )
+			return (Entry*)&_archiveFileContent[this->tocEntryOffset(slot.tocIndex)];
+	}
+	return NULL;
+}
+
+template <typename A>
+void File<A>::buildHashTable(const char* tocCachePath)
+{
+	// a cached table only records which entry each slot holds, so the entries
+	// themselves must be checked whether or not the table comes from the cache
+	for (uint32_t tocIndex=0; tocIndex < _tableOfContentCount; ++tocIndex) {
+		uint64_t offset = this->tocEntryOffset(tocIndex);
 		if ( offset > _archiveFilelength ) {
 			throwf("malformed archive TOC entry for %s, offset %lld is beyond end of file %lld\n",
-				entryName, entry->ran_off, _archiveFilelength);
+				this->tocEntryName(tocIndex), offset, _archiveFilelength);
 		}
+	}
+
+	char cacheFilePath[PATH_MAX];
+	if ( tocCachePath != NULL ) {
+		// cache files are named for the archive (slice) and its mod time and size
+		const uint64_t key[] = { (uint64_t)architecture(), (uint64_t)this->modificationTime(), _archiveFilelength };
+		uint8_t digest[CC_MD5_DIGEST_LENGTH];
+		CC_MD5_CTX md5state;
+		CC_MD5_Init(&md5state);
+		CC_MD5_Update(&md5state, key, sizeof(key));
+		CC_MD5_Update(&md5state, this->path(), strlen(this->path()));
+		CC_MD5_Final(digest, &md5state);
+		char name[2*CC_MD5_DIGEST_LENGTH+1];
+		for (int i=0; i < CC_MD5_DIGEST_LENGTH; ++i)
+			sprintf(&name[2*i], "%02x", digest[i]);
+		snprintf(cacheFilePath, PATH_MAX, "%s/%s.ldtoc", tocCachePath, name);
+		if ( this->mapHashTable(cacheFilePath) )
+			return;
+	}
+
+	uint32_t slotCount = 1;
+	while ( slotCount < 2*_tableOfContentCount )
+		slotCount *= 2;
+	TOCSlot emptySlot = { 0, kEmptyTOCSlot };
+	_tocSlotStorage.assign(slotCount, emptySlot);
+	_tocSlots = &_tocSlotStorage[0];
+	_tocSlotCount = slotCount;
 
-		//fprintf(stderr, "adding hash %d: %s -> 0x%0llX\n", i, entryName, offset);
-		_hashTable[entryName] = offset;
+	// walk through list forwards, skipping names already added
+	// this assures that with duplicates those earliest in the list will be found
+	const uint32_t mask = slotCount - 1;
+	for (uint32_t tocIndex=0; tocIndex < _tableOfContentCount; ++tocIndex) {
+		const char* entryName = this->tocEntryName(tocIndex);
+		const uint32_t hash = tocHash(entryName);
+		for (uint32_t i = (hash & mask); ; i = ((i+1) & mask)) {
+			TOCSlot& slot = _tocSlotStorage[i];
+			if ( slot.tocIndex == kEmptyTOCSlot ) {
+				slot.hash = hash;
+				slot.tocIndex = tocIndex;
+				break;
+			}
+			if ( (slot.hash == hash) && (strcmp(this->tocEntryName(slot.tocIndex), entryName) == 0) )
+				break;
+		}
 	}
+
+	if ( tocCachePath != NULL )
+		this->saveHashTable(cacheFilePath);
+}
+
+template <typename A>
+bool File<A>::mapHashTable(const char* cacheFilePath)
+{
+	int fd = ::open(cacheFilePath, O_RDONLY, 0);
+	if ( fd == -1 )
+		return false;
+	struct stat statBuffer;
+	if ( (::fstat(fd, &statBuffer) != 0) || (statBuffer.st_size < (off_t)sizeof(TOCCacheHeader)) ) {
+		::close(fd);
+		return false;
+	}
+	void* p = ::mmap(NULL, statBuffer.st_size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( p == (void*)(-1) )
+		return false;
+	const TOCCacheHeader* header = (TOCCacheHeader*)p;
+	if ( (memcmp(header->magic, kTOCCacheMagic, sizeof(kTOCCacheMagic)) != 0)
+		|| (header->version != kTOCCacheVersion)
+		|| (header->tocCount != _tableOfContentCount)
+		|| (header->archiveLength != _archiveFilelength)
+		|| (header->modTime != (int64_t)this->modificationTime())
+		|| (header->slotCount == 0)
+		|| ((header->slotCount & (header->slotCount-1)) != 0)
+		|| ((uint64_t)statBuffer.st_size != sizeof(TOCCacheHeader) + (uint64_t)header->slotCount*sizeof(TOCSlot)) ) {
+		::munmap(p, statBuffer.st_size);
+		return false;
+	}
+	// mapping stays for the life of the link
+	_tocSlots = (TOCSlot*)&header[1];
+	_tocSlotCount = header->slotCount;
+	return true;
+}
+
+template <typename A>
+void File<A>::saveHashTable(const char* cacheFilePath) const
+{
+	// the cache is best effort, a file that cannot be written is just not cached
+	TOCCacheHeader header;
+	bzero(&header, sizeof(header));
+	memcpy(header.magic, kTOCCacheMagic, sizeof(kTOCCacheMagic));
+	header.version			= kTOCCacheVersion;
+	header.tocCount			= _tableOfContentCount;
+	header.archiveLength	= _archiveFilelength;
+	header.modTime			= this->modificationTime();
+	header.slotCount		= _tocSlotCount;
+
+	// write to a temp file and rename, so concurrent links never see a partial file
+	char tmpPath[PATH_MAX];
+	snprintf(tmpPath, PATH_MAX, "%s.XXXXXX", cacheFilePath);
+	int fd = ::mkstemp(tmpPath);
+	if ( fd == -1 ) {
+		// create cache directory on first use
+		char dir[PATH_MAX];
+		strlcpy(dir, cacheFilePath, PATH_MAX);
+		char* lastSlash = strrchr(dir, '/');
+		if ( (errno != ENOENT) || (lastSlash == NULL) )
+			return;
+		*lastSlash = '\0';
+		if ( ::mkdir(dir, 0755) != 0 )
+			return;
+		snprintf(tmpPath, PATH_MAX, "%s.XXXXXX", cacheFilePath);
+		fd = ::mkstemp(tmpPath);
+		if ( fd == -1 )
+			return;
+	}
+	bool ok = (::write(fd, &header, sizeof(header)) == sizeof(header));
+	const size_t slotsSize = _tocSlotCount*sizeof(TOCSlot);
+	if ( ok && (::write(fd, _tocSlots, slotsSize) != (ssize_t)slotsSize) )
+		ok = false;
+	if ( ::close(fd) != 0 )
+		ok = false;
+	if ( !ok || (::rename(tmpPath, cacheFilePath) != 0) )
+		::unlink(tmpPath);
 }
-#endif
 
 template <typename A>
 void File<A>::dumpTableOfContents()
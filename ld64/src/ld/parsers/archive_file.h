@@ -38,6 +38,7 @@ struct ParserOptions {
 	bool								objcABI2;
 	bool								verboseLoad;
 	bool								logAllFiles;
+	const char*							tocCachePath;	// directory of table of contents hash tables, or NULL
 };
 
 extern ld::archive::File* parse(const uint8_t* fileContent, uint64_t fileLength, 
@@ -26,6 +26,7 @@
 #define __GENERIC_DYLIB_FILE_H__
 
 #include "ld.hpp"
+#include "Arena.hpp"
 #include "Options.h"
 #include <unordered_map>
 #include <unordered_set>
@@ -112,7 +113,7 @@ ImportAtom<A>::ImportAtom(File<A>& f, std::vector<const char*>& imports)
 	  _file(f)
 {
 	for(auto *name : imports)
-		_undefs.emplace_back(0, ld::Fixup::k1of1, ld::Fixup::kindNone, false, strdup(name));
+		_undefs.emplace_back(0, ld::Fixup::k1of1, ld::Fixup::kindNone, false, ld::arena::copyString(name));
 }
 
 //
@@ -146,6 +147,10 @@ public:
 	virtual bool							hasWeakExternals() const override final	{ return _hasWeakExports; }
 	virtual bool							deadStrippable() const override final { return _deadStrippable; }
 	virtual bool							hasWeakDefinition(const char* name) const override final;
+	virtual void							forEachExportedName(ld::File::NameHandler&) const override final;
+	virtual void							forEachLoadedExportName(ld::File::NameHandler&) const override final;
+	virtual bool							hasUnloadedExports() const override final;
+	virtual uint32_t						reExportedDylibCount() const override final;
 	virtual bool							hasPublicInstallName() const override final { return _hasPublicInstallName; }
 	virtual bool							allSymbolsAreWeakImported() const override final;
 	virtual bool							installPathVersionSpecific() const override final { return _installPathOverride; }
@@ -185,6 +190,7 @@ private:
 	using NameToAtomMap = std::unordered_map<const char*, AtomAndWeak, ld::CStringHash, ld::CStringEquals>;
 	using NameSet = std::unordered_set<const char*, CStringHash, ld::CStringEquals>;
 
+	bool						findExport(const char* name, AtomAndWeak& info) const;
 	std::pair<bool, bool>		hasWeakDefinitionImpl(const char* name) const;
 	bool						containsOrReExports(const char* name, bool& weakDef, bool& tlv, pint_t& addr) const;
 	void						assertNoReExportCycles(ReExportChain*) const;
@@ -192,6 +198,14 @@ private:
 protected:
 	bool						isPublicLocation(const char* path) const;
 
+	// Readers that look exports up where they lie in the file, instead of putting
+	// them all in _atoms up front, override these.  A lookup only reads the file,
+	// so it is safe from any thread; the export is added to _atoms when
+	// justInTimeforEachAtom() makes its atom.
+	virtual bool				loadsExportsLazily() const { return false; }
+	virtual bool				findUnloadedExport(const char* name, AtomAndWeak& info) const { return false; }
+	virtual void				forEachUnloadedExportName(ld::File::NameHandler&) const { }
+
 private:
 	ld::Section							_importProxySection;
 	ld::Section							_flatDummySection;
@@ -268,11 +282,22 @@ File<A>::File(const char* path, time_t mTime, ld::File::Ordinal ord,  Options::P
 }
 
 template <typename A>
-std::pair<bool, bool> File<A>::hasWeakDefinitionImpl(const char* name) const
+bool File<A>::findExport(const char* name, AtomAndWeak& info) const
 {
 	const auto pos = _atoms.find(name);
-	if ( pos != this->_atoms.end() )
-		return std::make_pair(true, pos->second.weakDef);
+	if ( pos != _atoms.end() ) {
+		info = pos->second;
+		return true;
+	}
+	return findUnloadedExport(name, info);
+}
+
+template <typename A>
+std::pair<bool, bool> File<A>::hasWeakDefinitionImpl(const char* name) const
+{
+	AtomAndWeak info;
+	if ( findExport(name, info) )
+		return std::make_pair(true, info.weakDef);
 
 	// look in re-exported libraries.
 	for (const auto &dep : _dependentDylibs) {
@@ -295,6 +320,56 @@ bool File<A>::hasWeakDefinition(const char* name) const
 	return hasWeakDefinitionImpl(name).second;
 }
 
+template <typename A>
+void File<A>::forEachExportedName(ld::File::NameHandler& handler) const
+{
+	for (const auto& entry : _atoms)
+		handler.doName(entry.first);
+	forEachUnloadedExportName(handler);
+
+	// names from re-exported dylibs, a superset of what containsOrReExports() will accept
+	for (const auto& dep : _dependentDylibs) {
+		if ( dep.reExport && (dep.dylib != nullptr) )
+			dep.dylib->forEachExportedName(handler);
+	}
+}
+
+template <typename A>
+void File<A>::forEachLoadedExportName(ld::File::NameHandler& handler) const
+{
+	for (const auto& entry : _atoms)
+		handler.doName(entry.first);
+
+	for (const auto& dep : _dependentDylibs) {
+		if ( dep.reExport && (dep.dylib != nullptr) )
+			dep.dylib->forEachLoadedExportName(handler);
+	}
+}
+
+template <typename A>
+bool File<A>::hasUnloadedExports() const
+{
+	if ( loadsExportsLazily() )
+		return true;
+
+	for (const auto& dep : _dependentDylibs) {
+		if ( dep.reExport && (dep.dylib != nullptr) && dep.dylib->hasUnloadedExports() )
+			return true;
+	}
+	return false;
+}
+
+template <typename A>
+uint32_t File<A>::reExportedDylibCount() const
+{
+	uint32_t count = 0;
+	for (const auto& dep : _dependentDylibs) {
+		if ( dep.reExport && (dep.dylib != nullptr) )
+			count += 1 + dep.dylib->reExportedDylibCount();
+	}
+	return count;
+}
+
 template <typename A>
 bool File<A>::containsOrReExports(const char* name, bool& weakDef, bool& tlv, pint_t& addr) const
 {
@@ -302,11 +377,11 @@ bool File<A>::containsOrReExports(const char* name, bool& weakDef, bool& tlv, pi
 		return false;
 
 	// check myself
-	const auto pos = _atoms.find(name);
-	if ( pos != _atoms.end() ) {
-		weakDef = pos->second.weakDef;
-		tlv = pos->second.tlv;
-		addr = pos->second.address;
+	AtomAndWeak info;
+	if ( findExport(name, info) ) {
+		weakDef = info.weakDef;
+		tlv = info.tlv;
+		addr = info.address;
 		return true;
 	}
 
@@ -345,7 +420,7 @@ bool File<A>::justInTimeforEachAtom(const char* name, ld::File::AtomHandler& han
 
 	AtomAndWeak bucket;
 	if ( containsOrReExports(name, bucket.weakDef, bucket.tlv, bucket.address) ) {
-		bucket.atom = new ExportAtom<A>(*this, name, bucket.weakDef, bucket.tlv, bucket.address);
+		bucket.atom = new (ld::arena::allocate(sizeof(ExportAtom<A>))) ExportAtom<A>(*this, name, bucket.weakDef, bucket.tlv, bucket.address);
 		_atoms[name] = bucket;
 		_providedAtom = true;
 		if ( _s_logHashtable )
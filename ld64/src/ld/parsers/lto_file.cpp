@@ -44,6 +44,7 @@
 #include "MachOFileAbstraction.hpp"
 #include "Architectures.hpp"
 #include "ld.hpp"
+#include "Arena.hpp"
 #include "macho_relocatable_file.h"
 #include "lto_file.h"
 
@@ -80,7 +81,7 @@ public:
 	// for adding references to symbols outside bitcode file
 	void										addReference(const char* nm)
 																	{ _undefs.push_back(ld::Fixup(0, ld::Fixup::k1of1, 
-																				ld::Fixup::kindNone, false, strdup(nm))); }
+																				ld::Fixup::kindNone, false, ld::arena::copyString(nm))); }
 private:
 
 	ld::File&									_file;
@@ -350,7 +351,7 @@ const char* Parser::fileKind(const uint8_t* p, uint64_t fileLength)
 File* Parser::parse(const uint8_t* fileContent, uint64_t fileLength, const char* path, time_t modTime, ld::File::Ordinal ordinal,
 													cpu_type_t architecture, cpu_subtype_t subarch, bool logAllFiles, bool verboseOptimizationHints) 
 {
-	File* f = new File(path, modTime, ordinal, fileContent, fileLength, architecture);
+	File* f = new (ld::arena::allocate(sizeof(File))) File(path, modTime, ordinal, fileContent, fileLength, architecture);
 	_s_files.push_back(f);
 	if ( logAllFiles ) 
 		printf("%s\n", path);
@@ -380,6 +381,8 @@ ld::relocatable::File* Parser::parseMachOFile(const uint8_t* p, size_t len, cons
 	objOpts.treateBitcodeAsData = false;
 	objOpts.usingBitcode		= options.bitcodeBundle;
 	objOpts.maxDefaultCommonAlignment = options.maxDefaultCommonAlignment;
+	objOpts.objectCachePath		= NULL;
+	objOpts.parallelParseMinSize = options.parallelParseMinSize;
 
 	const char *object_path = path.c_str();
 	if (path.empty())
@@ -435,7 +438,7 @@ File::File(const char* pth, time_t mTime, ld::File::Ordinal ordinal, const uint8
 
 	// create atom for each global symbol in module
 	uint32_t count = ::lto_module_get_num_symbols(_module);
-	_atomArray = (Atom*)malloc(sizeof(Atom)*count);
+	_atomArray = ld::arena::allocateArray<Atom>(count);
 	for (uint32_t i=0; i < count; ++i) {
 		const char* name = ::lto_module_get_symbol_name(_module, i);
 		lto_symbol_attributes attr = lto_module_get_symbol_attribute(_module, i);
@@ -580,7 +583,7 @@ Atom::Atom(File& f, const char* nm, ld::Atom::Scope s, ld::Atom::Definition d, l
 			ld::Atom::Alignment a, bool ah)
 	: ld::Atom(f._section, d, c, s, ld::Atom::typeLTOtemporary, 
 				ld::Atom::symbolTableIn, false, false, false, a),
-		_file(f), _name(strdup(nm)), _compiledAtom(NULL)
+		_file(f), _name(ld::arena::copyString(nm)), _compiledAtom(NULL)
 {
 	if ( ah )
 		this->setAutoHide();
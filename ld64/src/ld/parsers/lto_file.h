@@ -71,6 +71,7 @@ struct OptimizeOptions {
 	bool								ignoreMismatchPlatform;
 	bool								bitcodeBundle;
 	uint8_t								maxDefaultCommonAlignment;
+	uint64_t							parallelParseMinSize;
 	cpu_type_t							arch;
 	const char*							mcpu;
 	Options::Platform					platform;
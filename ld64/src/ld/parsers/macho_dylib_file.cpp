@@ -54,6 +54,10 @@ namespace dylib {
 // dylib, builds a hash table, then unmaps the file.  This is an important memory
 // savings for large dylibs.
 //
+// Dylibs with an export trie are the exception: most of the names exported by a
+// big umbrella framework are never referenced, so instead of hashing them all,
+// names are looked up in the trie where it lies in the still mapped file.
+//
 template <typename A>
 class File final : public generic::dylib::File<A>
 {
@@ -82,12 +86,18 @@ private:
 														const macho_nlist<P>* symbolTable, const char* strings,
 														const uint8_t* fileContent);
 	void				addSymbol(const char* name, bool weakDef = false, bool tlv = false, pint_t address = 0);
+	void				addSymbol(const mach_o::trie::Entry& entry);
+	virtual bool		loadsExportsLazily() const override final { return (_exportTrieStart != nullptr); }
+	virtual bool		findUnloadedExport(const char* name, typename Base::AtomAndWeak& info) const override final;
+	virtual void		forEachUnloadedExportName(ld::File::NameHandler&) const override final;
 	static const char*	objCInfoSegmentName();
 	static const char*	objCInfoSectionName();
 
 
-	uint64_t  _fileLength;
-	uint32_t  _linkeditStartOffset;
+	uint64_t		_fileLength;
+	uint32_t		_linkeditStartOffset;
+	const uint8_t*	_exportTrieStart;		// non-null if exports are looked up in the mapped trie
+	const uint8_t*	_exportTrieEnd;
 
 };
 
@@ -106,7 +116,8 @@ File<A>::File(const uint8_t* fileContent, uint64_t fileLength, const char* path,
 			  bool allowSimToMacOSX, bool addVers, bool buildingForSimulator, bool logAllFiles,
 			  const char* targetInstallPath, bool indirectDylib, bool ignoreMismatchPlatform, bool usingBitcode)
 	: Base(strdup(path), mTime, ord, platform, linkMinOSVersion, allowWeakImports, linkingFlatNamespace,
-		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _fileLength(fileLength), _linkeditStartOffset(0)
+		   hoistImplicitPublicDylibs, allowSimToMacOSX, addVers), _fileLength(fileLength), _linkeditStartOffset(0),
+		   _exportTrieStart(nullptr), _exportTrieEnd(nullptr)
 {
 	const macho_header<P>* header = (const macho_header<P>*)fileContent;
 	const uint32_t cmd_count = header->ncmds();
@@ -479,8 +490,9 @@ File<A>::File(const uint8_t* fileContent, uint64_t fileLength, const char* path,
 	else
 		buildExportHashTableFromSymbolTable(dynamicInfo, symbolTable, strings, fileContent);
 	
-	// unmap file
-	munmap((caddr_t)fileContent, fileLength);
+	// unmap file, unless exports are looked up in it later
+	if ( _exportTrieStart == nullptr )
+		munmap((caddr_t)fileContent, fileLength);
 }
 
 template <typename A>
@@ -528,16 +540,63 @@ void File<A>::buildExportHashTableFromExportInfo(const macho_dyld_info_command<P
 		const uint8_t* end = &start[dyldInfo->export_size()];
 		if ( (dyldInfo->export_off() + dyldInfo->export_size()) > _fileLength )
 			throwf("malformed mach-o dylib, exports trie extends beyond end of file, ");
+		// only the $ld$ meta-data symbols need to be looked at now, everything else is
+		// found by findUnloadedExport() when it is needed
 		std::vector<mach_o::trie::Entry> list;
-		parseTrie(start, end, list);
+		mach_o::trie::parseTrieWithPrefix(start, end, "$ld$", list);
 		for (const auto &entry : list)
-			this->addSymbol(entry.name,
-							entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION,
-							(entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL,
-							entry.address);
+			this->addSymbol(entry);
+		_exportTrieStart = start;
+		_exportTrieEnd = end;
 	}
 }
 
+template <typename A>
+void File<A>::addSymbol(const mach_o::trie::Entry& entry)
+{
+	this->addSymbol(entry.name,
+					entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION,
+					(entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL,
+					entry.address);
+}
+
+template <typename A>
+bool File<A>::findUnloadedExport(const char* name, typename Base::AtomAndWeak& info) const
+{
+	if ( _exportTrieStart == nullptr )
+		return false;
+	// $ld$ symbols were all handled by addSymbol() when the dylib was loaded
+	if ( strncmp(name, "$ld$", 4) == 0 )
+		return false;
+	if ( this->_ignoreExports.count(name) != 0 )
+		return false;
+	mach_o::trie::Entry entry;
+	if ( !mach_o::trie::findTrieEntry(_exportTrieStart, _exportTrieEnd, name, entry) )
+		return false;
+	if ( this->_s_logHashtable )
+		fprintf(stderr, "  found %s in export trie of %s\n", name, this->path());
+	info.atom = nullptr;
+	info.weakDef = (entry.flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION);
+	info.tlv = ((entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL);
+	info.address = entry.address;
+	return true;
+}
+
+template <typename A>
+void File<A>::forEachUnloadedExportName(ld::File::NameHandler& handler) const
+{
+	if ( _exportTrieStart == nullptr )
+		return;
+	// the trie walk only has a scratch copy of each name, so copy it if the handler keeps it.
+	// Names already in _atoms were reported by forEachExportedName(), don't report them again.
+	const bool keepsNames = handler.keepsNames();
+	auto reportName = [&](const char* name) {
+		if ( (strncmp(name, "$ld$", 4) != 0) && (this->_atoms.count(name) == 0) )
+			handler.doName(keepsNames ? ld::arena::copyString(name) : name);
+	};
+	mach_o::trie::forEachTrieName(_exportTrieStart, _exportTrieEnd, reportName);
+}
+
 template <typename A>
 void File<A>::addSymbol(const char* name, bool weakDef, bool tlv, pint_t address)
 {
@@ -596,7 +655,7 @@ void File<A>::addSymbol(const char* name, bool weakDef, bool tlv, pint_t address
 		typename Base::AtomAndWeak bucket = { nullptr, weakDef, tlv, address };
 		if ( this->_s_logHashtable )
 			fprintf(stderr, "  adding %s to hash table for %s\n", name, this->path());
-		this->_atoms[strdup(name)] = bucket;
+		this->_atoms[ld::arena::copyString(name)] = bucket;
 	}
 }
 
@@ -630,7 +689,7 @@ public:
 								  time_t mTime, ld::File::Ordinal ordinal, const Options& opts,
 								  bool indirectDylib)
 	{
-		return new File<A>(fileContent, fileLength, path, mTime, ordinal, opts.flatNamespace(),
+		return new (ld::arena::allocate(sizeof(File<A>))) File<A>(fileContent, fileLength, path, mTime, ordinal, opts.flatNamespace(),
 						   opts.linkingMainExecutable(), opts.implicitlyLinkIndirectPublicDylibs(),
 						   opts.platform(), opts.minOSversion(), opts.allowWeakImports(),
 						   opts.allowSimulatorToLinkWithMacOSX(), opts.addVersionLoadCommand(),
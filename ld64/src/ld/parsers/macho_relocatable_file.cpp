@@ -31,6 +31,10 @@
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <mach-o/loader.h>
+#include <CommonCrypto/CommonDigest.h>
 
 #include "MachOFileAbstraction.hpp"
 
@@ -39,8 +43,10 @@
 #include "libunwind/Registers.hpp"
 
 #include <vector>
+#include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <type_traits>
 #include <memory>
@@ -51,6 +57,9 @@
 #include "Architectures.hpp"
 #include "Bitcode.hpp"
 #include "ld.hpp"
+#include "Arena.hpp"
+#include "Parallel.hpp"
+#include "StringHash.hpp"
 #include "macho_relocatable_file.h"
 
 extern void throwf(const char* format, ...) __attribute__ ((noreturn,format(printf, 1, 2)));
@@ -75,6 +84,7 @@ public:
 												ld::relocatable::File(p,mTime,ord), _fileContent(content),
 												_sectionsArray(NULL), _atomsArray(NULL),
 												_sectionsArrayCount(0), _atomsArrayCount(0), _aliasAtomsArrayCount(0),
+												_fixups(NULL), _fixupsCount(0),
 												_debugInfoKind(ld::relocatable::File::kDebugInfoNone),
 												_dwarfTranslationUnitPath(NULL), 
 												_dwarfDebugInfoSect(NULL), _dwarfDebugAbbrevSect(NULL), 
@@ -126,7 +136,8 @@ private:
 	uint32_t								_sectionsArrayCount;
 	uint32_t								_atomsArrayCount;
 	uint32_t								_aliasAtomsArrayCount;
-	std::vector<ld::Fixup>					_fixups;
+	ld::Fixup*								_fixups;
+	uint32_t								_fixupsCount;
 	std::vector<ld::Atom::UnwindInfo>		_unwindInfos;
 	std::vector<ld::Atom::LineInfo>			_lineInfos;
 	std::vector<ld::relocatable::File::Stab>_stabs;
@@ -183,6 +194,8 @@ public:
 
 
 protected:	
+	friend class Parser<A>;
+
 						Section(File<A>& f, const macho_section<typename A::P>* s)
 							: ld::Section(makeSegmentName(s), makeSectionName(s), sectionType(s)),
 								_file(f), _machOSection(s), _beginAtoms(NULL), _endAtoms(NULL), _hasAliases(false) { }
@@ -690,11 +703,15 @@ class CStringSection : public ImplicitSizeSection<A>
 {
 public:
 						CStringSection(Parser<A>& parser, File<A>& f, const macho_section<typename A::P>* s)
-							: ImplicitSizeSection<A>(parser, f, s) {}
+							: ImplicitSizeSection<A>(parser, f, s), _lastElementAddr((typename A::P::uint_t)(-1)), _lastElementSize(0) {}
 protected:
 	typedef typename A::P::uint_t	pint_t;
 	typedef typename A::P			P;
 
+	// splitting the section asks for the size of each string several times
+	pint_t							_lastElementAddr;
+	pint_t							_lastElementSize;
+
 	virtual ld::Atom::ContentType	contentType()							{ return ld::Atom::typeCString; }
 	virtual	Atom<A>*				findAtomByAddress(pint_t addr);
 	virtual const char*				unlabeledAtomName(Parser<A>&, pint_t)	{ return "cstring"; }
@@ -864,7 +881,7 @@ void Atom<A>::setFixupsRange(uint32_t startIndex, uint32_t count)
 		throwf("too many fixups in function %s", this->name());
 	if ( startIndex >= (1 << kFixupStartIndexBits) ) 
 		throwf("too many fixups in file");
-	assert(((startIndex+count) <= sect().file()._fixups.size()) && "fixup index out of range");
+	assert(((startIndex+count) <= sect().file()._fixupsCount) && "fixup index out of range");
 	_fixupsStartIndex = startIndex; 
 	_fixupsCount = count; 
 }
@@ -981,6 +998,198 @@ private:
 ld::Section AliasAtom::_s_section("__LD", "__aliases", ld::Section::typeTempAlias, true);
 
 
+//
+// Object cache (-object_cache_path)
+//
+// An entry records the result of the expensive part of Parser<A>::parse():
+// where the sections were split into atoms, each atom's attributes, the
+// fixups and the compact unwind info.  Load commands, Section objects, alias
+// atoms and debug info are cheap to recompute and are still built from the
+// .o file, which stays mapped, so atom content and most names keep pointing
+// into it.  An entry is named by an MD5 of the file's path, modification
+// time, size, content, the ParserOptions and the LC_UUID of the linker
+// binary, so it is only used for the very same input parsed the very same
+// way by the very same linker.  The entry stores raw ld::Fixup::Kind and
+// other enum values, which may change between any two linker builds, so a
+// linker without an LC_UUID does not use the cache at all.
+//
+// Layout: ObjectCacheHeader, then sectionCount ObjectCacheSection, atomCount
+// ObjectCacheAtom, fixupCount ObjectCacheFixup, unwindInfoCount
+// ld::Atom::UnwindInfo, and finally the string pool.
+//
+enum { kObjectCacheVersion = 2 };
+static const char		kObjectCacheMagic[8] = { 'l', 'd', 'o', 'b', 'j', 'c', 'h', '2' };
+static const uint32_t	kObjectCacheNoString = 0xFFFFFFFF;	// NULL string
+static const uint32_t	kObjectCachePoolString = 0x80000000;	// else offset into .o file
+static const uint32_t	kObjectCacheNoAtom = 0xFFFFFFFF;
+
+struct ObjectCacheHeader {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	sectionCount;
+	uint32_t	atomCount;
+	uint32_t	fixupCount;
+	uint32_t	unwindInfoCount;
+	uint32_t	stringPoolSize;
+	uint64_t	fileLength;
+	uint8_t		key[CC_MD5_DIGEST_LENGTH];
+	uint8_t		linkerUUID[16];
+};
+
+struct ObjectCacheSection {
+	uint32_t	beginAtom;
+	uint32_t	endAtom;
+};
+
+struct ObjectCacheAtom {
+	enum { kAutoHide=1, kDontDeadStrip=2, kThumb=4, kAlias=8, kDontDeadStripIfReferencesLive=16 };
+	uint64_t	objectAddress;
+	uint64_t	size;
+	uint32_t	name;
+	uint32_t	sectionIndex;
+	uint32_t	fixupsStart;
+	uint32_t	fixupsCount;
+	uint32_t	unwindInfoStart;
+	uint16_t	alignmentModulus;
+	uint8_t		alignmentPowerOf2;
+	uint8_t		unwindInfoCount;
+	uint8_t		definition;
+	uint8_t		combine;
+	uint8_t		scope;
+	uint8_t		contentType;
+	uint8_t		symbolTableInclusion;
+	uint8_t		flags;
+	uint8_t		pad[2];
+};
+
+struct ObjectCacheFixup {
+	enum { kWeakImport=1, kContentAddendOnly=2, kContentDeltaToAddendOnly=4, kContentIgnoresAddend=8,
+			kValueIsAtomIndex=16, kValueIsString=32 };
+	uint64_t	value;
+	uint32_t	offsetInAtom;
+	uint8_t		kind;
+	uint8_t		clusterSize;
+	uint8_t		binding;
+	uint8_t		flags;
+};
+
+static uint8_t			sLinkerUUID[16];
+static bool				sHaveLinkerUUID = false;
+static pthread_once_t	sLinkerUUIDOnce = PTHREAD_ONCE_INIT;
+
+static void findLinkerUUID()
+{
+	// the image containing this code, which is ld itself (or the tool linking this parser)
+	Dl_info info;
+	if ( (dladdr((void*)&findLinkerUUID, &info) == 0) || (info.dli_fbase == NULL) )
+		return;
+	const struct mach_header* mh = (struct mach_header*)info.dli_fbase;
+	const uint8_t* p = (uint8_t*)mh + ((mh->magic == MH_MAGIC_64) ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+	for (uint32_t i=0; i < mh->ncmds; ++i) {
+		const struct load_command* cmd = (struct load_command*)p;
+		if ( cmd->cmd == LC_UUID ) {
+			memcpy(sLinkerUUID, ((struct uuid_command*)cmd)->uuid, sizeof(sLinkerUUID));
+			sHaveLinkerUUID = true;
+			return;
+		}
+		p += cmd->cmdsize;
+	}
+}
+
+// returns the LC_UUID of the linker, or NULL if it has none
+static const uint8_t* linkerUUID()
+{
+	pthread_once(&sLinkerUUIDOnce, &findLinkerUUID);
+	return sHaveLinkerUUID ? sLinkerUUID : NULL;
+}
+
+static void objectCacheKey(const uint8_t* fileContent, uint32_t fileLength, const char* path, time_t modTime,
+							const ParserOptions& opts, uint8_t key[CC_MD5_DIGEST_LENGTH])
+{
+	// everything in ParserOptions that can change the parse result
+	const uint32_t settings[] = { kObjectCacheVersion, opts.architecture, opts.objSubtypeMustMatch,
+		opts.warnUnwindConversionProblems, opts.keepDwarfUnwind, opts.forceDwarfConversion,
+		opts.neverConvertDwarf, opts.verboseOptimizationHints, opts.armUsesZeroCostExceptions,
+		opts.simulator, opts.ignoreMismatchPlatform, opts.subType, (uint32_t)opts.platform,
+		opts.minOSVersion, (uint32_t)opts.srcKind, opts.treateBitcodeAsData, opts.usingBitcode,
+		opts.maxDefaultCommonAlignment, (uint32_t)opts.osxMin };
+	const uint64_t fileInfo[] = { (uint64_t)modTime, fileLength };
+	CC_MD5_CTX md5state;
+	CC_MD5_Init(&md5state);
+	CC_MD5_Update(&md5state, settings, sizeof(settings));
+	CC_MD5_Update(&md5state, linkerUUID(), sizeof(sLinkerUUID));
+	CC_MD5_Update(&md5state, fileInfo, sizeof(fileInfo));
+	CC_MD5_Update(&md5state, path, strlen(path)+1);
+	CC_MD5_Update(&md5state, fileContent, fileLength);
+	CC_MD5_Final(key, &md5state);
+}
+
+static void objectCacheEntryPath(const char* cacheDir, const uint8_t key[CC_MD5_DIGEST_LENGTH], char path[PATH_MAX])
+{
+	char name[2*CC_MD5_DIGEST_LENGTH+1];
+	for (int i=0; i < CC_MD5_DIGEST_LENGTH; ++i)
+		sprintf(&name[2*i], "%02x", key[i]);
+	snprintf(path, PATH_MAX, "%s/%s.ldobj", cacheDir, name);
+}
+
+static uint64_t objectCacheEntrySize(const ObjectCacheHeader* header)
+{
+	return sizeof(ObjectCacheHeader)
+			+ (uint64_t)header->sectionCount * sizeof(ObjectCacheSection)
+			+ (uint64_t)header->atomCount * sizeof(ObjectCacheAtom)
+			+ (uint64_t)header->fixupCount * sizeof(ObjectCacheFixup)
+			+ (uint64_t)header->unwindInfoCount * sizeof(ld::Atom::UnwindInfo)
+			+ header->stringPoolSize;
+}
+
+//
+// Maps the cache entry for key, or returns NULL if there is no usable one.
+// A used entry stays mapped for the rest of the link because atom and fixup
+// names may point into its string pool.
+//
+static const ObjectCacheHeader* mapObjectCacheEntry(const char* cacheDir, const uint8_t key[CC_MD5_DIGEST_LENGTH], uint32_t fileLength)
+{
+	char path[PATH_MAX];
+	objectCacheEntryPath(cacheDir, key, path);
+	int fd = ::open(path, O_RDONLY, 0);
+	if ( fd == -1 )
+		return NULL;
+	struct stat statBuffer;
+	if ( (::fstat(fd, &statBuffer) != 0) || (statBuffer.st_size < (off_t)sizeof(ObjectCacheHeader)) ) {
+		::close(fd);
+		return NULL;
+	}
+	void* p = ::mmap(NULL, statBuffer.st_size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( p == (void*)(-1) )
+		return NULL;
+	const ObjectCacheHeader* header = (ObjectCacheHeader*)p;
+	if ( (memcmp(header->magic, kObjectCacheMagic, sizeof(kObjectCacheMagic)) != 0)
+		|| (header->version != kObjectCacheVersion)
+		|| (memcmp(header->key, key, CC_MD5_DIGEST_LENGTH) != 0)
+		|| (memcmp(header->linkerUUID, linkerUUID(), sizeof(header->linkerUUID)) != 0)
+		|| (header->fileLength != fileLength)
+		|| (objectCacheEntrySize(header) != (uint64_t)statBuffer.st_size) ) {
+		::munmap(p, statBuffer.st_size);
+		return NULL;
+	}
+	return header;
+}
+
+static bool objectCacheWrite(int fd, const void* buffer, size_t size)
+{
+	const uint8_t* p = (uint8_t*)buffer;
+	while ( size != 0 ) {
+		ssize_t amount = ::write(fd, p, size);
+		if ( amount <= 0 )
+			return false;
+		p += amount;
+		size -= amount;
+	}
+	return true;
+}
+
+
 template <typename A>
 class Parser 
 {
@@ -1023,49 +1232,49 @@ public:
 
 	struct FixupInAtom {
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, Atom<A>* target) :
-			fixup(src.offsetInAtom, c, k, target), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, target), atom(src.atom) { }
 			
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, ld::Fixup::TargetBinding b, Atom<A>* target) :
-			fixup(src.offsetInAtom, c, k, b, target), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, b, target), atom(src.atom) { }
 			
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, bool wi, const char* name) :
-			fixup(src.offsetInAtom, c, k, wi, name), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, wi, name), atom(src.atom) { }
 					
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, ld::Fixup::TargetBinding b, const char* name) :
-			fixup(src.offsetInAtom, c, k, b, name), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, b, name), atom(src.atom) { }
 					
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, uint64_t addend) :
-			fixup(src.offsetInAtom, c, k, addend), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, addend), atom(src.atom) { }
 
 		FixupInAtom(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k) :
-			fixup(src.offsetInAtom, c, k, (uint64_t)0), atom(src.atom) { src.atom->incrementFixupCount(); }
+			fixup(src.offsetInAtom, c, k, (uint64_t)0), atom(src.atom) { }
 
 		ld::Fixup		fixup;
 		Atom<A>*		atom;
 	};
 
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, Atom<A>* target) { 
-		_allFixups.push_back(FixupInAtom(src, c, k, target)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k, target)); 
 	}
 	
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, ld::Fixup::TargetBinding b, Atom<A>* target) { 
-		_allFixups.push_back(FixupInAtom(src, c, k, b, target)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k, b, target)); 
 	}
 	
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, bool wi, const char* name) { 
-		_allFixups.push_back(FixupInAtom(src, c, k, wi, name)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k, wi, name)); 
 	}
 	
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, ld::Fixup::TargetBinding b, const char* name) { 
-		_allFixups.push_back(FixupInAtom(src, c, k, b, name)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k, b, name)); 
 	}
 	
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k, uint64_t addend) { 
-		_allFixups.push_back(FixupInAtom(src, c, k, addend)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k, addend)); 
 	}
 
 	void addFixup(const SourceLocation& src, ld::Fixup::Cluster c, ld::Fixup::Kind k) { 
-		_allFixups.push_back(FixupInAtom(src, c, k)); 
+		_threadFixups->push_back(FixupInAtom(src, c, k)); 
 	}
 
 	const char*										path() { return _path; }
@@ -1088,7 +1297,7 @@ public:
 	uint32_t										machOSectionCount() { return _machOSectionsCount; }
 	uint32_t										undefinedStartIndex() { return _undefinedStartIndex; }
 	uint32_t										undefinedEndIndex() { return _undefinedEndIndex; }
-	void											addFixup(FixupInAtom f) { _allFixups.push_back(f); }
+	void											addFixup(FixupInAtom f) { _threadFixups->push_back(f); }
 	Section<A>*										sectionForNum(unsigned int sectNum);
 	Section<A>*										sectionForAddress(pint_t addr);
 	Atom<A>*										findAtomByAddress(pint_t addr);
@@ -1215,7 +1424,11 @@ private:
 
 	void											parseDebugInfo();
 	void											parseStabs();
+	void											makeAliasAtoms();
 	void											appendAliasAtoms(uint8_t* atomBuffer);
+	bool											restoreFromObjectCache(const ObjectCacheHeader* entry);
+	void											writeObjectCache(const char* cacheDir, const uint8_t key[CC_MD5_DIGEST_LENGTH]);
+	const char*										objectCacheString(uint32_t ref, const char* pool, uint32_t poolSize, bool* valid);
 	static bool										isConstFunStabs(const char *stabStr);
 	bool											read_comp_unit(const char ** name, const char ** comp_dir,
 																								uint64_t *stmt_list);
@@ -1278,9 +1491,14 @@ private:
 	const macho_section<P>*						_stubsMachOSections[3];
 	ld::MacVersionMin 							_osxMin;
 	std::vector<const char*>					_dtraceProviderInfo;
-	std::vector<FixupInAtom>					_allFixups;
+
+	// fixups made by the section whose makeFixups() is running on this thread
+	static __thread std::vector<FixupInAtom>*	_threadFixups;
 };
 
+template <typename A>
+__thread std::vector<typename Parser<A>::FixupInAtom>* Parser<A>::_threadFixups = NULL;
+
 
 
 template <typename A>
@@ -1780,23 +1998,11 @@ typename A::P::uint_t Parser<A>::realAddr(typename A::P::uint_t addr)
 	return addr;
 }
 
-#define STACK_ALLOC_IF_SMALL(_type, _name, _actual_count, _maxCount) \
-	_type*  _name = NULL;   \
-	uint32_t _name##_count = 1; \
-	if ( _actual_count > _maxCount ) \
-		_name = (_type*)malloc(sizeof(_type) * _actual_count); \
-	else \
-		_name##_count = _actual_count; \
-	_type  _name##_buffer[_name##_count]; \
-	if ( _name == NULL ) \
-		_name = _name##_buffer;
-
-
 template <typename A>
 ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 {
 	// create file object
-	_file = new File<A>(_path, _modTime, _fileContent, _ordinal);
+	_file = new (ld::arena::allocate(sizeof(File<A>))) File<A>(_path, _modTime, _fileContent, _ordinal);
 
 	// set sourceKind
 	_file->_srcKind = opts.srcKind;
@@ -1815,30 +2021,51 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	if ( ! parseLoadCommands(opts.platform, opts.minOSVersion, opts.simulator, opts.ignoreMismatchPlatform) )
 		return _file;
 	
+	// see if an earlier link left the atoms of this file in the object cache
+	uint8_t cacheKey[CC_MD5_DIGEST_LENGTH];
+	const ObjectCacheHeader* cacheEntry = NULL;
+	const bool useObjectCache = (opts.objectCachePath != NULL) && (linkerUUID() != NULL);
+	if ( useObjectCache ) {
+		objectCacheKey(_fileContent, _fileLength, _path, _modTime, opts, cacheKey);
+		cacheEntry = mapObjectCacheEntry(opts.objectCachePath, cacheKey, _fileLength);
+	}
+
 	// make array of
-	uint32_t sortedSectionIndexes[_machOSectionsCount];
-	this->makeSortedSectionsArray(sortedSectionIndexes);
+	// (these arrays are sized by the input, so they go on the heap, huge object files would overflow the stack)
+	std::vector<uint32_t> sortedSectionIndexes(_machOSectionsCount);
+	this->makeSortedSectionsArray(sortedSectionIndexes.data());
 	
 	// make symbol table sorted by address
 	this->prescanSymbolTable();
-	uint32_t sortedSymbolIndexes[_symbolsInSections];
-	this->makeSortedSymbolsArray(sortedSymbolIndexes, sortedSectionIndexes);
+	std::vector<uint32_t> sortedSymbolIndexes(_symbolsInSections);
+	if ( cacheEntry == NULL )
+		this->makeSortedSymbolsArray(sortedSymbolIndexes.data(), sortedSectionIndexes.data());
 		
 	// allocate Section<A> object for each mach-o section
 	makeSections();
 	
+	if ( cacheEntry != NULL ) {
+		if ( this->restoreFromObjectCache(cacheEntry) ) {
+			this->makeAliasAtoms();
+			this->parseDebugInfo();
+			return _file;
+		}
+		// entry does not fit this file after all, parse it the slow way
+		::munmap((void*)cacheEntry, objectCacheEntrySize(cacheEntry));
+		this->makeSortedSymbolsArray(sortedSymbolIndexes.data(), sortedSectionIndexes.data());
+	}
+
 	// if it exists, do special early parsing of __compact_unwind section
 	uint32_t countOfCUs = 0;
 	if ( _compactUnwindSection != NULL )
 		countOfCUs = _compactUnwindSection->count();
-	// stack allocate (if not too large) cuInfoBuffer
-	STACK_ALLOC_IF_SMALL(typename CUSection<A>::Info, cuInfoArray, countOfCUs, 1024);
+	std::vector<typename CUSection<A>::Info> cuInfoArray(countOfCUs);
 	if ( countOfCUs != 0 )
-		_compactUnwindSection->parse(*this, countOfCUs, cuInfoArray);
+		_compactUnwindSection->parse(*this, countOfCUs, cuInfoArray.data());
 
 	// create lists of address that already have compact unwind and thus don't need the dwarf parsed
 	unsigned cuLsdaCount = 0;
-	pint_t cuStarts[countOfCUs];
+	std::vector<pint_t> cuStarts(countOfCUs);
 	for (uint32_t i=0; i < countOfCUs; ++i) {
 		if ( CUSection<A>::encodingMeansUseDwarf(cuInfoArray[i].compactUnwindInfo) )
 			cuStarts[i] = -1;
@@ -1850,20 +2077,20 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	
 	
 	// if it exists, do special early parsing of __eh_frame section 
-	// stack allocate (if not too large) array of CFI_Atom_Info
+	// allocate array of CFI_Atom_Info
 	uint32_t countOfCFIs = 0;
 	if ( _EHFrameSection != NULL )
 		countOfCFIs = _EHFrameSection->cfiCount(*this);
-	STACK_ALLOC_IF_SMALL(typename CFISection<A>::CFI_Atom_Info, cfiArray, countOfCFIs, 1024);
+	std::vector<typename CFISection<A>::CFI_Atom_Info> cfiArray(countOfCFIs);
 	
-	// stack allocate (if not too large) a copy of __eh_frame to apply relocations to
+	// allocate a copy of __eh_frame to apply relocations to
 	uint32_t sectSize = 4;
 	if ( (countOfCFIs != 0) && _EHFrameSection->needsRelocating() ) 
 		sectSize = _EHFrameSection->machoSection()->size()+4;
-	STACK_ALLOC_IF_SMALL(uint8_t, ehBuffer, sectSize, 50*1024);
+	std::vector<uint8_t> ehBuffer(sectSize);
 	uint32_t cfiStartsCount = 0;
 	if ( countOfCFIs != 0 ) {
-		_EHFrameSection->cfiParse(*this, ehBuffer, cfiArray, countOfCFIs, cuStarts, countOfCUs);
+		_EHFrameSection->cfiParse(*this, ehBuffer.data(), cfiArray.data(), countOfCFIs, cuStarts.data(), countOfCUs);
 		// count functions and lsdas
 		for(uint32_t i=0; i < countOfCFIs; ++i) {
 			if ( cfiArray[i].isCIE )
@@ -1878,10 +2105,10 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 				++cfiStartsCount;
 		}
 	}
-	CFI_CU_InfoArrays cfis(cfiArray, countOfCFIs, cuInfoArray, countOfCUs);
+	CFI_CU_InfoArrays cfis(cfiArray.data(), countOfCFIs, cuInfoArray.data(), countOfCUs);
 	
 	// create sorted array of function starts and lsda starts
-	pint_t cfiStartsArray[cfiStartsCount+cuLsdaCount];
+	std::vector<pint_t> cfiStartsArray(cfiStartsCount+cuLsdaCount);
 	uint32_t countOfFDEs = 0;
 	uint32_t cfiStartsArrayCount = 0;
 	if ( countOfCFIs != 0 ) {
@@ -1912,7 +2139,7 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 		}
 	}
 	if ( cfiStartsArrayCount != 0 ) {
-		::qsort(cfiStartsArray, cfiStartsArrayCount, sizeof(pint_t), pointerSorter);
+		::qsort(cfiStartsArray.data(), cfiStartsArrayCount, sizeof(pint_t), pointerSorter);
 	#ifndef NDEBUG
 		// scan for FDEs claming the same function
 		for(uint32_t i=1; i < cfiStartsArrayCount; ++i) {
@@ -1924,40 +2151,81 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 	Section<A>** sections = _file->_sectionsArray;
 	uint32_t	sectionsCount = _file->_sectionsArrayCount;
 
+	// very large object files (such as LTO output) have their sections turned into atoms and fixups in parallel
+	const bool parallel = (_fileLength >= opts.parallelParseMinSize);
+
 	// figure out how many atoms will be allocated and allocate
-	LabelAndCFIBreakIterator breakIterator(sortedSymbolIndexes, _symbolsInSections, cfiStartsArray, 
+	LabelAndCFIBreakIterator breakIterator(sortedSymbolIndexes.data(), _symbolsInSections, cfiStartsArray.data(), 
 											cfiStartsArrayCount, _overlappingSymbols);
+	std::vector<LabelAndCFIBreakIterator> sectionBreakIterators;
+	std::vector<uint32_t> sectionAtomStarts;
+	sectionBreakIterators.reserve(sectionsCount);
+	sectionAtomStarts.reserve(sectionsCount);
 	uint32_t computedAtomCount = 0;
 	for (uint32_t i=0; i < sectionsCount; ++i ) {
 		breakIterator.beginSection();
+		// remember where each section starts, so sections can be split into atoms independently
+		sectionBreakIterators.push_back(breakIterator);
+		sectionAtomStarts.push_back(computedAtomCount);
 		uint32_t count = sections[i]->computeAtomCount(*this, breakIterator, cfis);
 		//const macho_section<P>* sect = sections[i]->machoSection();
 		//fprintf(stderr, "computed count=%u for section %s size=%llu\n", count, sect->sectname(), (sect != NULL) ? sect->size() : 0);
 		computedAtomCount += count;
 	}
 	//fprintf(stderr, "allocating %d atoms * sizeof(Atom<A>)=%ld, sizeof(ld::Atom)=%ld\n", computedAtomCount, sizeof(Atom<A>), sizeof(ld::Atom));
-	_file->_atomsArray = new uint8_t[computedAtomCount*sizeof(Atom<A>)];
+	_file->_atomsArray = ld::arena::allocateArray<uint8_t>(computedAtomCount*sizeof(Atom<A>));
 	_file->_atomsArrayCount = 0;
 	
-	// have each section append atoms to _atomsArray
-	LabelAndCFIBreakIterator breakIterator2(sortedSymbolIndexes, _symbolsInSections, cfiStartsArray, 
-												cfiStartsArrayCount, _overlappingSymbols);
+	// have each section append atoms to its part of _atomsArray
+	std::vector<uint32_t> sectionAtomCounts(sectionsCount);
+	auto appendSectionAtoms = [&](size_t i) {
+		uint8_t* atoms = _file->_atomsArray + sectionAtomStarts[i]*sizeof(Atom<A>);
+		LabelAndCFIBreakIterator sectionBreakIterator = sectionBreakIterators[i];
+		sectionAtomCounts[i] = sections[i]->appendAtoms(*this, atoms, sectionBreakIterator, cfis);
+		//fprintf(stderr, "append count=%u for section %s/%s\n", sectionAtomCounts[i], sections[i]->machoSection()->segname(), sections[i]->machoSection()->sectname());
+	};
+	if ( parallel ) {
+		ld::parallel::forEach(sectionsCount, appendSectionAtoms);
+	}
+	else {
+		for (uint32_t i=0; i < sectionsCount; ++i )
+			appendSectionAtoms(i);
+	}
 	for (uint32_t i=0; i < sectionsCount; ++i ) {
-		uint8_t* atoms = _file->_atomsArray + _file->_atomsArrayCount*sizeof(Atom<A>);
-		breakIterator2.beginSection();
-		uint32_t count = sections[i]->appendAtoms(*this, atoms, breakIterator2, cfis);
-		//fprintf(stderr, "append count=%u for section %s/%s\n", count, sections[i]->machoSection()->segname(), sections[i]->machoSection()->sectname());
-		_file->_atomsArrayCount += count;
+		assert( (sectionAtomStarts[i] == _file->_atomsArrayCount) && "more atoms allocated than expected");
+		_file->_atomsArrayCount += sectionAtomCounts[i];
 	}
 	assert( _file->_atomsArrayCount == computedAtomCount && "more atoms allocated than expected");
 
 	
-	// have each section add all fix-ups for its atoms
-	_allFixups.reserve(computedAtomCount*5);
-	for (uint32_t i=0; i < sectionsCount; ++i )
-		sections[i]->makeFixups(*this, cfis);
+	// have each section add all fix-ups for its atoms, into a vector of its own
+	std::vector<std::vector<FixupInAtom> > sectionFixups(sectionsCount);
+	auto makeSectionFixups = [&](size_t i) {
+		_threadFixups = &sectionFixups[i];
+		try {
+			sections[i]->makeFixups(*this, cfis);
+		}
+		catch (...) {
+			_threadFixups = NULL;
+			throw;
+		}
+		_threadFixups = NULL;
+	};
+	if ( parallel ) {
+		ld::parallel::forEach(sectionsCount, makeSectionFixups);
+	}
+	else {
+		for (uint32_t i=0; i < sectionsCount; ++i )
+			makeSectionFixups(i);
+	}
 	
-	// assign fixups start offset for each atom
+	// count fixups for each atom, then assign fixups start offset for each atom
+	uint32_t fixupCount = 0;
+	for (uint32_t i=0; i < sectionsCount; ++i ) {
+		for(typename std::vector<FixupInAtom>::iterator it=sectionFixups[i].begin(); it != sectionFixups[i].end(); ++it)
+			it->atom->incrementFixupCount();
+		fixupCount += sectionFixups[i].size();
+	}
 	uint8_t* p = _file->_atomsArray;
 	uint32_t fixupOffset = 0;
 	for(int i=_file->_atomsArrayCount; i > 0; --i) {
@@ -1967,18 +2235,18 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 		atom->_fixupsCount = 0;
 		p += sizeof(Atom<A>);
 	}
-	assert(fixupOffset == _allFixups.size());
-	_file->_fixups.resize(fixupOffset);
+	assert(fixupOffset == fixupCount);
+	_file->_fixups = ld::arena::allocateArray<ld::Fixup>(fixupOffset);
+	_file->_fixupsCount = fixupOffset;
 	
-	// copy each fixup for each atom 
-	for(typename std::vector<FixupInAtom>::iterator it=_allFixups.begin(); it != _allFixups.end(); ++it) {
-		uint32_t slot = it->atom->_fixupsStartIndex + it->atom->_fixupsCount;
-		_file->_fixups[slot] = it->fixup;
-		it->atom->_fixupsCount++;
+	// copy each fixup for each atom, in section order
+	for (uint32_t i=0; i < sectionsCount; ++i ) {
+		for(typename std::vector<FixupInAtom>::iterator it=sectionFixups[i].begin(); it != sectionFixups[i].end(); ++it) {
+			uint32_t slot = it->atom->_fixupsStartIndex + it->atom->_fixupsCount;
+			_file->_fixups[slot] = it->fixup;
+			it->atom->_fixupsCount++;
+		}
 	}
-	
-	// done with temp vector
-	_allFixups.clear();
 
 	// add unwind info
 	_file->_unwindInfos.reserve(countOfFDEs+countOfCUs);
@@ -2026,20 +2294,292 @@ ld::relocatable::File* Parser<A>::parse(const ParserOptions& opts)
 		}
 	}
 	
+	// record atoms so the next link of this same file can skip the work above
+	if ( useObjectCache )
+		this->writeObjectCache(opts.objectCachePath, cacheKey);
+
 	// process indirect symbols which become AliasAtoms
+	this->makeAliasAtoms();
+	
+	// parse dwarf debug info to get line info
+	this->parseDebugInfo();
+
+	return _file;
+}
+
+template <typename A>
+void Parser<A>::makeAliasAtoms()
+{
 	_file->_aliasAtomsArray = NULL;
 	_file->_aliasAtomsArrayCount = 0;
 	if ( _indirectSymbolCount != 0 ) {
 		_file->_aliasAtomsArrayCount = _indirectSymbolCount;
-		_file->_aliasAtomsArray = new uint8_t[_file->_aliasAtomsArrayCount*sizeof(AliasAtom)];
+		_file->_aliasAtomsArray = ld::arena::allocateArray<uint8_t>(_file->_aliasAtomsArrayCount*sizeof(AliasAtom));
 		this->appendAliasAtoms(_file->_aliasAtomsArray);
 	}
-	
-	
-	// parse dwarf debug info to get line info
-	this->parseDebugInfo();
+}
 
-	return _file;
+template <typename A>
+const char* Parser<A>::objectCacheString(uint32_t ref, const char* pool, uint32_t poolSize, bool* valid)
+{
+	if ( ref == kObjectCacheNoString )
+		return NULL;
+	if ( ref & kObjectCachePoolString ) {
+		uint32_t offset = ref & ~kObjectCachePoolString;
+		if ( offset >= poolSize )
+			*valid = false;
+		return &pool[offset];
+	}
+	if ( ref >= _fileLength )
+		*valid = false;
+	return (char*)&_fileContent[ref];
+}
+
+template <typename A>
+bool Parser<A>::restoreFromObjectCache(const ObjectCacheHeader* header)
+{
+	const ObjectCacheSection*		sects		= (ObjectCacheSection*)&header[1];
+	const ObjectCacheAtom*			atoms		= (ObjectCacheAtom*)&sects[header->sectionCount];
+	const ObjectCacheFixup*			fixups		= (ObjectCacheFixup*)&atoms[header->atomCount];
+	const ld::Atom::UnwindInfo*		unwindInfos	= (ld::Atom::UnwindInfo*)&fixups[header->fixupCount];
+	const char*						pool		= (char*)&unwindInfos[header->unwindInfoCount];
+	const uint32_t					atomCount	= header->atomCount;
+
+	// check everything before building anything, so a bad entry just means parsing normally
+	if ( header->sectionCount != _file->_sectionsArrayCount )
+		return false;
+	if ( (header->stringPoolSize != 0) && (pool[header->stringPoolSize-1] != '\0') )
+		return false;
+	bool valid = true;
+	for (uint32_t i=0; i < header->sectionCount; ++i) {
+		if ( (sects[i].beginAtom == kObjectCacheNoAtom) != (sects[i].endAtom == kObjectCacheNoAtom) )
+			return false;
+		if ( (sects[i].beginAtom != kObjectCacheNoAtom) && ((sects[i].beginAtom > sects[i].endAtom) || (sects[i].endAtom > atomCount)) )
+			return false;
+	}
+	for (uint32_t i=0; i < atomCount; ++i) {
+		const ObjectCacheAtom& a = atoms[i];
+		if ( (a.sectionIndex >= header->sectionCount) 
+			|| ((uint64_t)a.fixupsStart + a.fixupsCount > header->fixupCount)
+			|| ((uint64_t)a.unwindInfoStart + a.unwindInfoCount > header->unwindInfoCount) )
+			return false;
+		objectCacheString(a.name, pool, header->stringPoolSize, &valid);
+	}
+	for (uint32_t i=0; i < header->fixupCount; ++i) {
+		const ObjectCacheFixup& f = fixups[i];
+		if ( (f.flags & ObjectCacheFixup::kValueIsAtomIndex) && (f.value >= atomCount) )
+			return false;
+		if ( f.flags & ObjectCacheFixup::kValueIsString )
+			objectCacheString((uint32_t)f.value, pool, header->stringPoolSize, &valid);
+	}
+	if ( !valid )
+		return false;
+
+	Atom<A>* atomBase = ld::arena::allocateArray<Atom<A> >(atomCount);
+	_file->_atomsArray = (uint8_t*)atomBase;
+	_file->_atomsArrayCount = atomCount;
+
+	_file->_fixups = ld::arena::allocateArray<ld::Fixup>(header->fixupCount);
+	_file->_fixupsCount = header->fixupCount;
+	for (uint32_t i=0; i < header->fixupCount; ++i) {
+		const ObjectCacheFixup& f = fixups[i];
+		ld::Fixup& fixup = *new (&_file->_fixups[i]) ld::Fixup();
+		fixup.offsetInAtom				= f.offsetInAtom;
+		fixup.kind						= (ld::Fixup::Kind)f.kind;
+		fixup.clusterSize				= (ld::Fixup::Cluster)f.clusterSize;
+		fixup.binding					= (ld::Fixup::TargetBinding)f.binding;
+		fixup.weakImport				= (f.flags & ObjectCacheFixup::kWeakImport);
+		fixup.contentAddendOnly			= (f.flags & ObjectCacheFixup::kContentAddendOnly);
+		fixup.contentDetlaToAddendOnly	= (f.flags & ObjectCacheFixup::kContentDeltaToAddendOnly);
+		fixup.contentIgnoresAddend		= (f.flags & ObjectCacheFixup::kContentIgnoresAddend);
+		if ( f.flags & ObjectCacheFixup::kValueIsAtomIndex )
+			fixup.u.target = &atomBase[f.value];
+		else if ( f.flags & ObjectCacheFixup::kValueIsString )
+			fixup.u.name = objectCacheString((uint32_t)f.value, pool, header->stringPoolSize, &valid);
+		else
+			fixup.u.addend = f.value;
+	}
+	_file->_unwindInfos.assign(unwindInfos, &unwindInfos[header->unwindInfoCount]);
+
+	for (uint32_t i=0; i < atomCount; ++i) {
+		const ObjectCacheAtom& a = atoms[i];
+		Atom<A>* atom = new (&atomBase[i]) Atom<A>(*_file->_sectionsArray[a.sectionIndex],
+									objectCacheString(a.name, pool, header->stringPoolSize, &valid),
+									a.objectAddress, a.size, (ld::Atom::Definition)a.definition,
+									(ld::Atom::Combine)a.combine, (ld::Atom::Scope)a.scope,
+									(ld::Atom::ContentType)a.contentType, (ld::Atom::SymbolTableInclusion)a.symbolTableInclusion,
+									(a.flags & ObjectCacheAtom::kDontDeadStrip), (a.flags & ObjectCacheAtom::kThumb),
+									(a.flags & ObjectCacheAtom::kAlias), ld::Atom::Alignment(a.alignmentPowerOf2, a.alignmentModulus));
+		if ( a.flags & ObjectCacheAtom::kAutoHide )
+			atom->setAutoHide();
+		if ( a.flags & ObjectCacheAtom::kDontDeadStripIfReferencesLive )
+			atom->setDontDeadStripIfReferencesLive();
+		atom->setFixupsRange(a.fixupsStart, a.fixupsCount);
+		if ( a.unwindInfoCount != 0 )
+			atom->setUnwindInfoRange(a.unwindInfoStart, a.unwindInfoCount);
+	}
+
+	for (uint32_t i=0; i < header->sectionCount; ++i) {
+		Section<A>* sect = _file->_sectionsArray[i];
+		if ( sects[i].beginAtom != kObjectCacheNoAtom ) {
+			sect->_beginAtoms = &atomBase[sects[i].beginAtom];
+			sect->_endAtoms = &atomBase[sects[i].endAtom];
+		}
+	}
+	return true;
+}
+
+template <typename A>
+void Parser<A>::writeObjectCache(const char* cacheDir, const uint8_t key[CC_MD5_DIGEST_LENGTH])
+{
+	// the cache is best effort: anything unexpected just means this file is not cached
+	Atom<A>* atomBase = (Atom<A>*)_file->_atomsArray;
+	const uint32_t atomCount = _file->_atomsArrayCount;
+	std::vector<char> pool;
+	std::unordered_map<const char*, uint32_t> poolOffsets;
+	bool cacheable = true;
+	auto stringRef = [&](const char* str) -> uint32_t {
+		if ( str == NULL )
+			return kObjectCacheNoString;
+		if ( (str >= (char*)_fileContent) && (str < (char*)&_fileContent[_fileLength]) && (_fileLength < kObjectCachePoolString) )
+			return (uint32_t)(str - (char*)_fileContent);
+		auto pos = poolOffsets.find(str);
+		if ( pos != poolOffsets.end() )
+			return pos->second;
+		uint32_t offset = (uint32_t)pool.size();
+		if ( offset >= kObjectCachePoolString ) {
+			cacheable = false;
+			return kObjectCacheNoString;
+		}
+		pool.insert(pool.end(), str, str+strlen(str)+1);
+		poolOffsets[str] = offset | kObjectCachePoolString;
+		return offset | kObjectCachePoolString;
+	};
+
+	std::unordered_map<const ld::Section*, uint32_t> sectionIndexes;
+	std::vector<ObjectCacheSection> sects(_file->_sectionsArrayCount);
+	for (uint32_t i=0; i < _file->_sectionsArrayCount; ++i) {
+		Section<A>* sect = _file->_sectionsArray[i];
+		sectionIndexes[sect] = i;
+		sects[i].beginAtom = kObjectCacheNoAtom;
+		sects[i].endAtom = kObjectCacheNoAtom;
+		if ( sect->_beginAtoms != NULL ) {
+			sects[i].beginAtom = (uint32_t)(sect->_beginAtoms - atomBase);
+			sects[i].endAtom = (uint32_t)(sect->_endAtoms - atomBase);
+		}
+	}
+
+	std::vector<ObjectCacheAtom> atoms(atomCount);
+	for (uint32_t i=0; i < atomCount; ++i) {
+		const Atom<A>& atom = atomBase[i];
+		ObjectCacheAtom& a = atoms[i];
+		bzero(&a, sizeof(a));
+		auto sectPos = sectionIndexes.find(&atom.section());
+		if ( sectPos == sectionIndexes.end() )
+			return;
+		a.objectAddress			= atom._objAddress;
+		a.size					= atom._size;
+		a.name					= stringRef(atom._name);
+		a.sectionIndex			= sectPos->second;
+		a.fixupsStart			= atom._fixupsStartIndex;
+		a.fixupsCount			= atom._fixupsCount;
+		a.unwindInfoStart		= atom._unwindInfoStartIndex;
+		a.unwindInfoCount		= atom._unwindInfoCount;
+		a.alignmentModulus		= atom.alignment().modulus;
+		a.alignmentPowerOf2		= atom.alignment().powerOf2;
+		a.definition			= atom.definition();
+		a.combine				= atom.combine();
+		a.scope					= atom.scope();
+		a.contentType			= atom.contentType();
+		a.symbolTableInclusion	= atom.symbolTableInclusion();
+		if ( atom.autoHide() )
+			a.flags |= ObjectCacheAtom::kAutoHide;
+		if ( atom.dontDeadStrip() )
+			a.flags |= ObjectCacheAtom::kDontDeadStrip;
+		if ( atom.isThumb() )
+			a.flags |= ObjectCacheAtom::kThumb;
+		if ( atom.isAlias() )
+			a.flags |= ObjectCacheAtom::kAlias;
+		if ( atom.dontDeadStripIfReferencesLive() )
+			a.flags |= ObjectCacheAtom::kDontDeadStripIfReferencesLive;
+	}
+
+	std::vector<ObjectCacheFixup> fixups(_file->_fixupsCount);
+	for (size_t i=0; i < fixups.size(); ++i) {
+		const ld::Fixup& fixup = _file->_fixups[i];
+		ObjectCacheFixup& f = fixups[i];
+		f.offsetInAtom	= fixup.offsetInAtom;
+		f.kind			= fixup.kind;
+		f.clusterSize	= fixup.clusterSize;
+		f.binding		= fixup.binding;
+		f.flags			= 0;
+		if ( fixup.weakImport )
+			f.flags |= ObjectCacheFixup::kWeakImport;
+		if ( fixup.contentAddendOnly )
+			f.flags |= ObjectCacheFixup::kContentAddendOnly;
+		if ( fixup.contentDetlaToAddendOnly )
+			f.flags |= ObjectCacheFixup::kContentDeltaToAddendOnly;
+		if ( fixup.contentIgnoresAddend )
+			f.flags |= ObjectCacheFixup::kContentIgnoresAddend;
+		switch ( fixup.binding ) {
+			case ld::Fixup::bindingDirectlyBound:
+			case ld::Fixup::bindingByContentBound:
+				// targets must be atoms of this file
+				if ( ((Atom<A>*)fixup.u.target < atomBase) || ((Atom<A>*)fixup.u.target >= &atomBase[atomCount]) )
+					return;
+				f.value = (const Atom<A>*)fixup.u.target - atomBase;
+				f.flags |= ObjectCacheFixup::kValueIsAtomIndex;
+				break;
+			case ld::Fixup::bindingByNameUnbound:
+				f.value = stringRef(fixup.u.name);
+				f.flags |= ObjectCacheFixup::kValueIsString;
+				break;
+			case ld::Fixup::bindingNone:
+				f.value = fixup.u.addend;
+				break;
+			case ld::Fixup::bindingsIndirectlyBound:
+				f.value = fixup.u.bindingIndex;
+				break;
+		}
+	}
+	if ( !cacheable )
+		return;
+
+	ObjectCacheHeader header;
+	bzero(&header, sizeof(header));
+	memcpy(header.magic, kObjectCacheMagic, sizeof(kObjectCacheMagic));
+	header.version			= kObjectCacheVersion;
+	header.sectionCount		= (uint32_t)sects.size();
+	header.atomCount		= atomCount;
+	header.fixupCount		= (uint32_t)fixups.size();
+	header.unwindInfoCount	= (uint32_t)_file->_unwindInfos.size();
+	header.stringPoolSize	= (uint32_t)pool.size();
+	header.fileLength		= _fileLength;
+	memcpy(header.key, key, CC_MD5_DIGEST_LENGTH);
+	memcpy(header.linkerUUID, linkerUUID(), sizeof(header.linkerUUID));
+
+	// write to a temp file and rename, so concurrent links never see a partial entry
+	char entryPath[PATH_MAX];
+	objectCacheEntryPath(cacheDir, key, entryPath);
+	char tmpPath[PATH_MAX];
+	snprintf(tmpPath, PATH_MAX, "%s.XXXXXX", entryPath);
+	int fd = ::mkstemp(tmpPath);
+	if ( (fd == -1) && (errno == ENOENT) && (::mkdir(cacheDir, 0755) == 0) ) {
+		snprintf(tmpPath, PATH_MAX, "%s.XXXXXX", entryPath);
+		fd = ::mkstemp(tmpPath);
+	}
+	if ( fd == -1 )
+		return;
+	bool ok = objectCacheWrite(fd, &header, sizeof(header))
+			&& objectCacheWrite(fd, sects.data(), sects.size()*sizeof(ObjectCacheSection))
+			&& objectCacheWrite(fd, atoms.data(), atoms.size()*sizeof(ObjectCacheAtom))
+			&& objectCacheWrite(fd, fixups.data(), fixups.size()*sizeof(ObjectCacheFixup))
+			&& objectCacheWrite(fd, _file->_unwindInfos.data(), _file->_unwindInfos.size()*sizeof(ld::Atom::UnwindInfo))
+			&& objectCacheWrite(fd, pool.data(), pool.size());
+	if ( ::close(fd) != 0 )
+		ok = false;
+	if ( !ok || (::rename(tmpPath, entryPath) != 0) )
+		::unlink(tmpPath);
 }
 
 static void versionToString(uint32_t value, char buffer[32])
@@ -2760,7 +3300,7 @@ void Parser<A>::makeSections()
 	}
 
 	// allocate one block for all Section objects as well as pointers to each
-	uint8_t* space = new uint8_t[totalSectionsSize+count*sizeof(Section<A>*)];
+	uint8_t* space = ld::arena::allocateArray<uint8_t>(totalSectionsSize+count*sizeof(Section<A>*));
 	_file->_sectionsArray = (Section<A>**)space;
 	_file->_sectionsArrayCount = count;
 	Section<A>** objects = _file->_sectionsArray;
@@ -3932,12 +4472,9 @@ void Parser<A>::parseStabs()
 							const char* colon = strchr(symString, ':');
 							if ( colon != NULL ) {
 								// build underscore leading name
-								int nameLen = colon - symString;
-								char symName[nameLen+2];
-								strlcpy(&symName[1], symString, nameLen+1);
-								symName[0] = '_';
-								symName[nameLen+1] = '\0';
-								currentAtom = this->findAtomByName(symName);
+								std::string symName("_");
+								symName.append(symString, colon - symString);
+								currentAtom = this->findAtomByName(symName.c_str());
 								if ( currentAtom != NULL ) {
 									stab.atom = currentAtom;
 									stab.string = symString;
@@ -4238,8 +4775,7 @@ bool Parser<A>::read_comp_unit(const char ** name, const char ** comp_dir,
 template <typename A>
 File<A>::~File()
 {
-	free(_sectionsArray);
-	free(_atomsArray);
+	// atoms, sections and fixups are in the link-lifetime arena
 }
 
 template <typename A>
@@ -4274,9 +4810,7 @@ const char* Section<A>::makeSegmentName(const macho_section<typename A::P>* sect
 	const char* name = sect->segname();
 	if ( strlen(name) < 16 ) 
 		return name;
-	char* tmp = new char[17];
-	strlcpy(tmp, name, 17);
-	return tmp;
+	return ld::arena::copyString(name, 16);
 }
 
 template <typename A>
@@ -4308,9 +4842,7 @@ const char* Section<A>::makeSectionName(const macho_section<typename A::P>* sect
 	if ( strncmp(sect->sectname(), "__gcc_except_tab", 16) == 0 )
 		return "__gcc_except_tab";
 
-	char* tmp = new char[17];
-	strlcpy(tmp, name, 17);
-	return tmp;
+	return ld::arena::copyString(name, 16);
 }
 
 template <typename A>
@@ -5762,9 +6294,14 @@ bool Literal16Section<A>::canCoalesceWith(const class Atom<A>* atom, const ld::A
 template <typename A>
 typename A::P::uint_t CStringSection<A>::elementSizeAtAddress(pint_t addr)
 {
+	if ( addr == _lastElementAddr )
+		return _lastElementSize;
 	const macho_section<P>* sect = this->machoSection();
-	const char* stringContent = (char*)(this->file().fileContent() + sect->offset() + addr - sect->addr());
-	return strlen(stringContent) + 1;
+	const char* sectionContent = (char*)(this->file().fileContent() + sect->offset());
+	const char* stringContent = sectionContent + (addr - sect->addr());
+	_lastElementAddr = addr;
+	_lastElementSize = ld::strings::length(stringContent, sectionContent + sect->size()) + 1;
+	return _lastElementSize;
 }
 
 template <typename A>
@@ -5790,12 +6327,8 @@ Atom<A>* CStringSection<A>::findAtomByAddress(pint_t addr)
 template <typename A>
 unsigned long CStringSection<A>::contentHash(const class Atom<A>* atom, const ld::IndirectBindingTable& ind) const
 {
-	unsigned long hash = 5381;
-	const char* stringContent = (char*)atom->contentPointer();
-	for (const char* s = stringContent; *s != '\0'; ++s) {
-		hash = hash * 33 + *s;
-	}
-	return hash;
+	// atom size is the string length plus its zero, so there is no need to scan for the end again
+	return ld::strings::hash(atom->contentPointer(), atom->_size - 1);
 }
 
 
@@ -7068,10 +7601,10 @@ bool Section<A>::addRelocFixup_powerpc(class Parser<A>& parser,
 				// proved dead?? ... this causes problems when we come to emit.
 				if ( nextReloc->r_type() != PPC_RELOC_PAIR )
 					throw "PPC_RELOC_JBSR missing following pair";
-				if ( !parser._hasLongBranchStubs && parser._osxMin >= ld::mac10_5)
+				// sections may make fixups in parallel, so only the first to get here warns
+				if ( !__sync_lock_test_and_set(&parser._hasLongBranchStubs, true) && parser._osxMin >= ld::mac10_5)
 					warning("object file compiled with -mlong-branch which is no longer needed. "
 							"To remove this warning, recompile without -mlong-branch: %s", parser._path);
-				parser._hasLongBranchStubs = true;
 				this->_hasJBSR = true;
 				result = true;
 				if ( reloc->r_extern() ) {
@@ -8129,7 +8662,7 @@ bool ObjC1ClassSection<x86>::addRelocFixup(class Parser<x86>& parser, const mach
 			assert(stringTarget.atom != NULL);
 			assert(stringTarget.atom->contentType() == ld::Atom::typeCString);
 			const char* superClassBaseName = (char*)stringTarget.atom->rawContentPointer();
-			char* superClassName = new char[strlen(superClassBaseName) + 20];
+			char* superClassName = (char*)ld::arena::allocate(strlen(superClassBaseName) + 20, 1);
 			strcpy(superClassName, ".objc_class_name_");
 			strcat(superClassName, superClassBaseName);
 			
@@ -8162,7 +8695,7 @@ bool ObjC1ClassSection<ppc>::addRelocFixup(class Parser<ppc>& parser, const mach
 			assert(stringTarget.atom != NULL);
 			assert(stringTarget.atom->contentType() == ld::Atom::typeCString);
 			const char* superClassBaseName = (char*)stringTarget.atom->rawContentPointer();
-			char* superClassName = new char[strlen(superClassBaseName) + 20];
+			char* superClassName = (char*)ld::arena::allocate(strlen(superClassBaseName) + 20, 1);
 			strcpy(superClassName, ".objc_class_name_");
 			strcat(superClassName, superClassBaseName);
 
@@ -8210,7 +8743,7 @@ bool Objc1ClassReferences<ppc>::addRelocFixup(class Parser<ppc>& parser, const m
 	assert(stringTarget.atom != NULL);
 	assert(stringTarget.atom->contentType() == ld::Atom::typeCString);
 	const char* baseClassName = (char*)stringTarget.atom->rawContentPointer();
-	char* objcClassName = new char[strlen(baseClassName) + 20];
+	char* objcClassName = (char*)ld::arena::allocate(strlen(baseClassName) + 20, 1);
 	strcpy(objcClassName, ".objc_class_name_");
 	strcat(objcClassName, baseClassName);
 
@@ -8243,7 +8776,7 @@ bool Objc1ClassReferences<x86>::addRelocFixup(class Parser<x86>& parser, const m
 	assert(stringTarget.atom != NULL);
 	assert(stringTarget.atom->contentType() == ld::Atom::typeCString);
 	const char* baseClassName = (char*)stringTarget.atom->rawContentPointer();
-	char* objcClassName = new char[strlen(baseClassName) + 20];
+	char* objcClassName = (char*)ld::arena::allocate(strlen(baseClassName) + 20, 1);
 	strcpy(objcClassName, ".objc_class_name_");
 	strcat(objcClassName, baseClassName);
 
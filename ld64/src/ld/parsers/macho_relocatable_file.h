@@ -51,6 +51,8 @@ struct ParserOptions {
 	bool			usingBitcode;
 	uint8_t			maxDefaultCommonAlignment;
 	ld::MacVersionMin osxMin;
+	const char*		objectCachePath;	// directory of parsed-object cache entries, or NULL
+	uint64_t		parallelParseMinSize;	// files at least this big are split into atoms on several threads
 };
 
 extern ld::relocatable::File* parse(const uint8_t* fileContent, uint64_t fileLength, 
@@ -219,7 +219,7 @@ void File<A>::buildExportHashTable(const tapi::LinkerInterfaceFile* file) {
 		typename Base::AtomAndWeak bucket = { nullptr, weakDef, tlv, 0 };
 		if ( this->_s_logHashtable )
 			fprintf(stderr, "  adding %s to hash table for %s\n", name, this->path());
-		this->_atoms[strdup(name)] = bucket;
+		this->_atoms[ld::arena::copyString(name)] = bucket;
 	}
 }
 
@@ -234,7 +234,7 @@ public:
 								  ld::File::Ordinal ordinal, const Options& opts,
 								  bool indirectDylib)
 	{
-		return new File<A>(path, fileContent, fileLength,mTime, ordinal,
+		return new (ld::arena::allocate(sizeof(File<A>))) File<A>(path, fileContent, fileLength,mTime, ordinal,
 						   opts.flatNamespace(),
 						   opts.linkingMainExecutable(),
 						   opts.implicitlyLinkIndirectPublicDylibs(),
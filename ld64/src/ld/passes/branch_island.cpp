@@ -33,9 +33,12 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include "MachOFileAbstraction.hpp"
 #include "ld.hpp"
+#include "Parallel.hpp"
+#include "Timing.hpp"
 #include "branch_island.h"
 
 namespace ld {
@@ -50,17 +53,42 @@ static uint64_t furthestCodeOrStubSect;
 static uint64_t sizeOfTEXTSeg;
 static unsigned sectionsWithBanches;
 
-static std::map<const Atom*, uint64_t> sAtomToAddress;
+//
+// Addresses of all atoms, laid out the way the final image will be.  Each atom
+// gets a dense index (its section's first index plus its position in the
+// section) into one contiguous array, so walking a section's atoms needs no
+// lookup at all, and finding a branch target is one hash table probe.
+//
+class AtomAddressTable
+{
+public:
+	void				build(ld::Internal& state);
+	uint64_t			address(unsigned sectionIndex, size_t position) const { return _addresses[_sectionStarts[sectionIndex] + position]; }
+	uint64_t			address(const ld::Atom* atom) const;
+
+private:
+	std::vector<uint64_t>							_addresses;
+	std::vector<uint32_t>							_sectionStarts;
+	std::unordered_map<const ld::Atom*, uint32_t>	_indexes;
+};
+
+static AtomAddressTable sAtomAddresses;
 
 struct TargetAndOffset { const ld::Atom* atom; uint32_t offset; };
-class TargetAndOffsetComparor
+class TargetAndOffsetHash
+{
+public:
+	size_t operator()(const TargetAndOffset& value) const
+	{
+		return std::hash<const ld::Atom*>()(value.atom) ^ ((size_t)value.offset * 0x9E3779B97F4A7C15ULL);
+	}
+};
+class TargetAndOffsetEqual
 {
 public:
 	bool operator()(const TargetAndOffset& left, const TargetAndOffset& right) const
 	{
-		if ( left.atom != right.atom )
-			return ( left.atom < right.atom );
-		return ( left.offset < right.offset );
+		return ( (left.atom == right.atom) && (left.offset == right.offset) );
 	}
 };
 
@@ -447,7 +475,7 @@ static uint64_t maxDistanceBetweenIslands(const Options& opts, bool seenThumbBra
 
 //
 
-typedef std::map<TargetAndOffset,const ld::Atom*, TargetAndOffsetComparor> AtomToIsland;
+typedef std::unordered_map<TargetAndOffset,const ld::Atom*, TargetAndOffsetHash, TargetAndOffsetEqual> AtomToIsland;
 
 static unsigned numberOfIslandRegions;
 static std::vector<const ld::Atom*> branchIslandInsertionPoints; // atoms in the atom list after which branch islands will be inserted
@@ -459,28 +487,35 @@ static uint64_t *regionAddresses;
 static std::vector<const ld::Atom*>* *regionsIslands;
 static unsigned int islandCount;
 
-static void makeIslandsForSection(const Options& opts, ld::Internal& state,
-								  ld::Internal::FinalSection* sect, unsigned stubCount)
+// A branch found to be out of range by the scan
+struct OutOfRangeBranch {
+	const ld::Atom*		atom;
+	const ld::Atom*		target;
+	ld::Fixup*			fixupWithTarget;
+	ld::Fixup*			fixupWithAddend;
+	ld::Fixup::Kind		kind;
+	uint32_t			addend;
+	bool				crossSectionBranch;
+	int64_t				srcAddr;
+	int64_t				dstAddr;
+	int64_t				displacement;
+};
+
+// Finds the branches in sect->atoms[startIndex, endIndex) that cannot reach their target.
+// Only reads the atoms, so different ranges can be scanned at the same time.
+static void findOutOfRangeBranches(const Options& opts, const ld::Internal& state, const ld::Internal::FinalSection* sect,
+								   unsigned sectionIndex, size_t startIndex, size_t endIndex, std::vector<OutOfRangeBranch>& branches)
 {
-	bool hasThumbBranches = sect->hasThumbBranches;
-	bool haveCrossSectionBranches = sect->hasCrossSectionBranches;
 	const bool preload = (opts.outputKind() == Options::kPreload);
-
-if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
-	
-	// create islands for branches in sect that are out of range
-	for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin();
-		 ait != sect->atoms.end(); ++ait) {
-		const ld::Atom* atom = *ait;
+	const int64_t kBranchLimit = kBetweenRegions;
+	for (size_t atomIndex=startIndex; atomIndex < endIndex; ++atomIndex) {
+		const ld::Atom* atom = sect->atoms[atomIndex];
 		const ld::Atom* target = NULL;
 		uint32_t addend = 0;
 		ld::Fixup* fixupWithTarget = NULL;
 		ld::Fixup* fixupWithAddend = NULL;
-		int fu = 0;
-//if (_s_log) fprintf(stderr, "atom : %s \n", atom->name());
 		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd();
 			 fit != end; ++fit) {
-//if (_s_log) fprintf(stderr, "fu %d %s : %s : ", fu++, (fit->firstInCluster()?"is first":"not first"), (fit->lastInCluster()?"is last":"not last"));
 			if ( fit->firstInCluster() ) {
 				target = NULL;
 				fixupWithTarget = NULL;
@@ -490,18 +525,15 @@ if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
 			switch ( fit->binding ) {
 				case ld::Fixup::bindingNone:
 				case ld::Fixup::bindingByNameUnbound:
-//if (_s_log) fprintf(stderr, "Binding none / unbound " );
 					break;
 				case ld::Fixup::bindingByContentBound:
 				case ld::Fixup::bindingDirectlyBound:
 					target = fit->u.target;
 					fixupWithTarget = fit;
-//if (_s_log) fprintf(stderr, "      target : %s ", target->name());
 					break;
 				case ld::Fixup::bindingsIndirectlyBound:
 					target = state.indirectBindingTable[fit->u.bindingIndex];
 					fixupWithTarget = fit;
-//if (_s_log) fprintf(stderr, "indir target : %s ", target->name());
 					break;
 			}
 			bool haveBranch = false;
@@ -509,12 +541,9 @@ if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
 				case ld::Fixup::kindAddAddend:
 					addend = fit->u.addend;
 					fixupWithAddend = fit;
-//if (_s_log) fprintf(stderr, " addend : %u\n", addend);
 					break;
 				case ld::Fixup::kindStoreTargetAddressPPCBranch24:
-//if (_s_log) fprintf(stderr, " StoreTargetAddress", addend);
 				case ld::Fixup::kindStorePPCBranch24:
-//if (_s_log) fprintf(stderr, "  branch\n", addend);
 				case ld::Fixup::kindStoreARMBranch24:
 				case ld::Fixup::kindStoreThumbBranch22:
 				case ld::Fixup::kindStoreTargetAddressARMBranch24:
@@ -526,7 +555,6 @@ if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
 					haveBranch = true;
 					break;
                 default:
-//if (_s_log)  fprintf(stderr, " [%u] def\n", fit->kind);
                    break;
 			}
 			if ( haveBranch ) {
@@ -534,108 +562,146 @@ if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
 				int64_t srcAddr = atom->sectionOffset() + fit->offsetInAtom;
 				int64_t dstAddr = target->sectionOffset() + addend;
 				if ( seenCrossSectBr || preload ) {
-					srcAddr = sAtomToAddress[atom] + fit->offsetInAtom;
-					dstAddr = sAtomToAddress[target] + addend;
+					srcAddr = sAtomAddresses.address(sectionIndex, atomIndex) + fit->offsetInAtom;
+					dstAddr = sAtomAddresses.address(target) + addend;
 				}
 				if ( target->section().type() == ld::Section::typeStub )
 					dstAddr = furthestStubSect;
 				int64_t displacement = dstAddr - srcAddr;
-if (_s_log && (abs(displacement) > kBetweenRegions) ) fprintf(stderr, "from %s to %s delta : 0x%0" PRIx64 " in section %s\n",
+				if ( (displacement > kBranchLimit) || (displacement < (-kBranchLimit)) ) {
+if (_s_log) fprintf(stderr, "from %s to %s delta : 0x%0" PRIx64 " in section %s\n",
 					atom->name(), target->name(), displacement, sect->sectionName());
-				TargetAndOffset finalTargetAndOffset = { target, addend };
-				const int64_t kBranchLimit = kBetweenRegions;
-				if ( crossSectionBranch && preload && ((displacement > kBranchLimit) || (displacement < (-kBranchLimit))) ) {
-					const ld::Atom* island;
-					AtomToIsland* region = regionsMap[0];
-					AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
-					if ( pos == region->end() ) {
-						island = makeBranchIsland(opts, fit->kind, 0, target, finalTargetAndOffset, atom->section(), true);
-						(*region)[finalTargetAndOffset] = island;
-						if (_s_log) fprintf(stderr, "added absolute branching island %p %s, displacement=%lld\n", 
-												island, island->name(), displacement);
-						++islandCount;
-						regionsIslands[0]->push_back(island);
-						state.atomToSection[island] = sect;
-					}
-					else {
-						island = pos->second;
-					}
-					if (_s_log) fprintf(stderr, "using island %p %s for branch to %s from %s\n", island, island->name(), target->name(), atom->name());
-					fixupWithTarget->u.target = island;
-					fixupWithTarget->binding = ld::Fixup::bindingDirectlyBound;
-					if (fixupWithAddend)
-						fixupWithAddend->u.addend = 0;
+					OutOfRangeBranch branch = { atom, target, fixupWithTarget, fixupWithAddend, fit->kind, addend,
+												crossSectionBranch, srcAddr, dstAddr, displacement };
+					branches.push_back(branch);
+				}
+			}
+		}
+	}
+}
+
+static void makeIslandsForSection(const Options& opts, ld::Internal& state,
+								  ld::Internal::FinalSection* sect, unsigned sectionIndex, unsigned stubCount)
+{
+	const bool preload = (opts.outputKind() == Options::kPreload);
+
+if (_s_log) fprintf(stderr, "ld: checking section %s\n", sect->sectionName());
+	
+	// find branches in sect that are out of range, scanning chunks of the section in parallel
+	const size_t kAtomsPerChunk = 4096;
+	const size_t atomCount = sect->atoms.size();
+	std::vector<std::vector<OutOfRangeBranch>> chunkBranches((atomCount + kAtomsPerChunk - 1) / kAtomsPerChunk);
+	ld::parallel::forEach(chunkBranches.size(), [&](size_t chunk) {
+		const size_t start = chunk * kAtomsPerChunk;
+		findOutOfRangeBranches(opts, state, sect, sectionIndex, start, std::min(atomCount, start + kAtomsPerChunk), chunkBranches[chunk]);
+	});
+
+	// create islands for them, in atom order so island order and names do not depend on threads
+	const int64_t kBranchLimit = kBetweenRegions;
+	for (const std::vector<OutOfRangeBranch>& branches : chunkBranches) {
+		for (const OutOfRangeBranch& branch : branches) {
+			const ld::Atom* atom = branch.atom;
+			const ld::Atom* target = branch.target;
+			const int64_t srcAddr = branch.srcAddr;
+			const int64_t dstAddr = branch.dstAddr;
+			const int64_t displacement = branch.displacement;
+			TargetAndOffset finalTargetAndOffset = { target, branch.addend };
+			const ld::Atom* newTarget;
+			if ( branch.crossSectionBranch && preload ) {
+				const ld::Atom* island;
+				AtomToIsland* region = regionsMap[0];
+				AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
+				if ( pos == region->end() ) {
+					island = makeBranchIsland(opts, branch.kind, 0, target, finalTargetAndOffset, atom->section(), true);
+					(*region)[finalTargetAndOffset] = island;
+					if (_s_log) fprintf(stderr, "added absolute branching island %p %s, displacement=%lld\n", 
+											island, island->name(), displacement);
+					++islandCount;
+					regionsIslands[0]->push_back(island);
+					state.atomToSection[island] = sect;
 				}
-				else if ( displacement > kBranchLimit ) {
-					// create forward branch chain
-					const ld::Atom* nextTarget = target;
-					if (_s_log) fprintf(stderr, "  +need forward branching island srcAdr=0x%08llX, dstAdr=0x%08llX, target=%s\n",
-														srcAddr, dstAddr, target->name());
-					for (int i=kIslandRegionsCount-1; i >=0 ; --i) {
-						AtomToIsland* region = regionsMap[i];
-						int64_t islandRegionAddr = regionAddresses[i];
-						if ( (srcAddr < islandRegionAddr) && ((islandRegionAddr <= dstAddr)) ) { 
-							AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
-							if ( pos == region->end() ) {
-								ld::Atom* island = makeBranchIsland(opts, fit->kind, i, nextTarget, finalTargetAndOffset, *branchIslandInsertionSections[i], false);
-								(*region)[finalTargetAndOffset] = island;
-								if (_s_log) fprintf(stderr, "  +added forward branching island %p %s to region %d (in section %s) for %s\n", island, island->name(), i, branchIslandInsertionSections[i]->sectionName(), atom->name());
-								regionsIslands[i]->push_back(island);
-								state.atomToSection[island] = sect;
-								++islandCount;
-								nextTarget = island;
-							}
-							else {
-								nextTarget = pos->second;
-							}
+				else {
+					island = pos->second;
+				}
+				if (_s_log) fprintf(stderr, "using island %p %s for branch to %s from %s\n", island, island->name(), target->name(), atom->name());
+				newTarget = island;
+			}
+			else if ( displacement > kBranchLimit ) {
+				// create forward branch chain
+				const ld::Atom* nextTarget = target;
+				if (_s_log) fprintf(stderr, "  +need forward branching island srcAdr=0x%08llX, dstAdr=0x%08llX, target=%s\n",
+													srcAddr, dstAddr, target->name());
+				for (int i=kIslandRegionsCount-1; i >=0 ; --i) {
+					AtomToIsland* region = regionsMap[i];
+					int64_t islandRegionAddr = regionAddresses[i];
+					if ( (srcAddr < islandRegionAddr) && ((islandRegionAddr <= dstAddr)) ) { 
+						AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
+						if ( pos == region->end() ) {
+							ld::Atom* island = makeBranchIsland(opts, branch.kind, i, nextTarget, finalTargetAndOffset, *branchIslandInsertionSections[i], false);
+							(*region)[finalTargetAndOffset] = island;
+							if (_s_log) fprintf(stderr, "  +added forward branching island %p %s to region %d (in section %s) for %s\n", island, island->name(), i, branchIslandInsertionSections[i]->sectionName(), atom->name());
+							regionsIslands[i]->push_back(island);
+							state.atomToSection[island] = sect;
+							++islandCount;
+							nextTarget = island;
+						}
+						else {
+							nextTarget = pos->second;
 						}
 					}
-					if (_s_log) fprintf(stderr, "  +using island %p %s for branch to %s from %s\n", nextTarget, nextTarget->name(), target->name(), atom->name());
-					fixupWithTarget->u.target = nextTarget;
-					fixupWithTarget->binding = ld::Fixup::bindingDirectlyBound;
-					if (fixupWithAddend)
-						fixupWithAddend->u.addend = 0;
 				}
-				else if ( displacement < (-kBranchLimit) ) {
-					// create back branching chain
-					const ld::Atom* prevTarget = target;
-					for (int i=0; i < kIslandRegionsCount ; ++i) {
-						AtomToIsland* region = regionsMap[i];
-						int64_t islandRegionAddr = regionAddresses[i];
-						if ( (dstAddr < islandRegionAddr) && (islandRegionAddr <= srcAddr) ) {
-							if (_s_log) fprintf(stderr, "  -need backward branching island srcAdr=0x%08llX, dstAdr=0x%08llX, target=%s\n", srcAddr, dstAddr, target->name());
-							AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
-							if ( pos == region->end() ) {
-								ld::Atom* island = makeBranchIsland(opts, fit->kind, i, prevTarget, finalTargetAndOffset, *branchIslandInsertionSections[i], false);
-								(*region)[finalTargetAndOffset] = island;
-								if (_s_log) fprintf(stderr, "  -added back branching island %p %s to region %d (in section %s) for %s\n", island, island->name(), i, branchIslandInsertionSections[i]->sectionName(), atom->name());
-								regionsIslands[i]->push_back(island);
-								state.atomToSection[island] = sect;
-								++islandCount;
-								prevTarget = island;
-							}
-							else {
-								prevTarget = pos->second;
-							}
+				if (_s_log) fprintf(stderr, "  +using island %p %s for branch to %s from %s\n", nextTarget, nextTarget->name(), target->name(), atom->name());
+				newTarget = nextTarget;
+			}
+			else {
+				// create back branching chain
+				const ld::Atom* prevTarget = target;
+				for (int i=0; i < kIslandRegionsCount ; ++i) {
+					AtomToIsland* region = regionsMap[i];
+					int64_t islandRegionAddr = regionAddresses[i];
+					if ( (dstAddr < islandRegionAddr) && (islandRegionAddr <= srcAddr) ) {
+						if (_s_log) fprintf(stderr, "  -need backward branching island srcAdr=0x%08llX, dstAdr=0x%08llX, target=%s\n", srcAddr, dstAddr, target->name());
+						AtomToIsland::iterator pos = region->find(finalTargetAndOffset);
+						if ( pos == region->end() ) {
+							ld::Atom* island = makeBranchIsland(opts, branch.kind, i, prevTarget, finalTargetAndOffset, *branchIslandInsertionSections[i], false);
+							(*region)[finalTargetAndOffset] = island;
+							if (_s_log) fprintf(stderr, "  -added back branching island %p %s to region %d (in section %s) for %s\n", island, island->name(), i, branchIslandInsertionSections[i]->sectionName(), atom->name());
+							regionsIslands[i]->push_back(island);
+							state.atomToSection[island] = sect;
+							++islandCount;
+							prevTarget = island;
+						}
+						else {
+							prevTarget = pos->second;
 						}
 					}
-					if (_s_log) fprintf(stderr, "  -using back island %p %s for %s\n", prevTarget, prevTarget->name(), atom->name());
-					fixupWithTarget->u.target = prevTarget;
-					fixupWithTarget->binding = ld::Fixup::bindingDirectlyBound;
-					if (fixupWithAddend)
-						fixupWithAddend->u.addend = 0;
 				}
+				if (_s_log) fprintf(stderr, "  -using back island %p %s for %s\n", prevTarget, prevTarget->name(), atom->name());
+				newTarget = prevTarget;
 			}
+			branch.fixupWithTarget->u.target = newTarget;
+			branch.fixupWithTarget->binding = ld::Fixup::bindingDirectlyBound;
+			if (branch.fixupWithAddend)
+				branch.fixupWithAddend->u.addend = 0;
 		}
 	}
 }
 
 // Layout the atoms well enough to determine where to insert
-static void buildAddressMap(const Options& opts, ld::Internal& state) {
+void AtomAddressTable::build(ld::Internal& state) {
 	
 	// Assign addresses to atoms in a side table
 	const bool log = false;
-	if ( log ) fprintf(stderr, "buildAddressMap()\n");
+	if ( log ) fprintf(stderr, "AtomAddressTable::build()\n");
+	size_t atomCount = 0;
+	for (ld::Internal::FinalSection* sect : state.sections)
+		atomCount += sect->atoms.size();
+	_addresses.clear();
+	_addresses.reserve(atomCount);
+	_sectionStarts.clear();
+	_sectionStarts.reserve(state.sections.size());
+	_indexes.clear();
+	_indexes.reserve(atomCount);
 	for (std::vector<ld::Internal::FinalSection*>::iterator sit = state.sections.begin();
 	     sit != state.sections.end(); ++sit) {
 		ld::Internal::FinalSection* sect = *sit;
@@ -643,6 +709,7 @@ static void buildAddressMap(const Options& opts, ld::Internal& state) {
 		uint64_t offset = 0;
 		if ( log ) fprintf(stderr, "  section=%s/%s, address=0x%08llX\n",
 		                   sect->segmentName(), sect->sectionName(), sect->address);
+		_sectionStarts.push_back((uint32_t)_addresses.size());
 		for (std::vector<const ld::Atom*>::iterator ait = sect->atoms.begin();
 		     ait != sect->atoms.end(); ++ait) {
 			const ld::Atom* atom = *ait;
@@ -662,13 +729,22 @@ static void buildAddressMap(const Options& opts, ld::Internal& state) {
 			}
 			
 			if ( log ) fprintf(stderr, "    0x%08llX atom=%p, name=%s\n", sect->address+offset, atom, atom->name());
-			sAtomToAddress[atom] = sect->address + offset;
+			_indexes[atom] = (uint32_t)_addresses.size();
+			_addresses.push_back(sect->address + offset);
 			
 			offset += atom->size();
 		}
 	}
 }
 
+uint64_t AtomAddressTable::address(const ld::Atom* atom) const
+{
+	std::unordered_map<const ld::Atom*, uint32_t>::const_iterator pos = _indexes.find(atom);
+	if ( pos == _indexes.end() )
+		return 0;
+	return _addresses[pos->second];
+}
+
 // Initial (conservative) check as to whether islands might be required.
 // If the total size of sections containing code exceeds that reachable by a
 // branch instruction (including ability to reach a stubs section), then we
@@ -862,7 +938,7 @@ if ( _s_log ) fprintf(stderr, "ld: checking for poss branch isl.\n");
 	// insert island regions globally to the __TEXT segment.  Otherwise, it's
 	// enough to make island regions local to the section that requires them.
 	if ( seenCrossSectBr || (opts.outputKind() == Options::kPreload) ) {
-		buildAddressMap(opts, state);
+		sAtomAddresses.build(state);
 	}
 
 	// scan sections for number of stubs
@@ -878,13 +954,13 @@ if ( _s_log ) fprintf(stderr, "ld: checking for poss branch isl.\n");
 
 	// scan sections and add island to each code section
 	islandCount = 0;
-	for (std::vector<ld::Internal::FinalSection*>::iterator sit=state.sections.begin();
-		 sit != state.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
+	for (unsigned sectionIndex=0; sectionIndex < state.sections.size(); ++sectionIndex) {
+		ld::Internal::FinalSection* sect = state.sections[sectionIndex];
 		if ( sect->type() == ld::Section::typeCode ) 
-			makeIslandsForSection(opts, state, sect, stubCount);
+			makeIslandsForSection(opts, state, sect, sectionIndex, stubCount);
 	}
 
+	ld::timing::count("branch islands", islandCount);
 	int regionIndex = 0;
     if ( islandCount == 0 ) {
 		if ( _s_log ) fprintf(stderr, "ld: a bit surprising that we didn't need any branch islands after all\n");
@@ -911,7 +987,7 @@ if ( _s_log ) fprintf(stderr, "ld: checking for poss branch isl.\n");
 				assert(branchIslandInsertionSections[regionIndex] == sect && "wrong section seen?");
 				std::vector<const ld::Atom*>* islands = regionsIslands[regionIndex];
 	if ( _s_log ) fprintf(stderr, "ld: inserted %d islands after %s (0x%08llx)\n",
-							islands->size(), atom->name(), sAtomToAddress[atom]+atom->size());
+							islands->size(), atom->name(), sAtomAddresses.address(atom)+atom->size());
 				newAtomList.insert(newAtomList.end(), islands->begin(), islands->end());
 				++regionIndex;
 			}
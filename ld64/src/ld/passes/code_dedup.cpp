@@ -35,6 +35,8 @@
 #include <unordered_map>
 
 #include "ld.hpp"
+#include "Parallel.hpp"
+#include "Timing.hpp"
 #include "code_dedup.h"
 
 namespace ld {
@@ -72,158 +74,397 @@ private:
 };
 
 
+//
+// Identical code folding by partition refinement.
+//
+// Every foldable atom starts out in a class with all the atoms that have the
+// same section, size, alignment, content, unwind info and fixups, where a
+// fixup to another foldable atom only needs to agree on everything but the
+// target.  Then classes are split, round after round, until within every class
+// each reference to a foldable atom goes to atoms of one class.  Starting from
+// the optimistic assumption that statically equal atoms are equal means
+// mutually recursive functions fold without tracking which pairs are being
+// compared, and each round only touches the classes that still have several
+// members.  Hashing and the per class sorting run on all worker threads.
+//
 namespace {
-    typedef std::unordered_map<const ld::Atom*, unsigned long> CachedHashes;
 
-    ld::Internal*   sState = nullptr;
-    CachedHashes    sSavedHashes;
-    unsigned long   sHashCount = 0;
-    unsigned long   sFixupCompareCount = 0;
+    enum { kNotCandidate = 0xFFFFFFFF, kCandidatesPerChunk = 1024 };
+
+    struct Candidate {
+        const ld::Atom*                 atom;
+        ld::Internal::FinalSection*     section;
+        uint32_t                        sectionIndex;   // index of section in state.sections
+        uint32_t                        position;       // index of atom in section->atoms
+        uint32_t                        fixupsStart;    // index of first fixup's entry in fixupTargets
+        uint64_t                        hash;
+    };
+
+    class Folder {
+    public:
+                                Folder(ld::Internal& state) : _state(state), _rounds(0) { }
+
+        void                    addCandidate(const ld::Atom* atom, ld::Internal::FinalSection* sect, uint32_t sectionIndex, uint32_t position);
+        void                    partition();
+        uint32_t                rounds() const { return _rounds; }
+        const std::vector<Candidate>& candidates() const { return _candidates; }
+        uint32_t                candidateIndex(const ld::Atom* atom) const;
+        // calls handler(members) for each class of more than one atom, members in atom order
+        template <typename H>
+        void                    forEachFoldedClass(const H& handler);
+
+    private:
+        struct Range { uint32_t start; uint32_t end; };
+
+        const ld::Atom*         fixupTarget(const ld::Fixup* fit) const;
+        void                    computeStaticHash(uint32_t index);
+        int                     staticCompare(uint32_t left, uint32_t right) const;
+        uint64_t                referenceHash(uint32_t index) const;
+        int                     referenceCompare(uint32_t left, uint32_t right) const;
+
+        ld::Internal&                                       _state;
+        std::vector<Candidate>                              _candidates;
+        std::unordered_map<const ld::Atom*, uint32_t>       _candidateIndexes;
+        std::vector<uint32_t>                               _fixupTargets;  // candidate index of each fixup's target, or kNotCandidate
+        std::vector<uint32_t>                               _order;         // candidates, each class contiguous
+        std::vector<uint32_t>                               _classOf;       // position in _order of first member of candidate's class
+        uint32_t                                            _rounds;
+    };
+
+    inline uint64_t hashMix(uint64_t hash, uint64_t value) {
+        hash ^= value;
+        hash *= 0x100000001B3ULL;
+        return hash;
+    }
 };
 
 
-// A helper for std::unordered_map<> that hashes the instructions of a function
-struct atom_hashing {
+void Folder::addCandidate(const ld::Atom* atom, ld::Internal::FinalSection* sect, uint32_t sectionIndex, uint32_t position)
+{
+    Candidate candidate;
+    candidate.atom          = atom;
+    candidate.section       = sect;
+    candidate.sectionIndex  = sectionIndex;
+    candidate.position      = position;
+    candidate.fixupsStart   = 0;
+    candidate.hash          = 0;
+    _candidateIndexes[atom] = (uint32_t)_candidates.size();
+    _candidates.push_back(candidate);
+}
+
+uint32_t Folder::candidateIndex(const ld::Atom* atom) const
+{
+    auto pos = _candidateIndexes.find(atom);
+    if ( pos == _candidateIndexes.end() )
+        return kNotCandidate;
+    return pos->second;
+}
+
+const ld::Atom* Folder::fixupTarget(const ld::Fixup* fit) const
+{
+    switch ( fit->binding ) {
+        case ld::Fixup::bindingDirectlyBound:
+            return fit->u.target;
+        case ld::Fixup::bindingsIndirectlyBound:
+            return _state.indirectBindingTable[fit->u.bindingIndex];
+        default:
+            return NULL;
+    }
+}
+
+void Folder::computeStaticHash(uint32_t index)
+{
+    Candidate& candidate = _candidates[index];
+    const ld::Atom* atom = candidate.atom;
+    const uint8_t* content = atom->rawContentPointer();
+    const uint64_t size = atom->size();
+    uint64_t hash = hashMix(0xCBF29CE484222325ULL, size);
+    hash = hashMix(hash, candidate.sectionIndex);
+    for (uint64_t i=0; i < size; ++i)
+        hash = hashMix(hash, content[i]);
+    uint32_t fixupIndex = candidate.fixupsStart;
+    for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit, ++fixupIndex) {
+        hash = hashMix(hash, ((uint64_t)fit->offsetInAtom << 8) | fit->kind);
+        const ld::Atom* target = this->fixupTarget(fit);
+        uint32_t targetIndex = (target != NULL) ? this->candidateIndex(target) : kNotCandidate;
+        _fixupTargets[fixupIndex] = targetIndex;
+        // references to other candidates are only compared once classes are known
+        if ( targetIndex == kNotCandidate )
+            hash = hashMix(hash, (target != NULL) ? (uintptr_t)target : (uint64_t)fit->u.addend);
+    }
+    candidate.hash = hash;
+}
+
+template <typename T>
+static int threeWay(T left, T right)
+{
+    if ( left < right )
+        return -1;
+    if ( left > right )
+        return 1;
+    return 0;
+}
 
-    static unsigned long hash(const ld::Atom* atom) {
-        auto pos = sSavedHashes.find(atom);
-        if ( pos != sSavedHashes.end() )
-            return pos->second;
+// orders candidates by everything but the identity of their references to other candidates
+int Folder::staticCompare(uint32_t left, uint32_t right) const
+{
+    const Candidate& l = _candidates[left];
+    const Candidate& r = _candidates[right];
+    if ( int result = threeWay(l.hash, r.hash) )
+        return result;
+    if ( int result = threeWay(l.sectionIndex, r.sectionIndex) )
+        return result;
+    const ld::Atom* latom = l.atom;
+    const ld::Atom* ratom = r.atom;
+    if ( int result = threeWay(latom->size(), ratom->size()) )
+        return result;
+    if ( int result = threeWay(latom->alignment().powerOf2, ratom->alignment().powerOf2) )
+        return result;
+    if ( int result = threeWay(latom->alignment().modulus, ratom->alignment().modulus) )
+        return result;
+    if ( int result = threeWay((int)latom->contentType(), (int)ratom->contentType()) )
+        return result;
+    if ( int result = memcmp(latom->rawContentPointer(), ratom->rawContentPointer(), latom->size()) )
+        return result;
+
+    ld::Atom::UnwindInfo::iterator lu = latom->beginUnwind();
+    ld::Atom::UnwindInfo::iterator lue = latom->endUnwind();
+    ld::Atom::UnwindInfo::iterator ru = ratom->beginUnwind();
+    ld::Atom::UnwindInfo::iterator rue = ratom->endUnwind();
+    if ( int result = threeWay(lue - lu, rue - ru) )
+        return result;
+    for ( ; lu != lue; ++lu, ++ru) {
+        if ( int result = threeWay(lu->startOffset, ru->startOffset) )
+            return result;
+        if ( int result = threeWay(lu->unwindInfo, ru->unwindInfo) )
+            return result;
+    }
 
-        const unsigned instructionBytes = atom->size();
-        const uint8_t*	instructions = atom->rawContentPointer();
-        unsigned long hash = instructionBytes;
-        for (unsigned i=0; i < instructionBytes; ++i) {
-            hash = (hash * 33) + instructions[i];
+    ld::Fixup::iterator lf = latom->fixupsBegin();
+    ld::Fixup::iterator lfe = latom->fixupsEnd();
+    ld::Fixup::iterator rf = ratom->fixupsBegin();
+    ld::Fixup::iterator rfe = ratom->fixupsEnd();
+    if ( int result = threeWay(lfe - lf, rfe - rf) )
+        return result;
+    for (uint32_t li = l.fixupsStart, ri = r.fixupsStart; lf != lfe; ++lf, ++rf, ++li, ++ri) {
+        if ( int result = threeWay(lf->offsetInAtom, rf->offsetInAtom) )
+            return result;
+        if ( int result = threeWay((int)lf->kind, (int)rf->kind) )
+            return result;
+        if ( int result = threeWay((int)lf->clusterSize, (int)rf->clusterSize) )
+            return result;
+        if ( int result = threeWay((int)lf->weakImport, (int)rf->weakImport) )
+            return result;
+        const ld::Atom* ltarget = this->fixupTarget(lf);
+        const ld::Atom* rtarget = this->fixupTarget(rf);
+        if ( int result = threeWay(ltarget == NULL, rtarget == NULL) )
+            return result;
+        if ( ltarget == NULL ) {
+            if ( int result = threeWay(lf->u.addend, rf->u.addend) )
+                return result;
+            continue;
         }
-		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-            const Atom* target = NULL;
-            switch ( fit->binding ) {
-                case ld::Fixup::bindingDirectlyBound:
-                    target = fit->u.target;
-                    break;
-                case ld::Fixup::bindingsIndirectlyBound:
-                    target = sState->indirectBindingTable[fit->u.bindingIndex];
-                    break;
-                default:
-                    break;
-            }
-            // don't include calls to auto-hide functions in hash because they might be de-dup'ed
-            switch ( fit->kind ) {
-#if SUPPORT_ARCH_arm64
-                case ld::Fixup::kindStoreTargetAddressARM64Branch26:
-#endif
-                case ld::Fixup::kindStoreTargetAddressX86BranchPCRel32:
-                    if ( target && target->autoHide() )
-                        continue; // don't include
-                    break;
-                default:
-                    break;
-            }
-            if ( target != NULL ) {
-                const char* name = target->name();
-                if ( target->contentType() == ld::Atom::typeCString )
-                    name = (const char*)target->rawContentPointer();
-                for (const char* s = name; *s != '\0'; ++s)
-                    hash = (hash * 33) + *s;
-            }
+        const bool lcandidate = (_fixupTargets[li] != kNotCandidate);
+        const bool rcandidate = (_fixupTargets[ri] != kNotCandidate);
+        if ( int result = threeWay(lcandidate, rcandidate) )
+            return result;
+        if ( !lcandidate ) {
+            if ( int result = threeWay((uintptr_t)ltarget, (uintptr_t)rtarget) )
+                return result;
         }
-        ++sHashCount;
-        sSavedHashes[atom] = hash;
-        return hash;
     }
+    return 0;
+}
 
-    unsigned long operator()(const ld::Atom* atom) const {
-        return hash(atom);
+uint64_t Folder::referenceHash(uint32_t index) const
+{
+    const Candidate& candidate = _candidates[index];
+    const uint32_t end = candidate.fixupsStart + (uint32_t)(candidate.atom->fixupsEnd() - candidate.atom->fixupsBegin());
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (uint32_t i = candidate.fixupsStart; i < end; ++i) {
+        if ( _fixupTargets[i] != kNotCandidate )
+            hash = hashMix(hash, _classOf[_fixupTargets[i]]);
     }
-};
-
+    return hash;
+}
 
-// A helper for std::unordered_map<> that compares functions
-struct atom_equal {
+// orders candidates of one class by the classes of the candidates they reference
+int Folder::referenceCompare(uint32_t left, uint32_t right) const
+{
+    const Candidate& l = _candidates[left];
+    const Candidate& r = _candidates[right];
+    if ( int result = threeWay(l.hash, r.hash) )
+        return result;
+    // candidates in one class have the same fixups, so the same number of entries
+    const uint32_t count = (uint32_t)(l.atom->fixupsEnd() - l.atom->fixupsBegin());
+    for (uint32_t i=0; i < count; ++i) {
+        uint32_t ltarget = _fixupTargets[l.fixupsStart + i];
+        if ( ltarget == kNotCandidate )
+            continue;
+        uint32_t rtarget = _fixupTargets[r.fixupsStart + i];
+        if ( int result = threeWay(_classOf[ltarget], _classOf[rtarget]) )
+            return result;
+    }
+    return 0;
+}
 
-    struct VisitedSet {
-        std::unordered_set<const ld::Atom*> atoms1;
-        std::unordered_set<const ld::Atom*> atoms2;
-    };
+void Folder::partition()
+{
+    const uint32_t count = (uint32_t)_candidates.size();
+    uint32_t fixupCount = 0;
+    for (Candidate& candidate : _candidates) {
+        candidate.fixupsStart = fixupCount;
+        fixupCount += (uint32_t)(candidate.atom->fixupsEnd() - candidate.atom->fixupsBegin());
+    }
+    _fixupTargets.resize(fixupCount);
+    const size_t chunkCount = (count + kCandidatesPerChunk - 1) / kCandidatesPerChunk;
+    ld::parallel::forEach(chunkCount, [&](size_t chunk) {
+        const uint32_t end = std::min(count, (uint32_t)((chunk + 1) * kCandidatesPerChunk));
+        for (uint32_t i = (uint32_t)(chunk * kCandidatesPerChunk); i < end; ++i)
+            this->computeStaticHash(i);
+    });
+
+    // initial classes: candidates that are equal ignoring which candidates they reference
+    _order.resize(count);
+    for (uint32_t i=0; i < count; ++i)
+        _order[i] = i;
+    std::sort(_order.begin(), _order.end(), [&](uint32_t left, uint32_t right) {
+        int result = this->staticCompare(left, right);
+        return (result != 0) ? (result < 0) : (left < right);
+    });
+    _classOf.resize(count);
+    std::vector<Range> ranges;
+    for (uint32_t start=0; start < count; ) {
+        uint32_t end = start + 1;
+        while ( (end < count) && (this->staticCompare(_order[start], _order[end]) == 0) )
+            ++end;
+        for (uint32_t i=start; i < end; ++i)
+            _classOf[_order[i]] = start;
+        if ( end - start > 1 )
+            ranges.push_back({ start, end });
+        start = end;
+    }
 
-    static bool sameFixups(const ld::Atom* atom1, const ld::Atom* atom2, VisitedSet& visited) {
-        ++sFixupCompareCount;
-        //fprintf(stderr, "sameFixups(%s,%s)\n", atom1->name(), atom2->name());
-        Fixup::iterator	f1   = atom1->fixupsBegin();
-        Fixup::iterator	end1 = atom1->fixupsEnd();
-        Fixup::iterator	f2   = atom2->fixupsBegin();
-        Fixup::iterator	end2 = atom2->fixupsEnd();
-        // two atoms must have same number of fixups
-        if ( (end1 - f1) != (end2 - f2) )
-            return false;
-        // if no fixups, fixups are equal
-        if ( f1 == end1 )
-            return true;
-        // all fixups must be the same
-        do {
-            if ( f1->offsetInAtom != f2->offsetInAtom )
-                return false;
-            if ( f1->kind != f2->kind )
-                return false;
-            if ( f1->clusterSize != f2->clusterSize )
-                return false;
-            if ( f1->binding != f2->binding )
-                return false;
-            const Atom* target1 = NULL;
-            const Atom* target2 = NULL;
-            switch ( f1->binding ) {
-                case ld::Fixup::bindingDirectlyBound:
-                    target1 = f1->u.target;
-                    target2 = f2->u.target;
-                    break;
-                case ld::Fixup::bindingsIndirectlyBound:
-                    target1 = sState->indirectBindingTable[f1->u.bindingIndex];
-                    target2 = sState->indirectBindingTable[f2->u.bindingIndex];
-                    break;
-                 case ld::Fixup::bindingNone:
-                    break;
-               default:
-                    return false;
+    // split classes until every member of a class references the same classes
+    std::vector<uint32_t> newClassOf;
+    while ( !ranges.empty() ) {
+        ++_rounds;
+        ld::parallel::forEach(ranges.size(), [&](size_t rangeIndex) {
+            const Range& range = ranges[rangeIndex];
+            for (uint32_t i=range.start; i < range.end; ++i)
+                _candidates[_order[i]].hash = this->referenceHash(_order[i]);
+        });
+        newClassOf = _classOf;
+        std::vector<std::vector<Range>> splits(ranges.size());
+        ld::parallel::forEach(ranges.size(), [&](size_t rangeIndex) {
+            const Range& range = ranges[rangeIndex];
+            std::sort(&_order[range.start], &_order[range.end], [&](uint32_t left, uint32_t right) {
+                int result = this->referenceCompare(left, right);
+                return (result != 0) ? (result < 0) : (left < right);
+            });
+            uint32_t start = range.start;
+            while ( start < range.end ) {
+                uint32_t end = start + 1;
+                while ( (end < range.end) && (this->referenceCompare(_order[start], _order[end]) == 0) )
+                    ++end;
+                for (uint32_t i=start; i < end; ++i)
+                    newClassOf[_order[i]] = start;
+                if ( end - start > 1 )
+                    splits[rangeIndex].push_back({ start, end });
+                start = end;
+            }
+        });
+        _classOf.swap(newClassOf);
+        // stop once a round splits nothing; otherwise every class that still has more
+        // than one member is looked at again, since a class it references may have split
+        bool changed = false;
+        for (size_t i=0; i < ranges.size(); ++i) {
+            if ( (splits[i].size() != 1) || (splits[i][0].start != ranges[i].start) || (splits[i][0].end != ranges[i].end) ) {
+                changed = true;
+                break;
             }
-            if ( target1 != target2 ) {
-                // targets must match unless they are both calls to functions that will de-dup together
-    #if SUPPORT_ARCH_arm64
-                if ( (f1->kind != ld::Fixup::kindStoreTargetAddressARM64Branch26) && (f1->kind != ld::Fixup::kindStoreTargetAddressX86BranchPCRel32) )
-    #else
-                if ( f1->kind != ld::Fixup::kindStoreTargetAddressX86BranchPCRel32 )
-    #endif
-                    return false;
-                if ( target1->section().type() != target2->section().type() )
-                    return false;
-                if ( target1->section().type() != ld::Section::typeCode )
-                    return false;
-                // to support co-recursive functions, don't call equals() on targets we've already visited
-                if ( ((visited.atoms1.count(target1) == 0) || (visited.atoms2.count(target2) == 0)) && !equal(target1, target2, visited) )
-                    return false;
-              }
-
-            ++f1;
-            ++f2;
-        } while (f1 != end1);
-
-        return true;
+        }
+        if ( !changed )
+            break;
+        ranges.clear();
+        for (const std::vector<Range>& split : splits)
+            ranges.insert(ranges.end(), split.begin(), split.end());
     }
+}
 
-    static bool equal(const ld::Atom* atom1, const ld::Atom* atom2, VisitedSet& visited) {
-        if ( atom_hashing::hash(atom1) != atom_hashing::hash(atom2) )
-            return false;
-        visited.atoms1.insert(atom1);
-        visited.atoms2.insert(atom2);
-        return sameFixups(atom1, atom2, visited);
+template <typename H>
+void Folder::forEachFoldedClass(const H& handler)
+{
+    const uint32_t count = (uint32_t)_order.size();
+    std::vector<const Candidate*> members;
+    std::vector<std::vector<const Candidate*>> classes;
+    for (uint32_t start=0; start < count; ) {
+        uint32_t end = start + 1;
+        while ( (end < count) && (_classOf[_order[end]] == start) )
+            ++end;
+        if ( end - start > 1 ) {
+            members.clear();
+            for (uint32_t i=start; i < end; ++i)
+                members.push_back(&_candidates[_order[i]]);
+            std::sort(members.begin(), members.end(), [](const Candidate* left, const Candidate* right) {
+                if ( left->sectionIndex != right->sectionIndex )
+                    return (left->sectionIndex < right->sectionIndex);
+                return (left->position < right->position);
+            });
+            classes.push_back(members);
+        }
+        start = end;
     }
+    // report classes in address order of their first member, so output does not depend on hashes
+    std::sort(classes.begin(), classes.end(), [](const std::vector<const Candidate*>& left, const std::vector<const Candidate*>& right) {
+        if ( left[0]->sectionIndex != right[0]->sectionIndex )
+            return (left[0]->sectionIndex < right[0]->sectionIndex);
+        return (left[0]->position < right[0]->position);
+    });
+    for (const std::vector<const Candidate*>& members : classes)
+        handler(members);
+}
+
 
-    bool operator()(const ld::Atom* atom1, const ld::Atom* atom2) const {
-        VisitedSet visited;
-        return equal(atom1, atom2, visited);
+// sections whose auto-hide atoms may be folded together
+static bool canFoldSection(const Options& opts, const ld::Internal::FinalSection* sect)
+{
+    switch ( sect->type() ) {
+        case ld::Section::typeCode:
+            return (strcmp(sect->sectionName(), "__text") == 0);
+        case ld::Section::typeUnclassified:
+            return opts.deduplicateReadOnlyData() && (strcmp(sect->sectionName(), "__const") == 0);
+        case ld::Section::typeCString:
+        case ld::Section::typeLiteral4:
+        case ld::Section::typeLiteral8:
+        case ld::Section::typeLiteral16:
+            return opts.deduplicateReadOnlyData();
+        default:
+            return false;
     }
-};
+}
 
+static bool canFoldAtom(const ld::Atom* atom)
+{
+    // ignore empty (alias) atoms
+    if ( atom->size() == 0 )
+        return false;
+    if ( !atom->autoHide() )
+        return false;
+    if ( atom->rawContentPointer() == NULL )
+        return false;
+    for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+        switch ( fit->binding ) {
+            case ld::Fixup::bindingNone:
+            case ld::Fixup::bindingDirectlyBound:
+            case ld::Fixup::bindingsIndirectlyBound:
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
 
 
 void doPass(const Options& opts, ld::Internal& state)
@@ -244,77 +485,64 @@ void doPass(const Options& opts, ld::Internal& state)
 
     const bool verbose = opts.verboseDeduplicate();
 
-    // find __text section
-    ld::Internal::FinalSection* textSection = NULL;
-    for (ld::Internal::FinalSection* sect : state.sections) {
-        if ( (sect->type() == ld::Section::typeCode) && (strcmp(sect->sectionName(), "__text") == 0) ) {
-            textSection = sect;
-            break;
-        }
-    }
-    if ( textSection == NULL )
-        return;
-
-    // build map of auto-hide functions and their duplicates
-    // the key for the map is always the first element in the value vector
-    // the key is always earlier in the atoms list then matching other atoms
-    sState = &state;
-    std::unordered_map<const ld::Atom*, std::vector<const ld::Atom*>, atom_hashing, atom_equal> map;
-    std::unordered_set<const ld::Atom*> masterAtoms;
-    for (const ld::Atom* atom : textSection->atoms) {
-        // ignore empty (alias) atoms
-        if ( atom->size() == 0 )
+    // find auto-hide atoms in __text (and read-only data sections with -deduplicate_read_only_data)
+    Folder folder(state);
+    std::vector<ld::Internal::FinalSection*> foldSections;
+    for (uint32_t sectionIndex=0; sectionIndex < state.sections.size(); ++sectionIndex) {
+        ld::Internal::FinalSection* sect = state.sections[sectionIndex];
+        if ( !canFoldSection(opts, sect) )
             continue;
-        if ( atom->autoHide() )
-            map[atom].push_back(atom);
-	}
-
-    if ( log ) {
-        for (auto& entry : map) {
-            if ( entry.second.size() > 1 ) {
-                printf("Found following matching functions:\n");
-                for (const ld::Atom* atom : entry.second) {
-                    printf("  %p %s\n", atom, atom->name());
-                }
-            }
+        foldSections.push_back(sect);
+        for (uint32_t position=0; position < sect->atoms.size(); ++position) {
+            const ld::Atom* atom = sect->atoms[position];
+            if ( canFoldAtom(atom) )
+                folder.addCandidate(atom, sect, sectionIndex, position);
         }
-        fprintf(stderr, "duplicate sets count:\n");
-        for (auto& entry : map)
-            fprintf(stderr, "  %p -> %lu\n", entry.first, entry.second.size());
     }
+    if ( folder.candidates().empty() )
+        return;
+    folder.partition();
 
     // construct alias atoms to replace atoms found to be duplicates
-    unsigned atomsBeingComparedCount = 0;
-    uint64_t dedupSavings = 0;
-    std::vector<const ld::Atom*>& textAtoms = textSection->atoms;
+    // the first atom of each class stays, the aliases to it are placed in front of it
     std::unordered_map<const ld::Atom*, const ld::Atom*> replacementMap;
-    for (auto& entry : map) {
-        const ld::Atom* masterAtom = entry.first;
-        std::vector<const ld::Atom*>& dups = entry.second;
-        atomsBeingComparedCount += dups.size();
-        if ( dups.size() == 1 )
-            continue;
+    std::unordered_map<const ld::Atom*, std::vector<const ld::Atom*>> aliasesOf;
+    std::map<ld::Internal::FinalSection*, uint64_t> savings;
+    uint64_t foldedBytes = 0;
+    folder.forEachFoldedClass([&](const std::vector<const Candidate*>& dups) {
+        const ld::Atom* masterAtom = dups[0]->atom;
+        ld::Internal::FinalSection* sect = dups[0]->section;
+        foldedBytes += ((dups.size() - 1) * masterAtom->size());
         if ( verbose )  {
-            dedupSavings += ((dups.size() - 1) * masterAtom->size());
-            fprintf(stderr, "deduplicate the following %lu functions (%llu bytes apiece):\n", dups.size(), masterAtom->size());
+            savings[sect] += ((dups.size() - 1) * masterAtom->size());
+            fprintf(stderr, "deduplicate the following %lu %s (%llu bytes apiece):\n", dups.size(),
+                    (sect->type() == ld::Section::typeCode) ? "functions" : "constants", masterAtom->size());
         }
-        for (const ld::Atom* dupAtom : dups) {
+        std::vector<const ld::Atom*>& aliases = aliasesOf[masterAtom];
+        for (const Candidate* dup : dups) {
+            const ld::Atom* dupAtom = dup->atom;
             if ( verbose )
                 fprintf(stderr, "    %s\n", dupAtom->name());
             if ( dupAtom == masterAtom )
                 continue;
             const ld::Atom* aliasAtom = new DeDupAliasAtom(dupAtom, masterAtom);
-            auto pos = std::find(textAtoms.begin(), textAtoms.end(), masterAtom);
-            if ( pos != textAtoms.end() ) {
-                textAtoms.insert(pos, aliasAtom);
-                state.atomToSection[aliasAtom] = textSection;
-                replacementMap[dupAtom] = aliasAtom;
-            }
+            aliases.push_back(aliasAtom);
+            state.atomToSection[aliasAtom] = sect;
+            replacementMap[dupAtom] = aliasAtom;
         }
-    }
+    });
     if ( verbose )  {
-        fprintf(stderr, "deduplication saved %llu bytes of __text\n", dedupSavings);
+        for (ld::Internal::FinalSection* sect : foldSections) {
+            if ( (sect->type() == ld::Section::typeCode) || (savings.count(sect) != 0) )
+                fprintf(stderr, "deduplication saved %llu bytes of %s\n", savings[sect], sect->sectionName());
+        }
     }
+    ld::timing::count("deduplicated atoms", replacementMap.size());
+    ld::timing::count("deduplicated bytes", foldedBytes);
+    if ( log )
+        fprintf(stderr, "deduplication of %lu atoms took %u rounds\n", folder.candidates().size(), folder.rounds());
+    if ( replacementMap.empty() )
+        return;
 
     if ( log ) {
         fprintf(stderr, "replacement map:\n");
@@ -345,28 +573,31 @@ void doPass(const Options& opts, ld::Internal& state)
         }
     }
 
-    if ( log ) {
-        fprintf(stderr, "atoms before pruning:\n");
-        for (const ld::Atom* atom : textSection->atoms)
-            fprintf(stderr, "  %p (size=%llu) %sp\n", atom, atom->size(), atom->name());
+    // rebuild the atom lists in one pass: drop replaced atoms, put aliases in front of what they alias
+    for (ld::Internal::FinalSection* sect : foldSections) {
+        std::vector<const ld::Atom*> atoms;
+        atoms.reserve(sect->atoms.size());
+        for (const ld::Atom* atom : sect->atoms) {
+            if ( replacementMap.count(atom) != 0 )
+                continue;
+            auto pos = aliasesOf.find(atom);
+            if ( pos != aliasesOf.end() )
+                atoms.insert(atoms.end(), pos->second.begin(), pos->second.end());
+            atoms.push_back(atom);
+        }
+        sect->atoms.swap(atoms);
     }
-    // remove replaced atoms from section
-	textSection->atoms.erase(std::remove_if(textSection->atoms.begin(), textSection->atoms.end(),
-                [&](const ld::Atom* atom) {
-                    return (replacementMap.count(atom) != 0);
-                }),
-                textSection->atoms.end());
 
    for (auto& entry : replacementMap)
         state.atomToSection.erase(entry.first);
 
     if ( log ) {
         fprintf(stderr, "atoms after pruning:\n");
-        for (const ld::Atom* atom : textSection->atoms)
-            fprintf(stderr, "  %p (size=%llu) %sp\n", atom, atom->size(), atom->name());
+        for (ld::Internal::FinalSection* sect : foldSections) {
+            for (const ld::Atom* atom : sect->atoms)
+                fprintf(stderr, "  %p (size=%llu) %sp\n", atom, atom->size(), atom->name());
+        }
     }
-
-   //fprintf(stderr, "hash-count=%lu, fixup-compares=%lu, atom-count=%u\n", sHashCount, sFixupCompareCount, atomsBeingComparedCount);
 }
 
 
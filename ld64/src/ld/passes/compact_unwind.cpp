@@ -36,6 +36,7 @@
 #include <algorithm>
 
 #include "ld.hpp"
+#include "Parallel.hpp"
 #include "compact_unwind.h"
 #include "Architectures.hpp"
 #include "MachOFileAbstraction.hpp"
@@ -88,26 +89,45 @@ private:
 
 	typedef macho_unwind_info_compressed_second_level_page_header<P> CSLP;
 
+	// (encoding, index in encodings table) pairs, sorted by encoding
+	typedef std::vector<std::pair<compact_unwind_encoding_t, unsigned int> > EncodingIndexes;
+
+	// a second level page is planned (which entries, how big) serially, because
+	// where one page ends decides where the next starts, then filled in on its own
+	struct SecondLevelPage {
+		unsigned int										startIndex;		// of first unique entry on page
+		unsigned int										endIndex;
+		bool												compressed;
+		uint32_t											size;
+		uint8_t*											start;
+		std::map<compact_unwind_encoding_t, unsigned int>	pageSpecificEncodings;
+		std::vector<ld::Fixup>								fixups;			// offsets from _pageAlignedPages
+	};
+
 	bool						encodingMeansUseDwarf(compact_unwind_encoding_t enc);
-	void						compressDuplicates(const std::vector<UnwindEntry>& entries, 
+	void						compressDuplicates(const std::vector<UnwindEntry>& entries,
 													std::vector<UnwindEntry>& uniqueEntries);
-	void						makePersonalityIndexes(std::vector<UnwindEntry>& entries, 
-														std::map<const ld::Atom*, uint32_t>& personalityIndexMap);
-	void						findCommonEncoding(const std::vector<UnwindEntry>& entries, 
-													std::map<compact_unwind_encoding_t, unsigned int>& commonEncodings);
-	void						makeLsdaIndex(const std::vector<UnwindEntry>& entries, std::vector<LSDAEntry>& lsdaIndex, 
-																std::map<const ld::Atom*, uint32_t>& lsdaIndexOffsetMap);
-	unsigned int				makeCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
-													const std::map<compact_unwind_encoding_t,unsigned int> commonEncodings,  
-													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd);
-	unsigned int				makeRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,  
-															unsigned int endIndex, uint8_t*& pageEnd);
-	void						addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc);
-	void						addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde);
-	void						addRegularAddressFixup(uint32_t offset, const ld::Atom* func);
-	void						addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde);
-	void						addImageOffsetFixup(uint32_t offset, const ld::Atom* targ);
-	void						addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend);
+	void						makePersonalityIndexes(std::vector<UnwindEntry>& entries,
+														std::vector<const ld::Atom*>& personalities);
+	void						findCommonEncoding(const std::vector<UnwindEntry>& entries, EncodingIndexes& commonEncodings);
+	static bool					findEncodingIndex(const EncodingIndexes& encodings, compact_unwind_encoding_t encoding,
+																unsigned int& index);
+	void						makeLsdaIndex(const std::vector<UnwindEntry>& entries, std::vector<LSDAEntry>& lsdaIndex,
+																std::vector<uint32_t>& lsdaIndexOffsets);
+	void						planCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,
+													const EncodingIndexes& commonEncodings,
+													uint32_t pageSize, unsigned int endIndex, SecondLevelPage& page);
+	void						planRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,
+															unsigned int endIndex, SecondLevelPage& page);
+	void						fillCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,
+													const EncodingIndexes& commonEncodings, SecondLevelPage& page);
+	void						fillRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, SecondLevelPage& page);
+	void						addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc);
+	void						addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde);
+	void						addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func);
+	void						addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde);
+	void						addImageOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ);
+	void						addImageOffsetFixupPlusAddend(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ, uint32_t addend);
 
 	uint8_t*								_pagesForDelete;
 	uint8_t*								_pageAlignedPages;
@@ -143,20 +163,17 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 	_fixups.reserve(uniqueEntries.size()*3);
 
 	// build personality index, update encodings with personality index
-	std::map<const ld::Atom*, uint32_t>	personalityIndexMap;
-	makePersonalityIndexes(uniqueEntries, personalityIndexMap);
-	if ( personalityIndexMap.size() > 3 ) {
-		throw "too many personality routines for compact unwind to encode";
-	}
+	std::vector<const ld::Atom*> personalities;
+	makePersonalityIndexes(uniqueEntries, personalities);
 
 	// put the most common encodings into the common table, but at most 127 of them
-	std::map<compact_unwind_encoding_t, unsigned int> commonEncodings;
+	EncodingIndexes commonEncodings;
 	findCommonEncoding(uniqueEntries, commonEncodings);
 	
 	// build lsda index
-	std::map<const ld::Atom*, uint32_t> lsdaIndexOffsetMap;
+	std::vector<uint32_t> lsdaIndexOffsets;
 	std::vector<LSDAEntry>	lsdaIndex;
-	makeLsdaIndex(uniqueEntries, lsdaIndex, lsdaIndexOffsetMap);
+	makeLsdaIndex(uniqueEntries, lsdaIndex, lsdaIndexOffsets);
 	
 	// calculate worst case size for all unwind info pages when allocating buffer
 	const unsigned int entriesPerRegularPage = (4096-sizeof(unwind_info_regular_second_level_page_header))/sizeof(unwind_info_regular_second_level_entry);
@@ -177,18 +194,19 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 		maxLastPageSize = 4096;
 	}
 	
-	// fill in pages in reverse order
-	const ld::Atom* secondLevelFirstFuncs[pageCount*3];
-	uint8_t* secondLevelPagesStarts[pageCount*3];
+	// lay out pages in reverse order
+	std::vector<SecondLevelPage> secondLevelPages;
+	secondLevelPages.reserve(pageCount*3);
 	unsigned int endIndex = uniqueEntries.size();
-	unsigned int secondLevelPageCount = 0;
 	uint8_t* pageEnd = &_pageAlignedPages[pageCount*4096];
 	uint32_t pageSize = maxLastPageSize;
 	while ( endIndex > 0 ) {
-		endIndex = makeCompressedSecondLevelPage(uniqueEntries, commonEncodings, pageSize, endIndex, pageEnd);
-		secondLevelPagesStarts[secondLevelPageCount] = pageEnd;
-		secondLevelFirstFuncs[secondLevelPageCount] = uniqueEntries[endIndex].func;
-		++secondLevelPageCount;
+		secondLevelPages.push_back(SecondLevelPage());
+		SecondLevelPage& page = secondLevelPages.back();
+		planCompressedSecondLevelPage(uniqueEntries, commonEncodings, pageSize, endIndex, page);
+		pageEnd -= page.size;
+		page.start = pageEnd;
+		endIndex = page.startIndex;
 		// if this requires more than one page, align so that next starts on page boundary
 		if ( (pageSize != 4096) && (endIndex > 0) ) {
 			pageEnd = (uint8_t*)((uintptr_t)(pageEnd) & -4096);
@@ -197,13 +215,25 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 	}
 	_pages = pageEnd;
 	_pagesSize = &_pageAlignedPages[pageCount*4096] - pageEnd;
+	const unsigned int secondLevelPageCount = secondLevelPages.size();
+
+	// fill in pages concurrently, then gather their fixups in the order the pages were laid out
+	ld::parallel::forEach(secondLevelPageCount, [&](size_t index) {
+		SecondLevelPage& page = secondLevelPages[index];
+		if ( page.compressed )
+			fillCompressedSecondLevelPage(uniqueEntries, commonEncodings, page);
+		else
+			fillRegularSecondLevelPage(uniqueEntries, page);
+	});
+	for (typename std::vector<SecondLevelPage>::iterator it = secondLevelPages.begin(); it != secondLevelPages.end(); ++it)
+		_fixups.insert(_fixups.end(), it->fixups.begin(), it->fixups.end());
 
 	// calculate section layout
 	const uint32_t commonEncodingsArraySectionOffset = sizeof(macho_unwind_info_section_header<P>);
 	const uint32_t commonEncodingsArrayCount = commonEncodings.size();
 	const uint32_t commonEncodingsArraySize = commonEncodingsArrayCount * sizeof(compact_unwind_encoding_t);
 	const uint32_t personalityArraySectionOffset = commonEncodingsArraySectionOffset + commonEncodingsArraySize;
-	const uint32_t personalityArrayCount = personalityIndexMap.size();
+	const uint32_t personalityArrayCount = personalities.size();
 	const uint32_t personalityArraySize = personalityArrayCount * sizeof(uint32_t);
 	const uint32_t indexSectionOffset = personalityArraySectionOffset + personalityArraySize;
 	const uint32_t indexCount = secondLevelPageCount+1;
@@ -234,38 +264,43 @@ UnwindInfoAtom<A>::UnwindInfoAtom(const std::vector<UnwindEntry>& entries, uint6
 	
 	// copy common encodings
 	uint32_t* commonEncodingsTable = (uint32_t*)&_header[commonEncodingsArraySectionOffset];
-	for (std::map<uint32_t, unsigned int>::iterator it=commonEncodings.begin(); it != commonEncodings.end(); ++it)
+	for (typename EncodingIndexes::iterator it=commonEncodings.begin(); it != commonEncodings.end(); ++it)
 		E::set32(commonEncodingsTable[it->second], it->first);
 		
 	// make references for personality entries
 	uint32_t* personalityArray = (uint32_t*)&_header[sectionHeader->personalityArraySectionOffset()];
-	for (std::map<const ld::Atom*, unsigned int>::iterator it=personalityIndexMap.begin(); it != personalityIndexMap.end(); ++it) {
-		uint32_t offset = (uint8_t*)&personalityArray[it->second-1] - _header;
-		this->addImageOffsetFixup(offset, it->first);
+	for (unsigned int i=0; i < personalityArrayCount; ++i) {
+		uint32_t offset = (uint8_t*)&personalityArray[i] - _header;
+		this->addImageOffsetFixup(_fixups, offset, personalities[i]);
 	}
 
 	// build first level index and references
 	macho_unwind_info_section_header_index_entry<P>* indexTable = (macho_unwind_info_section_header_index_entry<P>*)&_header[indexSectionOffset];
 	uint32_t refOffset;
 	for (unsigned int i=0; i < secondLevelPageCount; ++i) {
-		unsigned int reverseIndex = secondLevelPageCount - 1 - i;
+		const SecondLevelPage& page = secondLevelPages[secondLevelPageCount - 1 - i];
+		const ld::Atom* firstFunc = uniqueEntries[page.startIndex].func;
+		// a function with several unwind ranges has several entries, the index uses the lsda offset of its last one
+		unsigned int lsdaEntry = page.startIndex;
+		while ( (lsdaEntry+1 < uniqueEntries.size()) && (uniqueEntries[lsdaEntry+1].func == firstFunc) )
+			++lsdaEntry;
 		indexTable[i].set_functionOffset(0);
-		indexTable[i].set_secondLevelPagesSectionOffset(secondLevelPagesStarts[reverseIndex]-_pages+headerEndSectionOffset);
-		indexTable[i].set_lsdaIndexArraySectionOffset(lsdaIndexOffsetMap[secondLevelFirstFuncs[reverseIndex]]+lsdaIndexArraySectionOffset); 
+		indexTable[i].set_secondLevelPagesSectionOffset(page.start-_pages+headerEndSectionOffset);
+		indexTable[i].set_lsdaIndexArraySectionOffset(lsdaIndexOffsets[lsdaEntry]+lsdaIndexArraySectionOffset); 
 		refOffset = (uint8_t*)&indexTable[i] - _header;
-		this->addImageOffsetFixup(refOffset, secondLevelFirstFuncs[reverseIndex]);
+		this->addImageOffsetFixup(_fixups, refOffset, firstFunc);
 	}
 	indexTable[secondLevelPageCount].set_functionOffset(0);
 	indexTable[secondLevelPageCount].set_secondLevelPagesSectionOffset(0);
 	indexTable[secondLevelPageCount].set_lsdaIndexArraySectionOffset(lsdaIndexArraySectionOffset+lsdaIndexArraySize); 
 	refOffset = (uint8_t*)&indexTable[secondLevelPageCount] - _header;
-	this->addImageOffsetFixupPlusAddend(refOffset, entries.back().func, entries.back().func->size()+1);
+	this->addImageOffsetFixupPlusAddend(_fixups, refOffset, entries.back().func, entries.back().func->size()+1);
 	
 	// build lsda references
 	uint32_t lsdaEntrySectionOffset = lsdaIndexArraySectionOffset;
 	for (std::vector<LSDAEntry>::iterator it = lsdaIndex.begin(); it != lsdaIndex.end(); ++it) {
-		this->addImageOffsetFixup(lsdaEntrySectionOffset, it->func);
-		this->addImageOffsetFixup(lsdaEntrySectionOffset+4, it->lsda);
+		this->addImageOffsetFixup(_fixups, lsdaEntrySectionOffset, it->func);
+		this->addImageOffsetFixup(_fixups, lsdaEntrySectionOffset+4, it->lsda);
 		lsdaEntrySectionOffset += sizeof(unwind_info_section_header_lsda_index_entry);
 	}
 	
@@ -334,64 +369,78 @@ void UnwindInfoAtom<A>::compressDuplicates(const std::vector<UnwindEntry>& entri
 }
 
 template <typename A>
-void UnwindInfoAtom<A>::makePersonalityIndexes(std::vector<UnwindEntry>& entries, std::map<const ld::Atom*, uint32_t>& personalityIndexMap)
+void UnwindInfoAtom<A>::makePersonalityIndexes(std::vector<UnwindEntry>& entries, std::vector<const ld::Atom*>& personalities)
 {
 	for(std::vector<UnwindEntry>::iterator it=entries.begin(); it != entries.end(); ++it) {
 		if ( it->personalityPointer != NULL ) {
-			std::map<const ld::Atom*, uint32_t>::iterator pos = personalityIndexMap.find(it->personalityPointer);
-			if ( pos == personalityIndexMap.end() ) {
-				const uint32_t nextIndex = personalityIndexMap.size() + 1;
-				personalityIndexMap[it->personalityPointer] = nextIndex;
+			// at most three personality routines can be encoded, so a linear search is all it takes
+			std::vector<const ld::Atom*>::iterator pos = std::find(personalities.begin(), personalities.end(), it->personalityPointer);
+			if ( pos == personalities.end() ) {
+				if ( personalities.size() == 3 )
+					throw "too many personality routines for compact unwind to encode";
+				personalities.push_back(it->personalityPointer);
+				pos = personalities.end() - 1;
 			}
-			uint32_t personalityIndex = personalityIndexMap[it->personalityPointer];
+			uint32_t personalityIndex = (pos - personalities.begin()) + 1;
 			it->encoding |= (personalityIndex << (__builtin_ctz(UNWIND_PERSONALITY_MASK)) );
 		}
 	}
-	if (_s_log) fprintf(stderr, "makePersonalityIndexes() %lu personality routines used\n", personalityIndexMap.size()); 
+	if (_s_log) fprintf(stderr, "makePersonalityIndexes() %lu personality routines used\n", personalities.size()); 
 }
 
 
 template <typename A>
-void UnwindInfoAtom<A>::findCommonEncoding(const std::vector<UnwindEntry>& entries, 
-											std::map<compact_unwind_encoding_t, unsigned int>& commonEncodings)
+void UnwindInfoAtom<A>::findCommonEncoding(const std::vector<UnwindEntry>& entries, EncodingIndexes& commonEncodings)
 {
-	// scan infos to get frequency counts for each encoding
-	std::map<compact_unwind_encoding_t, unsigned int> encodingsUsed;
-	unsigned int mostCommonEncodingUsageCount = 0;
+	// sort encodings to get frequency counts for each encoding
+	std::vector<compact_unwind_encoding_t> encodings;
+	encodings.reserve(entries.size());
 	for(std::vector<UnwindEntry>::const_iterator it=entries.begin(); it != entries.end(); ++it) {
 		// never put dwarf into common table
-		if ( encodingMeansUseDwarf(it->encoding) )
-			continue;
-		std::map<compact_unwind_encoding_t, unsigned int>::iterator pos = encodingsUsed.find(it->encoding);
-		if ( pos == encodingsUsed.end() ) {
-			encodingsUsed[it->encoding] = 1;
-		}
-		else {
-			encodingsUsed[it->encoding] += 1;
-			if ( mostCommonEncodingUsageCount < encodingsUsed[it->encoding] )
-				mostCommonEncodingUsageCount = encodingsUsed[it->encoding];
-		}
+		if ( !encodingMeansUseDwarf(it->encoding) )
+			encodings.push_back(it->encoding);
+	}
+	std::sort(encodings.begin(), encodings.end());
+	EncodingIndexes encodingsUsed;	// (encoding, usage count)
+	for(std::vector<compact_unwind_encoding_t>::iterator it=encodings.begin(); it != encodings.end(); ++it) {
+		if ( !encodingsUsed.empty() && (encodingsUsed.back().first == *it) )
+			encodingsUsed.back().second += 1;
+		else
+			encodingsUsed.push_back(std::make_pair(*it, 1U));
 	}
 	// put the most common encodings into the common table, but at most 127 of them
-	for(unsigned int usages=mostCommonEncodingUsageCount; usages > 1; --usages) {
-		for (std::map<compact_unwind_encoding_t, unsigned int>::iterator euit=encodingsUsed.begin(); euit != encodingsUsed.end(); ++euit) {
-			if ( euit->second == usages ) {
-				unsigned int sz = commonEncodings.size();
-				if ( sz < 127 ) {
-					commonEncodings[euit->first] = sz;
-				}
-			}
-		}
+	// encodings used equally often go in encoding order
+	std::stable_sort(encodingsUsed.begin(), encodingsUsed.end(),
+					[](const std::pair<compact_unwind_encoding_t, unsigned int>& a, const std::pair<compact_unwind_encoding_t, unsigned int>& b) {
+						return (a.second > b.second);
+					});
+	for (typename EncodingIndexes::iterator euit=encodingsUsed.begin(); euit != encodingsUsed.end(); ++euit) {
+		if ( (euit->second < 2) || (commonEncodings.size() == 127) )
+			break;
+		commonEncodings.push_back(std::make_pair(euit->first, (unsigned int)commonEncodings.size()));
 	}
+	std::sort(commonEncodings.begin(), commonEncodings.end());
 	if (_s_log) fprintf(stderr, "findCommonEncoding() %lu common encodings found\n", commonEncodings.size()); 
 }
 
 
 template <typename A>
-void UnwindInfoAtom<A>::makeLsdaIndex(const std::vector<UnwindEntry>& entries, std::vector<LSDAEntry>& lsdaIndex, std::map<const ld::Atom*, uint32_t>& lsdaIndexOffsetMap)
+bool UnwindInfoAtom<A>::findEncodingIndex(const EncodingIndexes& encodings, compact_unwind_encoding_t encoding, unsigned int& index)
+{
+	typename EncodingIndexes::const_iterator pos = std::lower_bound(encodings.begin(), encodings.end(), std::make_pair(encoding, 0U));
+	if ( (pos == encodings.end()) || (pos->first != encoding) )
+		return false;
+	index = pos->second;
+	return true;
+}
+
+
+template <typename A>
+void UnwindInfoAtom<A>::makeLsdaIndex(const std::vector<UnwindEntry>& entries, std::vector<LSDAEntry>& lsdaIndex, std::vector<uint32_t>& lsdaIndexOffsets)
 {
+	lsdaIndexOffsets.reserve(entries.size());
 	for(std::vector<UnwindEntry>::const_iterator it=entries.begin(); it != entries.end(); ++it) {
-		lsdaIndexOffsetMap[it->func] = lsdaIndex.size() * sizeof(unwind_info_section_header_lsda_index_entry);
+		lsdaIndexOffsets.push_back(lsdaIndex.size() * sizeof(unwind_info_section_header_lsda_index_entry));
 		if ( it->lsda != NULL ) {
 			LSDAEntry entry;
 			entry.func = it->func;
@@ -404,244 +453,252 @@ void UnwindInfoAtom<A>::makeLsdaIndex(const std::vector<UnwindEntry>& entries, s
 
 
 template <>
-void UnwindInfoAtom<x86>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<x86>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<x86_64>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<arm64>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addCompressedAddressOffsetFixup(uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
+void UnwindInfoAtom<arm>::addCompressedAddressOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func, const ld::Atom* fromFunc)
 {
 	if ( fromFunc->isThumb() ) {
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of4, ld::Fixup::kindSetTargetAddress, func));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of4, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of4, ld::Fixup::kindSubtractAddend, 1));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k4of4, ld::Fixup::kindStoreLittleEndianLow24of32));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of4, ld::Fixup::kindSetTargetAddress, func));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of4, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of4, ld::Fixup::kindSubtractAddend, 1));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k4of4, ld::Fixup::kindStoreLittleEndianLow24of32));
 	}
 	else {
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
-		_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetAddress, func));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindSubtractTargetAddress, fromFunc));
+		fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndianLow24of32));
 	}
 }
 
 template <>
-void UnwindInfoAtom<x86>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86_64>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addCompressedEncodingFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm>::addCompressedEncodingFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<x86>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<x86_64>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<arm64>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addRegularAddressFixup(uint32_t offset, const ld::Atom* func)
+void UnwindInfoAtom<arm>::addRegularAddressFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* func)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, func));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<x86_64>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm64>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addRegularFDEOffsetFixup(uint32_t offset, const ld::Atom* fde)
+void UnwindInfoAtom<arm>::addRegularFDEOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* fde)
 {
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
-	_fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k1of2, ld::Fixup::kindSetTargetSectionOffset, fde));
+	fixups.push_back(ld::Fixup(offset+4, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndianLow24of32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addImageOffsetFixup(uint32_t offset, const ld::Atom* targ)
+void UnwindInfoAtom<x86>::addImageOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addImageOffsetFixup(uint32_t offset, const ld::Atom* targ)
+void UnwindInfoAtom<x86_64>::addImageOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addImageOffsetFixup(uint32_t offset, const ld::Atom* targ)
+void UnwindInfoAtom<arm64>::addImageOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addImageOffsetFixup(uint32_t offset, const ld::Atom* targ)
+void UnwindInfoAtom<arm>::addImageOffsetFixup(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of2, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of2, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86>::addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend)
+void UnwindInfoAtom<x86>::addImageOffsetFixupPlusAddend(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ, uint32_t addend)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<x86_64>::addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend)
+void UnwindInfoAtom<x86_64>::addImageOffsetFixupPlusAddend(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ, uint32_t addend)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
 }
 
 template <>
-void UnwindInfoAtom<arm64>::addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend)
+void UnwindInfoAtom<arm64>::addImageOffsetFixupPlusAddend(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ, uint32_t addend)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
 }
 
 
 template <>
-void UnwindInfoAtom<arm>::addImageOffsetFixupPlusAddend(uint32_t offset, const ld::Atom* targ, uint32_t addend)
+void UnwindInfoAtom<arm>::addImageOffsetFixupPlusAddend(std::vector<ld::Fixup>& fixups, uint32_t offset, const ld::Atom* targ, uint32_t addend)
 {
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
-	_fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k1of3, ld::Fixup::kindSetTargetImageOffset, targ));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k2of3, ld::Fixup::kindAddAddend, addend));
+	fixups.push_back(ld::Fixup(offset, ld::Fixup::k3of3, ld::Fixup::kindStoreLittleEndian32));
 }
 
 
 
 
 template <typename A>
-unsigned int UnwindInfoAtom<A>::makeRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,  
-															unsigned int endIndex, uint8_t*& pageEnd)
+void UnwindInfoAtom<A>::planRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, uint32_t pageSize,
+															unsigned int endIndex, SecondLevelPage& page)
 {
 	const unsigned int maxEntriesPerPage = (pageSize - sizeof(unwind_info_regular_second_level_page_header))/sizeof(unwind_info_regular_second_level_entry);
 	const unsigned int entriesToAdd = ((endIndex > maxEntriesPerPage) ? maxEntriesPerPage : endIndex);
-	uint8_t* pageStart = pageEnd 
-						- entriesToAdd*sizeof(unwind_info_regular_second_level_entry) 
-						- sizeof(unwind_info_regular_second_level_page_header);
-	macho_unwind_info_regular_second_level_page_header<P>* page = (macho_unwind_info_regular_second_level_page_header<P>*)pageStart;
-	page->set_kind(UNWIND_SECOND_LEVEL_REGULAR);
-	page->set_entryPageOffset(sizeof(macho_unwind_info_regular_second_level_page_header<P>));
-	page->set_entryCount(entriesToAdd);
-	macho_unwind_info_regular_second_level_entry<P>* entryTable = (macho_unwind_info_regular_second_level_entry<P>*)(pageStart + page->entryPageOffset());
+	page.startIndex = endIndex - entriesToAdd;
+	page.endIndex = endIndex;
+	page.compressed = false;
+	page.size = entriesToAdd*sizeof(unwind_info_regular_second_level_entry) + sizeof(unwind_info_regular_second_level_page_header);
+	page.pageSpecificEncodings.clear();
+	if (_s_log) fprintf(stderr, "regular page with %u entries\n", entriesToAdd);
+}
+
+
+template <typename A>
+void UnwindInfoAtom<A>::fillRegularSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos, SecondLevelPage& page)
+{
+	const unsigned int entriesToAdd = page.endIndex - page.startIndex;
+	uint8_t* pageStart = page.start;
+	macho_unwind_info_regular_second_level_page_header<P>* pageHeader = (macho_unwind_info_regular_second_level_page_header<P>*)pageStart;
+	pageHeader->set_kind(UNWIND_SECOND_LEVEL_REGULAR);
+	pageHeader->set_entryPageOffset(sizeof(macho_unwind_info_regular_second_level_page_header<P>));
+	pageHeader->set_entryCount(entriesToAdd);
+	macho_unwind_info_regular_second_level_entry<P>* entryTable = (macho_unwind_info_regular_second_level_entry<P>*)(pageStart + pageHeader->entryPageOffset());
 	for (unsigned int i=0; i < entriesToAdd; ++i) {
-		const UnwindEntry& info = uniqueInfos[endIndex-entriesToAdd+i];
+		const UnwindEntry& info = uniqueInfos[page.startIndex+i];
 		entryTable[i].set_functionOffset(0);
 		entryTable[i].set_encoding(info.encoding);
 		// add fixup for address part of entry
 		uint32_t offset = (uint8_t*)(&entryTable[i]) - _pageAlignedPages;
-		this->addRegularAddressFixup(offset, info.func);
+		this->addRegularAddressFixup(page.fixups, offset, info.func);
 		if ( encodingMeansUseDwarf(info.encoding) ) {
 			// add fixup for dwarf offset part of page specific encoding
 			uint32_t encOffset = (uint8_t*)(&entryTable[i]) - _pageAlignedPages;
-			this->addRegularFDEOffsetFixup(encOffset, info.fde);
+			this->addRegularFDEOffsetFixup(page.fixups, encOffset, info.fde);
 		}
 	}
-	if (_s_log) fprintf(stderr, "regular page with %u entries\n", entriesToAdd);
-	pageEnd = pageStart;
-	return endIndex - entriesToAdd;
 }
 
 
 template <typename A>
-unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,   
-													const std::map<compact_unwind_encoding_t,unsigned int> commonEncodings,  
-													uint32_t pageSize, unsigned int endIndex, uint8_t*& pageEnd)
+void UnwindInfoAtom<A>::planCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,
+													const EncodingIndexes& commonEncodings,
+													uint32_t pageSize, unsigned int endIndex, SecondLevelPage& page)
 {
-	if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(pageSize=%u, endIndex=%u)\n", pageSize, endIndex);
-	// first pass calculates how many compressed entries we could fit in this sized page
+	if (_s_log) fprintf(stderr, "planCompressedSecondLevelPage(pageSize=%u, endIndex=%u)\n", pageSize, endIndex);
+	// calculate how many compressed entries we could fit in this sized page
 	// keep adding entries to page until:
 	//  1) encoding table plus entry table plus header exceed page size
 	//  2) the file offset delta from the first to last function > 24 bits
 	//  3) custom encoding index reaches 255
 	//  4) run out of uniqueInfos to encode
-	std::map<compact_unwind_encoding_t, unsigned int> pageSpecificEncodings;
+	std::map<compact_unwind_encoding_t, unsigned int>& pageSpecificEncodings = page.pageSpecificEncodings;
 	uint32_t space4 =  (pageSize - sizeof(unwind_info_compressed_second_level_page_header))/sizeof(uint32_t);
 	int index = endIndex-1;
 	int entryCount = 0;
@@ -651,10 +708,8 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 		const UnwindEntry& info = uniqueInfos[index--];
 		// compute encoding index
 		unsigned int encodingIndex;
-		std::map<compact_unwind_encoding_t, unsigned int>::const_iterator pos = commonEncodings.find(info.encoding);
-		if ( pos != commonEncodings.end() ) {
-			encodingIndex = pos->second;
-			if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, re-use commonEncodings[%d]=0x%08X\n", index, encodingIndex, info.encoding);
+		if ( findEncodingIndex(commonEncodings, info.encoding, encodingIndex) ) {
+			if (_s_log) fprintf(stderr, "planCompressedSecondLevelPage(): funcIndex=%d, re-use commonEncodings[%d]=0x%08X\n", index, encodingIndex, info.encoding);
 		}
 		else {
 			// no commmon entry, so add one on this page
@@ -665,14 +720,14 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 			}
 			std::map<compact_unwind_encoding_t, unsigned int>::iterator ppos = pageSpecificEncodings.find(encoding);
 			if ( ppos != pageSpecificEncodings.end() ) {
-				encodingIndex = pos->second;
-				if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, re-use pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
+				encodingIndex = ppos->second;
+				if (_s_log) fprintf(stderr, "planCompressedSecondLevelPage(): funcIndex=%d, re-use pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
 			}
 			else {
 				encodingIndex = commonEncodings.size() + pageSpecificEncodings.size();
 				if ( encodingIndex <= 255 ) {
 					pageSpecificEncodings[encoding] = encodingIndex;
-					if (_s_log) fprintf(stderr, "makeCompressedSecondLevelPage(): funcIndex=%d, pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
+					if (_s_log) fprintf(stderr, "planCompressedSecondLevelPage(): funcIndex=%d, pageSpecificEncodings[%d]=0x%08X\n", index, encodingIndex, encoding);
 				}
 				else {
 					canDo = false; // case 3)
@@ -707,7 +762,8 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 	if ( (compressPageUsed < (pageSize-4) && (index >= 0) ) ) {
 		const int regularEntriesPerPage = (pageSize - sizeof(unwind_info_regular_second_level_page_header))/sizeof(unwind_info_regular_second_level_entry);
 		if ( entryCount < regularEntriesPerPage ) {
-			return makeRegularSecondLevelPage(uniqueInfos, pageSize, endIndex, pageEnd);
+			planRegularSecondLevelPage(uniqueInfos, pageSize, endIndex, page);
+			return;
 		}
 	}
 	
@@ -716,19 +772,32 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 	if ( compressPageUsed == (pageSize-4) )
 		pad = 4;
 
-	// second pass fills in page 
-	uint8_t* pageStart = pageEnd - compressPageUsed - pad;
-	CSLP* page = (CSLP*)pageStart;
-	page->set_kind(UNWIND_SECOND_LEVEL_COMPRESSED);
-	page->set_entryPageOffset(sizeof(CSLP));
-	page->set_entryCount(entryCount);
-	page->set_encodingsPageOffset(page->entryPageOffset()+entryCount*sizeof(uint32_t));
-	page->set_encodingsCount(pageSpecificEncodings.size());
-	uint32_t* const encodingsArray = (uint32_t*)&pageStart[page->encodingsPageOffset()];
+	page.startIndex = endIndex - entryCount;
+	page.endIndex = endIndex;
+	page.compressed = true;
+	page.size = compressPageUsed + pad;
+	if (_s_log) fprintf(stderr, "compressed page with %u entries, %lu custom encodings\n", entryCount, pageSpecificEncodings.size());
+}
+
+
+template <typename A>
+void UnwindInfoAtom<A>::fillCompressedSecondLevelPage(const std::vector<UnwindEntry>& uniqueInfos,
+													const EncodingIndexes& commonEncodings, SecondLevelPage& page)
+{
+	std::map<compact_unwind_encoding_t, unsigned int>& pageSpecificEncodings = page.pageSpecificEncodings;
+	const unsigned int entryCount = page.endIndex - page.startIndex;
+	uint8_t* pageStart = page.start;
+	CSLP* pageHeader = (CSLP*)pageStart;
+	pageHeader->set_kind(UNWIND_SECOND_LEVEL_COMPRESSED);
+	pageHeader->set_entryPageOffset(sizeof(CSLP));
+	pageHeader->set_entryCount(entryCount);
+	pageHeader->set_encodingsPageOffset(pageHeader->entryPageOffset()+entryCount*sizeof(uint32_t));
+	pageHeader->set_encodingsCount(pageSpecificEncodings.size());
+	uint32_t* const encodingsArray = (uint32_t*)&pageStart[pageHeader->encodingsPageOffset()];
 	// fill in entry table
-	uint32_t* const entiresArray = (uint32_t*)&pageStart[page->entryPageOffset()];
-	const ld::Atom* firstFunc = uniqueInfos[endIndex-entryCount].func;
-	for(unsigned int i=endIndex-entryCount; i < endIndex; ++i) {
+	uint32_t* const entiresArray = (uint32_t*)&pageStart[pageHeader->entryPageOffset()];
+	const ld::Atom* firstFunc = uniqueInfos[page.startIndex].func;
+	for(unsigned int i=page.startIndex; i < page.endIndex; ++i) {
 		const UnwindEntry& info = uniqueInfos[i];
 		uint8_t encodingIndex;
 		if ( encodingMeansUseDwarf(info.encoding) ) {
@@ -737,33 +806,27 @@ unsigned int UnwindInfoAtom<A>::makeCompressedSecondLevelPage(const std::vector<
 			encodingIndex = pageSpecificEncodings[info.encoding+i];
 		}
 		else {
-			std::map<uint32_t, unsigned int>::const_iterator pos = commonEncodings.find(info.encoding);
-			if ( pos != commonEncodings.end() ) 
-				encodingIndex = pos->second;
+			unsigned int commonIndex;
+			if ( findEncodingIndex(commonEncodings, info.encoding, commonIndex) )
+				encodingIndex = commonIndex;
 			else 
 				encodingIndex = pageSpecificEncodings[info.encoding];
 		}
-		uint32_t entryIndex = i - endIndex + entryCount;
+		uint32_t entryIndex = i - page.startIndex;
 		E::set32(entiresArray[entryIndex], encodingIndex << 24);
 		// add fixup for address part of entry
 		uint32_t offset = (uint8_t*)(&entiresArray[entryIndex]) - _pageAlignedPages;
-		this->addCompressedAddressOffsetFixup(offset, info.func, firstFunc);
+		this->addCompressedAddressOffsetFixup(page.fixups, offset, info.func, firstFunc);
 		if ( encodingMeansUseDwarf(info.encoding) ) {
 			// add fixup for dwarf offset part of page specific encoding
 			uint32_t encOffset = (uint8_t*)(&encodingsArray[encodingIndex-commonEncodings.size()]) - _pageAlignedPages;
-			this->addCompressedEncodingFixup(encOffset, info.fde);
+			this->addCompressedEncodingFixup(page.fixups, encOffset, info.fde);
 		}
 	}
 	// fill in encodings table
 	for(std::map<uint32_t, unsigned int>::const_iterator it = pageSpecificEncodings.begin(); it != pageSpecificEncodings.end(); ++it) {
 		E::set32(encodingsArray[it->second-commonEncodings.size()], it->first);
 	}
-	
-	if (_s_log) fprintf(stderr, "compressed page with %u entries, %lu custom encodings\n", entryCount, pageSpecificEncodings.size());
-	
-	// update pageEnd;
-	pageEnd = pageStart;
-	return endIndex-entryCount;  // endIndex for next page
 }
 
 
@@ -791,97 +854,138 @@ static uint64_t calculateEHFrameSize(ld::Internal& state)
 	return size;
 }
 
-static void getAllUnwindInfos(const ld::Internal& state, std::vector<UnwindEntry>& entries)
+static uint64_t alignAtomAddress(uint64_t address, const ld::Atom* atom)
 {
-	uint64_t address = 0;
-	for (std::vector<ld::Internal::FinalSection*>::const_iterator sit=state.sections.begin(); sit != state.sections.end(); ++sit) {
-		ld::Internal::FinalSection* sect = *sit;
-		for (std::vector<const ld::Atom*>::iterator ait=sect->atoms.begin(); ait != sect->atoms.end(); ++ait) {
-			const ld::Atom* atom = *ait;
-			// adjust address for atom alignment
-			uint64_t alignment = 1 << atom->alignment().powerOf2;
-			uint64_t currentModulus = (address % alignment);
-			uint64_t requiredModulus = atom->alignment().modulus;
-			if ( currentModulus != requiredModulus ) {
-				if ( requiredModulus > currentModulus )
-					address += requiredModulus-currentModulus;
-				else
-					address += requiredModulus+alignment-currentModulus;
-			}
+	uint64_t alignment = 1 << atom->alignment().powerOf2;
+	uint64_t currentModulus = (address % alignment);
+	uint64_t requiredModulus = atom->alignment().modulus;
+	if ( currentModulus != requiredModulus ) {
+		if ( requiredModulus > currentModulus )
+			address += requiredModulus-currentModulus;
+		else
+			address += requiredModulus+alignment-currentModulus;
+	}
+	return address;
+}
 
-			if ( atom->beginUnwind() == atom->endUnwind() ) {
-				// be sure to mark that we have no unwind info for stuff in the TEXT segment without unwind info
-				if ( (atom->section().type() == ld::Section::typeCode) && (atom->size() !=0) ) {
-					entries.push_back(UnwindEntry(atom, address, 0, NULL, NULL, NULL, 0));
-				}
+static void getAtomUnwindInfos(const ld::Internal& state, const ld::Atom* atom, uint64_t address, std::vector<UnwindEntry>& entries)
+{
+	if ( atom->beginUnwind() == atom->endUnwind() ) {
+		// be sure to mark that we have no unwind info for stuff in the TEXT segment without unwind info
+		if ( (atom->section().type() == ld::Section::typeCode) && (atom->size() !=0) ) {
+			entries.push_back(UnwindEntry(atom, address, 0, NULL, NULL, NULL, 0));
+		}
+	}
+	else {
+		// atom has unwind info(s), add entry for each
+		const ld::Atom*	fde = NULL;
+		const ld::Atom*	lsda = NULL; 
+		const ld::Atom*	personalityPointer = NULL; 
+		for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
+			switch ( fit->kind ) {
+				case ld::Fixup::kindNoneGroupSubordinateFDE:
+					assert(fit->binding == ld::Fixup::bindingDirectlyBound);
+					fde = fit->u.target;
+					break;
+				case ld::Fixup::kindNoneGroupSubordinateLSDA:
+					assert(fit->binding == ld::Fixup::bindingDirectlyBound);
+					lsda = fit->u.target;
+					break;
+				case ld::Fixup::kindNoneGroupSubordinatePersonality:
+					assert(fit->binding == ld::Fixup::bindingDirectlyBound);
+					personalityPointer = fit->u.target;
+					assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
+					break;
+				default:
+					break;
 			}
-			else {
-				// atom has unwind info(s), add entry for each
-				const ld::Atom*	fde = NULL;
-				const ld::Atom*	lsda = NULL; 
-				const ld::Atom*	personalityPointer = NULL; 
-				for (ld::Fixup::iterator fit = atom->fixupsBegin(), end=atom->fixupsEnd(); fit != end; ++fit) {
-					switch ( fit->kind ) {
-						case ld::Fixup::kindNoneGroupSubordinateFDE:
-							assert(fit->binding == ld::Fixup::bindingDirectlyBound);
-							fde = fit->u.target;
-							break;
-						case ld::Fixup::kindNoneGroupSubordinateLSDA:
-							assert(fit->binding == ld::Fixup::bindingDirectlyBound);
-							lsda = fit->u.target;
-							break;
-						case ld::Fixup::kindNoneGroupSubordinatePersonality:
-							assert(fit->binding == ld::Fixup::bindingDirectlyBound);
-							personalityPointer = fit->u.target;
-							assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
-							break;
-						default:
-							break;
-					}
-				}
-				if ( fde != NULL ) {
-					// find CIE for this FDE
-					const ld::Atom*	cie = NULL;
-					for (ld::Fixup::iterator fit = fde->fixupsBegin(), end=fde->fixupsEnd(); fit != end; ++fit) {
-						if ( fit->kind != ld::Fixup::kindSubtractTargetAddress )
-							continue;
-						if ( fit->binding != ld::Fixup::bindingDirectlyBound )
-							continue;
-						cie = fit->u.target;
-						// CIE is only direct subtracted target in FDE
-						assert(cie->section().type() == ld::Section::typeCFI);
-						break;
-					}
-					if ( cie != NULL ) {
-						// if CIE can have just one fixup - to the personality pointer
-						for (ld::Fixup::iterator fit = cie->fixupsBegin(), end=cie->fixupsEnd(); fit != end; ++fit) {
-							if ( fit->kind == ld::Fixup::kindSetTargetAddress ) {
-								switch ( fit->binding ) {
-									case ld::Fixup::bindingsIndirectlyBound:
-										personalityPointer = state.indirectBindingTable[fit->u.bindingIndex];
-										assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
-										break;
-									case ld::Fixup::bindingDirectlyBound:
-										personalityPointer = fit->u.target;
-										assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
-										break;
-									default:
-										break;
-								}
-							}
+		}
+		if ( fde != NULL ) {
+			// find CIE for this FDE
+			const ld::Atom*	cie = NULL;
+			for (ld::Fixup::iterator fit = fde->fixupsBegin(), end=fde->fixupsEnd(); fit != end; ++fit) {
+				if ( fit->kind != ld::Fixup::kindSubtractTargetAddress )
+					continue;
+				if ( fit->binding != ld::Fixup::bindingDirectlyBound )
+					continue;
+				cie = fit->u.target;
+				// CIE is only direct subtracted target in FDE
+				assert(cie->section().type() == ld::Section::typeCFI);
+				break;
+			}
+			if ( cie != NULL ) {
+				// if CIE can have just one fixup - to the personality pointer
+				for (ld::Fixup::iterator fit = cie->fixupsBegin(), end=cie->fixupsEnd(); fit != end; ++fit) {
+					if ( fit->kind == ld::Fixup::kindSetTargetAddress ) {
+						switch ( fit->binding ) {
+							case ld::Fixup::bindingsIndirectlyBound:
+								personalityPointer = state.indirectBindingTable[fit->u.bindingIndex];
+								assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
+								break;
+							case ld::Fixup::bindingDirectlyBound:
+								personalityPointer = fit->u.target;
+								assert(personalityPointer->section().type() == ld::Section::typeNonLazyPointer);
+								break;
+							default:
+								break;
 						}
 					}
 				}
-				for ( ld::Atom::UnwindInfo::iterator uit = atom->beginUnwind(); uit != atom->endUnwind(); ++uit ) {
-					entries.push_back(UnwindEntry(atom, address, uit->startOffset, fde, lsda, personalityPointer, uit->unwindInfo));
-				}
 			}
-			address += atom->size();
+		}
+		for ( ld::Atom::UnwindInfo::iterator uit = atom->beginUnwind(); uit != atom->endUnwind(); ++uit ) {
+			entries.push_back(UnwindEntry(atom, address, uit->startOffset, fde, lsda, personalityPointer, uit->unwindInfo));
+		}
+	}
+}
+
+struct AtomRun {
+	const ld::Internal::FinalSection*	sect;
+	size_t								start;
+	size_t								end;
+	uint64_t							address;	// tentative address before aligning atom at start
+};
+
+static void getAllUnwindInfos(const ld::Internal& state, std::vector<UnwindEntry>& entries)
+{
+	// tentative addresses depend on every atom before, so walk all atoms once just
+	// adding up sizes, then scan runs of atoms for unwind info concurrently
+	const size_t atomsPerRun = 4096;
+	std::vector<AtomRun> runs;
+	uint64_t address = 0;
+	for (std::vector<ld::Internal::FinalSection*>::const_iterator sit=state.sections.begin(); sit != state.sections.end(); ++sit) {
+		const ld::Internal::FinalSection* sect = *sit;
+		const size_t atomCount = sect->atoms.size();
+		for (size_t i=0; i < atomCount; ++i) {
+			if ( (i % atomsPerRun) == 0 ) {
+				AtomRun run = { sect, i, std::min(i+atomsPerRun, atomCount), address };
+				runs.push_back(run);
+			}
+			const ld::Atom* atom = sect->atoms[i];
+			address = alignAtomAddress(address, atom) + atom->size();
 		}
 	}
+	std::vector< std::vector<UnwindEntry> > runEntries(runs.size());
+	ld::parallel::forEach(runs.size(), [&](size_t index) {
+		const AtomRun& run = runs[index];
+		uint64_t runAddress = run.address;
+		for (size_t i=run.start; i < run.end; ++i) {
+			const ld::Atom* atom = run.sect->atoms[i];
+			runAddress = alignAtomAddress(runAddress, atom);
+			getAtomUnwindInfos(state, atom, runAddress, runEntries[index]);
+			runAddress += atom->size();
+		}
+	});
+	size_t entryCount = entries.size();
+	for (std::vector< std::vector<UnwindEntry> >::iterator it = runEntries.begin(); it != runEntries.end(); ++it)
+		entryCount += it->size();
+	entries.reserve(entryCount);
+	for (std::vector< std::vector<UnwindEntry> >::iterator it = runEntries.begin(); it != runEntries.end(); ++it)
+		entries.insert(entries.end(), it->begin(), it->end());
 }
 
 
+
 static void makeFinalLinkedImageCompactUnwindSection(const Options& opts, ld::Internal& state)
 {
 	// walk every atom and gets its unwind info
@@ -36,6 +36,7 @@
 #include <unordered_map>
 
 #include "ld.hpp"
+#include "Parallel.hpp"
 #include "order.h"
 
 namespace ld {
@@ -77,15 +78,24 @@ public:
 	void		doPass();
 private:
 
-	class Comparer {
-	public:
-					Comparer(const Layout& l, ld::Internal& s) : _layout(l), _state(s) {}
-		bool		operator()(const ld::Atom* left, const ld::Atom* right);
-	private:
-		const Layout&	_layout;
-		ld::Internal&	_state;
+	// Everything the sort order of an atom depends on, gathered once per atom
+	// so that comparisons do not have to look in maps or follow fixups.
+	struct SortKey {
+		uint64_t			rank;		// kind of atom in top bits, then order file ordinal or tentative bit
+		uint64_t			fileOrdinal;
+		uint64_t			address;
+		uint32_t			notAlias;	// aliases sort before their target
+		const ld::Atom*		sortAs;		// the alias target for aliases, else atom
+		const ld::Atom*		atom;
 	};
-				
+	enum { kRankSectionStart=0, kRankOrdered=1, kRankNormal=2, kRankSectionEnd=3 };
+	enum { kSortSliceSize=0x4000 };		// atoms sorted by one thread before merging
+
+	static bool			keyLess(const SortKey& left, const SortKey& right);
+	const ld::Atom*		aliasTarget(const ld::Atom* atom) const;
+	void				makeSortKey(const ld::Atom* atom, SortKey& key) const;
+	void				sortSection(ld::Internal::FinalSection* sect, std::vector<SortKey>& keys);
+
 	typedef std::unordered_map<const char*, const ld::Atom*, CStringHash, CStringEquals> NameToAtom;
 	
 	typedef std::map<const ld::Atom*, const ld::Atom*> AtomToAtom;
@@ -96,6 +106,8 @@ private:
 	void				buildNameTable();
 	void				buildFollowOnTables();
 	void				buildOrdinalOverrideMap();
+	bool				assignOverrideOrdinal(const ld::Atom* atom, uint32_t& index);
+	void				orderByCallGraph(uint32_t& index);
 	const ld::Atom*		follower(const ld::Atom* atom);
 	static bool			matchesObjectFile(const ld::Atom* atom, const char* objectFileLeafName);
 			bool		possibleToOrder(const ld::Internal::FinalSection*);
@@ -107,7 +119,6 @@ private:
 	NameToAtom							_nameTable;
 	std::vector<const ld::Atom*>		_nameCollisionAtoms;
 	AtomToOrdinal						_ordinalOverrideMap;
-	Comparer							_comparer;
 	bool								_haveOrderFile;
 
 	static bool							_s_log;
@@ -116,150 +127,132 @@ private:
 bool Layout::_s_log = false;
 
 Layout::Layout(const Options& opts, ld::Internal& state)
-	: _options(opts), _state(state), _comparer(*this, state), _haveOrderFile(opts.orderedSymbolsCount() != 0)
+	: _options(opts), _state(state), _haveOrderFile((opts.orderedSymbolsCount() != 0) || !opts.callGraphEdges().empty())
 {
 }
 
 
-bool Layout::Comparer::operator()(const ld::Atom* left, const ld::Atom* right)
+const ld::Atom* Layout::aliasTarget(const ld::Atom* atom) const
 {
-	if ( left == right )
-		return false;
+	for (ld::Fixup::iterator fit=atom->fixupsBegin(); fit != atom->fixupsEnd(); ++fit) {
+		if ( fit->kind == ld::Fixup::kindNoneFollowOn ) {
+			switch ( fit->binding ) {
+				case ld::Fixup::bindingsIndirectlyBound:
+					return _state.indirectBindingTable[fit->u.bindingIndex];
+				case ld::Fixup::bindingDirectlyBound:
+					return fit->u.target;
+				default:
+					return atom;
+			}
+		}
+	}
+	return atom;
+}
+
+void Layout::makeSortKey(const ld::Atom* atom, SortKey& key) const
+{
+	key.atom = atom;
+	key.sortAs = atom;
+	key.fileOrdinal = 0;
+	key.address = 0;
+	key.notAlias = 1;
 
 	// magic section$start symbol always sorts to the start of its section
-	if ( left->contentType() == ld::Atom::typeSectionStart )
-		return true;
-	if ( right->contentType() == ld::Atom::typeSectionStart )
-		return false;
+	if ( atom->contentType() == ld::Atom::typeSectionStart ) {
+		key.rank = (uint64_t)kRankSectionStart << 62;
+		return;
+	}
 
 	// if an -order_file is specified, then sorting is altered to sort those symbols first
-	if ( _layout._haveOrderFile ) {
-		AtomToOrdinal::const_iterator leftPos  = _layout._ordinalOverrideMap.find(left);
-		AtomToOrdinal::const_iterator rightPos = _layout._ordinalOverrideMap.find(right);
-		AtomToOrdinal::const_iterator end = _layout._ordinalOverrideMap.end();
-		if ( leftPos != end ) {
-			if ( rightPos != end ) {
-				// both left and right are overridden, so compare overridden ordinals
-				return leftPos->second < rightPos->second;
-			}
-			else {
-				// left is overridden and right is not, so left < right
-				return true;
-			}
-		}
-		else {
-			if ( rightPos != end ) {
-				// right is overridden and left is not, so right < left
-				return false;
-			}
-			else {
-				// neither are overridden, 
-				// fall into default sorting below
-			}
+	if ( _haveOrderFile ) {
+		AtomToOrdinal::const_iterator pos = _ordinalOverrideMap.find(atom);
+		if ( pos != _ordinalOverrideMap.end() ) {
+			key.rank = ((uint64_t)kRankOrdered << 62) | pos->second;
+			return;
 		}
 	}
 
 	// magic section$end symbol always sorts to the end of its section
-	if ( left->contentType() == ld::Atom::typeSectionEnd )
-		return false;
-	if ( right->contentType() == ld::Atom::typeSectionEnd )
-		return true;
+	if ( atom->contentType() == ld::Atom::typeSectionEnd ) {
+		key.rank = (uint64_t)kRankSectionEnd << 62;
+		return;
+	}
 
-	// aliases sort before their target
-	bool leftIsAlias = left->isAlias();
-	if ( leftIsAlias ) {
-		for (ld::Fixup::iterator fit=left->fixupsBegin(); fit != left->fixupsEnd(); ++fit) {
-			const ld::Atom* target = NULL;
-			if ( fit->kind == ld::Fixup::kindNoneFollowOn ) {
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingsIndirectlyBound:
-						target = _state.indirectBindingTable[fit->u.bindingIndex];
-						break;
-					case ld::Fixup::bindingDirectlyBound:
-						target = fit->u.target;
-						break;
-                    default:
-                        break;   
-				}
-			    if ( target == right )
-					return true; // left already before right
-				left = target; // sort as if alias was its target
-				break;
-		    }
-		}
+	// aliases sort as if they were their target, but before it
+	if ( atom->isAlias() ) {
+		key.sortAs = aliasTarget(atom);
+		key.notAlias = 0;
 	}
-	bool rightIsAlias = right->isAlias();
-    if ( rightIsAlias ) {
-        for (ld::Fixup::iterator fit=right->fixupsBegin(); fit != right->fixupsEnd(); ++fit) {
-			const ld::Atom* target = NULL;
-			if ( fit->kind == ld::Fixup::kindNoneFollowOn ) {
-				switch ( fit->binding ) {
-					case ld::Fixup::bindingsIndirectlyBound:
-						target = _state.indirectBindingTable[fit->u.bindingIndex];
-						break;
-					case ld::Fixup::bindingDirectlyBound:
-						target = fit->u.target;
-						break;
-                    default:
-                        break;   
-				}
-			    if ( target == left )
-                    return false; // need to swap, alias is after target
-				right = target; // continue with sort as if right was target
-                break;
-			}       
-		}
-    }
+	const ld::Atom* sortAs = key.sortAs;
 
 	// the __common section can have real or tentative definitions
 	// we want the real ones to sort before tentative ones
-	bool leftIsTent  =  (left->definition() == ld::Atom::definitionTentative);
-	bool rightIsTent =  (right->definition() == ld::Atom::definitionTentative);
-	if ( leftIsTent != rightIsTent )
-		return rightIsTent; 
-
-#if 0	
-	// initializers are auto sorted to start of section
-	if ( !fInitializerSet.empty() ) {
-		bool leftFirst  = (fInitializerSet.count(left) != 0);
-		bool rightFirst = (fInitializerSet.count(right) != 0);
-		if ( leftFirst != rightFirst ) 
-			return leftFirst;
-	}
+	const bool isTent = (sortAs->definition() == ld::Atom::definitionTentative);
+	key.rank = ((uint64_t)kRankNormal << 62) | (isTent ? 1 : 0);
 
-	// terminators are auto sorted to end of section
-	if ( !fTerminatorSet.empty() ) {
-		bool leftLast  = (fTerminatorSet.count(left) != 0);
-		bool rightLast = (fTerminatorSet.count(right) != 0);
-		if ( leftLast != rightLast ) 
-			return rightLast;
-	}
-#endif
-	
 	// sort by .o order
-	const ld::File* leftFile = left->file();
-	const ld::File* rightFile = right->file();
 	// <rdar://problem/10830126> properly sort if on file is NULL and the other is not
-	ld::File::Ordinal leftFileOrdinal = (leftFile != NULL) ? leftFile->ordinal() : ld::File::Ordinal::NullOrdinal();
-	ld::File::Ordinal rightFileOrdinal = (rightFile != NULL) ? rightFile->ordinal() : ld::File::Ordinal::NullOrdinal();
-	if ( leftFileOrdinal != rightFileOrdinal )
-		return leftFileOrdinal< rightFileOrdinal;
+	const ld::File* file = sortAs->file();
+	ld::File::Ordinal fileOrdinal = (file != NULL) ? file->ordinal() : ld::File::Ordinal::NullOrdinal();
+	key.fileOrdinal = fileOrdinal.value();
 
 	// tentative defintions have no address in .o file, they are traditionally laid out by name
-	if ( leftIsTent && rightIsTent ) 
-		return (strcmp(left->name(), right->name()) < 0);
-
-	// lastly sort by atom address
-	int64_t addrDiff = left->objectAddress() - right->objectAddress();
-	if ( addrDiff == 0 ) {
-		// have same address so one might be an alias, and aliases need to sort before target
-		if ( leftIsAlias != rightIsAlias )
-			return leftIsAlias;
-
-		// both at same address, sort by name 
-		return (strcmp(left->name(), right->name()) < 0);
+	if ( !isTent )
+		key.address = sortAs->objectAddress();
+}
+
+bool Layout::keyLess(const SortKey& left, const SortKey& right)
+{
+	if ( left.rank != right.rank )
+		return (left.rank < right.rank);
+	if ( left.fileOrdinal != right.fileOrdinal )
+		return (left.fileOrdinal < right.fileOrdinal);
+	if ( left.address != right.address )
+		return (left.address < right.address);
+	if ( left.atom == right.atom )
+		return false;
+	// only atoms at the same address get this far
+	if ( (left.rank >> 62) != kRankNormal )
+		return false;
+	if ( left.notAlias != right.notAlias )
+		return (left.notAlias < right.notAlias);
+	// both at same address, sort by name 
+	if ( left.sortAs != right.sortAs ) {
+		if ( int result = strcmp(left.sortAs->name(), right.sortAs->name()) )
+			return (result < 0);
 	}
-	return (addrDiff < 0);
+	return (strcmp(left.atom->name(), right.atom->name()) < 0);
+}
+
+// Large sections are sorted in slices by several threads and then merged.
+void Layout::sortSection(ld::Internal::FinalSection* sect, std::vector<SortKey>& keys)
+{
+	const size_t count = sect->atoms.size();
+	keys.resize(count);
+	const size_t sliceCount = (count + kSortSliceSize - 1) / kSortSliceSize;
+	ld::parallel::forEach(sliceCount, [&](size_t slice) {
+		const size_t start = slice * kSortSliceSize;
+		const size_t end = std::min(start + (size_t)kSortSliceSize, count);
+		for (size_t i=start; i < end; ++i)
+			makeSortKey(sect->atoms[i], keys[i]);
+		std::sort(&keys[start], &keys[end], &keyLess);
+	});
+
+	// merge pairs of sorted runs until one run is left
+	std::vector<SortKey> merged(count);
+	for (size_t runSize=kSortSliceSize; runSize < count; runSize *= 2) {
+		const size_t pairCount = (count + 2*runSize - 1) / (2*runSize);
+		ld::parallel::forEach(pairCount, [&](size_t pair) {
+			const size_t start = pair * 2 * runSize;
+			const size_t middle = std::min(start + runSize, count);
+			const size_t end = std::min(start + 2*runSize, count);
+			std::merge(keys.begin()+start, keys.begin()+middle, keys.begin()+middle, keys.begin()+end, merged.begin()+start, &keyLess);
+		});
+		keys.swap(merged);
+	}
+
+	for (size_t i=0; i < count; ++i)
+		sect->atoms[i] = keys[i].atom;
 }
 
 bool Layout::matchesObjectFile(const ld::Atom* atom, const char* objectFileLeafName)
@@ -490,6 +483,195 @@ private:
 };
 
 
+// Gives atom, or the whole follow-on cluster it is in, the next override
+// ordinals.  Returns false if the cluster was already ordered.
+bool Layout::assignOverrideOrdinal(const ld::Atom* atom, uint32_t& index)
+{
+	AtomToAtom::iterator start = _followOnStarts.find(atom);
+	if ( start != _followOnStarts.end() ) {
+		// this symbol for the order file corresponds to an atom that is in a cluster that must lay out together
+		bool assigned = false;
+		for(const ld::Atom* nextAtom = start->second; nextAtom != NULL; nextAtom = _followOnNexts[nextAtom]) {
+			AtomToOrdinal::iterator pos = _ordinalOverrideMap.find(nextAtom);
+			if ( pos == _ordinalOverrideMap.end() ) {
+				_ordinalOverrideMap[nextAtom] = index++;
+				assigned = true;
+				if (_s_log ) fprintf(stderr, "override ordinal %u assigned to %s in cluster from %s\n", index, nextAtom->name(), nextAtom->file()->path());
+			}
+			else {
+				if (_s_log ) fprintf(stderr, "could not order %s as %u because it was already laid out earlier by %s as %u\n",
+								atom->name(), index, _followOnStarts[atom]->name(), _ordinalOverrideMap[atom] );
+			}
+		}
+		return assigned;
+	}
+	_ordinalOverrideMap[atom] = index;
+	if (_s_log ) fprintf(stderr, "override ordinal %u assigned to %s from %s\n", index, atom->name(), atom->file()->path());
+	return true;
+}
+
+
+//
+// Orders the functions named in a -call_graph_order_file by call-chain
+// clustering (C3, Ottoni & Maher, CGO 2017), which refines Pettis-Hansen.
+//
+// Every function starts in a cluster of its own.  Going from the hottest
+// function to the coldest, each function's cluster is appended to the
+// cluster of the caller that calls it most, unless the result would be too
+// big or much less dense (weight per byte) than the caller's cluster.  The
+// clusters are then laid out densest first, so hot code ends up on as few
+// pages as possible and callers tend to sit just before their callees.
+//
+struct CallGraphNode {
+	const ld::Atom*		atom;
+	uint64_t			weight;			// calls into function, plus samples
+	uint32_t			bestCaller;		// node index, or kNoCaller
+	uint64_t			bestCallerWeight;
+};
+
+struct CallGraphCluster {
+	std::vector<uint32_t>	nodes;		// in layout order
+	uint64_t				size;
+	uint64_t				weight;
+
+	double					density() const { return (double)weight / (double)(size ? size : 1); }
+};
+
+static const uint32_t kNoCaller = 0xFFFFFFFF;
+static const uint64_t kMaxClusterSize = 1024*1024;
+static const unsigned int kMaxDensityDegradation = 8;
+
+static uint32_t clusterLeader(std::vector<uint32_t>& leaders, uint32_t node)
+{
+	while ( leaders[node] != node ) {
+		leaders[node] = leaders[leaders[node]];
+		node = leaders[node];
+	}
+	return node;
+}
+
+void Layout::orderByCallGraph(uint32_t& index)
+{
+	// find a node for every function named in the profile
+	std::vector<CallGraphNode> nodes;
+	std::unordered_map<const ld::Atom*, uint32_t> atomToNode;
+	unsigned long unmatched = 0;
+	std::vector<std::pair<uint32_t, uint32_t> > edgeNodes;
+	edgeNodes.reserve(_options.callGraphEdges().size());
+	for (const Options::CallGraphEdge& edge : _options.callGraphEdges()) {
+		uint32_t ends[2] = { kNoCaller, kNoCaller };
+		const char* names[2] = { edge.caller, edge.callee };
+		for (int i=0; i < 2; ++i) {
+			if ( names[i] == NULL )
+				continue;
+			Options::OrderedSymbol symbol = { names[i], NULL };
+			const ld::Atom* atom = this->findAtom(symbol);
+			if ( (atom == NULL) || (atom->section().type() != ld::Section::typeCode) ) {
+				++unmatched;
+				if ( _options.printOrderFileStatistics() )
+					warning("can't find function for call graph entry: %s", names[i]);
+				continue;
+			}
+			std::unordered_map<const ld::Atom*, uint32_t>::iterator pos = atomToNode.find(atom);
+			if ( pos == atomToNode.end() ) {
+				CallGraphNode node = { atom, 0, kNoCaller, 0 };
+				pos = atomToNode.insert(std::make_pair(atom, (uint32_t)nodes.size())).first;
+				nodes.push_back(node);
+			}
+			ends[i] = pos->second;
+		}
+		edgeNodes.push_back(std::make_pair(ends[0], ends[1]));
+	}
+	if ( _options.printOrderFileStatistics() && (unmatched != 0) )
+		warning("%lu call graph order file entries did not name a function", unmatched);
+
+	// weigh nodes and find the caller each node is called from most
+	for (size_t i=0; i < edgeNodes.size(); ++i) {
+		const uint32_t caller = edgeNodes[i].first;
+		const uint32_t callee = edgeNodes[i].second;
+		const uint64_t weight = _options.callGraphEdges()[i].weight;
+		if ( _options.callGraphEdges()[i].callee == NULL ) {
+			if ( caller != kNoCaller )
+				nodes[caller].weight += weight;
+			continue;
+		}
+		if ( (caller == kNoCaller) || (callee == kNoCaller) || (caller == callee) )
+			continue;
+		CallGraphNode& node = nodes[callee];
+		node.weight += weight;
+		// clusters only work within one section
+		if ( strcmp(nodes[caller].atom->section().sectionName(), node.atom->section().sectionName()) != 0 )
+			continue;
+		if ( weight > node.bestCallerWeight ) {
+			node.bestCaller = caller;
+			node.bestCallerWeight = weight;
+		}
+	}
+
+	// merge clusters, hottest function first
+	std::vector<CallGraphCluster> clusters(nodes.size());
+	std::vector<uint32_t> leaders(nodes.size());
+	std::vector<uint32_t> byWeight(nodes.size());
+	for (uint32_t i=0; i < nodes.size(); ++i) {
+		clusters[i].nodes.push_back(i);
+		clusters[i].size = nodes[i].atom->size();
+		clusters[i].weight = nodes[i].weight;
+		leaders[i] = i;
+		byWeight[i] = i;
+	}
+	std::stable_sort(byWeight.begin(), byWeight.end(), [&](uint32_t left, uint32_t right) {
+		return (nodes[left].weight > nodes[right].weight);
+	});
+	for (uint32_t i : byWeight) {
+		const CallGraphNode& node = nodes[i];
+		// a caller that accounts for a tenth or less of the calls is no reason to move
+		if ( (node.bestCaller == kNoCaller) || (node.bestCallerWeight * 10 <= node.weight) )
+			continue;
+		const uint32_t leader = clusterLeader(leaders, i);
+		const uint32_t callerLeader = clusterLeader(leaders, node.bestCaller);
+		if ( leader == callerLeader )
+			continue;
+		CallGraphCluster& cluster = clusters[leader];
+		CallGraphCluster& callerCluster = clusters[callerLeader];
+		if ( cluster.size + callerCluster.size > kMaxClusterSize )
+			continue;
+		const uint64_t mergedWeight = cluster.weight + callerCluster.weight;
+		const uint64_t mergedSize = cluster.size + callerCluster.size;
+		if ( (double)mergedWeight / (double)(mergedSize ? mergedSize : 1) < callerCluster.density() / kMaxDensityDegradation )
+			continue;
+		callerCluster.nodes.insert(callerCluster.nodes.end(), cluster.nodes.begin(), cluster.nodes.end());
+		callerCluster.size = mergedSize;
+		callerCluster.weight = mergedWeight;
+		cluster.nodes.clear();
+		leaders[leader] = callerLeader;
+	}
+
+	// lay out clusters densest first
+	std::vector<uint32_t> order;
+	for (uint32_t i=0; i < clusters.size(); ++i) {
+		if ( !clusters[i].nodes.empty() )
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+		return (clusters[left].density() > clusters[right].density());
+	});
+	uint32_t orderedCount = 0;
+	for (uint32_t c : order) {
+		for (uint32_t n : clusters[c].nodes) {
+			// the -order_file takes precedence
+			if ( _ordinalOverrideMap.count(nodes[n].atom) != 0 )
+				continue;
+			if ( this->assignOverrideOrdinal(nodes[n].atom, index) ) {
+				++index;
+				++orderedCount;
+			}
+		}
+	}
+	if ( _options.printOrderFileStatistics() )
+		fprintf(stderr, "call graph profile ordered %u functions in %lu clusters\n", orderedCount, order.size());
+}
+
+
 void Layout::buildOrdinalOverrideMap()
 {
 	// if no -order_file, then skip building override map
@@ -524,25 +706,7 @@ void Layout::buildOrdinalOverrideMap()
 					break;
 			}
 		
-			AtomToAtom::iterator start = _followOnStarts.find(atom);
-			if ( start != _followOnStarts.end() ) {
-				// this symbol for the order file corresponds to an atom that is in a cluster that must lay out together
-				for(const ld::Atom* nextAtom = start->second; nextAtom != NULL; nextAtom = _followOnNexts[nextAtom]) {
-					AtomToOrdinal::iterator pos = _ordinalOverrideMap.find(nextAtom);
-					if ( pos == _ordinalOverrideMap.end() ) {
-						_ordinalOverrideMap[nextAtom] = index++;
-						if (_s_log ) fprintf(stderr, "override ordinal %u assigned to %s in cluster from %s\n", index, nextAtom->name(), nextAtom->file()->path());
-					}
-					else {
-						if (_s_log ) fprintf(stderr, "could not order %s as %u because it was already laid out earlier by %s as %u\n",
-										atom->name(), index, _followOnStarts[atom]->name(), _ordinalOverrideMap[atom] );
-					}
-				}
-			}
-			else {
-				_ordinalOverrideMap[atom] = index;
-				if (_s_log ) fprintf(stderr, "override ordinal %u assigned to %s from %s\n", index, atom->name(), atom->file()->path());
-			}
+			this->assignOverrideOrdinal(atom, index);
 			++matchCount;
 		}
 		else {
@@ -559,6 +723,10 @@ void Layout::buildOrdinalOverrideMap()
 		warning("only %u out of %lu order_file symbols were applicable", matchCount, _options.orderedSymbolsCount() );
 	}
 
+	// functions not in the -order_file are laid out as the call graph profile suggests
+	if ( !_options.callGraphEdges().empty() )
+		this->orderByCallGraph(index);
+
 	// <rdar://problem/8612550> When order file used on data, turn ordered zero fill symbols into zeroed data
 	if ( ! moveToData.empty() ) {
 		// <rdar://problem/14919139> only move zero fill symbols to __data if there is a __data section
@@ -615,14 +783,27 @@ void Layout::doPass()
 	// assign new ordinal value to all ordered atoms
 	this->buildOrdinalOverrideMap();
 
-	// sort atoms in each section
+	// sort atoms in each section, small sections in parallel with each other,
+	// large ones one at a time using all threads
+	std::vector<ld::Internal::FinalSection*> smallSections;
+	std::vector<ld::Internal::FinalSection*> largeSections;
 	for (std::vector<ld::Internal::FinalSection*>::iterator sit=_state.sections.begin(); sit != _state.sections.end(); ++sit) {
 		ld::Internal::FinalSection* sect = *sit;
 		if ( sect->type() ==  ld::Section::typeTempAlias )
 			continue;
 		if ( log ) fprintf(stderr, "sorting section %s\n", sect->sectionName());
-		std::sort(sect->atoms.begin(), sect->atoms.end(), _comparer);
+		if ( sect->atoms.size() <= kSortSliceSize )
+			smallSections.push_back(sect);
+		else
+			largeSections.push_back(sect);
 	}
+	ld::parallel::forEach(smallSections.size(), [&](size_t index) {
+		std::vector<SortKey> keys;
+		sortSection(smallSections[index], keys);
+	});
+	std::vector<SortKey> keys;
+	for (ld::Internal::FinalSection* sect : largeSections)
+		sortSection(sect, keys);
 
 	if ( log ) {
 		fprintf(stderr, "Sorted atoms:\n");
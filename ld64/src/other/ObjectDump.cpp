@@ -1289,6 +1289,8 @@ static ld::relocatable::File* createReader(const char* path)
 	objOpts.subType				= sPreferredSubArch;
 	objOpts.treateBitcodeAsData  = false;
 	objOpts.usingBitcode		= true;
+	objOpts.objectCachePath		= NULL;
+	objOpts.parallelParseMinSize = 32*1024*1024;
 #if 1
 	if ( ! foundFatSlice ) {
 		cpu_type_t archOfObj;
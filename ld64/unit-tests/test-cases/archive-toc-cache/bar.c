@@ -0,0 +1 @@
+int bar() { return 1; }
@@ -0,0 +1,3 @@
+extern int bar();
+
+int foo() { return bar() + 1; }
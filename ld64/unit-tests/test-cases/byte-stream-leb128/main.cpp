@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "ByteStream.hpp"
+
+//
+// The encoders as they were before ByteStream grew its multi-byte paths.
+// Used both as the reference output and as the benchmark baseline.
+//
+class ClassicByteStream {
+public:
+	std::vector<uint8_t>	_data;
+
+	unsigned long size() const { return _data.size(); }
+	const uint8_t* start() const { return &_data[0]; }
+
+	void append_uleb128(uint64_t value) {
+		uint8_t byte;
+		do {
+			byte = value & 0x7F;
+			value &= ~0x7F;
+			if ( value != 0 )
+				byte |= 0x80;
+			_data.push_back(byte);
+			value = value >> 7;
+		} while( byte >= 0x80 );
+	}
+
+	void append_sleb128(int64_t value) {
+		bool isNeg = ( value < 0 );
+		uint8_t byte;
+		bool more;
+		do {
+			byte = value & 0x7F;
+			value = value >> 7;
+			if ( isNeg )
+				more = ( (value != -1) || ((byte & 0x40) == 0) );
+			else
+				more = ( (value != 0) || ((byte & 0x40) != 0) );
+			if ( more )
+				byte |= 0x80;
+			_data.push_back(byte);
+		}
+		while( more );
+	}
+
+	void append_delta_encoded_uleb128_run(uint64_t start, const std::vector<uint64_t>& locations) {
+		uint64_t lastAddr = start;
+		for(std::vector<uint64_t>::const_iterator it = locations.begin(); it != locations.end(); ++it) {
+			append_uleb128(*it - lastAddr);
+			lastAddr = *it;
+		}
+	}
+
+	void append_string(const char* str) {
+		for (const char* s = str; *s != '\0'; ++s)
+			_data.push_back(*s);
+		_data.push_back('\0');
+	}
+};
+
+
+static uint64_t randomValue()
+{
+	// spread values over every encoded length, biased toward small ones
+	uint64_t value = ((uint64_t)random() << 32) ^ (uint64_t)random() ^ ((uint64_t)random() << 62);
+	return value >> (random() % 64);
+}
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+template <typename S>
+static void encodeAll(S& stream, const std::vector<uint64_t>& values, const std::vector<uint64_t>& locations)
+{
+	for (std::vector<uint64_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+		stream.append_uleb128(*it);
+		stream.append_sleb128((int64_t)*it);
+		stream.append_sleb128((int64_t)(0 - *it));
+	}
+	stream.append_string("_objc_msgSend");
+	stream.append_delta_encoded_uleb128_run(0x1000, locations);
+}
+
+template <typename S>
+static double timeEncoding(const std::vector<uint64_t>& values, const std::vector<uint64_t>& locations, std::vector<uint8_t>& result)
+{
+	const int kRounds = 20;
+	double start = now();
+	for (int i=0; i < kRounds; ++i) {
+		S stream;
+		encodeAll(stream, values, locations);
+		if ( i == 0 )
+			result.assign(stream.start(), stream.start() + stream.size());
+	}
+	return (now() - start) / kRounds;
+}
+
+
+
+int main()
+{
+	srandom(42);
+	std::vector<uint64_t> values;
+	for (int i=0; i < 1000000; ++i)
+		values.push_back(randomValue());
+	// edge cases for every length boundary
+	for (int shift=0; shift < 64; ++shift) {
+		values.push_back((1ULL << shift) - 1);
+		values.push_back(1ULL << shift);
+	}
+	values.push_back(0x8000000000000000ULL);
+	values.push_back(0xFFFFFFFFFFFFFFFFULL);
+
+	// typical rebase/function-starts deltas: small strides with occasional gaps
+	std::vector<uint64_t> locations;
+	uint64_t addr = 0x1000;
+	for (int i=0; i < 1000000; ++i) {
+		addr += (random() % 16 == 0) ? (random() % 0x100000) + 1 : 8;
+		locations.push_back(addr);
+	}
+
+	std::vector<uint8_t> classic;
+	std::vector<uint8_t> current;
+	double classicTime = timeEncoding<ClassicByteStream>(values, locations, classic);
+	double currentTime = timeEncoding<ld::tool::ByteStream>(values, locations, current);
+
+	printf("classic:    %8.3f ms\n", classicTime * 1000.0);
+	printf("ByteStream: %8.3f ms\n", currentTime * 1000.0);
+
+	if ( classic != current ) {
+		fprintf(stderr, "ByteStream output differs from classic encoding\n");
+		return 1;
+	}
+	for (std::vector<uint64_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+		ld::tool::ByteStream s;
+		s.append_uleb128(*it);
+		if ( s.size() != ld::tool::ByteStream::uleb128_size(*it) ) {
+			fprintf(stderr, "uleb128_size(0x%llX) is wrong\n", (unsigned long long)*it);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,2 @@
+# caller callee calls
+_main	_hot1	100	7
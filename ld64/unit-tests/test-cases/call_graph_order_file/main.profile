@@ -0,0 +1,5 @@
+# caller callee calls
+_main	_hot1	100
+_hot1	_hot2	90
+# sample count only
+_cold2	1
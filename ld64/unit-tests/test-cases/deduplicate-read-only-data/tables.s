@@ -0,0 +1,26 @@
+
+			.section __TEXT,__const
+			.align 2
+
+			.globl _tableA
+			.weak_def_can_be_hidden _tableA
+_tableA:	.long 1
+			.long 2
+			.long 3
+			.long 4
+
+			.globl _tableB
+			.weak_def_can_be_hidden _tableB
+_tableB:	.long 1
+			.long 2
+			.long 3
+			.long 4
+
+			.globl _tableC
+			.weak_def_can_be_hidden _tableC
+_tableC:	.long 1
+			.long 2
+			.long 3
+			.long 5
+
+			.subsections_via_symbols
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+static const char* names[] = { "one", "two", "three" };
+
+const char* foo(int i)
+{
+	return names[i % 3];
+}
+
+void bar(const char* str)
+{
+	printf("%s\n", str);
+}
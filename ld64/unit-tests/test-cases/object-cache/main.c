@@ -0,0 +1,9 @@
+extern const char* foo(int);
+extern void bar(const char*);
+
+int main(int argc, const char* argv[])
+{
+	bar(foo(argc));
+	bar("hello");
+	return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+
+static const char* names[] = { "one", "two", "three" };
+static int counts[3];
+
+const char* foo(int i)
+{
+	++counts[i % 3];
+	return names[i % 3];
+}
+
+static void report(const char* str)
+{
+	printf("%s %d\n", str, counts[0] + counts[1] + counts[2]);
+}
+
+void (*reporter)(const char*) = &report;
+
+int bar(int i)
+{
+	switch ( i ) {
+		case 0: return 10;
+		case 1: return 20;
+		case 2: return 35;
+		case 3: return 47;
+		case 4: return 51;
+		default: return i;
+	}
+}
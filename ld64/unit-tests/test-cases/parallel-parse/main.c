@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+extern const char* foo(int);
+extern int bar(int);
+extern void (*reporter)(const char*);
+
+static const char* message = "done";
+
+int main()
+{
+	for (int i=0; i < 5; ++i)
+		printf("%s %d\n", foo(i), bar(i));
+	reporter(message);
+	return 0;
+}
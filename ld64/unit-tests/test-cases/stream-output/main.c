@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+#include <stdio.h>
+
+//
+// Two 20MB tables put more than one 32MB window's worth of content in
+// __TEXT, so the file is written in several windows, with the header in
+// a window of its own.  The pointers need rebasing in __DATA, the bss
+// array is zero fill with no file content, and the strings go in
+// __cstring.
+//
+
+#define TABLE_SIZE (20*1024*1024)
+
+const char table1[TABLE_SIZE] = { 1, 2, 3, [TABLE_SIZE-1] = 4 };
+const char table2[TABLE_SIZE] = { 5, 6, 7, [TABLE_SIZE-1] = 8 };
+
+const char* const tables[] = { table1, table2 };
+char scratch[1024*1024];
+
+static int sum(const char* table)
+{
+	return table[0] + table[1] + table[2] + table[TABLE_SIZE-1];
+}
+
+int (*summer)(const char*) = &sum;
+
+int main()
+{
+	int total = 0;
+	for (int i=0; i < 2; ++i)
+		total += summer(tables[i]);
+	scratch[0] = (char)total;
+	printf("total: %d\n", total);
+	return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2016 Apple Inc. All rights reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "WildcardMatcher.hpp"
+
+//
+// The matcher as it was before patterns were compiled: every pattern is
+// tried in turn with a recursive backtracking match.  Used both as the
+// reference result and as the benchmark baseline.
+//
+class ClassicWildcards {
+public:
+	std::vector<const char*>	_patterns;
+
+	void insert(const char* pattern) { _patterns.push_back(pattern); }
+
+	bool matches(const char* symbol) const {
+		for (std::vector<const char*>::const_iterator it = _patterns.begin(); it != _patterns.end(); ++it) {
+			if ( wildCardMatch(*it, symbol) )
+				return true;
+		}
+		return false;
+	}
+
+	static bool inCharRange(const char*& p, unsigned char c) {
+		++p; // find end
+		const char* b = p;
+		while ( *p != '\0' ) {
+			if ( *p == ']') {
+				const char* e = p;
+				// found beginining [ and ending ]
+				unsigned char last = '\0';
+				for ( const char* s = b; s < e; ++s ) {
+					if ( *s == '-' ) {
+						unsigned char next = *(++s);
+						if ( (last <= c) && (c <= next) )
+							return true;
+						++s;
+					}
+					else {
+						if ( *s == c )
+							return true;
+						last = *s;
+					}
+				}
+				return false;
+			}
+			++p;
+		}
+		return false;
+	}
+
+	static bool wildCardMatch(const char* pattern, const char* symbol) {
+		const char* s = symbol;
+		for (const char* p = pattern; *p != '\0'; ++p) {
+			switch ( *p ) {
+				case '*':
+					if ( p[1] == '\0' )
+						return true;
+					for (const char* t = s; *t != '\0'; ++t) {
+						if ( wildCardMatch(&p[1], t) )
+							return true;
+					}
+					return false;
+				case '?':
+					if ( *s == '\0' )
+						return false;
+					++s;
+					break;
+				case '[':
+					if ( ! inCharRange(p, *s) )
+						return false;
+					++s;
+					break;
+				default:
+					if ( *s != *p )
+						return false;
+					++s;
+			}
+		}
+		return (*s == '\0');
+	}
+};
+
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static std::string randomIdentifier(int length)
+{
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+	std::string result;
+	for (int i=0; i < length; ++i)
+		result += chars[random() % (sizeof(chars) - 1)];
+	return result;
+}
+
+// names shaped like C++ mangled names, sharing a few namespaces
+static std::string randomName(const std::vector<std::string>& namespaces)
+{
+	std::string name = "__ZN";
+	const std::string& ns = namespaces[random() % namespaces.size()];
+	char len[16];
+	snprintf(len, sizeof(len), "%d", (int)ns.size());
+	name += len;
+	name += ns;
+	std::string member = randomIdentifier(8 + (random() % 20));
+	snprintf(len, sizeof(len), "%d", (int)member.size());
+	name += len;
+	name += member;
+	name += "Ev";
+	return name;
+}
+
+// export-list style patterns: mostly "prefix*", some with '?', '[...]' and several '*'
+static std::string randomPattern(const std::vector<std::string>& namespaces)
+{
+	std::string name = randomName(namespaces);
+	switch ( random() % 6 ) {
+		case 0:
+		case 1:
+			return name.substr(0, name.size() - 2 - (random() % 5)) + "*";
+		case 2:
+			return "*" + name.substr(name.size() - 8 - (random() % 6));
+		case 3:
+			name[4 + (random() % (name.size() - 4))] = '?';
+			return name;
+		case 4:
+			return name.substr(0, name.size() - 10) + "[a-mA-M0-4]*" + name.substr(name.size() - 5);
+		default:
+			return name.substr(0, 8) + "*" + name.substr(name.size() - 8, 4) + "*Ev";
+	}
+}
+
+template <typename M>
+static double timeMatching(const M& matcher, const std::vector<std::string>& names, std::vector<bool>& results)
+{
+	double start = now();
+	results.clear();
+	for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+		results.push_back(matcher.matches(it->c_str()));
+	return now() - start;
+}
+
+
+
+int main()
+{
+	srandom(42);
+	std::vector<std::string> namespaces;
+	for (int i=0; i < 50; ++i)
+		namespaces.push_back(randomIdentifier(3 + (random() % 10)));
+
+	std::vector<std::string> patterns;
+	for (int i=0; i < 5000; ++i)
+		patterns.push_back(randomPattern(namespaces));
+	// edge cases of the pattern syntax
+	patterns.push_back("_edge[abc");
+	patterns.push_back("_edge[]x]");
+	patterns.push_back("_edge[a-cx]");
+	patterns.push_back("_edge?*?");
+	patterns.push_back("_edge*a*b*c*d");
+
+	ClassicWildcards classic;
+	ld::tool::WildcardMatcher compiled;
+	for (std::vector<std::string>::const_iterator it = patterns.begin(); it != patterns.end(); ++it) {
+		classic.insert(it->c_str());
+		compiled.insert(it->c_str());
+	}
+
+	std::vector<std::string> names;
+	for (int i=0; i < 5000; ++i)
+		names.push_back(randomName(namespaces));
+	const char* edgeNames[] = { "_edge", "_edgea", "_edge[abc", "_edge]x]", "_edgex", "_edgeb", "_edgeab",
+								"_edgeaXbYcZd", "_edgeabcd", "_edgeaaabbbcccddd", "_edgeabdc", NULL };
+	for (const char** p = edgeNames; *p != NULL; ++p)
+		names.push_back(*p);
+
+	std::vector<bool> classicResults;
+	std::vector<bool> compiledResults;
+	double classicTime = timeMatching(classic, names, classicResults);
+	double compiledTime = timeMatching(compiled, names, compiledResults);
+
+	printf("%lu patterns, %lu names\n", patterns.size(), names.size());
+	printf("classic:         %8.3f ms\n", classicTime * 1000.0);
+	printf("WildcardMatcher: %8.3f ms\n", compiledTime * 1000.0);
+
+	unsigned matchCount = 0;
+	for (size_t i=0; i < names.size(); ++i) {
+		if ( classicResults[i] != compiledResults[i] ) {
+			fprintf(stderr, "WildcardMatcher says %d for %s, classic matcher says %d\n",
+					(int)compiledResults[i], names[i].c_str(), (int)classicResults[i]);
+			return 1;
+		}
+		if ( classicResults[i] )
+			++matchCount;
+	}
+	printf("%u names matched\n", matchCount);
+	return 0;
+}